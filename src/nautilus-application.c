@@ -43,6 +43,7 @@
 #include "nautilus-debug.h"
 
 #include "nautilus-bookmark-list.h"
+#include "nautilus-canvas-container.h"
 #include "nautilus-dbus-manager.h"
 #include "nautilus-directory-private.h"
 #include "nautilus-file.h"
@@ -54,11 +55,13 @@
 #include "nautilus-global-preferences.h"
 #include "nautilus-icon-info.h"
 #include "nautilus-lib-self-check-functions.h"
+#include "nautilus-list-model.h"
 #include "nautilus-module.h"
 #include "nautilus-preferences-window.h"
 #include "nautilus-previewer.h"
 #include "nautilus-profile.h"
 #include "nautilus-progress-persistence-handler.h"
+#include "nautilus-search-engine-index.h"
 #include "nautilus-self-check-functions.h"
 #include "nautilus-shell-search-provider.h"
 #include "nautilus-signaller.h"
@@ -1298,6 +1301,90 @@ icon_theme_changed_callback (GtkIconTheme *icon_theme,
     emit_change_signals_for_all_files_in_all_directories ();
 }
 
+/* The content types most folders are made of */
+static const char *prewarm_content_types[] =
+{
+    "inode/directory",
+    "text/plain",
+    "application/pdf",
+    "image/jpeg",
+    "image/png",
+    "audio/mpeg",
+    "video/mp4",
+    "application/zip",
+    "application/x-compressed-tar",
+    "application/vnd.oasis.opendocument.text",
+    "application/x-executable",
+    "application/octet-stream",
+};
+
+/* Icons of special folders, which nautilus_file_get_gicon() uses instead
+ * of the icon for their content type */
+static const char *prewarm_icon_names[] =
+{
+    "folder-remote",
+    "user-home",
+    "user-desktop",
+    "user-trash",
+    "user-trash-full",
+    "folder-documents",
+    "folder-download",
+    "folder-music",
+    "folder-pictures",
+    "folder-publicshare",
+    "folder-templates",
+    "folder-videos",
+};
+
+/* Loads the icons of the common file types and folders at the sizes of the
+ * default zoom levels, so that showing the first folder does not have to
+ * wait on icon theme lookups.
+ */
+static void
+prewarm_icon_cache (void)
+{
+    GdkDisplay *display;
+    GdkMonitor *monitor;
+    GList *icons = NULL;
+    NautilusCanvasZoomLevel canvas_zoom_level;
+    NautilusListZoomLevel list_zoom_level;
+    int sizes[2];
+    int scale = 1;
+    guint i;
+
+    display = gdk_display_get_default ();
+    monitor = display != NULL ? gdk_display_get_primary_monitor (display) : NULL;
+    if (monitor == NULL && display != NULL && gdk_display_get_n_monitors (display) > 0)
+    {
+        monitor = gdk_display_get_monitor (display, 0);
+    }
+    if (monitor != NULL)
+    {
+        scale = gdk_monitor_get_scale_factor (monitor);
+    }
+
+    canvas_zoom_level = g_settings_get_enum (nautilus_icon_view_preferences,
+                                             NAUTILUS_PREFERENCES_ICON_VIEW_DEFAULT_ZOOM_LEVEL);
+    list_zoom_level = g_settings_get_enum (nautilus_list_view_preferences,
+                                           NAUTILUS_PREFERENCES_LIST_VIEW_DEFAULT_ZOOM_LEVEL);
+    sizes[0] = nautilus_canvas_container_get_icon_size_for_zoom_level (canvas_zoom_level);
+    sizes[1] = nautilus_list_model_get_icon_size_for_zoom_level (list_zoom_level);
+
+    for (i = 0; i < G_N_ELEMENTS (prewarm_content_types); i++)
+    {
+        icons = g_list_prepend (icons, g_content_type_get_icon (prewarm_content_types[i]));
+    }
+    for (i = 0; i < G_N_ELEMENTS (prewarm_icon_names); i++)
+    {
+        icons = g_list_prepend (icons, g_themed_icon_new (prewarm_icon_names[i]));
+    }
+    icons = g_list_reverse (icons);
+
+    nautilus_icon_info_prewarm_cache (icons, sizes, sizes[0] == sizes[1] ? 1 : 2, scale);
+
+    g_list_free_full (icons, g_object_unref);
+}
+
 void
 nautilus_application_startup_common (NautilusApplication *self)
 {
@@ -1350,6 +1437,10 @@ nautilus_application_startup_common (NautilusApplication *self)
                              "changed",
                              G_CALLBACK (icon_theme_changed_callback),
                              NULL, 0);
+
+    prewarm_icon_cache ();
+
+    nautilus_search_engine_index_setup ();
 }
 
 static void
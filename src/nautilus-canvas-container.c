@@ -39,10 +39,12 @@
 #define DEBUG_FLAG NAUTILUS_DEBUG_CANVAS_CONTAINER
 #include "nautilus-debug.h"
 
+#include "nautilus-canvas-label-cache.h"
 #include "nautilus-canvas-private.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-icon-info.h"
 #include "nautilus-lib-self-check-functions.h"
+#include "nautilus-profile.h"
 #include "nautilus-selection-canvas-item.h"
 
 /* Interval for updating the rubberband selection, in milliseconds.  */
@@ -102,6 +104,16 @@
 /* Copied from NautilusCanvasContainer */
 #define NAUTILUS_CANVAS_CONTAINER_SEARCH_DIALOG_TIMEOUT 5
 
+/* Labels of folders with fewer icons are quick enough to measure on demand */
+#define LABEL_CACHE_PREFILL_MIN_ICONS 500
+/* Wait for loading and layout to settle before measuring labels ahead */
+#define LABEL_CACHE_PREFILL_DELAY_SECONDS 2
+/* Label measurements per icon: the ellipsized and entire name and the
+ * additional text at the current zoom level, and the ellipsized and entire
+ * name at each of the neighbouring zoom levels measured ahead.
+ */
+#define LABEL_CACHE_ENTRIES_PER_ICON 7
+
 /* Copied from NautilusFile */
 #define UNDEFINED_TIME ((time_t) (-1))
 
@@ -144,10 +156,18 @@ static void          handle_vadjustment_changed (GtkAdjustment           *adjust
                                                  NautilusCanvasContainer *container);
 static GList *nautilus_canvas_container_get_selected_icons (NautilusCanvasContainer *container);
 static void          nautilus_canvas_container_update_visible_icons (NautilusCanvasContainer *container);
+static void          nautilus_canvas_container_cancel_prefetch (NautilusCanvasContainer *container,
+                                                                NautilusCanvasIcon      *icon);
+static void          nautilus_canvas_container_deprioritize_thumbnailing (NautilusCanvasContainer *container,
+                                                                          NautilusCanvasIcon      *icon);
+static void          icon_set_visible (NautilusCanvasContainer *container,
+                                       NautilusCanvasIcon      *icon,
+                                       gboolean                 visible);
 static void          reveal_icon (NautilusCanvasContainer *container,
                                   NautilusCanvasIcon      *icon);
 
-static void          nautilus_canvas_container_set_rtl_positions (NautilusCanvasContainer *container);
+static void          nautilus_canvas_container_set_rtl_positions (NautilusCanvasContainer *container,
+                                                                  GList                   *icons);
 static double        get_mirror_x_position (NautilusCanvasContainer *container,
                                             NautilusCanvasIcon      *icon,
                                             double                   x);
@@ -162,6 +182,11 @@ static int compare_icons_vertical (NautilusCanvasContainer *container,
                                    NautilusCanvasIcon      *icon_b);
 
 static void schedule_redo_layout (NautilusCanvasContainer *container);
+static void invalidate_label_font (NautilusCanvasContainer *container);
+static void schedule_label_cache_prefill (NautilusCanvasContainer *container);
+static void unschedule_label_cache_prefill (NautilusCanvasContainer *container);
+static void cancel_label_cache_prefill (NautilusCanvasContainer *container);
+static void update_label_cache_reservation (NautilusCanvasContainer *container);
 
 static const char *nautilus_canvas_container_accessible_action_names[] =
 {
@@ -365,11 +390,26 @@ icon_raise (NautilusCanvasIcon *icon)
     eel_canvas_item_send_behind (item, band);
 }
 
+/* Records that the selection state of @data flipped, for
+ * nautilus_canvas_container_steal_selection_changes (). Flipping it back
+ * cancels the change out.
+ */
+static void
+record_selection_change (NautilusCanvasContainer *container,
+                         NautilusCanvasIconData  *data)
+{
+    if (!g_hash_table_remove (container->details->selection_changes, data))
+    {
+        g_hash_table_add (container->details->selection_changes, data);
+    }
+}
+
 static void
 icon_toggle_selected (NautilusCanvasContainer *container,
                       NautilusCanvasIcon      *icon)
 {
     icon->is_selected = !icon->is_selected;
+    record_selection_change (container, icon->data);
     if (icon->is_selected)
     {
         container->details->selection = g_list_prepend (container->details->selection, icon->data);
@@ -1088,6 +1128,17 @@ resort (NautilusCanvasContainer *container)
     cache_icon_positions (container);
 }
 
+/* Makes the next layout reposition every icon, instead of only laying down
+ * newly appended ones. Needed whenever the width, the zoom level, the sort
+ * order or the size of an already positioned icon changes.
+ */
+static void
+invalidate_layout (NautilusCanvasContainer *container)
+{
+    container->details->layout_last_line_start = NULL;
+    container->details->layout_last_icon = NULL;
+}
+
 typedef struct
 {
     double width;
@@ -1135,46 +1186,23 @@ lay_down_one_line (NautilusCanvasContainer *container,
     }
 }
 
-static void
-lay_down_icons_horizontal (NautilusCanvasContainer *container,
-                           GList                   *icons,
-                           double                   start_y)
+/* Returns the width of a grid unit for laying down @icons. When @is_stable is
+ * not NULL, it is set to whether the width is independent of the number of
+ * icons, i.e. whether icons can be appended without changing it.
+ */
+static double
+get_grid_width (NautilusCanvasContainer *container,
+                GList                   *icons,
+                double                   canvas_width,
+                gboolean                *is_stable)
 {
-    GList *p, *line_start;
-    NautilusCanvasIcon *icon;
-    double canvas_width, y;
     double available_width;
-    GArray *positions;
-    IconPositions *position;
-    EelDRect bounds;
-    EelDRect icon_bounds;
-    double max_height_above, max_height_below;
-    double height_above, height_below;
-    double line_width;
     double min_grid_width;
     double grid_width;
     double num_columns;
-    double icon_width, icon_size;
-    int i;
-    GtkAllocation allocation;
-
-    g_assert (NAUTILUS_IS_CANVAS_CONTAINER (container));
-
-    /* We can't get the right allocation if the size hasn't been allocated yet */
-    g_return_if_fail (container->details->has_been_allocated);
-
-    if (icons == NULL)
-    {
-        return;
-    }
-
-    positions = g_array_new (FALSE, FALSE, sizeof (IconPositions));
-    gtk_widget_get_allocation (GTK_WIDGET (container), &allocation);
+    gboolean stable;
 
-    /* Lay out icons a line at a time. */
-    canvas_width = CANVAS_WIDTH (container, allocation);
     min_grid_width = nautilus_canvas_container_get_grid_size_for_zoom_level (container->details->zoom_level);
-    icon_size = nautilus_canvas_container_get_icon_size_for_zoom_level (container->details->zoom_level);
 
     /* Subtracting 1.0 adds some room for error to prevent the jitter due to
      * the code not being able to decide how many columns should be there, as
@@ -1187,7 +1215,8 @@ lay_down_icons_horizontal (NautilusCanvasContainer *container,
     available_width = MAX (1.0, canvas_width - ICON_PAD_LEFT - ICON_PAD_RIGHT - 1.0);
     num_columns = MAX (1.0, floor (available_width / min_grid_width));
 
-    if (g_list_nth (icons, num_columns) != NULL)
+    stable = g_list_nth (icons, num_columns) != NULL;
+    if (stable)
     {
         grid_width = available_width / num_columns;
     }
@@ -1225,11 +1254,58 @@ lay_down_icons_horizontal (NautilusCanvasContainer *container,
         grid_width = min_grid_width * (1 + extra_fraction);
     }
 
-    grid_width = MAX (min_grid_width, grid_width);
+    if (is_stable != NULL)
+    {
+        *is_stable = stable;
+    }
+
+    return MAX (min_grid_width, grid_width);
+}
+
+/* Lays down @icons line by line, the first line starting at @start_y, and
+ * remembers where the last line started so that icons appended later can be
+ * laid down from there.
+ */
+static void
+lay_down_icons_horizontal (NautilusCanvasContainer *container,
+                           GList                   *icons,
+                           double                   grid_width,
+                           double                   start_y)
+{
+    GList *p, *line_start;
+    NautilusCanvasIcon *icon;
+    double canvas_width, y;
+    GArray *positions;
+    IconPositions *position;
+    EelDRect bounds;
+    EelDRect icon_bounds;
+    double max_height_above, max_height_below;
+    double height_above, height_below;
+    double line_width;
+    double icon_width, icon_size;
+    int i;
+    GtkAllocation allocation;
+
+    g_assert (NAUTILUS_IS_CANVAS_CONTAINER (container));
+
+    /* We can't get the right allocation if the size hasn't been allocated yet */
+    g_return_if_fail (container->details->has_been_allocated);
+
+    if (icons == NULL)
+    {
+        return;
+    }
+
+    positions = g_array_new (FALSE, FALSE, sizeof (IconPositions));
+    gtk_widget_get_allocation (GTK_WIDGET (container), &allocation);
+
+    /* Lay out icons a line at a time. */
+    canvas_width = CANVAS_WIDTH (container, allocation);
+    icon_size = nautilus_canvas_container_get_icon_size_for_zoom_level (container->details->zoom_level);
 
     line_width = 0;
     line_start = icons;
-    y = start_y + CONTAINER_PAD_TOP;
+    y = start_y;
     i = 0;
 
     max_height_above = 0;
@@ -1300,6 +1376,13 @@ lay_down_icons_horizontal (NautilusCanvasContainer *container,
     /* Lay down that last line of icons. */
     if (line_start != NULL)
     {
+        /* The last line is laid down again whenever icons are appended,
+         * since they might end up on it and change its height.
+         */
+        container->details->layout_last_line_start = line_start->data;
+        container->details->layout_last_line_y = y;
+        container->details->layout_grid_width = grid_width;
+
         /* Advance to the baseline. */
         y += ICON_PAD_TOP + max_height_above;
 
@@ -1323,19 +1406,16 @@ get_mirror_x_position (NautilusCanvasContainer *container,
     return CANVAS_WIDTH (container, allocation) - x - (icon_bounds.x1 - icon_bounds.x0);
 }
 
+/* Mirrors the positions of @icons and every icon after them in the icon list. */
 static void
-nautilus_canvas_container_set_rtl_positions (NautilusCanvasContainer *container)
+nautilus_canvas_container_set_rtl_positions (NautilusCanvasContainer *container,
+                                             GList                   *icons)
 {
     GList *l;
     NautilusCanvasIcon *icon;
     double x;
 
-    if (!container->details->icons)
-    {
-        return;
-    }
-
-    for (l = container->details->icons; l != NULL; l = l->next)
+    for (l = icons; l != NULL; l = l->next)
     {
         icon = l->data;
         x = get_mirror_x_position (container, icon, icon->saved_ltr_x);
@@ -1348,33 +1428,168 @@ lay_down_icons (NautilusCanvasContainer *container,
                 GList                   *icons,
                 double                   start_y)
 {
-    lay_down_icons_horizontal (container, icons, start_y);
+    GtkAllocation allocation;
+    double grid_width;
+    gboolean grid_width_is_stable;
+
+    invalidate_layout (container);
+
+    if (icons == NULL)
+    {
+        return;
+    }
+
+    gtk_widget_get_allocation (GTK_WIDGET (container), &allocation);
+    grid_width = get_grid_width (container, icons,
+                                 CANVAS_WIDTH (container, allocation),
+                                 &grid_width_is_stable);
+
+    lay_down_icons_horizontal (container, icons, grid_width, start_y + CONTAINER_PAD_TOP);
+
+    container->details->layout_last_icon = g_list_last (icons)->data;
+
+    /* While there is only one line the grid width depends on the number of
+     * icons, so appending icons means laying down everything again.
+     */
+    if (!grid_width_is_stable)
+    {
+        invalidate_layout (container);
+    }
+}
+
+/* Whether all the pending new icons can be appended after the icons that
+ * are already laid down, without disturbing their positions.
+ */
+static gboolean
+can_lay_down_new_icons_incrementally (NautilusCanvasContainer *container)
+{
+    NautilusCanvasContainerDetails *details;
+    GList *p;
+
+    details = container->details;
+
+    if (details->layout_last_line_start == NULL ||
+        details->new_icons == NULL)
+    {
+        return FALSE;
+    }
+
+    for (p = details->new_icons; p != NULL; p = p->next)
+    {
+        if (compare_icons (p->data, details->layout_last_icon, container) <= 0)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Moves the @n_new_icons icons that nautilus_canvas_container_add () put at
+ * the head of the icon list to its end, in sorted order, and lays them down
+ * starting from the last line of the previous layout.
+ */
+static void
+lay_down_new_icons_incrementally (NautilusCanvasContainer *container,
+                                  guint                    n_new_icons)
+{
+    NautilusCanvasContainerDetails *details;
+    GList *new_icons, *old_icons, *last, *line_start, *p;
+    int position;
+
+    details = container->details;
+
+    new_icons = details->icons;
+    old_icons = g_list_nth (new_icons, n_new_icons);
+    g_assert (old_icons != NULL);
+
+    old_icons->prev->next = NULL;
+    old_icons->prev = NULL;
+    sort_icons (container, &new_icons);
+
+    last = g_list_last (old_icons);
+    g_assert (last->data == details->layout_last_icon);
+    last->next = new_icons;
+    new_icons->prev = last;
+    details->icons = old_icons;
+
+    position = details->layout_last_icon->position;
+    for (p = new_icons; p != NULL; p = p->next)
+    {
+        ((NautilusCanvasIcon *) p->data)->position = ++position;
+    }
+
+    line_start = last;
+    while (line_start->data != details->layout_last_line_start)
+    {
+        line_start = line_start->prev;
+    }
+
+    lay_down_icons_horizontal (container, line_start,
+                               details->layout_grid_width,
+                               details->layout_last_line_y);
+
+    /* The icons before the last line kept their mirrored positions */
+    if (nautilus_canvas_container_is_layout_rtl (container))
+    {
+        nautilus_canvas_container_set_rtl_positions (container, line_start);
+    }
+
+    details->layout_last_icon = g_list_last (new_icons)->data;
 }
 
 static void
 redo_layout_internal (NautilusCanvasContainer *container)
 {
     gboolean layout_possible;
+    gboolean incremental;
+    guint n_new_icons;
+
+    incremental = can_lay_down_new_icons_incrementally (container);
+    n_new_icons = g_list_length (container->details->new_icons);
+
+    nautilus_profile_start ("%s layout, %u new icons, %u icons",
+                            incremental ? "incremental" : "full",
+                            n_new_icons,
+                            g_hash_table_size (container->details->icon_set));
 
     layout_possible = finish_adding_new_icons (container);
     if (!layout_possible)
     {
         schedule_redo_layout (container);
+        nautilus_profile_end (NULL);
         return;
     }
 
-    if (container->details->needs_resort)
+    if (incremental)
     {
-        resort (container);
+        lay_down_new_icons_incrementally (container, n_new_icons);
         container->details->needs_resort = FALSE;
     }
-    lay_down_icons (container, container->details->icons, 0);
+    else if (n_new_icons > 0 || container->details->layout_last_line_start == NULL)
+    {
+        if (container->details->needs_resort)
+        {
+            resort (container);
+            container->details->needs_resort = FALSE;
+        }
+        lay_down_icons (container, container->details->icons, 0);
 
-    if (nautilus_canvas_container_is_layout_rtl (container))
+        if (nautilus_canvas_container_is_layout_rtl (container))
+        {
+            nautilus_canvas_container_set_rtl_positions (container, container->details->icons);
+        }
+    }
+
+    if (n_new_icons > 0 || !incremental)
     {
-        nautilus_canvas_container_set_rtl_positions (container);
+        update_label_cache_reservation (container);
+        unschedule_label_cache_prefill (container);
+        schedule_label_cache_prefill (container);
     }
 
+    nautilus_profile_end (NULL);
+
     nautilus_canvas_container_update_scroll_region (container);
 
     process_pending_icon_to_reveal (container);
@@ -1448,6 +1663,8 @@ invalidate_label_sizes (NautilusCanvasContainer *container)
 
         nautilus_canvas_item_invalidate_label_size (icon->item);
     }
+
+    invalidate_layout (container);
 }
 
 static gboolean
@@ -2983,6 +3200,11 @@ destroy (GtkWidget *object)
         container->details->size_allocation_count_id = 0;
     }
 
+    unschedule_label_cache_prefill (container);
+    cancel_label_cache_prefill (container);
+    nautilus_canvas_label_cache_unreserve (container->details->label_cache_reserved);
+    container->details->label_cache_reserved = 0;
+
     GTK_WIDGET_CLASS (nautilus_canvas_container_parent_class)->destroy (object);
 }
 
@@ -2999,8 +3221,10 @@ finalize (GObject *object)
 
     g_hash_table_destroy (details->icon_set);
     details->icon_set = NULL;
+    g_hash_table_destroy (details->selection_changes);
 
     g_free (details->font);
+    invalidate_label_font (NAUTILUS_CANVAS_CONTAINER (object));
 
     if (details->a11y_item_action_queue != NULL)
     {
@@ -3051,6 +3275,7 @@ size_allocate (GtkWidget     *widget,
     if (allocation->width != wid_allocation.width)
     {
         need_layout_redone = TRUE;
+        invalidate_layout (container);
     }
 
     if (allocation->height != wid_allocation.height)
@@ -3200,6 +3425,11 @@ nautilus_canvas_container_request_update_all_internal (NautilusCanvasContainer *
 
     g_return_if_fail (NAUTILUS_IS_CANVAS_CONTAINER (container));
 
+    if (invalidate_labels)
+    {
+        invalidate_label_font (container);
+    }
+
     for (node = container->details->icons; node != NULL; node = node->next)
     {
         icon = node->data;
@@ -3213,6 +3443,7 @@ nautilus_canvas_container_request_update_all_internal (NautilusCanvasContainer *
     }
 
     container->details->needs_resort = TRUE;
+    invalidate_layout (container);
     redo_layout (container);
 }
 
@@ -4174,6 +4405,7 @@ nautilus_canvas_container_init (NautilusCanvasContainer *container)
     details = g_new0 (NautilusCanvasContainerDetails, 1);
 
     details->icon_set = g_hash_table_new (g_direct_hash, g_direct_equal);
+    details->selection_changes = g_hash_table_new (g_direct_hash, g_direct_equal);
     details->zoom_level = NAUTILUS_CANVAS_ZOOM_LEVEL_STANDARD;
 
     container->details = details;
@@ -4439,18 +4671,36 @@ nautilus_canvas_container_clear (NautilusCanvasContainer *container)
 
     for (p = details->icons; p != NULL; p = p->next)
     {
-        icon_free (p->data);
+        NautilusCanvasIcon *icon = p->data;
+
+        if (nautilus_canvas_item_get_is_visible (icon->item))
+        {
+            nautilus_canvas_container_deprioritize_thumbnailing (container, icon);
+            icon_set_visible (container, icon, FALSE);
+        }
+        else if (icon->is_prefetched)
+        {
+            nautilus_canvas_container_cancel_prefetch (container, icon);
+        }
+        icon_free (icon);
     }
     g_list_free (details->icons);
     details->icons = NULL;
     g_list_free (details->new_icons);
     details->new_icons = NULL;
+    nautilus_scroll_tracker_reset (&details->scroll_tracker);
+    for (p = details->selection; p != NULL; p = p->next)
+    {
+        record_selection_change (container, p->data);
+    }
     g_list_free (details->selection);
     details->selection = NULL;
 
     g_hash_table_destroy (details->icon_set);
     details->icon_set = g_hash_table_new (g_direct_hash, g_direct_equal);
 
+    invalidate_layout (container);
+    update_label_cache_reservation (container);
     nautilus_canvas_container_update_scroll_region (container);
 }
 
@@ -4648,16 +4898,22 @@ icon_destroy (NautilusCanvasContainer *container,
 
     details = container->details;
 
-    item = g_list_find (details->icons, icon);
+    item = icon->link;
     item = item->next ? item->next : item->prev;
     icon_to_focus = (item != NULL) ? item->data : NULL;
 
-    details->icons = g_list_remove (details->icons, icon);
+    details->icons = g_list_delete_link (details->icons, icon->link);
+    icon->link = NULL;
     details->new_icons = g_list_remove (details->new_icons, icon);
+    invalidate_layout (container);
     details->selection = g_list_remove (details->selection, icon->data);
     g_hash_table_remove (details->icon_set, icon->data);
 
     was_selected = icon->is_selected;
+    if (was_selected)
+    {
+        record_selection_change (container, icon->data);
+    }
 
     if (details->focus == icon ||
         details->focus == NULL)
@@ -4698,6 +4954,16 @@ icon_destroy (NautilusCanvasContainer *container,
         set_pending_icon_to_reveal (container, NULL);
     }
 
+    if (nautilus_canvas_item_get_is_visible (icon->item))
+    {
+        nautilus_canvas_container_deprioritize_thumbnailing (container, icon);
+        icon_set_visible (container, icon, FALSE);
+    }
+    else if (icon->is_prefetched)
+    {
+        nautilus_canvas_container_cancel_prefetch (container, icon);
+    }
+
     icon_free (icon);
 
     if (was_selected)
@@ -4810,15 +5076,84 @@ nautilus_canvas_container_prioritize_thumbnailing (NautilusCanvasContainer *cont
     klass->prioritize_thumbnailing (container, icon->data);
 }
 
+static void
+nautilus_canvas_container_deprioritize_thumbnailing (NautilusCanvasContainer *container,
+                                                     NautilusCanvasIcon      *icon)
+{
+    NautilusCanvasContainerClass *klass;
+
+    klass = NAUTILUS_CANVAS_CONTAINER_GET_CLASS (container);
+    g_assert (klass->deprioritize_thumbnailing != NULL);
+
+    klass->deprioritize_thumbnailing (container, icon->data);
+}
+
+/* Tells the subclass when @icon scrolls into view, and out of it again or
+ * when it is removed while in view.
+ */
+static void
+icon_set_visible (NautilusCanvasContainer *container,
+                  NautilusCanvasIcon      *icon,
+                  gboolean                 visible)
+{
+    NautilusCanvasContainerClass *klass;
+
+    if (nautilus_canvas_item_get_is_visible (icon->item) == visible)
+    {
+        return;
+    }
+
+    nautilus_canvas_item_set_is_visible (icon->item, visible);
+
+    klass = NAUTILUS_CANVAS_CONTAINER_GET_CLASS (container);
+    if (klass->icon_visibility_changed != NULL)
+    {
+        klass->icon_visibility_changed (container, icon->data, visible);
+    }
+}
+
+static void
+nautilus_canvas_container_prefetch (NautilusCanvasContainer *container,
+                                    NautilusCanvasIcon      *icon)
+{
+    NautilusCanvasContainerClass *klass;
+
+    klass = NAUTILUS_CANVAS_CONTAINER_GET_CLASS (container);
+    if (klass->prefetch != NULL)
+    {
+        klass->prefetch (container, icon->data);
+    }
+    icon->is_prefetched = TRUE;
+}
+
+static void
+nautilus_canvas_container_cancel_prefetch (NautilusCanvasContainer *container,
+                                           NautilusCanvasIcon      *icon)
+{
+    NautilusCanvasContainerClass *klass;
+
+    klass = NAUTILUS_CANVAS_CONTAINER_GET_CLASS (container);
+    if (klass->cancel_prefetch != NULL)
+    {
+        klass->cancel_prefetch (container, icon->data);
+    }
+    icon->is_prefetched = FALSE;
+}
+
 static void
 nautilus_canvas_container_update_visible_icons (NautilusCanvasContainer *container)
 {
     GtkAdjustment *vadj, *hadj;
     double min_y, max_y;
     double min_x, max_x;
+    double ahead_min_y, ahead_max_y;
+    double page_height;
     double x0, y0, x1, y1;
     GList *node;
+    GList *visible_icons = NULL;
+    GList *prefetch_icons = NULL;
     NautilusCanvasIcon *icon;
+    NautilusScrollTracker *tracker;
     gboolean visible;
     GtkAllocation allocation;
 
@@ -4826,6 +5161,11 @@ nautilus_canvas_container_update_visible_icons (NautilusCanvasContainer *contain
     vadj = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (container));
     gtk_widget_get_allocation (GTK_WIDGET (container), &allocation);
 
+    tracker = &container->details->scroll_tracker;
+    nautilus_scroll_tracker_update (tracker,
+                                    gtk_adjustment_get_value (vadj),
+                                    allocation.height);
+
     min_x = gtk_adjustment_get_value (hadj);
     max_x = min_x + allocation.width;
 
@@ -4837,6 +5177,21 @@ nautilus_canvas_container_update_visible_icons (NautilusCanvasContainer *contain
     eel_canvas_c2w (EEL_CANVAS (container),
                     max_x, max_y, &max_x, &max_y);
 
+    /* The pages the view is scrolling towards, prefetched so that their
+     * thumbnails and attributes are ready by the time they are shown.
+     */
+    page_height = max_y - min_y;
+    if (nautilus_scroll_tracker_get_direction (tracker) > 0)
+    {
+        ahead_min_y = max_y;
+        ahead_max_y = max_y + page_height * nautilus_scroll_tracker_get_pages_ahead (tracker);
+    }
+    else
+    {
+        ahead_max_y = min_y;
+        ahead_min_y = min_y - page_height * nautilus_scroll_tracker_get_pages_ahead (tracker);
+    }
+
     /* Do the iteration in reverse to get the render-order from top to
      * bottom for the prioritized thumbnails.
      */
@@ -4862,16 +5217,54 @@ nautilus_canvas_container_update_visible_icons (NautilusCanvasContainer *contain
 
             if (visible)
             {
-                nautilus_canvas_item_set_is_visible (icon->item, TRUE);
-                nautilus_canvas_container_prioritize_thumbnailing (container,
-                                                                   icon);
+                icon_set_visible (container, icon, TRUE);
+                icon->is_prefetched = FALSE;
+                visible_icons = g_list_prepend (visible_icons, icon);
             }
             else
             {
-                nautilus_canvas_item_set_is_visible (icon->item, FALSE);
+                /* Only on the way out, not to go over every hidden icon */
+                if (nautilus_canvas_item_get_is_visible (icon->item))
+                {
+                    nautilus_canvas_container_deprioritize_thumbnailing (container,
+                                                                         icon);
+                }
+                icon_set_visible (container, icon, FALSE);
+
+                if (y1 >= ahead_min_y && y0 <= ahead_max_y)
+                {
+                    prefetch_icons = g_list_prepend (prefetch_icons, icon);
+                }
+                else if (icon->is_prefetched)
+                {
+                    /* Left behind, or the scrolling turned around */
+                    nautilus_canvas_container_cancel_prefetch (container, icon);
+                }
             }
         }
     }
+
+    /* Each of these goes to the head of its queue, so the icons closest to
+     * the visible ones have to go last. The lists are in top to bottom
+     * order now.
+     */
+    if (nautilus_scroll_tracker_get_direction (tracker) > 0)
+    {
+        prefetch_icons = g_list_reverse (prefetch_icons);
+    }
+    for (node = prefetch_icons; node != NULL; node = node->next)
+    {
+        nautilus_canvas_container_prefetch (container, node->data);
+    }
+
+    visible_icons = g_list_reverse (visible_icons);
+    for (node = visible_icons; node != NULL; node = node->next)
+    {
+        nautilus_canvas_container_prioritize_thumbnailing (container, node->data);
+    }
+
+    g_list_free (prefetch_icons);
+    g_list_free (visible_icons);
 }
 
 static void
@@ -5034,6 +5427,7 @@ nautilus_canvas_container_add (NautilusCanvasContainer *container,
 
     /* Put it on both lists. */
     details->icons = g_list_prepend (details->icons, icon);
+    icon->link = details->icons;
     details->new_icons = g_list_prepend (details->new_icons, icon);
 
     g_hash_table_insert (details->icon_set, data, icon);
@@ -5094,6 +5488,42 @@ nautilus_canvas_container_remove (NautilusCanvasContainer *container,
     return TRUE;
 }
 
+static gboolean
+same_extents (const EelDRect *a,
+              const EelDRect *b)
+{
+    return (a->x1 - a->x0) == (b->x1 - b->x0) &&
+           (a->y1 - a->y0) == (b->y1 - b->y0);
+}
+
+/* Whether @icon is still sorted between its neighbours in the icon list. */
+static gboolean
+icon_keeps_sort_order (NautilusCanvasContainer *container,
+                       NautilusCanvasIcon      *icon)
+{
+    GList *link;
+
+    link = icon->link;
+    g_assert (link != NULL);
+
+    /* Icons that are not laid down yet get sorted on the next layout. */
+    if (link->prev != NULL &&
+        icon_is_positioned (link->prev->data) &&
+        compare_icons (link->prev->data, icon, container) > 0)
+    {
+        return FALSE;
+    }
+
+    if (link->next != NULL &&
+        icon_is_positioned (link->next->data) &&
+        compare_icons (icon, link->next->data, container) > 0)
+    {
+        return FALSE;
+    }
+
+    return TRUE;
+}
+
 /**
  * nautilus_canvas_container_request_update:
  * @container: A NautilusCanvasContainer.
@@ -5106,18 +5536,53 @@ nautilus_canvas_container_request_update (NautilusCanvasContainer *container,
                                           NautilusCanvasIconData  *data)
 {
     NautilusCanvasIcon *icon;
+    EelDRect old_bounds, new_bounds;
+    EelDRect old_icon_bounds, new_icon_bounds;
 
     g_return_if_fail (NAUTILUS_IS_CANVAS_CONTAINER (container));
     g_return_if_fail (data != NULL);
 
     icon = g_hash_table_lookup (container->details->icon_set, data);
 
-    if (icon != NULL)
+    if (icon == NULL)
+    {
+        return;
+    }
+
+    /* Icons that are not laid down yet are sorted and positioned with the
+     * rest of the new icons, but a change to an icon that is already laid
+     * down only needs everything repositioned if it moves in the sort order
+     * or changes size.
+     */
+    if (icon_is_positioned (icon))
+    {
+        nautilus_canvas_item_get_bounds_for_layout (icon->item,
+                                                    &old_bounds.x0, &old_bounds.y0,
+                                                    &old_bounds.x1, &old_bounds.y1);
+        old_icon_bounds = nautilus_canvas_item_get_icon_rectangle (icon->item);
+
+        nautilus_canvas_container_update_icon (container, icon);
+
+        nautilus_canvas_item_get_bounds_for_layout (icon->item,
+                                                    &new_bounds.x0, &new_bounds.y0,
+                                                    &new_bounds.x1, &new_bounds.y1);
+        new_icon_bounds = nautilus_canvas_item_get_icon_rectangle (icon->item);
+
+        if (!icon_keeps_sort_order (container, icon) ||
+            !same_extents (&old_bounds, &new_bounds) ||
+            !same_extents (&old_icon_bounds, &new_icon_bounds))
+        {
+            container->details->needs_resort = TRUE;
+            invalidate_layout (container);
+        }
+    }
+    else
     {
         nautilus_canvas_container_update_icon (container, icon);
         container->details->needs_resort = TRUE;
-        schedule_redo_layout (container);
     }
+
+    schedule_redo_layout (container);
 }
 
 /* zooming */
@@ -5219,6 +5684,47 @@ nautilus_canvas_container_get_selection (NautilusCanvasContainer *container)
     return g_list_copy (container->details->selection);
 }
 
+/**
+ * nautilus_canvas_container_steal_selection_changes:
+ * @container: the container
+ * @added: (out) (transfer container): the icon data selected since the last call
+ * @removed: (out) (transfer container): the icon data unselected since the
+ *   last call, including the one of icons removed while selected
+ *
+ * Lets listeners of #NautilusCanvasContainer::selection-changed update what
+ * they derive from the selection without comparing it as a whole.
+ */
+void
+nautilus_canvas_container_steal_selection_changes (NautilusCanvasContainer  *container,
+                                                   GList                   **added,
+                                                   GList                   **removed)
+{
+    GHashTableIter iter;
+    gpointer data;
+    NautilusCanvasIcon *icon;
+
+    g_return_if_fail (NAUTILUS_IS_CANVAS_CONTAINER (container));
+
+    *added = NULL;
+    *removed = NULL;
+
+    g_hash_table_iter_init (&iter, container->details->selection_changes);
+    while (g_hash_table_iter_next (&iter, &data, NULL))
+    {
+        icon = g_hash_table_lookup (container->details->icon_set, data);
+        if (icon != NULL && icon->is_selected)
+        {
+            *added = g_list_prepend (*added, data);
+        }
+        else
+        {
+            *removed = g_list_prepend (*removed, data);
+        }
+    }
+
+    g_hash_table_remove_all (container->details->selection_changes);
+}
+
 static GList *
 nautilus_canvas_container_get_selected_icons (NautilusCanvasContainer *container)
 {
@@ -5672,6 +6178,7 @@ void
 nautilus_canvas_container_sort (NautilusCanvasContainer *container)
 {
     container->details->needs_resort = TRUE;
+    invalidate_layout (container);
     redo_layout (container);
 }
 
@@ -6329,12 +6836,12 @@ nautilus_canvas_container_is_layout_rtl (NautilusCanvasContainer *container)
     return (gtk_widget_get_direction (GTK_WIDGET (container)) == GTK_TEXT_DIR_RTL);
 }
 
-int
-nautilus_canvas_container_get_max_layout_lines_for_pango (NautilusCanvasContainer *container)
+static int
+get_max_layout_lines_for_pango (int zoom_level)
 {
     int limit;
 
-    limit = text_ellipsis_limits[container->details->zoom_level];
+    limit = text_ellipsis_limits[zoom_level];
 
     if (limit <= 0)
     {
@@ -6344,12 +6851,12 @@ nautilus_canvas_container_get_max_layout_lines_for_pango (NautilusCanvasContaine
     return -limit;
 }
 
-int
-nautilus_canvas_container_get_max_layout_lines (NautilusCanvasContainer *container)
+static int
+get_max_layout_lines (int zoom_level)
 {
     int limit;
 
-    limit = text_ellipsis_limits[container->details->zoom_level];
+    limit = text_ellipsis_limits[zoom_level];
 
     if (limit <= 0)
     {
@@ -6358,3 +6865,179 @@ nautilus_canvas_container_get_max_layout_lines (NautilusCanvasContainer *contain
 
     return limit;
 }
+
+int
+nautilus_canvas_container_get_max_layout_lines_for_pango (NautilusCanvasContainer *container)
+{
+    return get_max_layout_lines_for_pango (container->details->zoom_level);
+}
+
+int
+nautilus_canvas_container_get_max_layout_lines (NautilusCanvasContainer *container)
+{
+    return get_max_layout_lines (container->details->zoom_level);
+}
+
+/**
+ * nautilus_canvas_container_get_label_font:
+ * @container: A NautilusCanvasContainer.
+ * @font_key: (out) (optional): the key identifying the font in the label cache
+ *
+ * Returns: (transfer none): the font labels are laid out with.
+ */
+const PangoFontDescription *
+nautilus_canvas_container_get_label_font (NautilusCanvasContainer  *container,
+                                          const char              **font_key)
+{
+    NautilusCanvasContainerDetails *details;
+    PangoContext *context;
+
+    details = container->details;
+
+    if (details->label_font == NULL)
+    {
+        context = gtk_widget_get_pango_context (GTK_WIDGET (container));
+
+        if (details->font != NULL)
+        {
+            details->label_font = pango_font_description_from_string (details->font);
+        }
+        else
+        {
+            details->label_font = pango_font_description_copy (pango_context_get_font_description (context));
+        }
+
+        details->label_font_key = nautilus_canvas_label_cache_get_font_key (context, details->label_font);
+    }
+
+    if (font_key != NULL)
+    {
+        *font_key = details->label_font_key;
+    }
+
+    return details->label_font;
+}
+
+static void
+invalidate_label_font (NautilusCanvasContainer *container)
+{
+    g_clear_pointer (&container->details->label_font, pango_font_description_free);
+    container->details->label_font_key = NULL;
+}
+
+static void
+cancel_label_cache_prefill (NautilusCanvasContainer *container)
+{
+    g_cancellable_cancel (container->details->label_cache_cancellable);
+    g_clear_object (&container->details->label_cache_cancellable);
+}
+
+/* Measures the names of all icons at the zoom levels next to the current one
+ * on a worker thread, so that zooming in or out finds them in the label cache.
+ */
+static gboolean
+prefill_label_cache_callback (gpointer data)
+{
+    NautilusCanvasContainer *container;
+    NautilusCanvasContainerDetails *details;
+    const PangoFontDescription *font_description;
+    PangoContext *context;
+    GPtrArray *texts;
+    GList *l;
+    int zoom_level;
+    double pixels_per_unit;
+
+    container = NAUTILUS_CANVAS_CONTAINER (data);
+    details = container->details;
+    details->label_cache_prefill_id = 0;
+
+    cancel_label_cache_prefill (container);
+    details->label_cache_cancellable = g_cancellable_new ();
+
+    context = gtk_widget_get_pango_context (GTK_WIDGET (container));
+    font_description = nautilus_canvas_container_get_label_font (container, NULL);
+
+    for (zoom_level = details->zoom_level - 1; zoom_level <= details->zoom_level + 1; zoom_level += 2)
+    {
+        if (zoom_level < NAUTILUS_CANVAS_ZOOM_LEVEL_SMALL ||
+            zoom_level > NAUTILUS_CANVAS_ZOOM_LEVEL_LARGER)
+        {
+            continue;
+        }
+
+        texts = g_ptr_array_sized_new (g_hash_table_size (details->icon_set) + 1);
+        for (l = details->icons; l != NULL; l = l->next)
+        {
+            NautilusCanvasIcon *icon = l->data;
+            const char *text;
+
+            text = nautilus_canvas_item_get_editable_text (icon->item);
+            if (text != NULL && text[0] != '\0')
+            {
+                g_ptr_array_add (texts, g_strdup (text));
+            }
+        }
+        g_ptr_array_add (texts, NULL);
+
+        pixels_per_unit = (double) nautilus_canvas_container_get_icon_size_for_zoom_level (zoom_level)
+                          / NAUTILUS_CANVAS_ICON_SIZE_STANDARD;
+
+        /* Both the ellipsized and the entire text are measured for layout. */
+        nautilus_canvas_label_cache_prefill_async (context, font_description,
+                                                   g_strdupv ((GStrv) texts->pdata),
+                                                   floor (nautilus_canvas_item_get_max_text_width_for_zoom_level (zoom_level, pixels_per_unit)),
+                                                   G_MININT,
+                                                   get_max_layout_lines (zoom_level),
+                                                   details->label_cache_cancellable);
+        nautilus_canvas_label_cache_prefill_async (context, font_description,
+                                                   (GStrv) g_ptr_array_free (texts, FALSE),
+                                                   floor (nautilus_canvas_item_get_max_text_width_for_zoom_level (zoom_level, pixels_per_unit)),
+                                                   get_max_layout_lines_for_pango (zoom_level),
+                                                   get_max_layout_lines (zoom_level),
+                                                   details->label_cache_cancellable);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Makes the label cache keep room for the labels of every icon, at this zoom
+ * level and the neighbouring ones, so that measuring them ahead does not
+ * evict the ones measured for the current zoom level.
+ */
+static void
+update_label_cache_reservation (NautilusCanvasContainer *container)
+{
+    NautilusCanvasContainerDetails *details;
+    guint n_entries;
+
+    details = container->details;
+    n_entries = g_hash_table_size (details->icon_set) * LABEL_CACHE_ENTRIES_PER_ICON;
+
+    nautilus_canvas_label_cache_reserve (n_entries);
+    nautilus_canvas_label_cache_unreserve (details->label_cache_reserved);
+    details->label_cache_reserved = n_entries;
+}
+
+static void
+schedule_label_cache_prefill (NautilusCanvasContainer *container)
+{
+    if (container->details->label_cache_prefill_id != 0 ||
+        g_hash_table_size (container->details->icon_set) < LABEL_CACHE_PREFILL_MIN_ICONS)
+    {
+        return;
+    }
+
+    container->details->label_cache_prefill_id =
+        g_timeout_add_seconds (LABEL_CACHE_PREFILL_DELAY_SECONDS,
+                               prefill_label_cache_callback, container);
+}
+
+static void
+unschedule_label_cache_prefill (NautilusCanvasContainer *container)
+{
+    if (container->details->label_cache_prefill_id != 0)
+    {
+        g_source_remove (container->details->label_cache_prefill_id);
+        container->details->label_cache_prefill_id = 0;
+    }
+}
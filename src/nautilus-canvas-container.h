@@ -150,6 +150,18 @@ typedef struct {
 						     NautilusCanvasIconData *canvas_b);
 	void         (* prioritize_thumbnailing)  (NautilusCanvasContainer *container,
 						   NautilusCanvasIconData *data);
+	void         (* deprioritize_thumbnailing) (NautilusCanvasContainer *container,
+						    NautilusCanvasIconData *data);
+	/* Called once when an icon scrolls into view, and once when it scrolls
+	 * out of it again or is removed.
+	 */
+	void         (* icon_visibility_changed)  (NautilusCanvasContainer *container,
+						   NautilusCanvasIconData *data,
+						   gboolean                visible);
+	void         (* prefetch)                 (NautilusCanvasContainer *container,
+						   NautilusCanvasIconData *data);
+	void         (* cancel_prefetch)          (NautilusCanvasContainer *container,
+						   NautilusCanvasIconData *data);
 
 	/* Queries on icons for subclass/client.
 	 * These must be implemented => These are signals !
@@ -257,6 +269,9 @@ void              nautilus_canvas_container_preview_selection_event       (Nauti
 
 /* operations on the selection */
 GList     *       nautilus_canvas_container_get_selection                 (NautilusCanvasContainer  *view);
+void              nautilus_canvas_container_steal_selection_changes       (NautilusCanvasContainer  *view,
+									   GList                 **added,
+									   GList                 **removed);
 void			  nautilus_canvas_container_invert_selection				(NautilusCanvasContainer  *view);
 void              nautilus_canvas_container_set_selection                 (NautilusCanvasContainer  *view,
 									   GList                  *selection);
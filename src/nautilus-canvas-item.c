@@ -27,6 +27,7 @@
 #include "nautilus-file-utilities.h"
 #include "nautilus-global-preferences.h"
 #include "nautilus-canvas-private.h"
+#include "nautilus-canvas-label-cache.h"
 #include <eel/eel-art-extensions.h>
 #include <eel/eel-glib-extensions.h>
 #include <eel/eel-graphic-effects.h>
@@ -43,6 +44,7 @@
 
 /* gap between bottom of icon and start of text box */
 #define LABEL_OFFSET 1
+/* keep in sync with nautilus-canvas-label-cache.c */
 #define LABEL_LINE_SPACING 0
 
 /* Text padding */
@@ -670,86 +672,21 @@ in_single_click_mode (void)
  #define PERFORMANCE_TEST_MEASURE_DISABLE
  */
 
-/* This gets the size of the layout from the position of the layout.
- * This means that if the layout is right aligned we get the full width
- * of the layout, not just the width of the text snippet on the right side
+/**
+ * nautilus_canvas_item_get_max_text_width_for_zoom_level:
+ * @zoom_level: a #NautilusCanvasZoomLevel
+ * @pixels_per_unit: the canvas scale at @zoom_level
+ *
+ * Returns: the width labels are wrapped at when the container is at
+ * @zoom_level, in pixels.
  */
-static void
-layout_get_full_size (PangoLayout *layout,
-                      int         *width,
-                      int         *height,
-                      int         *dx)
-{
-    PangoRectangle logical_rect;
-    int the_width, total_width;
-
-    pango_layout_get_extents (layout, NULL, &logical_rect);
-    the_width = (logical_rect.width + PANGO_SCALE / 2) / PANGO_SCALE;
-    total_width = (logical_rect.x + logical_rect.width + PANGO_SCALE / 2) / PANGO_SCALE;
-
-    if (width != NULL)
-    {
-        *width = the_width;
-    }
-
-    if (height != NULL)
-    {
-        *height = (logical_rect.height + PANGO_SCALE / 2) / PANGO_SCALE;
-    }
-
-    if (dx != NULL)
-    {
-        *dx = total_width - the_width;
-    }
-}
-
-static void
-layout_get_size_for_layout (PangoLayout *layout,
-                            int          max_layout_line_count,
-                            int          height_for_entire_text,
-                            int         *height_for_layout)
-{
-    PangoLayoutIter *iter;
-    PangoRectangle logical_rect;
-    int i;
-
-    /* only use the first max_layout_line_count lines for the gridded auto layout */
-    if (pango_layout_get_line_count (layout) <= max_layout_line_count)
-    {
-        *height_for_layout = height_for_entire_text;
-    }
-    else
-    {
-        *height_for_layout = 0;
-        iter = pango_layout_get_iter (layout);
-        for (i = 0; i < max_layout_line_count; i++)
-        {
-            pango_layout_iter_get_line_extents (iter, NULL, &logical_rect);
-            *height_for_layout += (logical_rect.height + PANGO_SCALE / 2) / PANGO_SCALE;
-
-            if (!pango_layout_iter_next_line (iter))
-            {
-                break;
-            }
-
-            *height_for_layout += pango_layout_get_spacing (layout);
-        }
-        pango_layout_iter_free (iter);
-    }
-}
-
-static double
-nautilus_canvas_item_get_max_text_width (NautilusCanvasItem *item)
+double
+nautilus_canvas_item_get_max_text_width_for_zoom_level (int    zoom_level,
+                                                        double pixels_per_unit)
 {
-    EelCanvasItem *canvas_item;
-    NautilusCanvasContainer *container;
     guint max_text_width;
 
-
-    canvas_item = EEL_CANVAS_ITEM (item);
-    container = NAUTILUS_CANVAS_CONTAINER (canvas_item->canvas);
-
-    switch (nautilus_canvas_container_get_zoom_level (container))
+    switch (zoom_level)
     {
         case NAUTILUS_CANVAS_ZOOM_LEVEL_SMALL:
         {
@@ -780,7 +717,20 @@ nautilus_canvas_item_get_max_text_width (NautilusCanvasItem *item)
             max_text_width = MAX_TEXT_WIDTH_STANDARD;
     }
 
-    return max_text_width * canvas_item->canvas->pixels_per_unit - 2 * TEXT_BACK_PADDING_X;
+    return max_text_width * pixels_per_unit - 2 * TEXT_BACK_PADDING_X;
+}
+
+static double
+nautilus_canvas_item_get_max_text_width (NautilusCanvasItem *item)
+{
+    EelCanvasItem *canvas_item;
+    NautilusCanvasContainer *container;
+
+    canvas_item = EEL_CANVAS_ITEM (item);
+    container = NAUTILUS_CANVAS_CONTAINER (canvas_item->canvas);
+
+    return nautilus_canvas_item_get_max_text_width_for_zoom_level (nautilus_canvas_container_get_zoom_level (container),
+                                                                   canvas_item->canvas->pixels_per_unit);
 }
 
 static void
@@ -791,24 +741,13 @@ prepare_pango_layout_width (NautilusCanvasItem *item,
     pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
 }
 
-static void
-prepare_pango_layout_for_measure_entire_text (NautilusCanvasItem *item,
-                                              PangoLayout        *layout)
-{
-    prepare_pango_layout_width (item, layout);
-    pango_layout_set_height (layout, G_MININT);
-}
-
-static void
-prepare_pango_layout_for_draw (NautilusCanvasItem *item,
-                               PangoLayout        *layout)
+static int
+get_line_limit_for_draw (NautilusCanvasItem *item)
 {
     NautilusCanvasItemDetails *details;
     NautilusCanvasContainer *container;
     gboolean needs_highlight;
 
-    prepare_pango_layout_width (item, layout);
-
     container = NAUTILUS_CANVAS_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);
     details = item->details;
 
@@ -819,17 +758,22 @@ prepare_pango_layout_for_draw (NautilusCanvasItem *item,
         details->entire_text)
     {
         /* VOODOO-TODO, cf. compute_text_rectangle() */
-        pango_layout_set_height (layout, G_MININT);
-    }
-    else
-    {
-        /* TODO? we might save some resources, when the re-layout is not neccessary in case
-         * the layout height already fits into max. layout lines. But pango should figure this
-         * out itself (which it doesn't ATM).
-         */
-        pango_layout_set_height (layout,
-                                 nautilus_canvas_container_get_max_layout_lines_for_pango (container));
+        return G_MININT;
     }
+
+    /* TODO? we might save some resources, when the re-layout is not neccessary in case
+     * the layout height already fits into max. layout lines. But pango should figure this
+     * out itself (which it doesn't ATM).
+     */
+    return nautilus_canvas_container_get_max_layout_lines_for_pango (container);
+}
+
+static void
+prepare_pango_layout_for_draw (NautilusCanvasItem *item,
+                               PangoLayout        *layout)
+{
+    prepare_pango_layout_width (item, layout);
+    pango_layout_set_height (layout, get_line_limit_for_draw (item));
 }
 
 static void
@@ -837,10 +781,11 @@ measure_label_text (NautilusCanvasItem *item)
 {
     NautilusCanvasItemDetails *details;
     NautilusCanvasContainer *container;
-    gint editable_height, editable_height_for_layout, editable_height_for_entire_text, editable_width, editable_dx;
-    gint additional_height, additional_width, additional_dx;
-    PangoLayout *editable_layout;
-    PangoLayout *additional_layout;
+    NautilusCanvasLabelExtents editable, editable_entire_text, additional;
+    PangoContext *context;
+    const PangoFontDescription *font_description;
+    const char *font_key;
+    int max_width, line_limit, max_layout_lines;
     gboolean have_editable, have_additional;
 
     /* check to see if the cached values are still valid; if so, there's
@@ -876,76 +821,68 @@ measure_label_text (NautilusCanvasItem *item)
     return;
 #endif
 
-    editable_width = 0;
-    editable_height = 0;
-    editable_height_for_layout = 0;
-    editable_height_for_entire_text = 0;
-    editable_dx = 0;
-    additional_width = 0;
-    additional_height = 0;
-    additional_dx = 0;
+    memset (&editable, 0, sizeof (editable));
+    memset (&editable_entire_text, 0, sizeof (editable_entire_text));
+    memset (&additional, 0, sizeof (additional));
 
+    /* The extents come from the label cache shared by all canvas items, so
+     * labels measured before, e.g. at this zoom level before zooming in and
+     * out again, or ahead of time by the container, are not measured again.
+     */
     container = NAUTILUS_CANVAS_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);
-    editable_layout = NULL;
-    additional_layout = NULL;
+    context = gtk_widget_get_pango_context (GTK_WIDGET (container));
+    font_description = nautilus_canvas_container_get_label_font (container, &font_key);
+    max_width = floor (nautilus_canvas_item_get_max_text_width (item));
+    line_limit = get_line_limit_for_draw (item);
+    max_layout_lines = nautilus_canvas_container_get_max_layout_lines (container);
 
     if (have_editable)
     {
-        /* first, measure required text height: editable_height_for_entire_text
-         * then, measure text height applicable for layout: editable_height_for_layout
-         * next, measure actually displayed height: editable_height
+        /* first, measure required text height and the text height applicable
+         * for layout, then measure the actually displayed size
          */
-        editable_layout = get_label_layout (&details->editable_text_layout, item, details->editable_text);
-
-        prepare_pango_layout_for_measure_entire_text (item, editable_layout);
-        layout_get_full_size (editable_layout,
-                              NULL,
-                              &editable_height_for_entire_text,
-                              NULL);
-        layout_get_size_for_layout (editable_layout,
-                                    nautilus_canvas_container_get_max_layout_lines (container),
-                                    editable_height_for_entire_text,
-                                    &editable_height_for_layout);
-
-        prepare_pango_layout_for_draw (item, editable_layout);
-        layout_get_full_size (editable_layout,
-                              &editable_width,
-                              &editable_height,
-                              &editable_dx);
+        nautilus_canvas_label_cache_measure (context, font_description, font_key,
+                                             details->editable_text,
+                                             max_width, G_MININT, max_layout_lines,
+                                             &editable_entire_text);
+        nautilus_canvas_label_cache_measure (context, font_description, font_key,
+                                             details->editable_text,
+                                             max_width, line_limit, max_layout_lines,
+                                             &editable);
     }
 
     if (have_additional)
     {
-        additional_layout = get_label_layout (&details->additional_text_layout, item, details->additional_text);
-        prepare_pango_layout_for_draw (item, additional_layout);
-        layout_get_full_size (additional_layout,
-                              &additional_width, &additional_height, &additional_dx);
+        nautilus_canvas_label_cache_measure (context, font_description, font_key,
+                                             details->additional_text,
+                                             max_width, line_limit, max_layout_lines,
+                                             &additional);
     }
 
-    details->editable_text_height = editable_height;
+    details->editable_text_height = editable.height;
 
-    if (editable_width > additional_width)
+    if (editable.width > additional.width)
     {
-        details->text_width = editable_width;
-        details->text_dx = editable_dx;
+        details->text_width = editable.width;
+        details->text_dx = editable.dx;
     }
     else
     {
-        details->text_width = additional_width;
-        details->text_dx = additional_dx;
+        details->text_width = additional.width;
+        details->text_dx = additional.dx;
     }
 
     if (have_additional)
     {
-        details->text_height = editable_height + LABEL_LINE_SPACING + additional_height;
-        details->text_height_for_layout = editable_height_for_layout + LABEL_LINE_SPACING + additional_height;
-        details->text_height_for_entire_text = editable_height_for_entire_text + LABEL_LINE_SPACING + additional_height;
+        details->text_height = editable.height + LABEL_LINE_SPACING + additional.height;
+        details->text_height_for_layout = editable_entire_text.height_for_layout + LABEL_LINE_SPACING + additional.height;
+        details->text_height_for_entire_text = editable_entire_text.height + LABEL_LINE_SPACING + additional.height;
     }
     else
     {
-        details->text_height = editable_height;
-        details->text_height_for_layout = editable_height_for_layout;
-        details->text_height_for_entire_text = editable_height_for_entire_text;
+        details->text_height = editable.height;
+        details->text_height_for_layout = editable_entire_text.height_for_layout;
+        details->text_height_for_entire_text = editable_entire_text.height;
     }
 
     /* add some extra space for highlighting even when we don't highlight so things won't move */
@@ -958,16 +895,6 @@ measure_label_text (NautilusCanvasItem *item)
 
     /* extra to make it look nicer */
     details->text_width += TEXT_BACK_PADDING_X * 2;
-
-    if (editable_layout)
-    {
-        g_object_unref (editable_layout);
-    }
-
-    if (additional_layout)
-    {
-        g_object_unref (additional_layout);
-    }
 }
 
 static void
@@ -1131,6 +1058,12 @@ draw_label_text (NautilusCanvasItem *item,
     }
 }
 
+const char *
+nautilus_canvas_item_get_editable_text (NautilusCanvasItem *item)
+{
+    return item->details->editable_text;
+}
+
 void
 nautilus_canvas_item_set_is_visible (NautilusCanvasItem *item,
                                      gboolean            visible)
@@ -1148,6 +1081,12 @@ nautilus_canvas_item_set_is_visible (NautilusCanvasItem *item,
     }
 }
 
+gboolean
+nautilus_canvas_item_get_is_visible (NautilusCanvasItem *item)
+{
+    return item->details->is_visible;
+}
+
 void
 nautilus_canvas_item_invalidate_label (NautilusCanvasItem *item)
 {
@@ -1369,78 +1308,18 @@ nautilus_canvas_item_draw (EelCanvasItem  *item,
     gtk_style_context_restore (context);
 }
 
-#define ZERO_WIDTH_SPACE "\xE2\x80\x8B"
-
 static PangoLayout *
 create_label_layout (NautilusCanvasItem *item,
                      const char         *text)
 {
-    PangoLayout *layout;
-    PangoContext *context;
-    PangoFontDescription *desc;
     NautilusCanvasContainer *container;
-    EelCanvasItem *canvas_item;
-    GString *str;
-    char *zeroified_text;
-    const char *p;
-
-    canvas_item = EEL_CANVAS_ITEM (item);
-
-    container = NAUTILUS_CANVAS_CONTAINER (canvas_item->canvas);
-    context = gtk_widget_get_pango_context (GTK_WIDGET (canvas_item->canvas));
-    layout = pango_layout_new (context);
-
-    zeroified_text = NULL;
-
-    if (text != NULL)
-    {
-        str = g_string_new (NULL);
-
-        for (p = text; *p != '\0'; p++)
-        {
-            str = g_string_append_c (str, *p);
-
-            if (*p == '_' || *p == '-' || (*p == '.' && !g_ascii_isdigit (*(p + 1))))
-            {
-                /* Ensure that we allow to break after '_' or '.' characters,
-                 * if they are not followed by a number */
-                str = g_string_append (str, ZERO_WIDTH_SPACE);
-            }
-        }
-
-        zeroified_text = g_string_free (str, FALSE);
-    }
-
-    pango_layout_set_text (layout, zeroified_text, -1);
-    pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
-
-    pango_layout_set_spacing (layout, LABEL_LINE_SPACING);
-    pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
-
-#if PANGO_VERSION_CHECK (1, 44, 4)
-    {
-        PangoAttrList *attr_list = pango_attr_list_new ();
-
-        pango_attr_list_insert (attr_list, pango_attr_insert_hyphens_new (FALSE));
-        pango_layout_set_attributes (layout, attr_list);
-        pango_attr_list_unref (attr_list);
-    }
-#endif
+    PangoContext *context;
 
-    /* Create a font description */
-    if (container->details->font)
-    {
-        desc = pango_font_description_from_string (container->details->font);
-    }
-    else
-    {
-        desc = pango_font_description_copy (pango_context_get_font_description (context));
-    }
-    pango_layout_set_font_description (layout, desc);
-    pango_font_description_free (desc);
-    g_free (zeroified_text);
+    container = NAUTILUS_CANVAS_CONTAINER (EEL_CANVAS_ITEM (item)->canvas);
+    context = gtk_widget_get_pango_context (GTK_WIDGET (container));
 
-    return layout;
+    return nautilus_canvas_label_layout_new (context, text,
+                                             nautilus_canvas_container_get_label_font (container, NULL));
 }
 
 static PangoLayout *
@@ -68,6 +68,7 @@ void        nautilus_canvas_item_set_image                (NautilusCanvasItem
 cairo_surface_t* nautilus_canvas_item_get_drag_surface    (NautilusCanvasItem       *item);
 void        nautilus_canvas_item_set_emblems              (NautilusCanvasItem       *item,
 							   GList                    *emblem_pixbufs);
+const char *nautilus_canvas_item_get_editable_text        (NautilusCanvasItem       *item);
 
 /* geometry and hit testing */
 gboolean    nautilus_canvas_item_hit_test_rectangle       (NautilusCanvasItem       *item,
@@ -83,6 +84,9 @@ void        nautilus_canvas_item_update_bounds            (NautilusCanvasItem
 							   double i2w_dx, double i2w_dy);
 void        nautilus_canvas_item_set_is_visible           (NautilusCanvasItem       *item,
 							   gboolean                  visible);
+gboolean    nautilus_canvas_item_get_is_visible           (NautilusCanvasItem       *item);
+double      nautilus_canvas_item_get_max_text_width_for_zoom_level (int                 zoom_level,
+								    double              pixels_per_unit);
 /* whether the entire label text must be visible at all times */
 void        nautilus_canvas_item_set_entire_text          (NautilusCanvasItem       *canvas_item,
 							   gboolean                  entire_text);
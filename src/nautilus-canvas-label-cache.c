@@ -0,0 +1,568 @@
+/* nautilus-canvas-label-cache.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-canvas-label-cache.h"
+
+#include <pango/pangocairo.h>
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_CANVAS_CONTAINER
+#include "nautilus-debug.h"
+
+/* keep in sync with nautilus-canvas-item.c */
+#define LABEL_LINE_SPACING 0
+
+/* Entries kept on top of the ones reserved by the views, so that going back
+ * to a folder that is not shown anymore does not measure everything again.
+ */
+#define LABEL_CACHE_MIN_ENTRIES 50000
+
+#define ZERO_WIDTH_SPACE "\xE2\x80\x8B"
+
+typedef struct
+{
+    const char *text;
+    /* Interned, so it can be compared by pointer. */
+    const char *font_key;
+    int max_width;
+    int line_limit;
+    int max_layout_lines;
+} LabelKey;
+
+typedef struct
+{
+    /* Must be first, entries are looked up by key. */
+    LabelKey key;
+    NautilusCanvasLabelExtents extents;
+
+    /* Link in the LRU queue, most recently used first. */
+    GList link;
+} LabelEntry;
+
+typedef struct
+{
+    char *font_description;
+    double resolution;
+    cairo_font_options_t *font_options;
+    PangoLanguage *language;
+    const char *font_key;
+
+    GStrv texts;
+    int max_width;
+    int line_limit;
+    int max_layout_lines;
+} PrefillData;
+
+/* Protects label_cache, label_cache_lru and label_cache_reserved, which are
+ * shared between the main thread and the prefill threads.
+ */
+static GMutex label_cache_mutex;
+static GHashTable *label_cache = NULL;
+static GQueue label_cache_lru = G_QUEUE_INIT;
+static guint label_cache_reserved = 0;
+
+static guint
+label_key_hash (gconstpointer key)
+{
+    const LabelKey *label_key = key;
+    guint hash;
+
+    hash = g_str_hash (label_key->text);
+    hash = hash * 31 + g_direct_hash (label_key->font_key);
+    hash = hash * 31 + (guint) label_key->max_width;
+    hash = hash * 31 + (guint) label_key->line_limit;
+    hash = hash * 31 + (guint) label_key->max_layout_lines;
+
+    return hash;
+}
+
+static gboolean
+label_key_equal (gconstpointer a,
+                 gconstpointer b)
+{
+    const LabelKey *key_a = a;
+    const LabelKey *key_b = b;
+
+    return key_a->font_key == key_b->font_key &&
+           key_a->max_width == key_b->max_width &&
+           key_a->line_limit == key_b->line_limit &&
+           key_a->max_layout_lines == key_b->max_layout_lines &&
+           g_str_equal (key_a->text, key_b->text);
+}
+
+static void
+label_entry_free (gpointer data)
+{
+    LabelEntry *entry = data;
+
+    g_free ((char *) entry->key.text);
+    g_slice_free (LabelEntry, entry);
+}
+
+static GHashTable *
+get_label_cache (void)
+{
+    if (label_cache == NULL)
+    {
+        label_cache = g_hash_table_new_full (label_key_hash, label_key_equal,
+                                             NULL, label_entry_free);
+    }
+
+    return label_cache;
+}
+
+/* Call with label_cache_mutex held. */
+static void
+label_cache_trim_locked (void)
+{
+    GList *oldest;
+    guint max_entries;
+
+    max_entries = LABEL_CACHE_MIN_ENTRIES + label_cache_reserved;
+
+    while (g_queue_get_length (&label_cache_lru) > max_entries)
+    {
+        oldest = g_queue_pop_tail_link (&label_cache_lru);
+        g_hash_table_remove (label_cache, oldest->data);
+    }
+}
+
+/* Call with label_cache_mutex held. */
+static gboolean
+label_cache_lookup_locked (const LabelKey             *key,
+                           NautilusCanvasLabelExtents *extents)
+{
+    LabelEntry *entry;
+
+    entry = g_hash_table_lookup (get_label_cache (), key);
+    if (entry == NULL)
+    {
+        return FALSE;
+    }
+
+    g_queue_unlink (&label_cache_lru, &entry->link);
+    g_queue_push_head_link (&label_cache_lru, &entry->link);
+
+    if (extents != NULL)
+    {
+        *extents = entry->extents;
+    }
+
+    return TRUE;
+}
+
+static void
+label_cache_insert (const LabelKey                   *key,
+                    const NautilusCanvasLabelExtents *extents)
+{
+    LabelEntry *entry;
+
+    g_mutex_lock (&label_cache_mutex);
+
+    if (label_cache_lookup_locked (key, NULL))
+    {
+        g_mutex_unlock (&label_cache_mutex);
+        return;
+    }
+
+    entry = g_slice_new0 (LabelEntry);
+    entry->key = *key;
+    entry->key.text = g_strdup (key->text);
+    entry->extents = *extents;
+    entry->link.data = entry;
+
+    g_hash_table_add (get_label_cache (), entry);
+    g_queue_push_head_link (&label_cache_lru, &entry->link);
+
+    label_cache_trim_locked ();
+
+    g_mutex_unlock (&label_cache_mutex);
+}
+
+static gboolean
+label_cache_lookup (const LabelKey             *key,
+                    NautilusCanvasLabelExtents *extents)
+{
+    gboolean found;
+
+    g_mutex_lock (&label_cache_mutex);
+    found = label_cache_lookup_locked (key, extents);
+    g_mutex_unlock (&label_cache_mutex);
+
+    return found;
+}
+
+/* This gets the size of the layout from the position of the layout.
+ * This means that if the layout is right aligned we get the full width
+ * of the layout, not just the width of the text snippet on the right side
+ */
+static void
+layout_get_full_size (PangoLayout *layout,
+                      int         *width,
+                      int         *height,
+                      int         *dx)
+{
+    PangoRectangle logical_rect;
+    int the_width, total_width;
+
+    pango_layout_get_extents (layout, NULL, &logical_rect);
+    the_width = (logical_rect.width + PANGO_SCALE / 2) / PANGO_SCALE;
+    total_width = (logical_rect.x + logical_rect.width + PANGO_SCALE / 2) / PANGO_SCALE;
+
+    *width = the_width;
+    *height = (logical_rect.height + PANGO_SCALE / 2) / PANGO_SCALE;
+    *dx = total_width - the_width;
+}
+
+static int
+layout_get_height_for_layout (PangoLayout *layout,
+                              int          max_layout_line_count,
+                              int          height)
+{
+    PangoLayoutIter *iter;
+    PangoRectangle logical_rect;
+    int height_for_layout;
+    int i;
+
+    /* only use the first max_layout_line_count lines for the gridded auto layout */
+    if (pango_layout_get_line_count (layout) <= max_layout_line_count)
+    {
+        return height;
+    }
+
+    height_for_layout = 0;
+    iter = pango_layout_get_iter (layout);
+    for (i = 0; i < max_layout_line_count; i++)
+    {
+        pango_layout_iter_get_line_extents (iter, NULL, &logical_rect);
+        height_for_layout += (logical_rect.height + PANGO_SCALE / 2) / PANGO_SCALE;
+
+        if (!pango_layout_iter_next_line (iter))
+        {
+            break;
+        }
+
+        height_for_layout += pango_layout_get_spacing (layout);
+    }
+    pango_layout_iter_free (iter);
+
+    return height_for_layout;
+}
+
+static void
+measure_layout (PangoLayout                *layout,
+                const LabelKey             *key,
+                NautilusCanvasLabelExtents *extents)
+{
+    pango_layout_set_width (layout, key->max_width * PANGO_SCALE);
+    pango_layout_set_ellipsize (layout, PANGO_ELLIPSIZE_END);
+    pango_layout_set_height (layout, key->line_limit);
+
+    layout_get_full_size (layout, &extents->width, &extents->height, &extents->dx);
+    extents->height_for_layout = layout_get_height_for_layout (layout,
+                                                               key->max_layout_lines,
+                                                               extents->height);
+}
+
+PangoLayout *
+nautilus_canvas_label_layout_new (PangoContext               *context,
+                                  const char                 *text,
+                                  const PangoFontDescription *font_description)
+{
+    PangoLayout *layout;
+    GString *str;
+    char *zeroified_text;
+    const char *p;
+
+    layout = pango_layout_new (context);
+
+    zeroified_text = NULL;
+
+    if (text != NULL)
+    {
+        str = g_string_new (NULL);
+
+        for (p = text; *p != '\0'; p++)
+        {
+            str = g_string_append_c (str, *p);
+
+            if (*p == '_' || *p == '-' || (*p == '.' && !g_ascii_isdigit (*(p + 1))))
+            {
+                /* Ensure that we allow to break after '_' or '.' characters,
+                 * if they are not followed by a number */
+                str = g_string_append (str, ZERO_WIDTH_SPACE);
+            }
+        }
+
+        zeroified_text = g_string_free (str, FALSE);
+    }
+
+    pango_layout_set_text (layout, zeroified_text, -1);
+    pango_layout_set_alignment (layout, PANGO_ALIGN_CENTER);
+
+    pango_layout_set_spacing (layout, LABEL_LINE_SPACING);
+    pango_layout_set_wrap (layout, PANGO_WRAP_WORD_CHAR);
+
+#if PANGO_VERSION_CHECK (1, 44, 4)
+    {
+        PangoAttrList *attr_list = pango_attr_list_new ();
+
+        pango_attr_list_insert (attr_list, pango_attr_insert_hyphens_new (FALSE));
+        pango_layout_set_attributes (layout, attr_list);
+        pango_attr_list_unref (attr_list);
+    }
+#endif
+
+    pango_layout_set_font_description (layout, font_description);
+    g_free (zeroified_text);
+
+    return layout;
+}
+
+/**
+ * nautilus_canvas_label_cache_get_font_key:
+ * @context: the context labels are measured with
+ * @font_description: the font of the labels
+ *
+ * Returns: (transfer none): an interned string identifying measurements done
+ * with @font_description at the resolution, with the font options and in the
+ * language of @context.
+ */
+const char *
+nautilus_canvas_label_cache_get_font_key (PangoContext               *context,
+                                          const PangoFontDescription *font_description)
+{
+    g_autofree char *description = NULL;
+    g_autofree char *key = NULL;
+    const cairo_font_options_t *font_options;
+
+    description = pango_font_description_to_string (font_description);
+    font_options = pango_cairo_context_get_font_options (context);
+    /* Hinting changes the advances, so the options are part of the key */
+    key = g_strdup_printf ("%s@%g/%lx/%s", description,
+                           pango_cairo_context_get_resolution (context),
+                           font_options != NULL ? cairo_font_options_hash (font_options) : 0,
+                           pango_language_to_string (pango_context_get_language (context)));
+
+    return g_intern_string (key);
+}
+
+/**
+ * nautilus_canvas_label_cache_reserve:
+ * @n_entries: the number of entries to keep room for
+ *
+ * Makes the cache keep room for @n_entries more entries than it does by
+ * default, e.g. for the labels of the icons a view shows. The cache shrinks
+ * back when the reservation is dropped with
+ * nautilus_canvas_label_cache_unreserve().
+ */
+void
+nautilus_canvas_label_cache_reserve (guint n_entries)
+{
+    g_mutex_lock (&label_cache_mutex);
+    label_cache_reserved += n_entries;
+    g_mutex_unlock (&label_cache_mutex);
+}
+
+/**
+ * nautilus_canvas_label_cache_unreserve:
+ * @n_entries: the number of entries passed to
+ *   nautilus_canvas_label_cache_reserve()
+ *
+ * Drops a reservation, evicting the least recently used entries that the
+ * cache has no room for anymore.
+ */
+void
+nautilus_canvas_label_cache_unreserve (guint n_entries)
+{
+    g_mutex_lock (&label_cache_mutex);
+    g_warn_if_fail (label_cache_reserved >= n_entries);
+    label_cache_reserved -= MIN (n_entries, label_cache_reserved);
+    if (label_cache != NULL)
+    {
+        label_cache_trim_locked ();
+    }
+    g_mutex_unlock (&label_cache_mutex);
+}
+
+/**
+ * nautilus_canvas_label_cache_measure:
+ * @context: the context to measure with on a cache miss
+ * @font_description: the font of the label
+ * @font_key: the key returned by nautilus_canvas_label_cache_get_font_key()
+ * @text: the label text
+ * @max_width: the width the label is wrapped and ellipsized at, in pixels
+ * @line_limit: the height limit of the layout, as for pango_layout_set_height()
+ * @max_layout_lines: the number of lines @extents->height_for_layout covers
+ * @extents: (out): the measured extents
+ *
+ * Looks up the extents of the label in the cache, measuring and caching them
+ * first if they are not there yet.
+ */
+void
+nautilus_canvas_label_cache_measure (PangoContext               *context,
+                                     const PangoFontDescription *font_description,
+                                     const char                 *font_key,
+                                     const char                 *text,
+                                     int                         max_width,
+                                     int                         line_limit,
+                                     int                         max_layout_lines,
+                                     NautilusCanvasLabelExtents *extents)
+{
+    LabelKey key;
+    PangoLayout *layout;
+
+    key.text = text;
+    key.font_key = font_key;
+    key.max_width = max_width;
+    key.line_limit = line_limit;
+    key.max_layout_lines = max_layout_lines;
+
+    if (label_cache_lookup (&key, extents))
+    {
+        return;
+    }
+
+    layout = nautilus_canvas_label_layout_new (context, text, font_description);
+    measure_layout (layout, &key, extents);
+    g_object_unref (layout);
+
+    label_cache_insert (&key, extents);
+}
+
+static void
+prefill_data_free (gpointer data)
+{
+    PrefillData *prefill_data = data;
+
+    g_free (prefill_data->font_description);
+    if (prefill_data->font_options != NULL)
+    {
+        cairo_font_options_destroy (prefill_data->font_options);
+    }
+    g_strfreev (prefill_data->texts);
+    g_free (prefill_data);
+}
+
+static void
+prefill_thread_func (GTask        *task,
+                     gpointer      source_object,
+                     gpointer      task_data,
+                     GCancellable *cancellable)
+{
+    PrefillData *data = task_data;
+    PangoFontMap *font_map;
+    PangoContext *context;
+    PangoFontDescription *font_description;
+    NautilusCanvasLabelExtents extents;
+    LabelKey key;
+    guint measured;
+    guint i;
+
+    /* Font maps are not thread-safe, so this thread needs its own. */
+    font_map = pango_cairo_font_map_new ();
+    context = pango_font_map_create_context (font_map);
+    pango_cairo_context_set_resolution (context, data->resolution);
+    pango_cairo_context_set_font_options (context, data->font_options);
+    pango_context_set_language (context, data->language);
+
+    font_description = pango_font_description_from_string (data->font_description);
+
+    key.font_key = data->font_key;
+    key.max_width = data->max_width;
+    key.line_limit = data->line_limit;
+    key.max_layout_lines = data->max_layout_lines;
+
+    measured = 0;
+    for (i = 0; data->texts[i] != NULL; i++)
+    {
+        PangoLayout *layout;
+
+        if (g_cancellable_is_cancelled (cancellable))
+        {
+            break;
+        }
+
+        key.text = data->texts[i];
+        if (label_cache_lookup (&key, NULL))
+        {
+            continue;
+        }
+
+        layout = nautilus_canvas_label_layout_new (context, key.text, font_description);
+        measure_layout (layout, &key, &extents);
+        g_object_unref (layout);
+
+        label_cache_insert (&key, &extents);
+        measured++;
+    }
+
+    DEBUG ("Prefilled %u of %u labels at width %d", measured, i, data->max_width);
+
+    pango_font_description_free (font_description);
+    g_object_unref (context);
+    g_object_unref (font_map);
+
+    g_task_return_boolean (task, TRUE);
+}
+
+/**
+ * nautilus_canvas_label_cache_prefill_async:
+ * @context: the context the labels will be measured with
+ * @font_description: the font of the labels
+ * @texts: (transfer full): the label texts
+ * @max_width: see nautilus_canvas_label_cache_measure()
+ * @line_limit: see nautilus_canvas_label_cache_measure()
+ * @max_layout_lines: see nautilus_canvas_label_cache_measure()
+ * @cancellable: (nullable): a #GCancellable
+ *
+ * Measures @texts on a worker thread, with a PangoContext matching @context,
+ * so that later calls to nautilus_canvas_label_cache_measure() with the same
+ * parameters find them in the cache.
+ */
+void
+nautilus_canvas_label_cache_prefill_async (PangoContext               *context,
+                                           const PangoFontDescription *font_description,
+                                           GStrv                       texts,
+                                           int                         max_width,
+                                           int                         line_limit,
+                                           int                         max_layout_lines,
+                                           GCancellable               *cancellable)
+{
+    g_autoptr (GTask) task = NULL;
+    PrefillData *data;
+    const cairo_font_options_t *font_options;
+
+    data = g_new0 (PrefillData, 1);
+    data->font_description = pango_font_description_to_string (font_description);
+    data->resolution = pango_cairo_context_get_resolution (context);
+    font_options = pango_cairo_context_get_font_options (context);
+    data->font_options = font_options != NULL ? cairo_font_options_copy (font_options) : NULL;
+    data->language = pango_context_get_language (context);
+    data->font_key = nautilus_canvas_label_cache_get_font_key (context, font_description);
+    data->texts = texts;
+    data->max_width = max_width;
+    data->line_limit = line_limit;
+    data->max_layout_lines = max_layout_lines;
+
+    task = g_task_new (NULL, cancellable, NULL, NULL);
+    g_task_set_source_tag (task, nautilus_canvas_label_cache_prefill_async);
+    g_task_set_priority (task, G_PRIORITY_LOW);
+    g_task_set_task_data (task, data, prefill_data_free);
+    g_task_run_in_thread (task, prefill_thread_func);
+}
@@ -0,0 +1,70 @@
+/* nautilus-canvas-label-cache.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+#include <pango/pango.h>
+
+G_BEGIN_DECLS
+
+/* Process-wide cache of canvas label measurements, keyed by the label text,
+ * the maximum width, the font and the line limits. It can be filled ahead of
+ * time from a worker thread, using a PangoContext of its own, so that zooming
+ * does not have to remeasure every label with Pango again.
+ */
+
+typedef struct
+{
+    /* Size of the ellipsized layout. */
+    int width;
+    int height;
+    int dx;
+
+    /* Height of the first max_layout_lines lines of the layout. */
+    int height_for_layout;
+} NautilusCanvasLabelExtents;
+
+PangoLayout *nautilus_canvas_label_layout_new            (PangoContext               *context,
+                                                          const char                 *text,
+                                                          const PangoFontDescription *font_description);
+
+const char  *nautilus_canvas_label_cache_get_font_key   (PangoContext               *context,
+                                                          const PangoFontDescription *font_description);
+
+void         nautilus_canvas_label_cache_reserve         (guint                       n_entries);
+void         nautilus_canvas_label_cache_unreserve       (guint                       n_entries);
+
+void         nautilus_canvas_label_cache_measure         (PangoContext               *context,
+                                                          const PangoFontDescription *font_description,
+                                                          const char                 *font_key,
+                                                          const char                 *text,
+                                                          int                         max_width,
+                                                          int                         line_limit,
+                                                          int                         max_layout_lines,
+                                                          NautilusCanvasLabelExtents *extents);
+
+void         nautilus_canvas_label_cache_prefill_async  (PangoContext               *context,
+                                                          const PangoFontDescription *font_description,
+                                                          GStrv                       texts,
+                                                          int                         max_width,
+                                                          int                         line_limit,
+                                                          int                         max_layout_lines,
+                                                          GCancellable               *cancellable);
+
+G_END_DECLS
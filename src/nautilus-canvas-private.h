@@ -26,6 +26,7 @@
 #include "nautilus-canvas-item.h"
 #include "nautilus-canvas-container.h"
 #include "nautilus-canvas-dnd.h"
+#include "nautilus-ui-utilities.h"
 
 /* An Icon. */
 
@@ -50,6 +51,12 @@ typedef struct {
 	/* Position in the view */
 	int position;
 
+	/* Link of this icon in the container's icon list. Sorting the list
+	 * moves links around without replacing them, so it stays valid until
+	 * the icon is removed.
+	 */
+	GList *link;
+
 	/* Whether this item is selected. */
 	eel_boolean_bit is_selected : 1;
 
@@ -58,6 +65,9 @@ typedef struct {
 
 	/* Whether this item is visible in the view. */
 	eel_boolean_bit is_visible : 1;
+
+	/* Whether this item is just ahead of the scrolling, and was prefetched. */
+	eel_boolean_bit is_prefetched : 1;
 } NautilusCanvasIcon;
 
 
@@ -115,6 +125,10 @@ struct NautilusCanvasContainerDetails {
 	GList *icons;
 	GList *new_icons;
 	GList *selection;
+	/* Icon data whose selection state flipped since the selection changes
+	 * were last stolen. Flipping back removes them again.
+	 */
+	GHashTable *selection_changes;
 	GHashTable *icon_set;
 
 	/* Currently focused icon for accessibility. */
@@ -165,6 +179,19 @@ struct NautilusCanvasContainerDetails {
 	/* Idle ID. */
 	guint idle_id;
 
+	/* Which way the view is scrolling, to prefetch the icons ahead. */
+	NautilusScrollTracker scroll_tracker;
+
+	/* Incremental layout state. Icons appended after the last laid out
+	 * icon are laid down starting from the last line, instead of
+	 * repositioning every icon. A NULL layout_last_line_start means the
+	 * next layout has to start over from the top.
+	 */
+	NautilusCanvasIcon *layout_last_line_start;
+	NautilusCanvasIcon *layout_last_icon;
+	double layout_last_line_y;
+	double layout_grid_width;
+
 	/* Align idle id */
 	guint align_idle_id;
 
@@ -177,6 +204,18 @@ struct NautilusCanvasContainerDetails {
 
 	/* specific fonts used to draw labels */
 	char *font;
+
+	/* The font labels are measured with, and its key in the label cache.
+	 * Computed on demand from font or the widget style.
+	 */
+	PangoFontDescription *label_font;
+	const char *label_font_key;
+
+	/* Measuring labels ahead of time for the neighbouring zoom levels. */
+	guint label_cache_prefill_id;
+	GCancellable *label_cache_cancellable;
+	/* Room kept in the label cache for the labels of the icons. */
+	guint label_cache_reserved;
 	
 	/* State used so arrow keys don't wander if icons aren't lined up.
 	 */
@@ -221,3 +260,6 @@ gboolean      nautilus_canvas_container_scroll                      (NautilusCan
 								     int                    delta_x,
 								     int                    delta_y);
 void          nautilus_canvas_container_update_scroll_region        (NautilusCanvasContainer *container);
+const PangoFontDescription *
+              nautilus_canvas_container_get_label_font              (NautilusCanvasContainer *container,
+								     const char           **font_key);
@@ -29,6 +29,7 @@
 #include "nautilus-canvas-view.h"
 #include "nautilus-enums.h"
 #include "nautilus-global-preferences.h"
+#include "nautilus-thumbnail-cache.h"
 #include "nautilus-thumbnails.h"
 
 struct _NautilusCanvasViewContainer
@@ -109,6 +110,8 @@ nautilus_canvas_view_container_prioritize_thumbnailing (NautilusCanvasContainer
 
     g_assert (NAUTILUS_IS_FILE (file));
 
+    nautilus_file_prioritize_attributes (file);
+
     if (nautilus_file_is_thumbnailing (file))
     {
         uri = nautilus_file_get_uri (file);
@@ -117,6 +120,79 @@ nautilus_canvas_view_container_prioritize_thumbnailing (NautilusCanvasContainer
     }
 }
 
+static void
+nautilus_canvas_view_container_deprioritize_thumbnailing (NautilusCanvasContainer *container,
+                                                          NautilusCanvasIconData  *data)
+{
+    NautilusFile *file;
+    char *uri;
+
+    file = (NautilusFile *) data;
+
+    g_assert (NAUTILUS_IS_FILE (file));
+
+    if (nautilus_file_is_thumbnailing (file))
+    {
+        uri = nautilus_file_get_uri (file);
+        nautilus_thumbnail_deprioritize (uri);
+        g_free (uri);
+    }
+}
+
+static void
+nautilus_canvas_view_container_icon_visibility_changed (NautilusCanvasContainer *container,
+                                                        NautilusCanvasIconData  *data,
+                                                        gboolean                 visible)
+{
+    NautilusFile *file;
+
+    file = (NautilusFile *) data;
+
+    g_assert (NAUTILUS_IS_FILE (file));
+
+    nautilus_thumbnail_cache_set_visible (file, visible);
+}
+
+static void
+nautilus_canvas_view_container_prefetch (NautilusCanvasContainer *container,
+                                         NautilusCanvasIconData  *data)
+{
+    NautilusFile *file;
+    char *uri;
+
+    file = (NautilusFile *) data;
+
+    g_assert (NAUTILUS_IS_FILE (file));
+
+    nautilus_file_prioritize_attributes (file);
+
+    if (nautilus_file_is_thumbnailing (file))
+    {
+        uri = nautilus_file_get_uri (file);
+        nautilus_thumbnail_prefetch (uri);
+        g_free (uri);
+    }
+}
+
+static void
+nautilus_canvas_view_container_cancel_prefetch (NautilusCanvasContainer *container,
+                                                NautilusCanvasIconData  *data)
+{
+    NautilusFile *file;
+    char *uri;
+
+    file = (NautilusFile *) data;
+
+    g_assert (NAUTILUS_IS_FILE (file));
+
+    if (nautilus_file_is_thumbnailing (file))
+    {
+        uri = nautilus_file_get_uri (file);
+        nautilus_thumbnail_cancel_prefetch (uri);
+        g_free (uri);
+    }
+}
+
 static GQuark *
 get_quark_from_strv (gchar **value)
 {
@@ -341,6 +417,10 @@ nautilus_canvas_view_container_class_init (NautilusCanvasViewContainerClass *kla
     ic_class->get_icon_images = nautilus_canvas_view_container_get_icon_images;
     ic_class->get_icon_description = nautilus_canvas_view_container_get_icon_description;
     ic_class->prioritize_thumbnailing = nautilus_canvas_view_container_prioritize_thumbnailing;
+    ic_class->deprioritize_thumbnailing = nautilus_canvas_view_container_deprioritize_thumbnailing;
+    ic_class->icon_visibility_changed = nautilus_canvas_view_container_icon_visibility_changed;
+    ic_class->prefetch = nautilus_canvas_view_container_prefetch;
+    ic_class->cancel_prefetch = nautilus_canvas_view_container_cancel_prefetch;
 
     ic_class->compare_icons = nautilus_canvas_view_container_compare_icons;
     ic_class->compare_icons_by_name = nautilus_canvas_view_container_compare_icons_by_name;
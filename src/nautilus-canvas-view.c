@@ -1163,10 +1163,15 @@ static void
 selection_changed_callback (NautilusCanvasContainer *container,
                             NautilusCanvasView      *canvas_view)
 {
+    g_autoptr (GList) added = NULL;
+    g_autoptr (GList) removed = NULL;
+
     g_assert (NAUTILUS_IS_CANVAS_VIEW (canvas_view));
     g_assert (container == get_canvas_container (canvas_view));
 
-    nautilus_files_view_notify_selection_changed (NAUTILUS_FILES_VIEW (canvas_view));
+    nautilus_canvas_container_steal_selection_changes (container, &added, &removed);
+    nautilus_files_view_notify_selection_changes (NAUTILUS_FILES_VIEW (canvas_view),
+                                                  added, removed);
 }
 
 static void
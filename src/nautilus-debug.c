@@ -54,6 +54,7 @@ static GDebugKey keys[] =
     { "Undo", NAUTILUS_DEBUG_UNDO },
     { "Thumbnails", NAUTILUS_DEBUG_THUMBNAILS },
     { "TagManager", NAUTILUS_DEBUG_TAG_MANAGER },
+    { "IconCache", NAUTILUS_DEBUG_ICON_CACHE },
     { 0, }
 };
 
@@ -48,6 +48,7 @@ typedef enum {
   NAUTILUS_DEBUG_SEARCH_HIT = 1 << 17,
   NAUTILUS_DEBUG_THUMBNAILS = 1 << 18,
   NAUTILUS_DEBUG_TAG_MANAGER = 1 << 19,
+  NAUTILUS_DEBUG_ICON_CACHE = 1 << 20,
 } DebugFlags;
 
 void nautilus_debug_set_flags (DebugFlags flags);
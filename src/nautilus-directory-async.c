@@ -35,6 +35,7 @@
 #include "nautilus-metadata.h"
 #include "nautilus-profile.h"
 #include "nautilus-signaller.h"
+#include "nautilus-thumbnail-cache.h"
 
 /* turn this on to check if async. job calls are balanced */
 #if 0
@@ -796,6 +797,9 @@ nautilus_directory_monitor_add_internal (NautilusDirectory         *directory,
 
     g_assert (NAUTILUS_IS_DIRECTORY (directory));
 
+#ifdef ENABLE_PROFILING
+    /* Only worth making the URIs for the log, since every file found by
+     * searching is monitored this way */
     if (file != NULL)
     {
         file_uri = nautilus_file_get_uri (file);
@@ -804,6 +808,7 @@ nautilus_directory_monitor_add_internal (NautilusDirectory         *directory,
     {
         dir_uri = nautilus_directory_get_uri (directory);
     }
+#endif
     nautilus_profile_start ("uri %s file-uri %s client %p", dir_uri, file_uri, client);
     g_free (dir_uri);
     g_free (file_uri);
@@ -3583,15 +3588,13 @@ thumbnail_done (NautilusDirectory *directory,
     time_t thumb_mtime = 0;
 
     file->details->thumbnail_is_up_to_date = TRUE;
-    if (file->details->thumbnail)
-    {
-        g_object_unref (file->details->thumbnail);
-        file->details->thumbnail = NULL;
-    }
-    if (file->details->scaled_thumbnail)
+    file->details->thumbnail_was_evicted = FALSE;
+    nautilus_thumbnail_cache_insert (file, NULL);
+    if (file->details->thumbnail_scale_cancellable != NULL)
     {
-        g_object_unref (file->details->scaled_thumbnail);
-        file->details->scaled_thumbnail = NULL;
+        /* It would be a scaled copy of the old thumbnail */
+        g_cancellable_cancel (file->details->thumbnail_scale_cancellable);
+        g_clear_object (&file->details->thumbnail_scale_cancellable);
     }
 
     if (pixbuf)
@@ -3605,7 +3608,7 @@ thumbnail_done (NautilusDirectory *directory,
         if (thumb_mtime == 0 ||
             thumb_mtime == file->details->mtime)
         {
-            file->details->thumbnail = g_object_ref (pixbuf);
+            nautilus_thumbnail_cache_insert (file, pixbuf);
             file->details->thumbnail_mtime = thumb_mtime;
         }
         else
@@ -3746,41 +3749,58 @@ get_pixbuf_for_content (goffset  file_len,
 }
 
 
+/* Reading and decoding the thumbnail both happen in a thread, so that
+ * scrolling through a folder of images does not wait on PNG decoding. */
+static void
+thumbnail_read_thread (GTask        *task,
+                       gpointer      source_object,
+                       gpointer      task_data,
+                       GCancellable *cancellable)
+{
+    GFile *location;
+    g_autofree char *file_contents = NULL;
+    gsize file_size;
+    GError *error = NULL;
+    GdkPixbuf *pixbuf;
+
+    location = task_data;
+
+    if (!g_file_load_contents (location, cancellable,
+                               &file_contents, &file_size,
+                               NULL, &error))
+    {
+        g_task_return_error (task, error);
+        return;
+    }
+
+    pixbuf = get_pixbuf_for_content (file_size, file_contents);
+    g_task_return_pointer (task, pixbuf, g_object_unref);
+}
+
 static void
 thumbnail_read_callback (GObject      *source_object,
                          GAsyncResult *res,
                          gpointer      user_data)
 {
     ThumbnailState *state;
-    gsize file_size;
-    char *file_contents;
-    gboolean result;
     NautilusDirectory *directory;
     GdkPixbuf *pixbuf;
 
     state = user_data;
 
+    /* Take the result in any case, so that it is freed */
+    pixbuf = g_task_propagate_pointer (G_TASK (res), NULL);
+
     if (state->directory == NULL)
     {
         /* Operation was cancelled. Bail out */
+        g_clear_object (&pixbuf);
         thumbnail_state_free (state);
         return;
     }
 
     directory = nautilus_directory_ref (state->directory);
 
-    result = g_file_load_contents_finish (G_FILE (source_object),
-                                          res,
-                                          &file_contents, &file_size,
-                                          NULL, NULL);
-
-    pixbuf = NULL;
-    if (result)
-    {
-        pixbuf = get_pixbuf_for_content (file_size, file_contents);
-        g_free (file_contents);
-    }
-
     state->directory->details->thumbnail_state = NULL;
     async_job_end (state->directory, "thumbnail");
 
@@ -3798,6 +3818,7 @@ thumbnail_start (NautilusDirectory *directory,
 {
     GFile *location;
     ThumbnailState *state;
+    g_autoptr (GTask) task = NULL;
 
     if (directory->details->thumbnail_state != NULL)
     {
@@ -3827,11 +3848,9 @@ thumbnail_start (NautilusDirectory *directory,
 
     directory->details->thumbnail_state = state;
 
-    g_file_load_contents_async (location,
-                                state->cancellable,
-                                thumbnail_read_callback,
-                                state);
-    g_object_unref (location);
+    task = g_task_new (NULL, state->cancellable, thumbnail_read_callback, state);
+    g_task_set_task_data (task, location, g_object_unref);
+    g_task_run_in_thread (task, thumbnail_read_thread);
 }
 
 static void
@@ -4717,6 +4736,20 @@ nautilus_directory_remove_file_from_work_queue (NautilusDirectory *directory,
 }
 
 
+/* Moves @file ahead of the other files waiting for the attributes that are
+ * read after their file info, such as item counts, thumbnails and extension
+ * info. Used for the files that are shown, or about to be.
+ */
+void
+nautilus_directory_prioritize_file_in_work_queue (NautilusDirectory *directory,
+                                                  NautilusFile      *file)
+{
+    nautilus_file_queue_move_to_head (directory->details->low_priority_queue,
+                                      file);
+    nautilus_file_queue_move_to_head (directory->details->extension_queue,
+                                      file);
+}
+
 static void
 move_file_to_low_priority_queue (NautilusDirectory *directory,
                                  NautilusFile      *file)
@@ -218,6 +218,8 @@ void               nautilus_directory_add_file_to_work_queue          (NautilusD
 								       NautilusFile *file);
 void               nautilus_directory_remove_file_from_work_queue     (NautilusDirectory *directory,
 								       NautilusFile *file);
+void               nautilus_directory_prioritize_file_in_work_queue   (NautilusDirectory *directory,
+								       NautilusFile *file);
 
 
 /* debugging functions */
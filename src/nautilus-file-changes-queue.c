@@ -21,6 +21,7 @@
 #include "nautilus-file-changes-queue.h"
 
 #include "nautilus-directory-notify.h"
+#include "nautilus-search-engine-index.h"
 #include "nautilus-tag-manager.h"
 
 typedef enum
@@ -267,6 +268,7 @@ nautilus_file_changes_consume_changes (gboolean consume_all)
             if (deletions != NULL)
             {
                 deletions = g_list_reverse (deletions);
+                nautilus_search_engine_index_files_removed (deletions);
                 nautilus_directory_notify_files_removed (deletions);
                 g_list_free_full (deletions, g_object_unref);
                 deletions = NULL;
@@ -274,6 +276,7 @@ nautilus_file_changes_consume_changes (gboolean consume_all)
             if (moves != NULL)
             {
                 moves = g_list_reverse (moves);
+                nautilus_search_engine_index_files_moved (moves);
                 nautilus_directory_notify_files_moved (moves);
                 pairs_list_free (moves);
                 moves = NULL;
@@ -281,6 +284,7 @@ nautilus_file_changes_consume_changes (gboolean consume_all)
             if (additions != NULL)
             {
                 additions = g_list_reverse (additions);
+                nautilus_search_engine_index_files_added (additions);
                 nautilus_directory_notify_files_added (additions);
                 g_list_free_full (additions, g_object_unref);
                 additions = NULL;
@@ -87,12 +87,13 @@ struct NautilusFileDetails
 
 	GIcon *icon;
 	
+	/* The loaded thumbnail itself is kept in nautilus-thumbnail-cache.c */
 	char *thumbnail_path;
-	GdkPixbuf *thumbnail;
 	time_t thumbnail_mtime;
 
-	GdkPixbuf *scaled_thumbnail;
-	double thumbnail_scale;
+	/* Set while the thumbnail is being scaled to pending_thumbnail_scale */
+	GCancellable *thumbnail_scale_cancellable;
+	double pending_thumbnail_scale;
 
 	GList *mime_list; /* If this is a directory, the list of MIME types in it. */
 
@@ -165,6 +166,7 @@ struct NautilusFileDetails
 	eel_boolean_bit got_custom_activation_uri     : 1;
 
 	eel_boolean_bit thumbnail_is_up_to_date       : 1;
+	eel_boolean_bit thumbnail_was_evicted         : 1;
 	eel_boolean_bit thumbnailing_failed           : 1;
 	
 	eel_boolean_bit is_thumbnailing               : 1;
@@ -112,6 +112,28 @@ nautilus_file_queue_remove (NautilusFileQueue *queue,
     nautilus_file_unref (file);
 }
 
+void
+nautilus_file_queue_move_to_head (NautilusFileQueue *queue,
+                                  NautilusFile      *file)
+{
+    GList *link;
+
+    link = g_hash_table_lookup (queue->item_to_link_map, file);
+
+    if (link == NULL || link == queue->head)
+    {
+        return;
+    }
+
+    if (link == queue->tail)
+    {
+        queue->tail = queue->tail->prev;
+    }
+
+    queue->head = g_list_remove_link (queue->head, link);
+    queue->head = g_list_concat (link, queue->head);
+}
+
 NautilusFile *
 nautilus_file_queue_head (NautilusFileQueue *queue)
 {
@@ -40,6 +40,10 @@ NautilusFile *     nautilus_file_queue_dequeue  (NautilusFileQueue *queue);
 void               nautilus_file_queue_remove   (NautilusFileQueue *queue,
 						 NautilusFile      *file);
 
+/* Move a file to the head of the queue, if it is in the queue. */
+void               nautilus_file_queue_move_to_head (NautilusFileQueue *queue,
+						     NautilusFile      *file);
+
 /* Get the file at the head of the queue without removing or unrefing it. */
 NautilusFile *     nautilus_file_queue_head     (NautilusFileQueue *queue);
 
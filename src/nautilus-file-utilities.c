@@ -1126,8 +1126,8 @@ gboolean
 nautilus_file_selection_equal (GList *selection_a,
                                GList *selection_b)
 {
-    GList *al, *bl;
-    gboolean selection_matches;
+    g_autoptr (GHashTable) b_locations = NULL;
+    GList *l;
 
     if (selection_a == NULL || selection_b == NULL)
     {
@@ -1139,35 +1139,28 @@ nautilus_file_selection_equal (GList *selection_a,
         return FALSE;
     }
 
-    selection_matches = TRUE;
-
-    for (al = selection_a; al; al = al->next)
+    b_locations = g_hash_table_new_full (g_file_hash,
+                                         (GEqualFunc) g_file_equal,
+                                         g_object_unref,
+                                         NULL);
+    for (l = selection_b; l != NULL; l = l->next)
     {
-        GFile *a_location = nautilus_file_get_location (NAUTILUS_FILE (al->data));
-        gboolean found = FALSE;
-
-        for (bl = selection_b; bl; bl = bl->next)
-        {
-            GFile *b_location = nautilus_file_get_location (NAUTILUS_FILE (bl->data));
-            found = g_file_equal (b_location, a_location);
-            g_object_unref (b_location);
-
-            if (found)
-            {
-                break;
-            }
-        }
+        g_hash_table_add (b_locations,
+                          nautilus_file_get_location (NAUTILUS_FILE (l->data)));
+    }
 
-        selection_matches = found;
-        g_object_unref (a_location);
+    for (l = selection_a; l != NULL; l = l->next)
+    {
+        g_autoptr (GFile) a_location = NULL;
 
-        if (!selection_matches)
+        a_location = nautilus_file_get_location (NAUTILUS_FILE (l->data));
+        if (!g_hash_table_contains (b_locations, a_location))
         {
-            break;
+            return FALSE;
         }
     }
 
-    return selection_matches;
+    return TRUE;
 }
 
 static char *
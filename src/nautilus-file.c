@@ -67,6 +67,7 @@
 #include "nautilus-module.h"
 #include "nautilus-signaller.h"
 #include "nautilus-tag-manager.h"
+#include "nautilus-thumbnail-cache.h"
 #include "nautilus-thumbnails.h"
 #include "nautilus-ui-utilities.h"
 #include "nautilus-vfs-file.h"
@@ -909,14 +910,8 @@ finalize (GObject *object)
     g_free (file->details->activation_uri);
     g_clear_object (&file->details->custom_icon);
 
-    if (file->details->thumbnail)
-    {
-        g_object_unref (file->details->thumbnail);
-    }
-    if (file->details->scaled_thumbnail)
-    {
-        g_object_unref (file->details->scaled_thumbnail);
-    }
+    nautilus_thumbnail_cache_remove (file);
+    g_clear_object (&file->details->thumbnail_scale_cancellable);
 
     if (file->details->mount)
     {
@@ -2785,7 +2780,7 @@ update_info_internal (NautilusFile *file,
     if (file->details->atime != atime ||
         file->details->mtime != mtime)
     {
-        if (file->details->thumbnail == NULL)
+        if (nautilus_thumbnail_cache_peek (file) == NULL)
         {
             file->details->thumbnail_is_up_to_date = FALSE;
         }
@@ -2796,7 +2791,7 @@ update_info_internal (NautilusFile *file,
     file->details->mtime = mtime;
     file->details->btime = btime;
 
-    if (file->details->thumbnail != NULL &&
+    if (nautilus_thumbnail_cache_peek (file) != NULL &&
         file->details->thumbnail_mtime != 0 &&
         file->details->thumbnail_mtime != mtime)
     {
@@ -5170,22 +5165,190 @@ nautilus_file_get_thumbnail_path (NautilusFile *file)
     return g_strdup (file->details->thumbnail_path);
 }
 
-static NautilusIconInfo *
-nautilus_file_get_thumbnail_icon (NautilusFile          *file,
-                                  int                    size,
-                                  int                    scale,
-                                  NautilusFileIconFlags  flags)
+typedef enum
+{
+    THUMBNAIL_FRAME_NONE,
+    THUMBNAIL_FRAME_IMAGE,
+    THUMBNAIL_FRAME_VIDEO,
+} ThumbnailFrame;
+
+/* The zoom levels of each view type, in order. Scaling a thumbnail for one
+ * of them also makes the copies for the zoom levels next to it, so that
+ * zooming in or out finds them ready.
+ */
+static const int canvas_zoom_sizes[] =
+{
+    NAUTILUS_CANVAS_ICON_SIZE_SMALL,
+    NAUTILUS_CANVAS_ICON_SIZE_STANDARD,
+    NAUTILUS_CANVAS_ICON_SIZE_LARGE,
+    NAUTILUS_CANVAS_ICON_SIZE_LARGER,
+    NAUTILUS_CANVAS_ICON_SIZE_LARGEST,
+};
+
+static const int list_zoom_sizes[] =
+{
+    NAUTILUS_LIST_ICON_SIZE_SMALL,
+    NAUTILUS_LIST_ICON_SIZE_STANDARD,
+    NAUTILUS_LIST_ICON_SIZE_LARGE,
+    NAUTILUS_LIST_ICON_SIZE_LARGER,
+};
+
+/* The requested scale, and those of the zoom levels before and after it */
+#define MAX_THUMBNAIL_SCALES_PER_JOB 3
+
+typedef struct
+{
+    GdkPixbuf *thumbnail;
+    double thumb_scales[MAX_THUMBNAIL_SCALES_PER_JOB];
+    guint n_thumb_scales;
+    ThumbnailFrame frame;
+} ScaleThumbnailData;
+
+static void
+scale_thumbnail_data_free (gpointer user_data)
+{
+    ScaleThumbnailData *data = user_data;
+
+    g_object_unref (data->thumbnail);
+    g_free (data);
+}
+
+/* Only uses GdkPixbuf, so it can run in any thread. */
+static GdkPixbuf *
+scale_thumbnail (GdkPixbuf      *thumbnail,
+                 double          thumb_scale,
+                 ThumbnailFrame  frame)
 {
-    int modified_size;
     GdkPixbuf *pixbuf;
-    int w, h, s;
-    double thumb_scale;
-    GIcon *gicon;
-    NautilusIconInfo *icon;
+    GdkPixbuf *bg_pixbuf;
+    int bg_size;
+    int w, h;
 
-    icon = NULL;
-    gicon = NULL;
-    pixbuf = NULL;
+    w = gdk_pixbuf_get_width (thumbnail);
+    h = gdk_pixbuf_get_height (thumbnail);
+
+    pixbuf = gdk_pixbuf_scale_simple (thumbnail,
+                                      MAX (w * thumb_scale, 1),
+                                      MAX (h * thumb_scale, 1),
+                                      GDK_INTERP_BILINEAR);
+
+    switch (frame)
+    {
+        case THUMBNAIL_FRAME_IMAGE:
+        {
+            nautilus_ui_frame_image (&pixbuf);
+        }
+        break;
+
+        case THUMBNAIL_FRAME_VIDEO:
+        {
+            nautilus_ui_frame_video (&pixbuf);
+        }
+        break;
+
+        case THUMBNAIL_FRAME_NONE:
+        {
+        }
+        break;
+    }
+
+    /* Copy to a transparent square pixbuf, aligned to the bottom edge */
+    bg_size = MAX (gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf));
+    bg_pixbuf = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (pixbuf),
+                                TRUE,
+                                gdk_pixbuf_get_bits_per_sample (pixbuf),
+                                bg_size,
+                                bg_size);
+    gdk_pixbuf_fill (bg_pixbuf, 0);
+    gdk_pixbuf_copy_area (pixbuf,
+                          0,
+                          0,
+                          gdk_pixbuf_get_width (pixbuf),
+                          gdk_pixbuf_get_height (pixbuf),
+                          bg_pixbuf,
+                          (bg_size - gdk_pixbuf_get_width (pixbuf)) / 2,
+                          (bg_size - gdk_pixbuf_get_height (pixbuf)));
+    g_object_unref (pixbuf);
+
+    return bg_pixbuf;
+}
+
+static void
+scale_thumbnail_thread (GTask        *task,
+                        gpointer      source_object,
+                        gpointer      task_data,
+                        GCancellable *cancellable)
+{
+    ScaleThumbnailData *data = task_data;
+    GPtrArray *pixbufs;
+    guint i;
+
+    pixbufs = g_ptr_array_new_with_free_func (g_object_unref);
+    for (i = 0; i < data->n_thumb_scales; i++)
+    {
+        if (g_cancellable_is_cancelled (cancellable))
+        {
+            break;
+        }
+
+        g_ptr_array_add (pixbufs,
+                         scale_thumbnail (data->thumbnail, data->thumb_scales[i], data->frame));
+    }
+
+    g_task_return_pointer (task, pixbufs, (GDestroyNotify) g_ptr_array_unref);
+}
+
+static void
+scale_thumbnail_callback (GObject      *source_object,
+                          GAsyncResult *result,
+                          gpointer      user_data)
+{
+    NautilusFile *file = NAUTILUS_FILE (source_object);
+    ScaleThumbnailData *data;
+    g_autoptr (GPtrArray) pixbufs = NULL;
+    GdkPixbuf *pixbuf;
+    guint i;
+
+    data = g_task_get_task_data (G_TASK (result));
+    pixbufs = g_task_propagate_pointer (G_TASK (result), NULL);
+    if (pixbufs == NULL || pixbufs->len == 0)
+    {
+        /* Cancelled for a request at another scale */
+        return;
+    }
+
+    g_clear_object (&file->details->thumbnail_scale_cancellable);
+
+    /* Add the requested scale last, so that it is the most recently used */
+    for (i = pixbufs->len; i > 0; i--)
+    {
+        pixbuf = g_ptr_array_index (pixbufs, i - 1);
+
+        /* The thumbnail may have been reloaded or evicted meanwhile */
+        if (!nautilus_thumbnail_cache_add_scaled (file, data->thumbnail,
+                                                  pixbuf, data->thumb_scales[i - 1]))
+        {
+            return;
+        }
+    }
+
+    pixbuf = g_ptr_array_index (pixbufs, 0);
+    DEBUG ("Scaled thumbnail ready, at size %d %d, with %u neighbouring zoom levels",
+           gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf),
+           pixbufs->len - 1);
+
+    nautilus_file_changed (file);
+}
+
+static double
+get_thumbnail_scale (GdkPixbuf             *thumbnail,
+                     int                    size,
+                     int                    scale,
+                     NautilusFileIconFlags  flags)
+{
+    int modified_size;
+    int s;
+    double thumb_scale;
 
     if (flags & NAUTILUS_FILE_ICON_FLAGS_FORCE_THUMBNAIL_SIZE)
     {
@@ -5196,90 +5359,227 @@ nautilus_file_get_thumbnail_icon (NautilusFile          *file,
         modified_size = size * scale * NAUTILUS_CANVAS_ICON_SIZE_STANDARD / NAUTILUS_CANVAS_ICON_SIZE_SMALL;
     }
 
-    if (file->details->thumbnail)
+    s = MAX (gdk_pixbuf_get_width (thumbnail), gdk_pixbuf_get_height (thumbnail));
+    /* Don't scale up small thumbnails in the standard view */
+    if (s <= NAUTILUS_CANVAS_ICON_SIZE_STANDARD)
+    {
+        thumb_scale = (double) size / NAUTILUS_CANVAS_ICON_SIZE_SMALL;
+    }
+    else
+    {
+        thumb_scale = (double) modified_size / s;
+    }
+
+    /* Make sure that icons don't get smaller than NAUTILUS_LIST_ICON_SIZE_SMALL */
+    if (s * thumb_scale <= NAUTILUS_LIST_ICON_SIZE_SMALL)
     {
-        w = gdk_pixbuf_get_width (file->details->thumbnail);
-        h = gdk_pixbuf_get_height (file->details->thumbnail);
+        thumb_scale = (double) NAUTILUS_LIST_ICON_SIZE_SMALL / s;
+    }
+
+    return thumb_scale;
+}
+
+static void
+add_thumbnail_scale (NautilusFile       *file,
+                     ScaleThumbnailData *data,
+                     double              thumb_scale)
+{
+    guint i;
 
-        s = MAX (w, h);
-        /* Don't scale up small thumbnails in the standard view */
-        if (s <= NAUTILUS_CANVAS_ICON_SIZE_STANDARD)
+    for (i = 0; i < data->n_thumb_scales; i++)
+    {
+        if (data->thumb_scales[i] == thumb_scale)
         {
-            thumb_scale = (double) size / NAUTILUS_CANVAS_ICON_SIZE_SMALL;
+            return;
         }
-        else
+    }
+
+    if (nautilus_thumbnail_cache_get_scaled (file, thumb_scale, NULL) != NULL)
+    {
+        return;
+    }
+
+    g_assert (data->n_thumb_scales < MAX_THUMBNAIL_SCALES_PER_JOB);
+    data->thumb_scales[data->n_thumb_scales++] = thumb_scale;
+}
+
+/* Adds the scales of the zoom levels next to @size, in the view type it
+ * belongs to, that have no scaled copy yet.
+ */
+static void
+add_neighbouring_thumbnail_scales (NautilusFile          *file,
+                                   ScaleThumbnailData    *data,
+                                   int                    size,
+                                   int                    scale,
+                                   NautilusFileIconFlags  flags)
+{
+    const int *sizes;
+    guint n_sizes;
+    guint i;
+
+    if (flags & NAUTILUS_FILE_ICON_FLAGS_FORCE_THUMBNAIL_SIZE)
+    {
+        sizes = list_zoom_sizes;
+        n_sizes = G_N_ELEMENTS (list_zoom_sizes);
+    }
+    else
+    {
+        sizes = canvas_zoom_sizes;
+        n_sizes = G_N_ELEMENTS (canvas_zoom_sizes);
+    }
+
+    for (i = 0; i < n_sizes; i++)
+    {
+        if (sizes[i] == size)
         {
-            thumb_scale = (double) modified_size / s;
+            break;
         }
+    }
 
-        /* Make sure that icons don't get smaller than NAUTILUS_LIST_ICON_SIZE_SMALL */
-        if (s * thumb_scale <= NAUTILUS_LIST_ICON_SIZE_SMALL)
+    if (i == n_sizes)
+    {
+        return;
+    }
+
+    if (i > 0)
+    {
+        add_thumbnail_scale (file, data,
+                             get_thumbnail_scale (data->thumbnail, sizes[i - 1], scale, flags));
+    }
+    if (i + 1 < n_sizes)
+    {
+        add_thumbnail_scale (file, data,
+                             get_thumbnail_scale (data->thumbnail, sizes[i + 1], scale, flags));
+    }
+}
+
+/* Scaling and framing the thumbnail is done in a thread, as it happens for
+ * every file with a thumbnail whenever the zoom level changes. */
+static void
+scale_thumbnail_async (NautilusFile          *file,
+                       GdkPixbuf             *thumbnail,
+                       double                 thumb_scale,
+                       int                    size,
+                       int                    scale,
+                       NautilusFileIconFlags  flags)
+{
+    ScaleThumbnailData *data;
+    g_autoptr (GTask) task = NULL;
+    int s;
+
+    if (file->details->thumbnail_scale_cancellable != NULL)
+    {
+        if (file->details->pending_thumbnail_scale == thumb_scale)
         {
-            thumb_scale = (double) NAUTILUS_LIST_ICON_SIZE_SMALL / s;
+            return;
         }
 
-        if (file->details->thumbnail_scale == thumb_scale &&
-            file->details->scaled_thumbnail != NULL)
+        g_cancellable_cancel (file->details->thumbnail_scale_cancellable);
+        g_clear_object (&file->details->thumbnail_scale_cancellable);
+    }
+
+    data = g_new0 (ScaleThumbnailData, 1);
+    data->thumbnail = g_object_ref (thumbnail);
+    data->thumb_scales[0] = thumb_scale;
+    data->n_thumb_scales = 1;
+    add_neighbouring_thumbnail_scales (file, data, size, scale, flags);
+    data->frame = THUMBNAIL_FRAME_NONE;
+
+    /* We don't want frames around small icons */
+    s = MAX (gdk_pixbuf_get_width (data->thumbnail), gdk_pixbuf_get_height (data->thumbnail));
+    if (!gdk_pixbuf_get_has_alpha (data->thumbnail) || s >= 128 * scale)
+    {
+        gboolean use_experimental_views;
+
+        use_experimental_views = g_settings_get_boolean (nautilus_preferences,
+                                                         NAUTILUS_PREFERENCES_USE_EXPERIMENTAL_VIEWS);
+        if (!use_experimental_views)
         {
-            pixbuf = file->details->scaled_thumbnail;
+            data->frame = nautilus_is_video_file (file) ? THUMBNAIL_FRAME_VIDEO : THUMBNAIL_FRAME_IMAGE;
         }
-        else
-        {
-            GdkPixbuf *bg_pixbuf;
-            int bg_size;
+    }
 
-            pixbuf = gdk_pixbuf_scale_simple (file->details->thumbnail,
-                                              MAX (w * thumb_scale, 1),
-                                              MAX (h * thumb_scale, 1),
-                                              GDK_INTERP_BILINEAR);
+    file->details->thumbnail_scale_cancellable = g_cancellable_new ();
+    file->details->pending_thumbnail_scale = thumb_scale;
 
-            /* We don't want frames around small icons */
-            if (!gdk_pixbuf_get_has_alpha (file->details->thumbnail) || s >= 128 * scale)
-            {
-                gboolean use_experimental_views;
+    task = g_task_new (file, file->details->thumbnail_scale_cancellable,
+                       scale_thumbnail_callback, NULL);
+    g_task_set_task_data (task, data, scale_thumbnail_data_free);
+    g_task_run_in_thread (task, scale_thumbnail_thread);
+}
 
-                use_experimental_views = g_settings_get_boolean (nautilus_preferences,
-                                                                 NAUTILUS_PREFERENCES_USE_EXPERIMENTAL_VIEWS);
-                if (!use_experimental_views)
-                {
-                    if (nautilus_is_video_file (file))
-                    {
-                        nautilus_ui_frame_video (&pixbuf);
-                    }
-                    else
-                    {
-                        nautilus_ui_frame_image (&pixbuf);
-                    }
-                }
-            }
+static gboolean
+reload_evicted_thumbnail_idle (gpointer user_data)
+{
+    NautilusFile *file = NAUTILUS_FILE (user_data);
+
+    if (!file->details->is_gone &&
+        file->details->thumbnail_path != NULL &&
+        nautilus_thumbnail_cache_peek (file) == NULL)
+    {
+        nautilus_file_invalidate_attributes (file, NAUTILUS_FILE_ATTRIBUTE_THUMBNAIL);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Thumbnails are evicted from the cache to save memory; read them back from
+ * the thumbnail store once they are wanted again. This is done from an idle,
+ * as invalidating attributes can call back into the views. */
+static void
+reload_evicted_thumbnail (NautilusFile *file)
+{
+    file->details->thumbnail_was_evicted = FALSE;
+    g_idle_add_full (G_PRIORITY_DEFAULT_IDLE,
+                     reload_evicted_thumbnail_idle,
+                     nautilus_file_ref (file),
+                     (GDestroyNotify) nautilus_file_unref);
+}
+
+static NautilusIconInfo *
+nautilus_file_get_thumbnail_icon (NautilusFile          *file,
+                                  int                    size,
+                                  int                    scale,
+                                  NautilusFileIconFlags  flags)
+{
+    GdkPixbuf *thumbnail;
+    GdkPixbuf *pixbuf;
+    GdkPixbuf *closest;
+    double thumb_scale;
+    GIcon *gicon;
+    NautilusIconInfo *icon;
 
-            /* Copy to a transparent square pixbuf, aligned to the bottom edge */
-            bg_size = MAX (gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf));
-            bg_pixbuf = gdk_pixbuf_new (gdk_pixbuf_get_colorspace (pixbuf),
-                                        TRUE,
-                                        gdk_pixbuf_get_bits_per_sample (pixbuf),
-                                        bg_size,
-                                        bg_size);
-            gdk_pixbuf_fill (bg_pixbuf, 0);
-            gdk_pixbuf_copy_area (pixbuf,
-                                  0,
-                                  0,
-                                  gdk_pixbuf_get_width (pixbuf),
-                                  gdk_pixbuf_get_height (pixbuf),
-                                  bg_pixbuf,
-                                  (bg_size - gdk_pixbuf_get_width (pixbuf)) / 2,
-                                  (bg_size - gdk_pixbuf_get_height (pixbuf)));
-            g_clear_object (&pixbuf);
-            pixbuf = bg_pixbuf;
-
-            g_clear_object (&file->details->scaled_thumbnail);
-            file->details->scaled_thumbnail = pixbuf;
-            file->details->thumbnail_scale = thumb_scale;
+    icon = NULL;
+    gicon = NULL;
+    pixbuf = NULL;
+    thumbnail = nautilus_thumbnail_cache_lookup (file);
+
+    if (thumbnail != NULL)
+    {
+        thumb_scale = get_thumbnail_scale (thumbnail, size, scale, flags);
+
+        pixbuf = nautilus_thumbnail_cache_get_scaled (file, thumb_scale, &closest);
+        if (pixbuf == NULL)
+        {
+            scale_thumbnail_async (file, thumbnail, thumb_scale, size, scale, flags);
+
+            /* Until then, show the copy of the closest size, if any */
+            pixbuf = closest;
+        }
+
+        if (pixbuf == NULL)
+        {
+            return NULL;
         }
 
         DEBUG ("Returning thumbnailed image, at size %d %d",
                gdk_pixbuf_get_width (pixbuf), gdk_pixbuf_get_height (pixbuf));
     }
+    else if (file->details->thumbnail_was_evicted &&
+             file->details->thumbnail_path != NULL)
+    {
+        reload_evicted_thumbnail (file);
+    }
     else if (file->details->thumbnail_path == NULL &&
              file->details->can_read &&
              !file->details->is_thumbnailing &&
@@ -8629,6 +8929,25 @@ nautilus_file_set_is_thumbnailing (NautilusFile *file,
 }
 
 
+/**
+ * nautilus_file_prioritize_attributes
+ *
+ * Have the pending attributes of this file, like the item count of a folder
+ * or the extension info, read before those of the other files in its
+ * directory. Views call this for files that are shown or about to be.
+ * @file: The file.
+ **/
+void
+nautilus_file_prioritize_attributes (NautilusFile *file)
+{
+    g_return_if_fail (NAUTILUS_IS_FILE (file));
+
+    if (file->details->directory != NULL)
+    {
+        nautilus_directory_prioritize_file_in_work_queue (file->details->directory, file);
+    }
+}
+
 /**
  * nautilus_file_invalidate_attributes
  *
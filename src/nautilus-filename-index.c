@@ -0,0 +1,1195 @@
+/* nautilus-filename-index.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-filename-index.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <gio/gunixoutputstream.h>
+#include <glib/gstdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+/* The file starts with an IndexHeader, followed by the IndexEntry of each
+ * file, the IndexTrigram of each trigram, sorted, the entries of each
+ * trigram, and the names. Numbers are in the byte order of the machine
+ * the index was built on, which is checked when loading it.
+ */
+#define INDEX_MAGIC "NAUTFNI1"
+#define INDEX_BYTE_ORDER 0x01020304
+
+/* The parent of the indexed folders, which are named by their URI */
+#define NO_ENTRY G_MAXUINT32
+
+#define ENTRY_DIRECTORY (1 << 0)
+/* The file is hidden or a backup */
+#define ENTRY_HIDDEN (1 << 1)
+/* The file, or a folder it is in, is hidden or a backup */
+#define ENTRY_HIDDEN_PATH (1 << 2)
+
+#define CANCELLATION_CHECK_INTERVAL 4096
+
+#define BUILD_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_ID_FILESYSTEM
+
+typedef struct
+{
+    char magic[8];
+    guint32 byte_order;
+    guint32 n_entries;
+    guint32 n_trigrams;
+    guint32 postings_size;
+    guint32 names_size;
+    guint32 reserved;
+    gint64 build_time;
+} IndexHeader;
+
+typedef struct
+{
+    guint32 parent;
+    /* Offset of the name in the names */
+    guint32 name;
+    /* One past the last entry inside, for folders */
+    guint32 end;
+    guint32 flags;
+    guint64 mtime;
+} IndexEntry;
+
+typedef struct
+{
+    guint32 trigram;
+    guint32 n_entries;
+    /* Offset in the postings of the entries, increasing, each stored as
+     * the difference from the previous one, in as few bytes as it fits.
+     */
+    guint32 offset;
+} IndexTrigram;
+
+G_STATIC_ASSERT (sizeof (IndexHeader) == 40);
+G_STATIC_ASSERT (sizeof (IndexEntry) == 24);
+G_STATIC_ASSERT (sizeof (IndexTrigram) == 12);
+
+struct _NautilusFilenameIndex
+{
+    GMappedFile *mapped_file;
+
+    const IndexHeader *header;
+    const IndexEntry *entries;
+    const IndexTrigram *trigrams;
+    const guchar *postings;
+    const char *names;
+};
+
+static void
+append_varint (GByteArray *bytes,
+               guint32     value)
+{
+    guint8 byte;
+
+    while (value >= 0x80)
+    {
+        byte = (value & 0x7f) | 0x80;
+        g_byte_array_append (bytes, &byte, 1);
+        value >>= 7;
+    }
+
+    byte = value;
+    g_byte_array_append (bytes, &byte, 1);
+}
+
+/* Returns the position after the number, or %NULL if it is cut short. */
+static const guchar *
+read_varint (const guchar *p,
+             const guchar *end,
+             guint32      *value)
+{
+    guint32 result = 0;
+    guint shift;
+
+    for (shift = 0; p < end && shift < 32; shift += 7)
+    {
+        guchar byte = *p++;
+
+        result |= (guint32) (byte & 0x7f) << shift;
+        if ((byte & 0x80) == 0)
+        {
+            *value = result;
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+static int
+compare_trigrams (gconstpointer a,
+                  gconstpointer b)
+{
+    guint32 trigram_a = *(const guint32 *) a;
+    guint32 trigram_b = *(const guint32 *) b;
+
+    return (trigram_a > trigram_b) - (trigram_a < trigram_b);
+}
+
+static int
+compare_pointer_trigrams (gconstpointer a,
+                          gconstpointer b)
+{
+    guint32 trigram_a = GPOINTER_TO_UINT (*(gconstpointer *) a);
+    guint32 trigram_b = GPOINTER_TO_UINT (*(gconstpointer *) b);
+
+    return (trigram_a > trigram_b) - (trigram_a < trigram_b);
+}
+
+/* Appends the trigrams of @string to @trigrams. */
+static void
+add_trigrams (GArray     *trigrams,
+              const char *string)
+{
+    const guchar *s = (const guchar *) string;
+    gsize length;
+    gsize i;
+    guint32 trigram;
+
+    length = strlen (string);
+    for (i = 0; i + 3 <= length; i++)
+    {
+        trigram = (s[i] << 16) | (s[i + 1] << 8) | s[i + 2];
+        g_array_append_val (trigrams, trigram);
+    }
+}
+
+static void
+sort_unique_trigrams (GArray *trigrams)
+{
+    guint i;
+    guint n_unique = 0;
+
+    g_array_sort (trigrams, compare_trigrams);
+    for (i = 0; i < trigrams->len; i++)
+    {
+        if (n_unique == 0 ||
+            g_array_index (trigrams, guint32, i) != g_array_index (trigrams, guint32, n_unique - 1))
+        {
+            g_array_index (trigrams, guint32, n_unique++) = g_array_index (trigrams, guint32, i);
+        }
+    }
+    g_array_set_size (trigrams, n_unique);
+}
+
+/* Building */
+
+typedef struct
+{
+    GByteArray *bytes;
+    guint32 n_entries;
+    guint32 last_entry;
+} Posting;
+
+typedef struct
+{
+    /* IndexEntry */
+    GArray *entries;
+    GByteArray *names;
+    /* Trigram to Posting */
+    GHashTable *postings;
+    /* The trigrams of one name */
+    GArray *trigrams;
+
+    GCancellable *cancellable;
+} IndexBuilder;
+
+static void
+posting_free (Posting *posting)
+{
+    g_byte_array_unref (posting->bytes);
+    g_free (posting);
+}
+
+static void
+builder_add_trigrams (IndexBuilder *builder,
+                      guint32       id,
+                      const char   *display_name)
+{
+    g_autofree gchar *prepared_name = NULL;
+    Posting *posting;
+    guint32 trigram;
+    guint i;
+
+    prepared_name = nautilus_query_matcher_prepare_string (display_name);
+
+    g_array_set_size (builder->trigrams, 0);
+    add_trigrams (builder->trigrams, prepared_name);
+    sort_unique_trigrams (builder->trigrams);
+
+    for (i = 0; i < builder->trigrams->len; i++)
+    {
+        trigram = g_array_index (builder->trigrams, guint32, i);
+        posting = g_hash_table_lookup (builder->postings, GUINT_TO_POINTER (trigram));
+        if (posting == NULL)
+        {
+            posting = g_new0 (Posting, 1);
+            posting->bytes = g_byte_array_new ();
+            g_hash_table_insert (builder->postings, GUINT_TO_POINTER (trigram), posting);
+        }
+
+        append_varint (posting->bytes, id - posting->last_entry);
+        posting->last_entry = id;
+        posting->n_entries++;
+    }
+}
+
+/* Adds an entry, with @display_name searchable unless it is %NULL. */
+static guint32
+builder_add_entry (IndexBuilder *builder,
+                   guint32       parent,
+                   const char   *name,
+                   const char   *display_name,
+                   guint32       flags,
+                   guint64       mtime)
+{
+    IndexEntry entry = { 0 };
+    guint32 id;
+
+    id = builder->entries->len;
+
+    entry.parent = parent;
+    entry.name = builder->names->len;
+    entry.end = id + 1;
+    entry.flags = flags;
+    entry.mtime = mtime;
+    g_array_append_val (builder->entries, entry);
+    g_byte_array_append (builder->names, (const guint8 *) name, strlen (name) + 1);
+
+    if (display_name != NULL)
+    {
+        builder_add_trigrams (builder, id, display_name);
+    }
+
+    return id;
+}
+
+/* Adds the contents of @directory, at @id, staying on the file system
+ * with @filesystem_id, which is how symbolic links and mounts are not
+ * followed.
+ */
+static void
+builder_add_directory (IndexBuilder *builder,
+                       GFile        *directory,
+                       guint32       id,
+                       guint32       flags,
+                       const char   *filesystem_id)
+{
+    g_autoptr (GFileEnumerator) enumerator = NULL;
+    GFileInfo *info;
+    const char *name;
+    const char *display_name;
+    guint32 child_flags;
+    guint32 child_id;
+
+    enumerator = g_file_enumerate_children (directory, BUILD_ATTRIBUTES,
+                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            builder->cancellable, NULL);
+    if (enumerator == NULL)
+    {
+        return;
+    }
+
+    while ((info = g_file_enumerator_next_file (enumerator, builder->cancellable, NULL)) != NULL)
+    {
+        name = g_file_info_get_name (info);
+        display_name = g_file_info_get_display_name (info);
+        if (name == NULL || display_name == NULL || builder->entries->len == NO_ENTRY - 1)
+        {
+            g_object_unref (info);
+            continue;
+        }
+
+        child_flags = flags & ENTRY_HIDDEN_PATH;
+        if (g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info))
+        {
+            child_flags |= ENTRY_HIDDEN | ENTRY_HIDDEN_PATH;
+        }
+        if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+        {
+            child_flags |= ENTRY_DIRECTORY;
+        }
+
+        child_id = builder_add_entry (builder, id, name, display_name, child_flags,
+                                      g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED));
+
+        if ((child_flags & ENTRY_DIRECTORY) != 0 &&
+            g_strcmp0 (g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM),
+                       filesystem_id) == 0)
+        {
+            g_autoptr (GFile) child = NULL;
+
+            child = g_file_get_child (directory, name);
+            builder_add_directory (builder, child, child_id, child_flags, filesystem_id);
+        }
+
+        g_object_unref (info);
+    }
+
+    g_array_index (builder->entries, IndexEntry, id).end = builder->entries->len;
+}
+
+static gboolean
+write_all (GOutputStream  *stream,
+           gconstpointer   data,
+           gsize           size,
+           GCancellable   *cancellable,
+           GError        **error)
+{
+    return size == 0 || g_output_stream_write_all (stream, data, size, NULL, cancellable, error);
+}
+
+static gboolean
+builder_write (IndexBuilder  *builder,
+               const char    *path,
+               gint64         build_time,
+               GError       **error)
+{
+    g_autofree gchar *temporary_path = NULL;
+    g_autofree gchar *directory = NULL;
+    g_autofree gpointer *keys = NULL;
+    g_autofree IndexTrigram *trigrams = NULL;
+    g_autoptr (GOutputStream) stream = NULL;
+    IndexHeader header = { 0 };
+    int fd;
+    Posting *posting;
+    guint n_trigrams;
+    guint64 postings_size = 0;
+    gboolean success;
+    guint i;
+
+    keys = g_hash_table_get_keys_as_array (builder->postings, &n_trigrams);
+    qsort (keys, n_trigrams, sizeof (gpointer), compare_pointer_trigrams);
+
+    trigrams = g_new (IndexTrigram, MAX (n_trigrams, 1));
+    for (i = 0; i < n_trigrams; i++)
+    {
+        posting = g_hash_table_lookup (builder->postings, keys[i]);
+        trigrams[i].trigram = GPOINTER_TO_UINT (keys[i]);
+        trigrams[i].n_entries = posting->n_entries;
+        trigrams[i].offset = postings_size;
+        postings_size += posting->bytes->len;
+    }
+
+    if (postings_size > G_MAXUINT32 || builder->names->len > G_MAXUINT32)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_NO_SPACE,
+                     "Too many files to index");
+        return FALSE;
+    }
+
+    memcpy (header.magic, INDEX_MAGIC, sizeof (header.magic));
+    header.byte_order = INDEX_BYTE_ORDER;
+    header.n_entries = builder->entries->len;
+    header.n_trigrams = n_trigrams;
+    header.postings_size = postings_size;
+    header.names_size = builder->names->len;
+    header.build_time = build_time;
+
+    /* Written next to the index, and renamed over it once complete */
+    directory = g_path_get_dirname (path);
+    g_mkdir_with_parents (directory, 0700);
+    temporary_path = g_strconcat (path, ".XXXXXX", NULL);
+    fd = g_mkstemp_full (temporary_path, O_WRONLY, 0600);
+    if (fd < 0)
+    {
+        int saved_errno = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                     "Could not create %s: %s", temporary_path, g_strerror (saved_errno));
+        return FALSE;
+    }
+    stream = g_unix_output_stream_new (fd, TRUE);
+
+    success = write_all (stream, &header, sizeof (header),
+                         builder->cancellable, error) &&
+              write_all (stream, builder->entries->data,
+                         builder->entries->len * sizeof (IndexEntry),
+                         builder->cancellable, error) &&
+              write_all (stream, trigrams,
+                         n_trigrams * sizeof (IndexTrigram),
+                         builder->cancellable, error);
+    for (i = 0; success && i < n_trigrams; i++)
+    {
+        posting = g_hash_table_lookup (builder->postings, keys[i]);
+        success = write_all (stream, posting->bytes->data, posting->bytes->len,
+                             builder->cancellable, error);
+    }
+    success = success &&
+              write_all (stream, builder->names->data, builder->names->len,
+                         builder->cancellable, error) &&
+              g_output_stream_close (stream, builder->cancellable, error);
+
+    if (success && g_rename (temporary_path, path) != 0)
+    {
+        int saved_errno = errno;
+
+        g_set_error (error, G_IO_ERROR, g_io_error_from_errno (saved_errno),
+                     "Could not save %s: %s", path, g_strerror (saved_errno));
+        success = FALSE;
+    }
+
+    if (!success)
+    {
+        g_output_stream_close (stream, NULL, NULL);
+        g_unlink (temporary_path);
+    }
+
+    return success;
+}
+
+/**
+ * nautilus_filename_index_build:
+ * @locations: (element-type GFile): the folders to index
+ * @path: where to save the index
+ * @cancellable: (nullable): a #GCancellable
+ * @error: return location for a #GError
+ *
+ * Indexes the names of the files in @locations and in their subfolders,
+ * on the same file system, replacing the index at @path once complete.
+ * This walks every folder, and is meant to be run in a thread.
+ *
+ * Returns: %TRUE on success.
+ */
+gboolean
+nautilus_filename_index_build (GList         *locations,
+                               const char    *path,
+                               GCancellable  *cancellable,
+                               GError       **error)
+{
+    IndexBuilder builder = { 0 };
+    gint64 build_time;
+    gboolean success;
+    GList *l;
+
+    build_time = g_get_real_time ();
+
+    builder.entries = g_array_new (FALSE, FALSE, sizeof (IndexEntry));
+    builder.names = g_byte_array_new ();
+    builder.postings = g_hash_table_new_full (NULL, NULL, NULL, (GDestroyNotify) posting_free);
+    builder.trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+    builder.cancellable = cancellable;
+
+    for (l = locations; l != NULL; l = l->next)
+    {
+        g_autoptr (GFileInfo) info = NULL;
+        g_autofree gchar *uri = NULL;
+        guint32 id;
+
+        info = g_file_query_info (l->data,
+                                  G_FILE_ATTRIBUTE_STANDARD_TYPE ","
+                                  G_FILE_ATTRIBUTE_ID_FILESYSTEM,
+                                  G_FILE_QUERY_INFO_NONE, cancellable, NULL);
+        if (info == NULL || g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY)
+        {
+            continue;
+        }
+
+        uri = g_file_get_uri (l->data);
+        id = builder_add_entry (&builder, NO_ENTRY, uri, NULL, ENTRY_DIRECTORY, 0);
+        builder_add_directory (&builder, l->data, id, 0,
+                               g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM));
+    }
+
+    if (g_cancellable_set_error_if_cancelled (cancellable, error))
+    {
+        success = FALSE;
+    }
+    else
+    {
+        success = builder_write (&builder, path, build_time, error);
+    }
+
+    DEBUG ("Indexed %u files in %" G_GINT64_FORMAT " ms",
+           builder.entries->len, (g_get_real_time () - build_time) / 1000);
+
+    g_array_unref (builder.entries);
+    g_byte_array_unref (builder.names);
+    g_hash_table_destroy (builder.postings);
+    g_array_unref (builder.trigrams);
+
+    return success;
+}
+
+/* Loading */
+
+static gboolean
+index_is_valid (NautilusFilenameIndex *index)
+{
+    const IndexHeader *header = index->header;
+    const IndexEntry *entry;
+    guint32 i;
+
+    if (header->names_size == 0 || index->names[header->names_size - 1] != '\0')
+    {
+        return header->n_entries == 0;
+    }
+
+    for (i = 0; i < header->n_entries; i++)
+    {
+        entry = &index->entries[i];
+        if (entry->name >= header->names_size ||
+            entry->end <= i || entry->end > header->n_entries)
+        {
+            return FALSE;
+        }
+
+        if (entry->parent == NO_ENTRY)
+        {
+            continue;
+        }
+        if (entry->parent >= i ||
+            entry->end > index->entries[entry->parent].end ||
+            (index->entries[entry->parent].flags & ENTRY_DIRECTORY) == 0)
+        {
+            return FALSE;
+        }
+    }
+
+    if (header->n_entries > 0 && index->entries[0].parent != NO_ENTRY)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < header->n_trigrams; i++)
+    {
+        if (index->trigrams[i].offset > header->postings_size ||
+            (i > 0 && index->trigrams[i].trigram <= index->trigrams[i - 1].trigram))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * nautilus_filename_index_new_for_path:
+ * @path: the file an index was built into
+ * @error: return location for a #GError
+ *
+ * Returns: (transfer full): the index at @path, or %NULL if it cannot be
+ * read or is not valid.
+ */
+NautilusFilenameIndex *
+nautilus_filename_index_new_for_path (const char  *path,
+                                      GError     **error)
+{
+    g_autoptr (GMappedFile) mapped_file = NULL;
+    NautilusFilenameIndex *index;
+    const IndexHeader *header;
+    const char *contents;
+    gsize length;
+    guint64 expected_length;
+
+    mapped_file = g_mapped_file_new (path, FALSE, error);
+    if (mapped_file == NULL)
+    {
+        return NULL;
+    }
+
+    contents = g_mapped_file_get_contents (mapped_file);
+    length = g_mapped_file_get_length (mapped_file);
+    header = (const IndexHeader *) contents;
+
+    if (length < sizeof (IndexHeader) ||
+        memcmp (header->magic, INDEX_MAGIC, sizeof (header->magic)) != 0 ||
+        header->byte_order != INDEX_BYTE_ORDER)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "%s is not a file name index", path);
+        return NULL;
+    }
+
+    expected_length = sizeof (IndexHeader) +
+                      (guint64) header->n_entries * sizeof (IndexEntry) +
+                      (guint64) header->n_trigrams * sizeof (IndexTrigram) +
+                      header->postings_size + header->names_size;
+    if (length != expected_length)
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "File name index %s is truncated", path);
+        return NULL;
+    }
+
+    index = g_atomic_rc_box_new0 (NautilusFilenameIndex);
+    index->header = header;
+    index->entries = (const IndexEntry *) (contents + sizeof (IndexHeader));
+    index->trigrams = (const IndexTrigram *) (index->entries + header->n_entries);
+    index->postings = (const guchar *) (index->trigrams + header->n_trigrams);
+    index->names = (const char *) index->postings + header->postings_size;
+    index->mapped_file = g_steal_pointer (&mapped_file);
+
+    if (!index_is_valid (index))
+    {
+        g_set_error (error, G_IO_ERROR, G_IO_ERROR_INVALID_DATA,
+                     "File name index %s is corrupted", path);
+        nautilus_filename_index_unref (index);
+        return NULL;
+    }
+
+    return index;
+}
+
+NautilusFilenameIndex *
+nautilus_filename_index_ref (NautilusFilenameIndex *index)
+{
+    g_return_val_if_fail (index != NULL, NULL);
+
+    return g_atomic_rc_box_acquire (index);
+}
+
+static void
+nautilus_filename_index_clear (NautilusFilenameIndex *index)
+{
+    g_mapped_file_unref (index->mapped_file);
+}
+
+void
+nautilus_filename_index_unref (NautilusFilenameIndex *index)
+{
+    g_return_if_fail (index != NULL);
+
+    g_atomic_rc_box_release_full (index, (GDestroyNotify) nautilus_filename_index_clear);
+}
+
+/* Returns the URIs of the indexed folders. */
+GStrv
+nautilus_filename_index_get_locations (NautilusFilenameIndex *index)
+{
+    GPtrArray *locations;
+    guint32 id;
+
+    locations = g_ptr_array_new ();
+    for (id = 0; id < index->header->n_entries; id = index->entries[id].end)
+    {
+        g_ptr_array_add (locations, g_strdup (index->names + index->entries[id].name));
+    }
+    g_ptr_array_add (locations, NULL);
+
+    return (GStrv) g_ptr_array_free (locations, FALSE);
+}
+
+/* Returns the real time the index was built at, in microseconds. */
+gint64
+nautilus_filename_index_get_build_time (NautilusFilenameIndex *index)
+{
+    return index->header->build_time;
+}
+
+guint
+nautilus_filename_index_get_n_files (NautilusFilenameIndex *index)
+{
+    return index->header->n_entries;
+}
+
+/* Lookups */
+
+static const char *
+get_entry_name (NautilusFilenameIndex *index,
+                guint32                id)
+{
+    return index->names + index->entries[id].name;
+}
+
+static guint32
+find_child (NautilusFilenameIndex *index,
+            guint32                parent,
+            const char            *name)
+{
+    guint32 id;
+
+    /* Skipping the contents of each child */
+    for (id = parent + 1; id < index->entries[parent].end; id = index->entries[id].end)
+    {
+        if (strcmp (get_entry_name (index, id), name) == 0)
+        {
+            return id;
+        }
+    }
+
+    return NO_ENTRY;
+}
+
+static guint32
+lookup_entry (NautilusFilenameIndex *index,
+              GFile                 *file)
+{
+    guint32 root;
+    guint32 id;
+    guint i;
+
+    for (root = 0; root < index->header->n_entries; root = index->entries[root].end)
+    {
+        g_autoptr (GFile) location = NULL;
+        g_autofree gchar *relative_path = NULL;
+        g_auto (GStrv) names = NULL;
+
+        location = g_file_new_for_uri (get_entry_name (index, root));
+        if (g_file_equal (file, location))
+        {
+            return root;
+        }
+
+        relative_path = g_file_get_relative_path (location, file);
+        if (relative_path == NULL)
+        {
+            continue;
+        }
+
+        names = g_strsplit (relative_path, G_DIR_SEPARATOR_S, -1);
+        id = root;
+        for (i = 0; names[i] != NULL && id != NO_ENTRY; i++)
+        {
+            id = find_child (index, id, names[i]);
+        }
+
+        return id;
+    }
+
+    return NO_ENTRY;
+}
+
+static GFile *
+get_entry_file (NautilusFilenameIndex *index,
+                guint32                id)
+{
+    g_autoptr (GArray) path = NULL;
+    GFile *file;
+    GFile *child;
+    guint i;
+
+    path = g_array_new (FALSE, FALSE, sizeof (guint32));
+    for (; index->entries[id].parent != NO_ENTRY; id = index->entries[id].parent)
+    {
+        g_array_append_val (path, id);
+    }
+
+    file = g_file_new_for_uri (get_entry_name (index, id));
+    for (i = path->len; i > 0; i--)
+    {
+        child = g_file_get_child (file, get_entry_name (index, g_array_index (path, guint32, i - 1)));
+        g_object_unref (file);
+        file = child;
+    }
+
+    return file;
+}
+
+gboolean
+nautilus_filename_index_contains (NautilusFilenameIndex *index,
+                                  GFile                 *file)
+{
+    return lookup_entry (index, file) != NO_ENTRY;
+}
+
+gboolean
+nautilus_filename_index_has_folder (NautilusFilenameIndex *index,
+                                    GFile                 *location)
+{
+    guint32 id;
+
+    id = lookup_entry (index, location);
+
+    return id != NO_ENTRY && (index->entries[id].flags & ENTRY_DIRECTORY) != 0;
+}
+
+/* Searching */
+
+typedef struct
+{
+    NautilusFilenameIndex *index;
+    NautilusQueryMatcher *matcher;
+    guint32 folder;
+    gboolean recursive;
+    gboolean show_hidden;
+    /* Entries whose contents are left out too */
+    GHashTable *excluded;
+
+    NautilusFilenameIndexFunc func;
+    gpointer user_data;
+} IndexSearch;
+
+static const IndexTrigram *
+find_trigram (NautilusFilenameIndex *index,
+              guint32                trigram)
+{
+    guint32 low = 0;
+    guint32 high = index->header->n_trigrams;
+    guint32 middle;
+
+    while (low < high)
+    {
+        middle = low + (high - low) / 2;
+        if (index->trigrams[middle].trigram < trigram)
+        {
+            low = middle + 1;
+        }
+        else
+        {
+            high = middle;
+        }
+    }
+
+    if (low < index->header->n_trigrams && index->trigrams[low].trigram == trigram)
+    {
+        return &index->trigrams[low];
+    }
+
+    return NULL;
+}
+
+static int
+compare_trigram_sizes (gconstpointer a,
+                       gconstpointer b)
+{
+    const IndexTrigram *trigram_a = *(const IndexTrigram **) a;
+    const IndexTrigram *trigram_b = *(const IndexTrigram **) b;
+
+    return (trigram_a->n_entries > trigram_b->n_entries) -
+           (trigram_a->n_entries < trigram_b->n_entries);
+}
+
+/* Appends the entries of @trigram after @first and before @end to
+ * @entries, in order.
+ */
+static void
+foreach_trigram_entry (NautilusFilenameIndex *index,
+                       const IndexTrigram    *trigram,
+                       guint32                first,
+                       guint32                end,
+                       GArray                *entries)
+{
+    const guchar *p;
+    const guchar *postings_end;
+    guint32 delta;
+    guint32 id = 0;
+    guint32 i;
+
+    p = index->postings + trigram->offset;
+    postings_end = index->postings + index->header->postings_size;
+    for (i = 0; i < trigram->n_entries; i++)
+    {
+        p = read_varint (p, postings_end, &delta);
+        if (p == NULL)
+        {
+            return;
+        }
+
+        id += delta;
+        if (id >= end)
+        {
+            return;
+        }
+        if (id > first)
+        {
+            g_array_append_val (entries, id);
+        }
+    }
+}
+
+/* Keeps only the entries of @candidates that @trigram is part of. */
+static void
+intersect_trigram_entries (NautilusFilenameIndex *index,
+                           const IndexTrigram    *trigram,
+                           GArray                *candidates)
+{
+    const guchar *p;
+    const guchar *postings_end;
+    guint32 candidate;
+    guint32 delta;
+    guint32 id = 0;
+    guint32 i;
+    guint next = 0;
+    guint n_kept = 0;
+
+    p = index->postings + trigram->offset;
+    postings_end = index->postings + index->header->postings_size;
+    for (i = 0; i < trigram->n_entries && next < candidates->len; i++)
+    {
+        p = read_varint (p, postings_end, &delta);
+        if (p == NULL)
+        {
+            break;
+        }
+
+        id += delta;
+        while (next < candidates->len && g_array_index (candidates, guint32, next) < id)
+        {
+            next++;
+        }
+
+        if (next < candidates->len)
+        {
+            candidate = g_array_index (candidates, guint32, next);
+            if (candidate == id)
+            {
+                g_array_index (candidates, guint32, n_kept++) = candidate;
+                next++;
+            }
+        }
+    }
+
+    g_array_set_size (candidates, n_kept);
+}
+
+/* Returns the entries in @search's folder that have every trigram of the
+ * query, in order, or %NULL if the query words are too short to have any,
+ * and every entry is a candidate.
+ */
+static GArray *
+find_candidates (IndexSearch *search)
+{
+    NautilusFilenameIndex *index = search->index;
+    g_autoptr (GArray) trigrams = NULL;
+    g_autoptr (GPtrArray) lists = NULL;
+    const IndexTrigram *trigram;
+    GArray *candidates;
+    guint i;
+
+    trigrams = g_array_new (FALSE, FALSE, sizeof (guint32));
+    for (i = 0; i < nautilus_query_matcher_get_n_words (search->matcher); i++)
+    {
+        add_trigrams (trigrams, nautilus_query_matcher_get_word (search->matcher, i));
+    }
+    if (trigrams->len == 0)
+    {
+        return NULL;
+    }
+    sort_unique_trigrams (trigrams);
+
+    candidates = g_array_new (FALSE, FALSE, sizeof (guint32));
+
+    lists = g_ptr_array_new ();
+    for (i = 0; i < trigrams->len; i++)
+    {
+        trigram = find_trigram (index, g_array_index (trigrams, guint32, i));
+        if (trigram == NULL)
+        {
+            return candidates;
+        }
+        g_ptr_array_add (lists, (gpointer) trigram);
+    }
+
+    /* Starting from the rarest trigram keeps the candidates few */
+    g_ptr_array_sort (lists, compare_trigram_sizes);
+
+    foreach_trigram_entry (index, g_ptr_array_index (lists, 0),
+                           search->folder, index->entries[search->folder].end,
+                           candidates);
+    for (i = 1; i < lists->len && candidates->len > 0; i++)
+    {
+        intersect_trigram_entries (index, g_ptr_array_index (lists, i), candidates);
+    }
+
+    return candidates;
+}
+
+static gboolean
+is_hidden_in_folder (IndexSearch *search,
+                     guint32      id)
+{
+    const IndexEntry *entries = search->index->entries;
+
+    if ((entries[id].flags & ENTRY_HIDDEN_PATH) == 0)
+    {
+        return FALSE;
+    }
+
+    /* Hidden folders the search starts in don't hide their contents */
+    if ((entries[search->folder].flags & ENTRY_HIDDEN_PATH) == 0)
+    {
+        return TRUE;
+    }
+
+    for (; id != search->folder; id = entries[id].parent)
+    {
+        if ((entries[id].flags & ENTRY_HIDDEN) != 0)
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+is_excluded (IndexSearch *search,
+             guint32      id)
+{
+    if (g_hash_table_size (search->excluded) == 0)
+    {
+        return FALSE;
+    }
+
+    for (; id != NO_ENTRY; id = search->index->entries[id].parent)
+    {
+        if (g_hash_table_contains (search->excluded, GUINT_TO_POINTER (id)))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+search_entry (IndexSearch *search,
+              guint32      id)
+{
+    const IndexEntry *entry = &search->index->entries[id];
+    g_autofree gchar *display_name = NULL;
+    g_autoptr (GFile) file = NULL;
+    const char *name;
+    gdouble rank;
+
+    if (!search->recursive && entry->parent != search->folder)
+    {
+        return;
+    }
+    if (!search->show_hidden && is_hidden_in_folder (search, id))
+    {
+        return;
+    }
+
+    name = get_entry_name (search->index, id);
+    if (!g_utf8_validate (name, -1, NULL))
+    {
+        display_name = g_filename_display_name (name);
+        name = display_name;
+    }
+
+    rank = nautilus_query_matcher_match (search->matcher, name);
+    if (rank <= -1 || is_excluded (search, id))
+    {
+        return;
+    }
+
+    file = get_entry_file (search->index, id);
+    search->func (file, rank, entry->mtime, search->user_data);
+}
+
+/**
+ * nautilus_filename_index_search:
+ * @index: a #NautilusFilenameIndex
+ * @matcher: the matcher of the query
+ * @location: the folder to search in
+ * @recursive: whether to search in its subfolders too
+ * @show_hidden: whether to find hidden files, and files in hidden folders
+ * @excluded: (element-type GFile): files known to be gone since the index
+ *   was built, which are left out with their contents
+ * @cancellable: (nullable): a #GCancellable
+ * @func: called with each file found
+ * @user_data: data for @func
+ *
+ * Finds the files in @location whose names match @matcher. Nothing is
+ * found if @location is not indexed.
+ */
+void
+nautilus_filename_index_search (NautilusFilenameIndex     *index,
+                                NautilusQueryMatcher      *matcher,
+                                GFile                     *location,
+                                gboolean                   recursive,
+                                gboolean                   show_hidden,
+                                GList                     *excluded,
+                                GCancellable              *cancellable,
+                                NautilusFilenameIndexFunc  func,
+                                gpointer                   user_data)
+{
+    g_autoptr (GHashTable) excluded_entries = NULL;
+    g_autoptr (GArray) candidates = NULL;
+    IndexSearch search = { 0 };
+    guint32 id;
+    guint32 end;
+    guint i;
+    GList *l;
+
+    search.folder = lookup_entry (index, location);
+    if (search.folder == NO_ENTRY ||
+        (index->entries[search.folder].flags & ENTRY_DIRECTORY) == 0)
+    {
+        return;
+    }
+
+    excluded_entries = g_hash_table_new (NULL, NULL);
+    for (l = excluded; l != NULL; l = l->next)
+    {
+        id = lookup_entry (index, l->data);
+        if (id != NO_ENTRY)
+        {
+            g_hash_table_add (excluded_entries, GUINT_TO_POINTER (id));
+        }
+    }
+
+    search.index = index;
+    search.matcher = matcher;
+    search.recursive = recursive;
+    search.show_hidden = show_hidden;
+    search.excluded = excluded_entries;
+    search.func = func;
+    search.user_data = user_data;
+
+    if (is_excluded (&search, search.folder))
+    {
+        return;
+    }
+
+    candidates = find_candidates (&search);
+    if (candidates != NULL)
+    {
+        for (i = 0; i < candidates->len; i++)
+        {
+            if (i % CANCELLATION_CHECK_INTERVAL == 0 &&
+                g_cancellable_is_cancelled (cancellable))
+            {
+                return;
+            }
+
+            search_entry (&search, g_array_index (candidates, guint32, i));
+        }
+
+        return;
+    }
+
+    end = index->entries[search.folder].end;
+    for (id = search.folder + 1; id < end; id = recursive ? id + 1 : index->entries[id].end)
+    {
+        if (id % CANCELLATION_CHECK_INTERVAL == 0 &&
+            g_cancellable_is_cancelled (cancellable))
+        {
+            return;
+        }
+
+        search_entry (&search, id);
+    }
+}
@@ -0,0 +1,76 @@
+/* nautilus-filename-index.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "nautilus-query-matcher.h"
+
+G_BEGIN_DECLS
+
+/* An index of the names of every file inside a few folders, to find the
+ * ones matching a query without walking the file system.
+ *
+ * Names are listed depth first, so that the contents of a folder follow
+ * it, and each trigram of the lowercase names, each sequence of three
+ * bytes, is listed with the names it is part of. Only names with every
+ * trigram of the query words are compared with the query.
+ *
+ * An index is built into a file, and mapped in memory from there. It is
+ * immutable, and can be searched from any thread.
+ */
+typedef struct _NautilusFilenameIndex NautilusFilenameIndex;
+
+typedef void (*NautilusFilenameIndexFunc) (GFile    *file,
+                                           gdouble   rank,
+                                           guint64   mtime,
+                                           gpointer  user_data);
+
+gboolean               nautilus_filename_index_build          (GList         *locations,
+                                                               const char    *path,
+                                                               GCancellable  *cancellable,
+                                                               GError       **error);
+
+NautilusFilenameIndex *nautilus_filename_index_new_for_path   (const char    *path,
+                                                               GError       **error);
+NautilusFilenameIndex *nautilus_filename_index_ref            (NautilusFilenameIndex *index);
+void                   nautilus_filename_index_unref          (NautilusFilenameIndex *index);
+
+GStrv                  nautilus_filename_index_get_locations  (NautilusFilenameIndex *index);
+gint64                 nautilus_filename_index_get_build_time (NautilusFilenameIndex *index);
+guint                  nautilus_filename_index_get_n_files    (NautilusFilenameIndex *index);
+
+gboolean               nautilus_filename_index_contains       (NautilusFilenameIndex *index,
+                                                               GFile                 *file);
+gboolean               nautilus_filename_index_has_folder     (NautilusFilenameIndex *index,
+                                                               GFile                 *location);
+
+void                   nautilus_filename_index_search         (NautilusFilenameIndex     *index,
+                                                               NautilusQueryMatcher      *matcher,
+                                                               GFile                     *location,
+                                                               gboolean                   recursive,
+                                                               gboolean                   show_hidden,
+                                                               GList                     *excluded,
+                                                               GCancellable              *cancellable,
+                                                               NautilusFilenameIndexFunc  func,
+                                                               gpointer                   user_data);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (NautilusFilenameIndex, nautilus_filename_index_unref)
+
+G_END_DECLS
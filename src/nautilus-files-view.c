@@ -74,12 +74,15 @@
 #include "nautilus-mime-actions.h"
 #include "nautilus-module.h"
 #include "nautilus-new-folder-dialog-controller.h"
+#include "nautilus-pending-files.h"
 #include "nautilus-previewer.h"
 #include "nautilus-profile.h"
 #include "nautilus-program-choosing.h"
 #include "nautilus-properties-window.h"
 #include "nautilus-rename-file-popover-controller.h"
 #include "nautilus-search-directory.h"
+#include "nautilus-selection-set.h"
+#include "nautilus-selection-summary.h"
 #include "nautilus-signaller.h"
 #include "nautilus-tag-manager.h"
 #include "nautilus-toolbar.h"
@@ -106,6 +109,17 @@
 /* Milliseconds that have to pass without a change to reset the update interval */
 #define UPDATE_INTERVAL_RESET 1000
 
+/* Number of files shown first when a directory is done loading, roughly a
+ * screenful. They are picked out of the pending files without sorting all of
+ * them. */
+#define FIRST_PAINT_FILES 100
+/* Milliseconds the first paint can spend picking out its files */
+#define FIRST_PAINT_BUDGET 50
+/* Milliseconds, and maximum number of files, each later chunk can take, so
+ * that the view keeps redrawing while the rest of the files stream in */
+#define DISPLAY_CHUNK_BUDGET 8
+#define DISPLAY_CHUNK_MAX_FILES 1000
+
 #define SILENT_WINDOW_OPEN_LIMIT 5
 
 #define DUPLICATE_HORIZONTAL_ICON_OFFSET 70
@@ -207,10 +221,17 @@ typedef struct
     GHashTable *non_ready_files;
     GList *old_added_files;
     GList *old_changed_files;
+    /* The added files not shown yet */
+    NautilusPendingFiles *pending_added_files;
+    gboolean first_paint_done;
 
     GList *pending_selection;
     GHashTable *pending_reveal;
 
+    /* The selection as of the last nautilus_files_view_notify_selection_changed() */
+    NautilusSelectionSet *selection_set;
+    NautilusSelectionSummary *selection_summary;
+
     /* whether we are in the active slot */
     gboolean active;
 
@@ -1055,14 +1076,6 @@ file_and_directory_new (NautilusFile      *file,
     return fad;
 }
 
-static NautilusFile *
-file_and_directory_get_file (FileAndDirectory *fad)
-{
-    g_return_val_if_fail (fad != NULL, NULL);
-
-    return nautilus_file_ref (fad->file);
-}
-
 static void
 file_and_directory_free (gpointer data)
 {
@@ -3323,6 +3336,9 @@ nautilus_files_view_finalize (GObject *object)
 
     g_hash_table_destroy (priv->non_ready_files);
     g_hash_table_destroy (priv->pending_reveal);
+    nautilus_pending_files_free (priv->pending_added_files);
+    nautilus_selection_set_free (priv->selection_set);
+    nautilus_selection_summary_free (priv->selection_summary);
 
     g_cancellable_cancel (priv->starred_cancellable);
     g_clear_object (&priv->starred_cancellable);
@@ -3341,13 +3357,12 @@ nautilus_files_view_finalize (GObject *object)
 void
 nautilus_files_view_display_selection_info (NautilusFilesView *view)
 {
-    g_autolist (NautilusFile) selection = NULL;
+    NautilusFilesViewPrivate *priv;
+    NautilusSelectionSummary *summary;
     goffset non_folder_size;
     gboolean non_folder_size_known;
     guint non_folder_count, folder_count, folder_item_count;
     gboolean folder_item_count_known;
-    guint file_item_count;
-    GList *p;
     char *first_item_name;
     char *non_folder_count_str;
     char *non_folder_item_count_str;
@@ -3355,53 +3370,28 @@ nautilus_files_view_display_selection_info (NautilusFilesView *view)
     char *folder_item_count_str;
     char *primary_status;
     char *detail_status;
-    NautilusFile *file;
 
     g_return_if_fail (NAUTILUS_IS_FILES_VIEW (view));
 
-    selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
-
-    folder_item_count_known = TRUE;
-    folder_count = 0;
-    folder_item_count = 0;
-    non_folder_count = 0;
-    non_folder_size_known = FALSE;
-    non_folder_size = 0;
+    priv = nautilus_files_view_get_instance_private (view);
+    summary = priv->selection_summary;
+
+    folder_count = nautilus_selection_summary_get_folder_count (summary);
+    folder_item_count_known = nautilus_selection_summary_get_folder_item_count (summary,
+                                                                                &folder_item_count);
+    non_folder_count = nautilus_selection_summary_get_count (summary) - folder_count;
+    non_folder_size_known = nautilus_selection_summary_get_non_folder_size (summary,
+                                                                            &non_folder_size);
     first_item_name = NULL;
     folder_count_str = NULL;
     folder_item_count_str = NULL;
     non_folder_count_str = NULL;
     non_folder_item_count_str = NULL;
 
-    for (p = selection; p != NULL; p = p->next)
+    /* The name is only shown for a single selected file */
+    if (folder_count + non_folder_count == 1)
     {
-        file = p->data;
-        if (nautilus_file_is_directory (file))
-        {
-            folder_count++;
-            if (nautilus_file_get_directory_item_count (file, &file_item_count, NULL))
-            {
-                folder_item_count += file_item_count;
-            }
-            else
-            {
-                folder_item_count_known = FALSE;
-            }
-        }
-        else
-        {
-            non_folder_count++;
-            if (!nautilus_file_can_get_size (file))
-            {
-                non_folder_size_known = TRUE;
-                non_folder_size += nautilus_file_get_size (file);
-            }
-        }
-
-        if (first_item_name == NULL)
-        {
-            first_item_name = nautilus_file_get_display_name (file);
-        }
+        first_item_name = nautilus_file_get_display_name (nautilus_selection_summary_get_any_file (summary));
     }
 
     /* Break out cases for localization's sake. But note that there are still pieces
@@ -4013,6 +4003,17 @@ compare_files_cover (gconstpointer a,
         return NAUTILUS_FILES_VIEW_CLASS (G_OBJECT_GET_CLASS (view))->compare_files (view, fad1->file, fad2->file);
     }
 }
+
+/* Files can wait to be added across many display passes, during which they
+ * can be deleted, hidden or moved out, and the changes are emitted before
+ * they are added, so check them again. */
+static gboolean
+keep_pending_added_file (gpointer item,
+                         gpointer user_data)
+{
+    return still_should_show_file (NAUTILUS_FILES_VIEW (user_data), item);
+}
+
 static void
 sort_files (NautilusFilesView  *view,
             GList             **list)
@@ -4023,7 +4024,8 @@ sort_files (NautilusFilesView  *view,
 /* Go through all the new added and changed files.
  * Put any that are not ready to load in the non_ready_files hash table.
  * Add all the rest to the old_added_files and old_changed_files lists.
- * Sort the old_*_files lists if anything was added to them.
+ * Sort the old_changed_files list if anything was added to it, the added
+ * files are only put in order as they are displayed, see process_old_files().
  */
 static void
 process_new_files (NautilusFilesView *view)
@@ -4106,12 +4108,7 @@ process_new_files (NautilusFilesView *view)
         }
     }
 
-    /* If any files were added to old_added_files, then resort it. */
-    if (old_added_files != priv->old_added_files)
-    {
-        priv->old_added_files = old_added_files;
-        sort_files (view, &priv->old_added_files);
-    }
+    priv->old_added_files = old_added_files;
 
     /* Resort old_changed_files too, since file attributes
      * relevant to sorting could have changed.
@@ -4162,54 +4159,33 @@ on_end_file_changes (NautilusFilesView *view)
     }
 }
 
-static int
-compare_pointers (gconstpointer pointer_1,
-                  gconstpointer pointer_2)
-{
-    if (pointer_1 < pointer_2)
-    {
-        return -1;
-    }
-    else if (pointer_1 > pointer_2)
-    {
-        return +1;
-    }
-
-    return 0;
-}
-
-static gboolean
-_g_lists_sort_and_check_for_intersection (GList **list_1,
-                                          GList **list_2)
+/* Moves the new added files to the pending ones, and takes the first ones
+ * in order out of them, as many as fit in the budget.
+ */
+static GList *
+take_next_added_files (NautilusFilesView *view,
+                       GList             *new_added_files)
 {
-    GList *node_1;
-    GList *node_2;
-    int compare_result;
+    NautilusFilesViewPrivate *priv;
+    gint64 deadline;
+    guint max_files;
 
-    *list_1 = g_list_sort (*list_1, compare_pointers);
-    *list_2 = g_list_sort (*list_2, compare_pointers);
+    priv = nautilus_files_view_get_instance_private (view);
 
-    node_1 = *list_1;
-    node_2 = *list_2;
+    nautilus_pending_files_add (priv->pending_added_files, new_added_files);
 
-    while (node_1 != NULL && node_2 != NULL)
+    if (!priv->first_paint_done)
     {
-        compare_result = compare_pointers (node_1->data, node_2->data);
-        if (compare_result == 0)
-        {
-            return TRUE;
-        }
-        if (compare_result <= 0)
-        {
-            node_1 = node_1->next;
-        }
-        if (compare_result >= 0)
-        {
-            node_2 = node_2->next;
-        }
+        deadline = g_get_monotonic_time () + FIRST_PAINT_BUDGET * 1000;
+        max_files = FIRST_PAINT_FILES;
+    }
+    else
+    {
+        deadline = g_get_monotonic_time () + DISPLAY_CHUNK_BUDGET * 1000;
+        max_files = DISPLAY_CHUNK_MAX_FILES;
     }
 
-    return FALSE;
+    return nautilus_pending_files_take (priv->pending_added_files, max_files, deadline);
 }
 
 static void
@@ -4219,13 +4195,22 @@ process_old_files (NautilusFilesView *view)
     g_autolist (FileAndDirectory) files_added = NULL;
     g_autolist (FileAndDirectory) files_changed = NULL;
     FileAndDirectory *pending;
-    GList *files;
     g_autoptr (GList) pending_additions = NULL;
 
     priv = nautilus_files_view_get_instance_private (view);
     files_added = g_steal_pointer (&priv->old_added_files);
     files_changed = g_steal_pointer (&priv->old_changed_files);
 
+    if (files_added != NULL ||
+        nautilus_pending_files_get_length (priv->pending_added_files) > 0)
+    {
+        /* The list elements are owned by the pending files now */
+        g_autoptr (GList) new_added_files = g_steal_pointer (&files_added);
+
+        files_added = take_next_added_files (view, new_added_files);
+        priv->first_paint_done = TRUE;
+    }
+
 
     if (files_added != NULL || files_changed != NULL)
     {
@@ -4278,21 +4263,20 @@ process_old_files (NautilusFilesView *view)
             }
         }
 
-        if (files_changed != NULL)
+        for (GList *node = files_changed; node != NULL; node = node->next)
         {
-            g_autolist (NautilusFile) selection = NULL;
-            selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
-            files = g_list_copy_deep (files_changed, (GCopyFunc) file_and_directory_get_file, NULL);
-            send_selection_change = _g_lists_sort_and_check_for_intersection
-                                        (&files, &selection);
-            nautilus_file_list_free (files);
+            pending = node->data;
+            /* Send a selection change since some file names could have
+             * changed, and keep the selection totals up to date. */
+            if (nautilus_selection_summary_update_file (priv->selection_summary,
+                                                        pending->file))
+            {
+                send_selection_change = TRUE;
+            }
         }
 
         if (send_selection_change)
         {
-            /* Send a selection change since some file names could
-             * have changed.
-             */
             nautilus_files_view_send_selection_change (view);
         }
 
@@ -4310,6 +4294,15 @@ display_pending_files (NautilusFilesView *view)
     process_old_files (view);
 
     priv = nautilus_files_view_get_instance_private (view);
+
+    /* Stream in the rest of the added files, giving the view a chance to
+     * redraw in between. */
+    if (nautilus_pending_files_get_length (priv->pending_added_files) > 0)
+    {
+        schedule_idle_display_of_pending_files (view);
+        return;
+    }
+
     selection = nautilus_files_view_get_selection (NAUTILUS_VIEW (view));
 
     if (selection == NULL &&
@@ -4658,10 +4651,18 @@ done_loading_callback (NautilusDirectory *directory,
     {
         /* Unschedule a pending update and schedule a new one with the minimal
          * update interval. This gives the view a short chance at gathering the
-         * (cached) deep counts.
+         * (cached) deep counts. Nothing is shown yet for the first paint
+         * though, so don't make it wait.
          */
         unschedule_display_of_pending_files (view);
-        schedule_timeout_display_of_pending_files (view, UPDATE_INTERVAL_MIN);
+        if (!priv->first_paint_done)
+        {
+            schedule_idle_display_of_pending_files (view);
+        }
+        else
+        {
+            schedule_timeout_display_of_pending_files (view, UPDATE_INTERVAL_MIN);
+        }
 
         remove_loading_floating_bar (view);
     }
@@ -4801,25 +4802,6 @@ nautilus_files_view_get_content_widget (NautilusFilesView *view)
     return priv->scrolled_window;
 }
 
-/* home_dir_in_selection()
- *
- * Return TRUE if the home directory is in the selection.
- */
-
-static gboolean
-home_dir_in_selection (GList *selection)
-{
-    for (GList *node = selection; node != NULL; node = node->next)
-    {
-        if (nautilus_file_is_home (NAUTILUS_FILE (node->data)))
-        {
-            return TRUE;
-        }
-    }
-
-    return FALSE;
-}
-
 static void
 trash_or_delete_done_cb (GHashTable        *debuting_uris,
                          gboolean           user_cancel,
@@ -7451,74 +7433,6 @@ on_clipboard_owner_changed (GtkClipboard *clipboard,
     nautilus_files_view_update_context_menus (self);
 }
 
-static gboolean
-can_delete_all (GList *files)
-{
-    NautilusFile *file;
-    GList *l;
-
-    for (l = files; l != NULL; l = l->next)
-    {
-        file = l->data;
-        if (!nautilus_file_can_delete (file))
-        {
-            return FALSE;
-        }
-    }
-    return TRUE;
-}
-
-static gboolean
-can_trash_all (GList *files)
-{
-    NautilusFile *file;
-    GList *l;
-
-    for (l = files; l != NULL; l = l->next)
-    {
-        file = l->data;
-        if (!nautilus_file_can_trash (file))
-        {
-            return FALSE;
-        }
-    }
-    return TRUE;
-}
-
-static gboolean
-all_in_trash (GList *files)
-{
-    NautilusFile *file;
-    GList *l;
-
-    for (l = files; l != NULL; l = l->next)
-    {
-        file = l->data;
-        if (!nautilus_file_is_in_trash (file))
-        {
-            return FALSE;
-        }
-    }
-    return TRUE;
-}
-
-static gboolean
-can_extract_all (GList *files)
-{
-    NautilusFile *file;
-    GList *l;
-
-    for (l = files; l != NULL; l = l->next)
-    {
-        file = l->data;
-        if (!nautilus_file_is_archive (file))
-        {
-            return FALSE;
-        }
-    }
-    return TRUE;
-}
-
 static gboolean
 nautilus_handles_all_files_to_extract (GList *files)
 {
@@ -7552,9 +7466,10 @@ static void
 real_update_actions_state (NautilusFilesView *view)
 {
     NautilusFilesViewPrivate *priv;
+    NautilusSelectionSummary *summary;
     g_autolist (NautilusFile) selection = NULL;
     GList *l;
-    gint selection_count;
+    guint selection_count;
     gboolean zoom_level_is_default;
     gboolean selection_contains_home_dir;
     gboolean selection_contains_recent;
@@ -7595,26 +7510,38 @@ real_update_actions_state (NautilusFilesView *view)
 
     view_action_group = priv->view_action_group;
 
-    selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
-    selection_count = g_list_length (selection);
-    selection_contains_home_dir = home_dir_in_selection (selection);
+    /* Most of the state comes from the selection totals. The files are
+     * only listed when there is a single one, or when all of them are of the
+     * few kinds whose actions need to look at each of them. */
+    summary = priv->selection_summary;
+    selection_count = nautilus_selection_summary_get_count (summary);
+    selection_all_in_trash = nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_IN_TRASH);
+    if (selection_count == 1 ||
+        (selection_count > 1 &&
+         (selection_all_in_trash ||
+          nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_ARCHIVE) ||
+          nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_VOLUME))))
+    {
+        selection = nautilus_selection_set_get_files (priv->selection_set);
+    }
+
+    selection_contains_home_dir = nautilus_selection_summary_any (summary, NAUTILUS_SELECTION_SUMMARY_HOME);
     selection_contains_recent = showing_recent_directory (view);
     selection_contains_starred = showing_starred_directory (view);
     selection_contains_search = nautilus_view_is_searching (NAUTILUS_VIEW (view));
     selection_is_read_only = selection_count == 1 &&
                              (!nautilus_file_can_write (NAUTILUS_FILE (selection->data)) &&
                               !nautilus_file_has_activation_uri (NAUTILUS_FILE (selection->data)));
-    selection_all_in_trash = all_in_trash (selection);
     zoom_level_is_default = nautilus_files_view_is_zoom_level_default (view);
 
     is_read_only = nautilus_files_view_is_read_only (view);
     can_create_files = nautilus_files_view_supports_creating_files (view);
     can_delete_files =
-        can_delete_all (selection) &&
+        nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_CAN_DELETE) &&
         selection_count != 0 &&
         !selection_contains_home_dir;
     can_trash_files =
-        can_trash_all (selection) &&
+        nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_CAN_TRASH) &&
         selection_count != 0 &&
         !selection_contains_home_dir;
     can_copy_files = selection_count != 0;
@@ -7625,9 +7552,10 @@ real_update_actions_state (NautilusFilesView *view)
                             selection_count == 1 &&
                             can_paste_into_file (NAUTILUS_FILE (selection->data)));
     can_extract_files = selection_count != 0 &&
-                        can_extract_all (selection);
+                        nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_ARCHIVE);
     can_extract_here = nautilus_files_view_supports_extract_here (view);
-    handles_all_files_to_extract = nautilus_handles_all_files_to_extract (selection);
+    handles_all_files_to_extract = can_extract_files &&
+                                   nautilus_handles_all_files_to_extract (selection);
     settings_show_delete_permanently = g_settings_get_boolean (nautilus_preferences,
                                                                NAUTILUS_PREFERENCES_SHOW_DELETE_PERMANENTLY);
     settings_show_create_link = g_settings_get_boolean (nautilus_preferences,
@@ -7646,7 +7574,7 @@ real_update_actions_state (NautilusFilesView *view)
     if (selection_count > 1)
     {
         g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
-                                     nautilus_file_can_rename_files (selection));
+                                     nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_CAN_RENAME));
     }
     else
     {
@@ -7686,24 +7614,9 @@ real_update_actions_state (NautilusFilesView *view)
                                          "new-folder");
     g_simple_action_set_enabled (G_SIMPLE_ACTION (action), can_create_files);
 
-    item_opens_in_view = selection_count != 0;
-
-    for (l = selection; l != NULL; l = l->next)
-    {
-        NautilusFile *file;
-
-        file = NAUTILUS_FILE (selection->data);
-
-        if (!nautilus_file_opens_in_view (file))
-        {
-            item_opens_in_view = FALSE;
-        }
-
-        if (!item_opens_in_view)
-        {
-            break;
-        }
-    }
+    /* Only folders open in the view */
+    item_opens_in_view = selection_count != 0 &&
+                         nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_DIRECTORY);
 
     action = g_action_map_lookup_action (G_ACTION_MAP (view_action_group),
                                          "open-with-default-application");
@@ -7729,7 +7642,8 @@ real_update_actions_state (NautilusFilesView *view)
     g_simple_action_set_enabled (G_SIMPLE_ACTION (action), can_set_wallpaper (selection));
     action = g_action_map_lookup_action (G_ACTION_MAP (view_action_group),
                                          "restore-from-trash");
-    g_simple_action_set_enabled (G_SIMPLE_ACTION (action), can_restore_from_trash (selection));
+    g_simple_action_set_enabled (G_SIMPLE_ACTION (action),
+                                 selection_all_in_trash && can_restore_from_trash (selection));
 
     action = g_action_map_lookup_action (G_ACTION_MAP (view_action_group),
                                          "move-to-trash");
@@ -7791,12 +7705,13 @@ real_update_actions_state (NautilusFilesView *view)
                                  !selection_contains_starred);
 
     /* Drive menu */
-    show_mount = (selection != NULL);
-    show_unmount = (selection != NULL);
-    show_eject = (selection != NULL);
-    show_start = (selection != NULL && selection_count == 1);
-    show_stop = (selection != NULL && selection_count == 1);
-    show_detect_media = (selection != NULL && selection_count == 1);
+    show_mount = (selection_count != 0 &&
+                  nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_VOLUME));
+    show_unmount = show_mount;
+    show_eject = show_mount;
+    show_start = (show_mount && selection_count == 1);
+    show_stop = (show_mount && selection_count == 1);
+    show_detect_media = (show_mount && selection_count == 1);
     for (l = selection; l != NULL && (show_mount || show_unmount
                                       || show_eject
                                       || show_start || show_stop
@@ -7933,10 +7848,14 @@ real_update_actions_state (NautilusFilesView *view)
     current_uri = g_file_get_uri (current_location);
     can_star_current_directory = nautilus_tag_manager_can_star_contents (priv->tag_manager, current_location);
 
-    show_star = (selection != NULL) &&
+    show_star = selection_count != 0 &&
                 (can_star_current_directory || selection_contains_starred);
-    show_unstar = (selection != NULL) &&
-                  (can_star_current_directory || selection_contains_starred);
+    show_unstar = show_star;
+    if (show_star && selection == NULL)
+    {
+        /* Whether files are starred is not part of the selection totals */
+        selection = nautilus_selection_set_get_files (priv->selection_set);
+    }
     for (l = selection; l != NULL; l = l->next)
     {
         NautilusFile *file;
@@ -8558,28 +8477,37 @@ schedule_update_status (NautilusFilesView *view)
     }
 }
 
-/**
- * nautilus_files_view_notify_selection_changed:
- *
- * Notify this view that the selection has changed. This is normally
- * called only by subclasses.
- * @view: NautilusFilesView whose selection has changed.
- *
- **/
-void
-nautilus_files_view_notify_selection_changed (NautilusFilesView *view)
+static void
+update_selection_summary (NautilusFilesView *view,
+                          GList             *selection)
 {
     NautilusFilesViewPrivate *priv;
-    GtkWindow *window;
-    g_autolist (NautilusFile) selection = NULL;
-
-    g_return_if_fail (NAUTILUS_IS_FILES_VIEW (view));
+    g_autolist (NautilusFile) added = NULL;
+    g_autolist (NautilusFile) removed = NULL;
 
     priv = nautilus_files_view_get_instance_private (view);
 
-    selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
-    window = nautilus_files_view_get_containing_window (view);
-    DEBUG_FILES (selection, "Selection changed in window %p", window);
+    if (!nautilus_selection_set_replace (priv->selection_set, selection, &added, &removed))
+    {
+        return;
+    }
+
+    for (GList *l = removed; l != NULL; l = l->next)
+    {
+        nautilus_selection_summary_remove_file (priv->selection_summary, l->data);
+    }
+    for (GList *l = added; l != NULL; l = l->next)
+    {
+        nautilus_selection_summary_add_file (priv->selection_summary, l->data);
+    }
+}
+
+static void
+selection_changed (NautilusFilesView *view)
+{
+    NautilusFilesViewPrivate *priv;
+
+    priv = nautilus_files_view_get_instance_private (view);
 
     priv->selection_was_removed = FALSE;
 
@@ -8608,6 +8536,76 @@ nautilus_files_view_notify_selection_changed (NautilusFilesView *view)
     }
 }
 
+/**
+ * nautilus_files_view_notify_selection_changed:
+ *
+ * Notify this view that the selection has changed. This is normally
+ * called only by subclasses.
+ * @view: NautilusFilesView whose selection has changed.
+ *
+ **/
+void
+nautilus_files_view_notify_selection_changed (NautilusFilesView *view)
+{
+    GtkWindow *window;
+    g_autolist (NautilusFile) selection = NULL;
+
+    g_return_if_fail (NAUTILUS_IS_FILES_VIEW (view));
+
+    selection = nautilus_view_get_selection (NAUTILUS_VIEW (view));
+    window = nautilus_files_view_get_containing_window (view);
+    DEBUG_FILES (selection, "Selection changed in window %p", window);
+
+    update_selection_summary (view, selection);
+
+    selection_changed (view);
+}
+
+/**
+ * nautilus_files_view_notify_selection_changes:
+ * @view: NautilusFilesView whose selection has changed.
+ * @added: (element-type NautilusFile): files that got selected
+ * @removed: (element-type NautilusFile): files that got unselected
+ *
+ * Like nautilus_files_view_notify_selection_changed(), for subclasses that
+ * know what changed, so that the selection is not compared as a whole.
+ */
+void
+nautilus_files_view_notify_selection_changes (NautilusFilesView *view,
+                                              GList             *added,
+                                              GList             *removed)
+{
+    NautilusFilesViewPrivate *priv;
+
+    g_return_if_fail (NAUTILUS_IS_FILES_VIEW (view));
+
+    priv = nautilus_files_view_get_instance_private (view);
+
+    DEBUG ("Selection changed in window %p, %u files added, %u removed",
+           nautilus_files_view_get_containing_window (view),
+           g_list_length (added), g_list_length (removed));
+
+    /* Removed files might be gone from the view already, but the set keeps
+     * the ones it has alive. */
+    for (GList *l = removed; l != NULL; l = l->next)
+    {
+        if (nautilus_selection_set_contains (priv->selection_set, l->data))
+        {
+            nautilus_selection_summary_remove_file (priv->selection_summary, l->data);
+            nautilus_selection_set_remove (priv->selection_set, l->data);
+        }
+    }
+    for (GList *l = added; l != NULL; l = l->next)
+    {
+        if (nautilus_selection_set_add (priv->selection_set, l->data))
+        {
+            nautilus_selection_summary_add_file (priv->selection_summary, l->data);
+        }
+    }
+
+    selection_changed (view);
+}
+
 static void
 file_changed_callback (NautilusFile *file,
                        gpointer      callback_data)
@@ -8647,6 +8645,7 @@ load_directory (NautilusFilesView *view,
     g_signal_emit (view, signals[CLEAR], 0);
 
     priv->loading = TRUE;
+    priv->first_paint_done = FALSE;
 
     setup_loading_floating_bar (view);
 
@@ -8759,10 +8758,18 @@ finish_loading (NautilusFilesView *view)
     {
         /* Unschedule a pending update and schedule a new one with the minimal
          * update interval. This gives the view a short chance at gathering the
-         * (cached) deep counts.
+         * (cached) deep counts. Nothing is shown yet for the first paint
+         * though, so don't make it wait.
          */
         unschedule_display_of_pending_files (view);
-        schedule_timeout_display_of_pending_files (view, UPDATE_INTERVAL_MIN);
+        if (!priv->first_paint_done)
+        {
+            schedule_idle_display_of_pending_files (view);
+        }
+        else
+        {
+            schedule_timeout_display_of_pending_files (view, UPDATE_INTERVAL_MIN);
+        }
     }
 
     /* Start loading. */
@@ -8934,6 +8941,8 @@ nautilus_files_view_stop_loading (NautilusFilesView *view)
     g_list_free_full (priv->old_changed_files, file_and_directory_free);
     priv->old_changed_files = NULL;
 
+    nautilus_pending_files_clear (priv->pending_added_files);
+
     g_list_free_full (priv->pending_selection, g_object_unref);
     priv->pending_selection = NULL;
 
@@ -9120,9 +9129,10 @@ nautilus_files_view_stop_batching_selection_changes (NautilusFilesView *view)
 
     if (--priv->batching_selection_level == 0)
     {
+        /* The selection summary was kept up to date while batching */
         if (priv->selection_changed_while_batched)
         {
-            nautilus_files_view_notify_selection_changed (view);
+            selection_changed (view);
         }
     }
 }
@@ -9916,6 +9926,12 @@ nautilus_files_view_init (NautilusFilesView *view)
                                NULL);
 
     priv->pending_reveal = g_hash_table_new (NULL, NULL);
+    priv->pending_added_files = nautilus_pending_files_new (compare_files_cover,
+                                                            keep_pending_added_file,
+                                                            file_and_directory_free,
+                                                            view);
+    priv->selection_set = nautilus_selection_set_new ();
+    priv->selection_summary = nautilus_selection_summary_new ();
 
     gtk_style_context_set_junction_sides (gtk_widget_get_style_context (GTK_WIDGET (view)),
                                           GTK_JUNCTION_TOP | GTK_JUNCTION_LEFT);
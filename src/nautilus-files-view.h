@@ -274,6 +274,9 @@ void                nautilus_files_view_preview_update                   (Nautil
 void                nautilus_files_view_start_batching_selection_changes (NautilusFilesView *view);
 void                nautilus_files_view_stop_batching_selection_changes  (NautilusFilesView *view);
 void                nautilus_files_view_notify_selection_changed         (NautilusFilesView *view);
+void                nautilus_files_view_notify_selection_changes         (NautilusFilesView *view,
+                                                                          GList             *added,
+                                                                          GList             *removed);
 NautilusDirectory  *nautilus_files_view_get_model                        (NautilusFilesView *view);
 NautilusFile       *nautilus_files_view_get_directory_as_file            (NautilusFilesView *view);
 void                nautilus_files_view_pop_up_background_context_menu   (NautilusFilesView *view,
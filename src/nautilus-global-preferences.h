@@ -114,6 +114,8 @@ typedef enum
 #define NAUTILUS_PREFERENCES_SHOW_DIRECTORY_ITEM_COUNTS "show-directory-item-counts"
 #define NAUTILUS_PREFERENCES_SHOW_FILE_THUMBNAILS	"show-image-thumbnails"
 #define NAUTILUS_PREFERENCES_FILE_THUMBNAIL_LIMIT	"thumbnail-limit"
+#define NAUTILUS_PREFERENCES_THUMBNAIL_THREADS		"thumbnail-threads"
+#define NAUTILUS_PREFERENCES_THUMBNAIL_CACHE_SIZE	"thumbnail-cache-size"
 
 typedef enum
 {
@@ -132,6 +134,8 @@ typedef enum
 
 /* Search behaviour */
 #define NAUTILUS_PREFERENCES_RECURSIVE_SEARCH "recursive-search"
+#define NAUTILUS_PREFERENCES_SEARCH_INDEX_LOCATIONS "search-index-locations"
+#define NAUTILUS_PREFERENCES_SEARCH_PRUNE_PATTERNS "search-prune-patterns"
 
 /* Context menu options */
 #define NAUTILUS_PREFERENCES_SHOW_DELETE_PERMANENTLY "show-delete-permanently"
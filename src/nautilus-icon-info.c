@@ -17,22 +17,40 @@
 
 #include "nautilus-icon-info.h"
 
+#define DEBUG_FLAG NAUTILUS_DEBUG_ICON_CACHE
+#include "nautilus-debug.h"
+
 #include "nautilus-enums.h"
 
+/* Upper bound for the pixel data of the cached icons, in bytes. About a
+ * thousand icons at 48×48, or a few hundred at 96×96 for scale factor 2.
+ */
+#define ICON_CACHE_MAX_SIZE (16 * 1024 * 1024)
+
+/* Icons looked up per idle iteration while pre-warming the cache */
+#define PREWARM_ICONS_PER_ITERATION 4
+
 struct _NautilusIconInfo
 {
     GObject parent;
 
     gboolean sole_owner;
-    gint64 last_use_time;
     GdkPixbuf *pixbuf;
 
     char *icon_name;
 
     gint orig_scale;
+
+    /* Set while the icon is in loadable_icon_cache or themed_icon_cache. The
+     * link is only in cache_lru while the icon is the sole owner of its
+     * pixbuf. */
+    gpointer cache_key;
+    GHashTable *cache;
+    GList *cache_link;
+    gsize cache_cost;
 };
 
-static void schedule_reap_cache (void);
+static void cache_icon_released (NautilusIconInfo *icon);
 
 G_DEFINE_TYPE (NautilusIconInfo,
                nautilus_icon_info,
@@ -41,7 +59,6 @@ G_DEFINE_TYPE (NautilusIconInfo,
 static void
 nautilus_icon_info_init (NautilusIconInfo *icon)
 {
-    icon->last_use_time = g_get_monotonic_time ();
     icon->sole_owner = TRUE;
 }
 
@@ -64,8 +81,8 @@ pixbuf_toggle_notify (gpointer  info,
         g_object_remove_toggle_ref (object,
                                     pixbuf_toggle_notify,
                                     info);
-        icon->last_use_time = g_get_monotonic_time ();
-        schedule_reap_cache ();
+
+        cache_icon_released (icon);
     }
 }
 
@@ -166,85 +183,156 @@ typedef struct
 
 static GHashTable *loadable_icon_cache = NULL;
 static GHashTable *themed_icon_cache = NULL;
-static guint reap_cache_timeout = 0;
 
-#define MICROSEC_PER_SEC ((guint64) 1000000L)
+/* NautilusIconInfo in either cache whose pixbuf is not in use elsewhere,
+ * least recently used first. Only these can be evicted, as evicting the
+ * others would free nothing. */
+static GQueue cache_lru = G_QUEUE_INIT;
+static gsize cache_size = 0;
 
-static guint time_now;
+static guint trim_cache_idle_id = 0;
 
-static gboolean
-reap_old_icon (gpointer key,
-               gpointer value,
-               gpointer user_info)
+static guint cache_hits = 0;
+static guint cache_misses = 0;
+static guint cache_evictions = 0;
+
+static void
+log_cache_stats (const char *reason)
 {
-    NautilusIconInfo *icon = value;
-    gboolean *reapable_icons_left = user_info;
+    DEBUG ("Icon cache %s: %u hits, %u misses, %u evictions, %u unused icons, %" G_GSIZE_FORMAT " bytes",
+           reason, cache_hits, cache_misses, cache_evictions,
+           cache_lru.length, cache_size);
+}
 
+/* Value destroy function of both caches */
+static void
+cache_value_free (NautilusIconInfo *icon)
+{
     if (icon->sole_owner)
     {
-        if (time_now - icon->last_use_time > 30 * MICROSEC_PER_SEC)
-        {
-            /* This went unused 30 secs ago. reap */
-            return TRUE;
-        }
-        else
-        {
-            /* We can reap this soon */
-            *reapable_icons_left = TRUE;
-        }
+        g_queue_delete_link (&cache_lru, icon->cache_link);
     }
+    else
+    {
+        g_list_free_1 (icon->cache_link);
+    }
+    cache_size -= icon->cache_cost;
+
+    icon->cache_key = NULL;
+    icon->cache = NULL;
+    icon->cache_link = NULL;
+    icon->cache_cost = 0;
 
-    return FALSE;
+    g_object_unref (icon);
 }
 
-static gboolean
-reap_cache (gpointer data)
+/* Evicts the least recently used icons that are not in use until the
+ * cache is within its size. */
+static void
+trim_cache (void)
 {
-    gboolean reapable_icons_left;
+    NautilusIconInfo *icon;
+    guint evicted = 0;
+
+    while (cache_lru.head != NULL && cache_size > ICON_CACHE_MAX_SIZE)
+    {
+        icon = cache_lru.head->data;
+        g_hash_table_remove (icon->cache, icon->cache_key);
+        evicted++;
+    }
+
+    if (evicted > 0)
+    {
+        cache_evictions += evicted;
+        log_cache_stats ("trimmed");
+    }
+}
 
-    reapable_icons_left = TRUE;
+static void
+cache_insert (GHashTable       *cache,
+              gpointer          key,
+              NautilusIconInfo *icon)
+{
+    cache_misses++;
 
-    time_now = g_get_monotonic_time ();
+    g_hash_table_insert (cache, key, icon);
 
-    if (loadable_icon_cache)
+    icon->cache_key = key;
+    icon->cache = cache;
+    icon->cache_cost = icon->pixbuf != NULL ? gdk_pixbuf_get_byte_length (icon->pixbuf) : 0;
+    icon->cache_link = g_list_alloc ();
+    icon->cache_link->data = icon;
+    if (icon->sole_owner)
     {
-        g_hash_table_foreach_remove (loadable_icon_cache,
-                                     reap_old_icon,
-                                     &reapable_icons_left);
+        g_queue_push_tail_link (&cache_lru, icon->cache_link);
     }
+    cache_size += icon->cache_cost;
 
-    if (themed_icon_cache)
+    trim_cache ();
+}
+
+static NautilusIconInfo *
+cache_use (NautilusIconInfo *icon)
+{
+    cache_hits++;
+
+    if (icon->sole_owner && icon->cache_link != cache_lru.tail)
     {
-        g_hash_table_foreach_remove (themed_icon_cache,
-                                     reap_old_icon,
-                                     &reapable_icons_left);
+        g_queue_unlink (&cache_lru, icon->cache_link);
+        g_queue_push_tail_link (&cache_lru, icon->cache_link);
     }
 
-    if (reapable_icons_left)
+    return g_object_ref (icon);
+}
+
+static gboolean
+trim_cache_idle (gpointer user_data)
+{
+    trim_cache_idle_id = 0;
+    trim_cache ();
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_trim_cache (void)
+{
+    if (trim_cache_idle_id == 0 && cache_size > ICON_CACHE_MAX_SIZE)
     {
-        return TRUE;
+        trim_cache_idle_id = g_idle_add (trim_cache_idle, NULL);
     }
-    else
+}
+
+/* The pixbuf of @icon is handed out, so it can't be evicted until it is
+ * released */
+static void
+cache_icon_in_use (NautilusIconInfo *icon)
+{
+    if (icon->cache_link != NULL)
     {
-        reap_cache_timeout = 0;
-        return FALSE;
+        g_queue_unlink (&cache_lru, icon->cache_link);
     }
 }
 
+/* The pixbuf of @icon is not in use anymore, so it can be evicted again,
+ * last as it was just used */
 static void
-schedule_reap_cache (void)
+cache_icon_released (NautilusIconInfo *icon)
 {
-    if (reap_cache_timeout == 0)
+    if (icon->cache_link != NULL)
     {
-        reap_cache_timeout = g_timeout_add_seconds_full (0, 5,
-                                                         reap_cache,
-                                                         NULL, NULL);
+        g_queue_push_tail_link (&cache_lru, icon->cache_link);
+
+        /* If the cache went over its size meanwhile */
+        schedule_trim_cache ();
     }
 }
 
 void
 nautilus_icon_info_clear_caches (void)
 {
+    log_cache_stats ("cleared");
+
     if (loadable_icon_cache)
     {
         g_hash_table_remove_all (loadable_icon_cache);
@@ -350,7 +438,7 @@ nautilus_icon_info_lookup (GIcon *icon,
                 g_hash_table_new_full ((GHashFunc) loadable_icon_key_hash,
                                        (GEqualFunc) loadable_icon_key_equal,
                                        (GDestroyNotify) loadable_icon_key_free,
-                                       (GDestroyNotify) g_object_unref);
+                                       (GDestroyNotify) cache_value_free);
         }
 
         lookup_key.icon = icon;
@@ -360,7 +448,7 @@ nautilus_icon_info_lookup (GIcon *icon,
         icon_info = g_hash_table_lookup (loadable_icon_cache, &lookup_key);
         if (icon_info)
         {
-            return g_object_ref (icon_info);
+            return cache_use (icon_info);
         }
 
         pixbuf = NULL;
@@ -379,10 +467,11 @@ nautilus_icon_info_lookup (GIcon *icon,
 
         icon_info = nautilus_icon_info_new_for_pixbuf (pixbuf, scale);
 
-        key = loadable_icon_key_new (icon, scale, size);
-        g_hash_table_insert (loadable_icon_cache, key, icon_info);
+        key = loadable_icon_key_new (icon, scale, size * scale);
+        g_object_ref (icon_info);
+        cache_insert (loadable_icon_cache, key, icon_info);
 
-        return g_object_ref (icon_info);
+        return icon_info;
     }
     else if (G_IS_THEMED_ICON (icon))
     {
@@ -399,7 +488,7 @@ nautilus_icon_info_lookup (GIcon *icon,
                 g_hash_table_new_full ((GHashFunc) themed_icon_key_hash,
                                        (GEqualFunc) themed_icon_key_equal,
                                        (GDestroyNotify) themed_icon_key_free,
-                                       (GDestroyNotify) g_object_unref);
+                                       (GDestroyNotify) cache_value_free);
         }
 
         names = g_themed_icon_get_names (G_THEMED_ICON (icon));
@@ -428,17 +517,18 @@ nautilus_icon_info_lookup (GIcon *icon,
         if (icon_info)
         {
             g_object_unref (gtkicon_info);
-            return g_object_ref (icon_info);
+            return cache_use (icon_info);
         }
 
         icon_info = nautilus_icon_info_new_for_icon_info (gtkicon_info, scale);
 
         key = themed_icon_key_new (filename, scale, size);
-        g_hash_table_insert (themed_icon_cache, key, icon_info);
+        g_object_ref (icon_info);
+        cache_insert (themed_icon_cache, key, icon_info);
 
         g_object_unref (gtkicon_info);
 
-        return g_object_ref (icon_info);
+        return icon_info;
     }
     else
     {
@@ -471,6 +561,88 @@ nautilus_icon_info_lookup (GIcon *icon,
     }
 }
 
+typedef struct
+{
+    GPtrArray *icons;
+    int sizes[NAUTILUS_ICON_INFO_MAX_PREWARM_SIZES];
+    guint n_sizes;
+    int scale;
+
+    /* Index of the next icon and size pair to look up */
+    guint next;
+} PrewarmData;
+
+static void
+prewarm_data_free (PrewarmData *data)
+{
+    g_ptr_array_unref (data->icons);
+    g_free (data);
+}
+
+static gboolean
+prewarm_cache_idle (gpointer user_data)
+{
+    PrewarmData *data = user_data;
+    guint n_lookups;
+    guint i;
+
+    n_lookups = data->icons->len * data->n_sizes;
+    for (i = 0; i < PREWARM_ICONS_PER_ITERATION && data->next < n_lookups; i++, data->next++)
+    {
+        g_autoptr (NautilusIconInfo) icon_info = NULL;
+
+        icon_info = nautilus_icon_info_lookup (g_ptr_array_index (data->icons, data->next / data->n_sizes),
+                                               data->sizes[data->next % data->n_sizes],
+                                               data->scale);
+    }
+
+    if (data->next < n_lookups)
+    {
+        return G_SOURCE_CONTINUE;
+    }
+
+    log_cache_stats ("pre-warmed");
+
+    return G_SOURCE_REMOVE;
+}
+
+/**
+ * nautilus_icon_info_prewarm_cache:
+ * @icons: (element-type GIcon): icons to load
+ * @sizes: sizes to load each icon at
+ * @n_sizes: number of @sizes, at most %NAUTILUS_ICON_INFO_MAX_PREWARM_SIZES
+ * @scale: scale factor to load the icons for
+ *
+ * Looks up @icons in the background, a few at a time from a low priority
+ * idle, so that they are in the cache by the time a view shows them.
+ */
+void
+nautilus_icon_info_prewarm_cache (GList     *icons,
+                                  const int *sizes,
+                                  guint      n_sizes,
+                                  int        scale)
+{
+    PrewarmData *data;
+    GList *l;
+
+    g_return_if_fail (n_sizes > 0 && n_sizes <= NAUTILUS_ICON_INFO_MAX_PREWARM_SIZES);
+
+    data = g_new0 (PrewarmData, 1);
+    data->icons = g_ptr_array_new_with_free_func (g_object_unref);
+    for (l = icons; l != NULL; l = l->next)
+    {
+        g_ptr_array_add (data->icons, g_object_ref (l->data));
+    }
+    memcpy (data->sizes, sizes, n_sizes * sizeof (int));
+    data->n_sizes = n_sizes;
+    data->scale = scale;
+
+    g_idle_add_full (G_PRIORITY_LOW,
+                     prewarm_cache_idle,
+                     data,
+                     (GDestroyNotify) prewarm_data_free);
+}
+
 NautilusIconInfo *
 nautilus_icon_info_lookup_from_name (const char *name,
                                      int         size,
@@ -521,6 +693,7 @@ nautilus_icon_info_get_pixbuf_nodefault (NautilusIconInfo *icon)
             g_object_add_toggle_ref (G_OBJECT (res),
                                      pixbuf_toggle_notify,
                                      icon);
+            cache_icon_in_use (icon);
         }
     }
 
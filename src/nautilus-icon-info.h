@@ -14,6 +14,8 @@ G_BEGIN_DECLS
 /* Maximum size of an icon that the icon factory will ever produce */
 #define NAUTILUS_ICON_MAXIMUM_SIZE     320
 
+#define NAUTILUS_ICON_INFO_MAX_PREWARM_SIZES 4
+
 #define NAUTILUS_TYPE_ICON_INFO (nautilus_icon_info_get_type ())
 G_DECLARE_FINAL_TYPE (NautilusIconInfo, nautilus_icon_info, NAUTILUS, ICON_INFO, GObject)
 
@@ -38,6 +40,10 @@ GdkPixbuf *           nautilus_icon_info_get_pixbuf_at_size           (NautilusI
 const char *          nautilus_icon_info_get_used_name                (NautilusIconInfo  *icon);
 
 void                  nautilus_icon_info_clear_caches                 (void);
+void                  nautilus_icon_info_prewarm_cache                (GList             *icons,
+								       const int         *sizes,
+								       guint              n_sizes,
+								       int                scale);
 
 gint  nautilus_get_icon_size_for_stock_size          (GtkIconSize        size);
 
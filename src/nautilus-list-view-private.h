@@ -24,6 +24,7 @@
 #include "nautilus-tree-view-drag-dest.h"
 #include "nautilus-dnd.h"
 #include "nautilus-tag-manager.h"
+#include "nautilus-ui-utilities.h"
 
 struct NautilusListViewDetails {
   GtkTreeView *tree_view;
@@ -75,5 +76,12 @@ struct NautilusListViewDetails {
 
   GtkGesture *tree_view_drag_gesture;
   GtkGesture *tree_view_multi_press_gesture;
+
+  /* Which way the view is scrolling, and the files of the rows ahead of it
+   * that were prefetched. */
+  NautilusScrollTracker scroll_tracker;
+  GHashTable *prefetched_files;
+  /* The files of the visible rows, which the thumbnail cache keeps */
+  GHashTable *visible_files;
 };
 
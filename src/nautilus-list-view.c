@@ -50,6 +50,8 @@
 #include "nautilus-metadata.h"
 #include "nautilus-search-directory.h"
 #include "nautilus-tag-manager.h"
+#include "nautilus-thumbnail-cache.h"
+#include "nautilus-thumbnails.h"
 #include "nautilus-toolbar.h"
 #include "nautilus-tree-view-drag-dest.h"
 #include "nautilus-ui-utilities.h"
@@ -2113,6 +2115,195 @@ list_view_use_tree_changed_callback (gpointer callback_data)
 }
 
 
+/* Returns the file of the top level row at @index, with a reference. */
+static NautilusFile *
+get_file_for_row (NautilusListView *view,
+                  int               index)
+{
+    GtkTreeModel *model;
+    GtkTreeIter iter;
+    NautilusFile *file = NULL;
+
+    model = GTK_TREE_MODEL (view->details->model);
+    if (gtk_tree_model_iter_nth_child (model, &iter, NULL, index))
+    {
+        gtk_tree_model_get (model, &iter,
+                            NAUTILUS_LIST_MODEL_FILE_COLUMN, &file,
+                            -1);
+    }
+
+    return file;
+}
+
+static void
+prioritize_file (NautilusFile *file,
+                 gboolean      prefetch)
+{
+    char *uri;
+
+    nautilus_file_prioritize_attributes (file);
+
+    if (nautilus_file_is_thumbnailing (file))
+    {
+        uri = nautilus_file_get_uri (file);
+        if (prefetch)
+        {
+            nautilus_thumbnail_prefetch (uri);
+        }
+        else
+        {
+            nautilus_thumbnail_prioritize (uri);
+        }
+        g_free (uri);
+    }
+}
+
+static void
+cancel_prefetch (NautilusFile *file)
+{
+    char *uri;
+
+    if (nautilus_file_is_thumbnailing (file))
+    {
+        uri = nautilus_file_get_uri (file);
+        nautilus_thumbnail_cancel_prefetch (uri);
+        g_free (uri);
+    }
+}
+
+static void
+set_files_visible (GHashTable *files,
+                   gboolean    visible)
+{
+    GHashTableIter iter;
+    gpointer file;
+
+    g_hash_table_iter_init (&iter, files);
+    while (g_hash_table_iter_next (&iter, &file, NULL))
+    {
+        nautilus_thumbnail_cache_set_visible (file, visible);
+    }
+}
+
+/* Has the thumbnails and attributes of the visible rows read first, and
+ * then those of the rows the view is scrolling towards, as the canvas
+ * view does, and keeps the thumbnails of the visible rows in the cache.
+ * Only top level rows are considered, which is what the view shows most
+ * of the time.
+ */
+static void
+update_visible_rows (NautilusListView *view)
+{
+    GtkAdjustment *vadjustment;
+    GtkTreePath *start_path;
+    GtkTreePath *end_path;
+    GHashTable *prefetched_files;
+    GHashTable *visible_files;
+    GHashTableIter iter;
+    gpointer file;
+    int start, end;
+    int ahead_start, ahead_end;
+    int n_rows;
+    int ahead;
+    int i;
+
+    vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (view->details->tree_view));
+    if (vadjustment == NULL ||
+        !gtk_tree_view_get_visible_range (view->details->tree_view, &start_path, &end_path))
+    {
+        return;
+    }
+
+    nautilus_scroll_tracker_update (&view->details->scroll_tracker,
+                                    gtk_adjustment_get_value (vadjustment),
+                                    gtk_adjustment_get_page_size (vadjustment));
+
+    start = gtk_tree_path_get_indices (start_path)[0];
+    end = gtk_tree_path_get_indices (end_path)[0];
+    gtk_tree_path_free (start_path);
+    gtk_tree_path_free (end_path);
+
+    n_rows = gtk_tree_model_iter_n_children (GTK_TREE_MODEL (view->details->model), NULL);
+    ahead = (end - start + 1) *
+            nautilus_scroll_tracker_get_pages_ahead (&view->details->scroll_tracker);
+    if (nautilus_scroll_tracker_get_direction (&view->details->scroll_tracker) > 0)
+    {
+        ahead_start = end + 1;
+        ahead_end = MIN (end + ahead, n_rows - 1);
+    }
+    else
+    {
+        ahead_start = MAX (start - ahead, 0);
+        ahead_end = start - 1;
+    }
+
+    /* Each of these goes to the head of its queue, so go from the farthest
+     * row to the closest one. */
+    prefetched_files = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                              (GDestroyNotify) nautilus_file_unref, NULL);
+    for (i = 0; i <= ahead_end - ahead_start; i++)
+    {
+        file = get_file_for_row (view, ahead_start > end ? ahead_end - i : ahead_start + i);
+        if (file != NULL)
+        {
+            prioritize_file (file, TRUE);
+            g_hash_table_add (prefetched_files, file);
+        }
+    }
+
+    visible_files = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                           (GDestroyNotify) nautilus_file_unref, NULL);
+    for (i = end; i >= start; i--)
+    {
+        file = get_file_for_row (view, i);
+        if (file != NULL)
+        {
+            prioritize_file (file, FALSE);
+            g_hash_table_remove (view->details->prefetched_files, file);
+            g_hash_table_add (visible_files, file);
+        }
+    }
+
+    g_hash_table_iter_init (&iter, visible_files);
+    while (g_hash_table_iter_next (&iter, &file, NULL))
+    {
+        if (!g_hash_table_contains (view->details->visible_files, file))
+        {
+            nautilus_thumbnail_cache_set_visible (file, TRUE);
+        }
+    }
+    g_hash_table_iter_init (&iter, view->details->visible_files);
+    while (g_hash_table_iter_next (&iter, &file, NULL))
+    {
+        if (!g_hash_table_contains (visible_files, file))
+        {
+            nautilus_thumbnail_cache_set_visible (file, FALSE);
+        }
+    }
+    g_hash_table_destroy (view->details->visible_files);
+    view->details->visible_files = visible_files;
+
+    /* Left behind, or the scrolling turned around */
+    g_hash_table_iter_init (&iter, view->details->prefetched_files);
+    while (g_hash_table_iter_next (&iter, &file, NULL))
+    {
+        if (!g_hash_table_contains (prefetched_files, file))
+        {
+            cancel_prefetch (file);
+        }
+    }
+
+    g_hash_table_destroy (view->details->prefetched_files);
+    view->details->prefetched_files = prefetched_files;
+}
+
+static void
+on_vadjustment_changed (GtkAdjustment    *adjustment,
+                        NautilusListView *view)
+{
+    update_visible_rows (view);
+}
+
 static void
 create_and_set_up_tree_view (NautilusListView *view)
 {
@@ -2124,6 +2315,7 @@ create_and_set_up_tree_view (NautilusListView *view)
     gchar **default_column_order, **default_visible_columns;
     GtkWidget *content_widget;
     GtkGesture *longpress_gesture;
+    GtkAdjustment *vadjustment;
 
     content_widget = nautilus_files_view_get_content_widget (NAUTILUS_FILES_VIEW (view));
     view->details->tree_view = GTK_TREE_VIEW (gtk_tree_view_new ());
@@ -2417,6 +2609,18 @@ create_and_set_up_tree_view (NautilusListView *view)
     gtk_widget_show (GTK_WIDGET (view->details->tree_view));
     gtk_container_add (GTK_CONTAINER (content_widget), GTK_WIDGET (view->details->tree_view));
 
+    view->details->prefetched_files = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                             (GDestroyNotify) nautilus_file_unref,
+                                                             NULL);
+    view->details->visible_files = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                                          (GDestroyNotify) nautilus_file_unref,
+                                                          NULL);
+    vadjustment = gtk_scrollable_get_vadjustment (GTK_SCROLLABLE (view->details->tree_view));
+    g_signal_connect_object (vadjustment, "value-changed",
+                             G_CALLBACK (on_vadjustment_changed), view, 0);
+    g_signal_connect_object (vadjustment, "changed",
+                             G_CALLBACK (on_vadjustment_changed), view, 0);
+
     atk_obj = gtk_widget_get_accessible (GTK_WIDGET (view->details->tree_view));
     atk_object_set_name (atk_obj, _("List View"));
 
@@ -2764,6 +2968,11 @@ nautilus_list_view_clear (NautilusFilesView *view)
 
         nautilus_list_model_clear (list_view->details->model);
     }
+
+    g_hash_table_remove_all (list_view->details->prefetched_files);
+    set_files_visible (list_view->details->visible_files, FALSE);
+    g_hash_table_remove_all (list_view->details->visible_files);
+    nautilus_scroll_tracker_reset (&list_view->details->scroll_tracker);
 }
 
 static void
@@ -3106,6 +3315,13 @@ nautilus_list_view_remove_file (NautilusFilesView *view,
 
         nautilus_list_model_remove_file (list_view->details->model, file, directory);
 
+        /* Until the visible rows are updated again */
+        if (g_hash_table_contains (list_view->details->visible_files, file))
+        {
+            nautilus_thumbnail_cache_set_visible (file, FALSE);
+            g_hash_table_remove (list_view->details->visible_files, file);
+        }
+
         if (gtk_tree_row_reference_valid (row_reference))
         {
             if (list_view->details->new_selection_path)
@@ -3740,6 +3956,9 @@ nautilus_list_view_finalize (GObject *object)
 
     g_list_free (list_view->details->cells);
     g_hash_table_destroy (list_view->details->columns);
+    g_hash_table_destroy (list_view->details->prefetched_files);
+    set_files_visible (list_view->details->visible_files, FALSE);
+    g_hash_table_destroy (list_view->details->visible_files);
 
     if (list_view->details->hover_path != NULL)
     {
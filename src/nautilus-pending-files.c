@@ -0,0 +1,250 @@
+/* nautilus-pending-files.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-pending-files.h"
+
+struct _NautilusPendingFiles
+{
+    /* The smallest item is at index 0, and the children of the item at
+     * index i are at 2i + 1 and 2i + 2 */
+    GPtrArray *heap;
+
+    GCompareDataFunc compare_func;
+    NautilusPendingFilesKeepFunc keep_func;
+    GDestroyNotify free_func;
+    gpointer user_data;
+};
+
+/**
+ * nautilus_pending_files_new:
+ * @compare_func: the function to order the items by
+ * @keep_func: (nullable): the function to check the items again with, when
+ *   they are taken out
+ * @free_func: (nullable): the function to free the items dropped, or left
+ *   when @pending is cleared
+ * @user_data: the data for @compare_func and @keep_func
+ *
+ * Returns: a new #NautilusPendingFiles, empty.
+ */
+NautilusPendingFiles *
+nautilus_pending_files_new (GCompareDataFunc             compare_func,
+                            NautilusPendingFilesKeepFunc keep_func,
+                            GDestroyNotify               free_func,
+                            gpointer                     user_data)
+{
+    NautilusPendingFiles *pending;
+
+    pending = g_new0 (NautilusPendingFiles, 1);
+    pending->heap = g_ptr_array_new_with_free_func (free_func);
+    pending->compare_func = compare_func;
+    pending->keep_func = keep_func;
+    pending->free_func = free_func;
+    pending->user_data = user_data;
+
+    return pending;
+}
+
+void
+nautilus_pending_files_free (NautilusPendingFiles *pending)
+{
+    if (pending == NULL)
+    {
+        return;
+    }
+
+    g_ptr_array_unref (pending->heap);
+    g_free (pending);
+}
+
+static int
+compare_items (NautilusPendingFiles *pending,
+               guint                 index_a,
+               guint                 index_b)
+{
+    return pending->compare_func (g_ptr_array_index (pending->heap, index_a),
+                                  g_ptr_array_index (pending->heap, index_b),
+                                  pending->user_data);
+}
+
+static void
+swap_items (NautilusPendingFiles *pending,
+            guint                 index_a,
+            guint                 index_b)
+{
+    gpointer swap;
+
+    swap = g_ptr_array_index (pending->heap, index_a);
+    g_ptr_array_index (pending->heap, index_a) = g_ptr_array_index (pending->heap, index_b);
+    g_ptr_array_index (pending->heap, index_b) = swap;
+}
+
+static void
+sift_down (NautilusPendingFiles *pending,
+           guint                 index)
+{
+    guint smallest;
+    guint child;
+
+    while (TRUE)
+    {
+        smallest = index;
+        for (child = 2 * index + 1; child <= 2 * index + 2 && child < pending->heap->len; child++)
+        {
+            if (compare_items (pending, child, smallest) < 0)
+            {
+                smallest = child;
+            }
+        }
+
+        if (smallest == index)
+        {
+            return;
+        }
+
+        swap_items (pending, smallest, index);
+        index = smallest;
+    }
+}
+
+static void
+sift_up (NautilusPendingFiles *pending,
+         guint                 index)
+{
+    guint parent;
+
+    for (; index > 0; index = parent)
+    {
+        parent = (index - 1) / 2;
+        if (compare_items (pending, parent, index) <= 0)
+        {
+            return;
+        }
+
+        swap_items (pending, parent, index);
+    }
+}
+
+static gpointer
+pop_smallest (NautilusPendingFiles *pending)
+{
+    GPtrArray *heap;
+    gpointer smallest;
+
+    heap = pending->heap;
+    smallest = g_ptr_array_index (heap, 0);
+    g_ptr_array_index (heap, 0) = g_ptr_array_index (heap, heap->len - 1);
+    /* Don't let the free func take the one we are returning */
+    g_ptr_array_index (heap, heap->len - 1) = NULL;
+    g_ptr_array_set_size (heap, heap->len - 1);
+    sift_down (pending, 0);
+
+    return smallest;
+}
+
+/**
+ * nautilus_pending_files_add:
+ * @pending: a #NautilusPendingFiles
+ * @items: the items to add, which @pending takes ownership of, but not of
+ *   the list
+ */
+void
+nautilus_pending_files_add (NautilusPendingFiles *pending,
+                            GList                *items)
+{
+    GList *l;
+    guint i;
+
+    if (pending->heap->len == 0)
+    {
+        for (l = items; l != NULL; l = l->next)
+        {
+            g_ptr_array_add (pending->heap, l->data);
+        }
+        for (i = pending->heap->len / 2; i > 0; i--)
+        {
+            sift_down (pending, i - 1);
+        }
+    }
+    else
+    {
+        for (l = items; l != NULL; l = l->next)
+        {
+            g_ptr_array_add (pending->heap, l->data);
+            sift_up (pending, pending->heap->len - 1);
+        }
+    }
+}
+
+/**
+ * nautilus_pending_files_take:
+ * @pending: a #NautilusPendingFiles
+ * @max_items: the most items to take
+ * @deadline: the monotonic time after which to stop taking items
+ *
+ * Takes the smallest items out of @pending, in order, leaving out the ones
+ * the keep function rejects. At least one item is taken, if there is any to
+ * keep, so that callers make progress.
+ *
+ * Returns: (transfer full): the items taken.
+ */
+GList *
+nautilus_pending_files_take (NautilusPendingFiles *pending,
+                             guint                 max_items,
+                             gint64                deadline)
+{
+    GList *items = NULL;
+    gpointer item;
+    guint n_taken = 0;
+
+    while (pending->heap->len > 0 && n_taken < max_items)
+    {
+        if (n_taken > 0 && g_get_monotonic_time () > deadline)
+        {
+            break;
+        }
+
+        item = pop_smallest (pending);
+        if (pending->keep_func != NULL &&
+            !pending->keep_func (item, pending->user_data))
+        {
+            if (pending->free_func != NULL)
+            {
+                pending->free_func (item);
+            }
+            continue;
+        }
+
+        items = g_list_prepend (items, item);
+        n_taken++;
+    }
+
+    return g_list_reverse (items);
+}
+
+guint
+nautilus_pending_files_get_length (NautilusPendingFiles *pending)
+{
+    return pending->heap->len;
+}
+
+void
+nautilus_pending_files_clear (NautilusPendingFiles *pending)
+{
+    g_ptr_array_set_size (pending->heap, 0);
+}
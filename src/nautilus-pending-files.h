@@ -0,0 +1,56 @@
+/* nautilus-pending-files.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The files waiting to be added to a view, in a binary heap. Building the
+ * heap is linear and each file taken out of it costs a logarithmic number
+ * of comparisons, so the first files can be shown in order without sorting
+ * all of them.
+ *
+ * Files can wait in it across many display passes, so each one is checked
+ * again with the keep function when it is taken out, and dropped if it
+ * should not be shown anymore.
+ */
+typedef struct _NautilusPendingFiles NautilusPendingFiles;
+
+/* Returns %TRUE if @item should still be added */
+typedef gboolean (*NautilusPendingFilesKeepFunc) (gpointer item,
+                                                  gpointer user_data);
+
+NautilusPendingFiles *nautilus_pending_files_new        (GCompareDataFunc              compare_func,
+                                                         NautilusPendingFilesKeepFunc  keep_func,
+                                                         GDestroyNotify                free_func,
+                                                         gpointer                      user_data);
+void                  nautilus_pending_files_free       (NautilusPendingFiles         *pending);
+
+void                  nautilus_pending_files_add        (NautilusPendingFiles         *pending,
+                                                         GList                        *items);
+GList                *nautilus_pending_files_take       (NautilusPendingFiles         *pending,
+                                                         guint                         max_items,
+                                                         gint64                        deadline);
+guint                 nautilus_pending_files_get_length (NautilusPendingFiles         *pending);
+void                  nautilus_pending_files_clear      (NautilusPendingFiles         *pending);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (NautilusPendingFiles, nautilus_pending_files_free)
+
+G_END_DECLS
@@ -0,0 +1,335 @@
+/* nautilus-query-matcher.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-query-matcher.h"
+
+#include <string.h>
+
+#define RANK_SCALE_FACTOR 100
+#define MIN_RANK 10.0
+#define MAX_RANK 50.0
+
+/* Names up to this length are lowercased on the stack. File systems seldom
+ * allow longer names than 255 bytes.
+ */
+#define MAX_FAST_NAME_LENGTH 512
+
+typedef struct
+{
+    char *text;
+    gsize length;
+} MatcherWord;
+
+struct _NautilusQueryMatcher
+{
+    /* The normalized, lowercase query text */
+    gchar *text;
+
+    /* The words of the normalized, lowercase query text, or %NULL if
+     * there is no text, and nothing matches.
+     */
+    MatcherWord *words;
+    guint n_words;
+
+    /* Whether lowercasing the ASCII letters of an ASCII string gives the
+     * same as g_utf8_strdown(), which is not the case in Turkic locales.
+     */
+    gboolean ascii_fast_path;
+};
+
+static gchar *
+prepare_string_for_compare (const gchar *string)
+{
+    gchar *normalized, *res;
+
+    normalized = g_utf8_normalize (string, -1, G_NORMALIZE_NFD);
+    res = g_utf8_strdown (normalized, -1);
+    g_free (normalized);
+
+    return res;
+}
+
+static gboolean
+ascii_lowercase_is_utf8_lowercase (void)
+{
+    g_autofree gchar *lowercase = NULL;
+
+    lowercase = g_utf8_strdown ("I", -1);
+
+    return g_strcmp0 (lowercase, "i") == 0;
+}
+
+/**
+ * nautilus_query_matcher_new:
+ * @text: (nullable): the text of a query
+ *
+ * Returns: (transfer full): a matcher for @text.
+ */
+NautilusQueryMatcher *
+nautilus_query_matcher_new (const char *text)
+{
+    NautilusQueryMatcher *matcher;
+    g_autofree gchar *prepared_text = NULL;
+    g_auto (GStrv) words = NULL;
+    guint i;
+
+    matcher = g_atomic_rc_box_new0 (NautilusQueryMatcher);
+    matcher->ascii_fast_path = ascii_lowercase_is_utf8_lowercase ();
+
+    if (text == NULL)
+    {
+        return matcher;
+    }
+
+    prepared_text = prepare_string_for_compare (text);
+    words = g_strsplit (prepared_text, " ", -1);
+    matcher->text = g_steal_pointer (&prepared_text);
+
+    matcher->n_words = g_strv_length (words);
+    matcher->words = g_new0 (MatcherWord, MAX (matcher->n_words, 1));
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        matcher->words[i].text = g_steal_pointer (&words[i]);
+        matcher->words[i].length = strlen (matcher->words[i].text);
+    }
+
+    return matcher;
+}
+
+NautilusQueryMatcher *
+nautilus_query_matcher_ref (NautilusQueryMatcher *matcher)
+{
+    g_return_val_if_fail (matcher != NULL, NULL);
+
+    return g_atomic_rc_box_acquire (matcher);
+}
+
+static void
+nautilus_query_matcher_clear (NautilusQueryMatcher *matcher)
+{
+    guint i;
+
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        g_free (matcher->words[i].text);
+    }
+    g_free (matcher->words);
+    g_free (matcher->text);
+}
+
+void
+nautilus_query_matcher_unref (NautilusQueryMatcher *matcher)
+{
+    g_return_if_fail (matcher != NULL);
+
+    g_atomic_rc_box_release_full (matcher, (GDestroyNotify) nautilus_query_matcher_clear);
+}
+
+/* Copies @string to @buffer with its letters lowercased, if it is all ASCII,
+ * for which normalizing changes nothing, and if it fits.
+ */
+static gboolean
+fold_ascii (const char *string,
+            char       *buffer,
+            gsize      *length)
+{
+    gsize i;
+    guchar c;
+
+    for (i = 0; i < MAX_FAST_NAME_LENGTH; i++)
+    {
+        c = string[i];
+        if (c == '\0')
+        {
+            *length = i;
+            return TRUE;
+        }
+        if (c >= 0x80)
+        {
+            return FALSE;
+        }
+
+        buffer[i] = g_ascii_tolower (c);
+    }
+
+    return FALSE;
+}
+
+/* Like strstr(), for strings of known lengths. memchr() is vectorized in
+ * the C libraries we care about, so candidates for the first byte of the
+ * word are found several bytes at a time.
+ */
+static const char *
+find_word (const char        *string,
+           gsize              length,
+           const MatcherWord *word)
+{
+    const char *p;
+    const char *last;
+
+    if (word->length == 0)
+    {
+        return string;
+    }
+    if (word->length > length)
+    {
+        return NULL;
+    }
+
+    last = string + length - word->length;
+    for (p = string; p <= last; p++)
+    {
+        p = memchr (p, word->text[0], last - p + 1);
+        if (p == NULL)
+        {
+            return NULL;
+        }
+        if (memcmp (p + 1, word->text + 1, word->length - 1) == 0)
+        {
+            return p;
+        }
+    }
+
+    return NULL;
+}
+
+static gdouble
+rank_prepared_string (NautilusQueryMatcher *matcher,
+                      const char           *string,
+                      gsize                 length)
+{
+    const char *ptr = string;
+    gsize nonexact_malus = 0;
+    guint i;
+
+    for (i = 0; i < matcher->n_words; i++)
+    {
+        ptr = find_word (string, length, &matcher->words[i]);
+        if (ptr == NULL)
+        {
+            return -1;
+        }
+
+        nonexact_malus += (string + length - ptr) - matcher->words[i].length;
+    }
+
+    /* The rank value depends on the numbers of letters before and after the match.
+     * To make the prefix matches prefered over sufix ones, the number of letters
+     * after the match is divided by a factor, so that it decreases the rank by a
+     * smaller amount.
+     */
+    return MAX (MIN_RANK, MAX_RANK - (gdouble) (ptr - string) - (gdouble) nonexact_malus / RANK_SCALE_FACTOR);
+}
+
+/**
+ * nautilus_query_matcher_match:
+ * @matcher: a #NautilusQueryMatcher
+ * @string: a file name
+ *
+ * Can be called from any thread.
+ *
+ * Returns: the rank of @string, the higher the better, or -1 if it does
+ * not contain every word of the query, ignoring case and accents.
+ */
+gdouble
+nautilus_query_matcher_match (NautilusQueryMatcher *matcher,
+                              const char           *string)
+{
+    char buffer[MAX_FAST_NAME_LENGTH];
+    g_autofree gchar *prepared_string = NULL;
+    gsize length;
+
+    if (matcher->words == NULL)
+    {
+        return -1;
+    }
+
+    if (matcher->ascii_fast_path && fold_ascii (string, buffer, &length))
+    {
+        return rank_prepared_string (matcher, buffer, length);
+    }
+
+    prepared_string = prepare_string_for_compare (string);
+
+    return rank_prepared_string (matcher, prepared_string, strlen (prepared_string));
+}
+
+/**
+ * nautilus_query_matcher_get_n_words:
+ * @matcher: a #NautilusQueryMatcher
+ *
+ * Returns: the number of words a string has to contain to match.
+ */
+guint
+nautilus_query_matcher_get_n_words (NautilusQueryMatcher *matcher)
+{
+    return matcher->n_words;
+}
+
+/**
+ * nautilus_query_matcher_get_word:
+ * @matcher: a #NautilusQueryMatcher
+ * @index: the index of a word
+ *
+ * Returns: the word at @index, prepared as by
+ * nautilus_query_matcher_prepare_string().
+ */
+const char *
+nautilus_query_matcher_get_word (NautilusQueryMatcher *matcher,
+                                 guint                 index)
+{
+    g_return_val_if_fail (index < matcher->n_words, NULL);
+
+    return matcher->words[index].text;
+}
+
+/**
+ * nautilus_query_matcher_prepare_string:
+ * @string: a file name
+ *
+ * Returns: (transfer full): @string normalized and lowercased, the way
+ * matchers compare it with the words of their query.
+ */
+gchar *
+nautilus_query_matcher_prepare_string (const char *string)
+{
+    return prepare_string_for_compare (string);
+}
+
+/**
+ * nautilus_query_matcher_is_narrowing:
+ * @matcher: a #NautilusQueryMatcher
+ * @previous: another #NautilusQueryMatcher
+ *
+ * Returns: %TRUE if the text of @matcher contains the one of @previous,
+ * ignoring case and accents, in which case any name it matches is matched
+ * by @previous too. Search engines that look for the whole text in names,
+ * rather than for each word, find fewer names for it too.
+ */
+gboolean
+nautilus_query_matcher_is_narrowing (NautilusQueryMatcher *matcher,
+                                     NautilusQueryMatcher *previous)
+{
+    if (matcher->text == NULL || previous->text == NULL)
+    {
+        return FALSE;
+    }
+
+    return strstr (matcher->text, previous->text) != NULL;
+}
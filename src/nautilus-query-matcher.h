@@ -0,0 +1,48 @@
+/* nautilus-query-matcher.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+G_BEGIN_DECLS
+
+/* The text of a query, compiled to rank file names against it. It is
+ * immutable, so search threads can share it without locking, and matching
+ * ASCII names, the most common ones, allocates nothing.
+ */
+typedef struct _NautilusQueryMatcher NautilusQueryMatcher;
+
+NautilusQueryMatcher *nautilus_query_matcher_new          (const char           *text);
+NautilusQueryMatcher *nautilus_query_matcher_ref          (NautilusQueryMatcher *matcher);
+void                  nautilus_query_matcher_unref        (NautilusQueryMatcher *matcher);
+
+gdouble               nautilus_query_matcher_match        (NautilusQueryMatcher *matcher,
+                                                           const char           *string);
+gboolean              nautilus_query_matcher_is_narrowing (NautilusQueryMatcher *matcher,
+                                                           NautilusQueryMatcher *previous);
+
+guint                 nautilus_query_matcher_get_n_words  (NautilusQueryMatcher *matcher);
+const char           *nautilus_query_matcher_get_word     (NautilusQueryMatcher *matcher,
+                                                           guint                 index);
+
+gchar                *nautilus_query_matcher_prepare_string (const char *string);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (NautilusQueryMatcher, nautilus_query_matcher_unref)
+
+G_END_DECLS
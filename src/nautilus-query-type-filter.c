@@ -0,0 +1,226 @@
+/* nautilus-query-type-filter.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-query-type-filter.h"
+
+struct _NautilusQueryTypeFilter
+{
+    GStrv mime_types;
+
+    /* Content types to whether they are one of @mime_types */
+    GMutex mutex;
+    GHashTable *types;
+};
+
+/**
+ * nautilus_query_type_filter_new:
+ * @mime_types: (element-type utf8): the MIME types to keep files of
+ *
+ * Returns: (transfer full): a filter for @mime_types.
+ */
+NautilusQueryTypeFilter *
+nautilus_query_type_filter_new (GPtrArray *mime_types)
+{
+    NautilusQueryTypeFilter *filter;
+    guint i;
+
+    filter = g_atomic_rc_box_new0 (NautilusQueryTypeFilter);
+    filter->mime_types = g_new0 (gchar *, mime_types->len + 1);
+    for (i = 0; i < mime_types->len; i++)
+    {
+        filter->mime_types[i] = g_strdup (g_ptr_array_index (mime_types, i));
+    }
+
+    g_mutex_init (&filter->mutex);
+    filter->types = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+
+    return filter;
+}
+
+NautilusQueryTypeFilter *
+nautilus_query_type_filter_ref (NautilusQueryTypeFilter *filter)
+{
+    g_return_val_if_fail (filter != NULL, NULL);
+
+    return g_atomic_rc_box_acquire (filter);
+}
+
+static void
+nautilus_query_type_filter_clear (NautilusQueryTypeFilter *filter)
+{
+    g_strfreev (filter->mime_types);
+    g_mutex_clear (&filter->mutex);
+    g_hash_table_destroy (filter->types);
+}
+
+void
+nautilus_query_type_filter_unref (NautilusQueryTypeFilter *filter)
+{
+    g_return_if_fail (filter != NULL);
+
+    g_atomic_rc_box_release_full (filter, (GDestroyNotify) nautilus_query_type_filter_clear);
+}
+
+/**
+ * nautilus_query_type_filter_is_empty:
+ * @filter: a #NautilusQueryTypeFilter
+ *
+ * Returns: %TRUE if @filter has no MIME types, and keeps every file.
+ */
+gboolean
+nautilus_query_type_filter_is_empty (NautilusQueryTypeFilter *filter)
+{
+    return filter->mime_types[0] == NULL;
+}
+
+/**
+ * nautilus_query_type_filter_match_type:
+ * @filter: a #NautilusQueryTypeFilter
+ * @content_type: a content type
+ *
+ * Returns: %TRUE if @content_type is one of the MIME types of @filter, or
+ * a subclass of one.
+ */
+gboolean
+nautilus_query_type_filter_match_type (NautilusQueryTypeFilter *filter,
+                                       const char              *content_type)
+{
+    gpointer match;
+    guint i;
+
+    if (nautilus_query_type_filter_is_empty (filter))
+    {
+        return TRUE;
+    }
+
+    g_mutex_lock (&filter->mutex);
+    if (!g_hash_table_lookup_extended (filter->types, content_type, NULL, &match))
+    {
+        match = GINT_TO_POINTER (FALSE);
+        for (i = 0; filter->mime_types[i] != NULL; i++)
+        {
+            if (g_content_type_is_a (content_type, filter->mime_types[i]))
+            {
+                match = GINT_TO_POINTER (TRUE);
+                break;
+            }
+        }
+
+        g_hash_table_insert (filter->types, g_strdup (content_type), match);
+    }
+    g_mutex_unlock (&filter->mutex);
+
+    return GPOINTER_TO_INT (match);
+}
+
+/**
+ * nautilus_query_type_filter_match_name:
+ * @filter: a #NautilusQueryTypeFilter
+ * @name: the name of a file, in the file system encoding
+ * @file_type: the type of the file
+ *
+ * Guesses the content type of a file from its name, like GIO does before
+ * sniffing the contents.
+ *
+ * Returns: whether the file is of one of the MIME types of @filter, or
+ * %NAUTILUS_QUERY_TYPE_FILTER_UNSURE if only its contents can tell.
+ */
+NautilusQueryTypeFilterResult
+nautilus_query_type_filter_match_name (NautilusQueryTypeFilter *filter,
+                                       const char              *name,
+                                       GFileType                file_type)
+{
+    g_autofree gchar *content_type = NULL;
+    gboolean uncertain;
+
+    if (nautilus_query_type_filter_is_empty (filter))
+    {
+        return NAUTILUS_QUERY_TYPE_FILTER_MATCH;
+    }
+
+    switch (file_type)
+    {
+        case G_FILE_TYPE_DIRECTORY:
+        {
+            content_type = g_strdup ("inode/directory");
+        }
+        break;
+
+        case G_FILE_TYPE_SYMBOLIC_LINK:
+        {
+            content_type = g_strdup ("inode/symlink");
+        }
+        break;
+
+        case G_FILE_TYPE_REGULAR:
+        {
+            content_type = g_content_type_guess (name, NULL, 0, &uncertain);
+            if (uncertain)
+            {
+                return NAUTILUS_QUERY_TYPE_FILTER_UNSURE;
+            }
+        }
+        break;
+
+        default:
+            return NAUTILUS_QUERY_TYPE_FILTER_UNSURE;
+    }
+
+    return nautilus_query_type_filter_match_type (filter, content_type) ?
+           NAUTILUS_QUERY_TYPE_FILTER_MATCH : NAUTILUS_QUERY_TYPE_FILTER_NO_MATCH;
+}
+
+/**
+ * nautilus_query_type_filter_match_file:
+ * @filter: a #NautilusQueryTypeFilter
+ * @file: a file
+ * @info: info about @file, with its name and type
+ * @cancellable: (nullable): a #GCancellable
+ *
+ * Tells from the name of @file whether it is of one of the MIME types of
+ * @filter, and only reads it if needed. This blocks, so it should be
+ * called from a thread.
+ *
+ * Returns: %TRUE if @file is of one of the MIME types of @filter.
+ */
+gboolean
+nautilus_query_type_filter_match_file (NautilusQueryTypeFilter *filter,
+                                       GFile                   *file,
+                                       GFileInfo               *info,
+                                       GCancellable            *cancellable)
+{
+    g_autoptr (GFileInfo) type_info = NULL;
+    NautilusQueryTypeFilterResult result;
+    const char *content_type;
+
+    result = nautilus_query_type_filter_match_name (filter,
+                                                    g_file_info_get_name (info),
+                                                    g_file_info_get_file_type (info));
+    if (result != NAUTILUS_QUERY_TYPE_FILTER_UNSURE)
+    {
+        return result == NAUTILUS_QUERY_TYPE_FILTER_MATCH;
+    }
+
+    type_info = g_file_query_info (file, G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE,
+                                   G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                   cancellable, NULL);
+    content_type = type_info != NULL ? g_file_info_get_content_type (type_info) : NULL;
+
+    return content_type != NULL && nautilus_query_type_filter_match_type (filter, content_type);
+}
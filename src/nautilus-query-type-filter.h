@@ -0,0 +1,59 @@
+/* nautilus-query-type-filter.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* The MIME types of a query, compiled to filter files by type without
+ * reading them. Types are guessed from file names first, and the contents
+ * of a file are only sniffed when its name says too little about it.
+ * Whether a type is one of the filtered ones is remembered, so that each
+ * type is only compared with them once. It can be shared by search threads.
+ */
+typedef struct _NautilusQueryTypeFilter NautilusQueryTypeFilter;
+
+typedef enum
+{
+    NAUTILUS_QUERY_TYPE_FILTER_NO_MATCH,
+    NAUTILUS_QUERY_TYPE_FILTER_MATCH,
+    /* The type can't be told from the name, only from the contents */
+    NAUTILUS_QUERY_TYPE_FILTER_UNSURE,
+} NautilusQueryTypeFilterResult;
+
+NautilusQueryTypeFilter       *nautilus_query_type_filter_new        (GPtrArray               *mime_types);
+NautilusQueryTypeFilter       *nautilus_query_type_filter_ref        (NautilusQueryTypeFilter *filter);
+void                           nautilus_query_type_filter_unref      (NautilusQueryTypeFilter *filter);
+
+gboolean                       nautilus_query_type_filter_is_empty   (NautilusQueryTypeFilter *filter);
+
+gboolean                       nautilus_query_type_filter_match_type (NautilusQueryTypeFilter *filter,
+                                                                      const char              *content_type);
+NautilusQueryTypeFilterResult  nautilus_query_type_filter_match_name (NautilusQueryTypeFilter *filter,
+                                                                      const char              *name,
+                                                                      GFileType                file_type);
+gboolean                       nautilus_query_type_filter_match_file (NautilusQueryTypeFilter *filter,
+                                                                      GFile                   *file,
+                                                                      GFileInfo               *info,
+                                                                      GCancellable            *cancellable);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (NautilusQueryTypeFilter, nautilus_query_type_filter_unref)
+
+G_END_DECLS
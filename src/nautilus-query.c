@@ -28,10 +28,6 @@
 #include "nautilus-file-utilities.h"
 #include "nautilus-global-preferences.h"
 
-#define RANK_SCALE_FACTOR 100
-#define MIN_RANK 10.0
-#define MAX_RANK 50.0
-
 struct _NautilusQuery
 {
     GObject parent;
@@ -46,8 +42,8 @@ struct _NautilusQuery
     NautilusQuerySearchContent search_content;
 
     gboolean searching;
-    char **prepared_words;
-    GMutex prepared_words_mutex;
+    NautilusQueryMatcher *matcher;
+    GMutex matcher_mutex;
 };
 
 static void  nautilus_query_class_init (NautilusQueryClass *class);
@@ -77,10 +73,10 @@ finalize (GObject *object)
     query = NAUTILUS_QUERY (object);
 
     g_free (query->text);
-    g_strfreev (query->prepared_words);
+    g_clear_pointer (&query->matcher, nautilus_query_matcher_unref);
     g_clear_object (&query->location);
     g_clear_pointer (&query->date_range, g_ptr_array_unref);
-    g_mutex_clear (&query->prepared_words_mutex);
+    g_mutex_clear (&query->matcher_mutex);
 
     G_OBJECT_CLASS (nautilus_query_parent_class)->finalize (object);
 }
@@ -342,75 +338,50 @@ nautilus_query_init (NautilusQuery *query)
     query->show_hidden = TRUE;
     query->search_type = g_settings_get_enum (nautilus_preferences, "search-filter-time-type");
     query->search_content = NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE;
-    g_mutex_init (&query->prepared_words_mutex);
+    g_mutex_init (&query->matcher_mutex);
 }
 
-static gchar *
-prepare_string_for_compare (const gchar *string)
+/**
+ * nautilus_query_get_matcher:
+ * @query: a #NautilusQuery
+ *
+ * Searches that match many names should get the matcher once, and use it
+ * without going through the query again.
+ *
+ * Returns: (transfer full): the matcher for the current text of @query.
+ */
+NautilusQueryMatcher *
+nautilus_query_get_matcher (NautilusQuery *query)
 {
-    gchar *normalized, *res;
+    NautilusQueryMatcher *matcher;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), NULL);
 
-    normalized = g_utf8_normalize (string, -1, G_NORMALIZE_NFD);
-    res = g_utf8_strdown (normalized, -1);
-    g_free (normalized);
+    g_mutex_lock (&query->matcher_mutex);
+    if (query->matcher == NULL)
+    {
+        query->matcher = nautilus_query_matcher_new (query->text);
+    }
+    matcher = nautilus_query_matcher_ref (query->matcher);
+    g_mutex_unlock (&query->matcher_mutex);
 
-    return res;
+    return matcher;
 }
 
 gdouble
 nautilus_query_matches_string (NautilusQuery *query,
                                const gchar   *string)
 {
-    gchar *prepared_string, *ptr;
-    gboolean found;
-    gdouble retval;
-    gint idx, nonexact_malus;
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
 
     if (!query->text)
     {
         return -1;
     }
 
-    g_mutex_lock (&query->prepared_words_mutex);
-    if (!query->prepared_words)
-    {
-        prepared_string = prepare_string_for_compare (query->text);
-        query->prepared_words = g_strsplit (prepared_string, " ", -1);
-        g_free (prepared_string);
-    }
-
-    prepared_string = prepare_string_for_compare (string);
-    found = TRUE;
-    ptr = NULL;
-    nonexact_malus = 0;
-
-    for (idx = 0; query->prepared_words[idx] != NULL; idx++)
-    {
-        if ((ptr = strstr (prepared_string, query->prepared_words[idx])) == NULL)
-        {
-            found = FALSE;
-            break;
-        }
-
-        nonexact_malus += strlen (ptr) - strlen (query->prepared_words[idx]);
-    }
-    g_mutex_unlock (&query->prepared_words_mutex);
-
-    if (!found)
-    {
-        g_free (prepared_string);
-        return -1;
-    }
-
-    /* The rank value depends on the numbers of letters before and after the match.
-     * To make the prefix matches prefered over sufix ones, the number of letters
-     * after the match is divided by a factor, so that it decreases the rank by a
-     * smaller amount.
-     */
-    retval = MAX (MIN_RANK, MAX_RANK - (gdouble) (ptr - prepared_string) - (gdouble) nonexact_malus / RANK_SCALE_FACTOR);
-    g_free (prepared_string);
+    matcher = nautilus_query_get_matcher (query);
 
-    return retval;
+    return nautilus_query_matcher_match (matcher, string);
 }
 
 NautilusQuery *
@@ -437,10 +408,9 @@ nautilus_query_set_text (NautilusQuery *query,
     g_free (query->text);
     query->text = g_strstrip (g_strdup (text));
 
-    g_mutex_lock (&query->prepared_words_mutex);
-    g_strfreev (query->prepared_words);
-    query->prepared_words = NULL;
-    g_mutex_unlock (&query->prepared_words_mutex);
+    g_mutex_lock (&query->matcher_mutex);
+    g_clear_pointer (&query->matcher, nautilus_query_matcher_unref);
+    g_mutex_unlock (&query->matcher_mutex);
 
     g_object_notify (G_OBJECT (query), "text");
 }
@@ -686,3 +656,123 @@ nautilus_query_is_empty (NautilusQuery *query)
 
     return FALSE;
 }
+
+/**
+ * nautilus_query_copy:
+ * @query: a #NautilusQuery
+ *
+ * Returns: (transfer full): a new query with the same text, location and
+ * filters as @query, to remember what was searched for while @query is
+ * edited.
+ */
+NautilusQuery *
+nautilus_query_copy (NautilusQuery *query)
+{
+    NautilusQuery *copy;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), NULL);
+
+    copy = nautilus_query_new ();
+    copy->text = g_strdup (query->text);
+    g_set_object (&copy->location, query->location);
+    g_clear_pointer (&copy->mime_types, g_ptr_array_unref);
+    copy->mime_types = g_ptr_array_ref (query->mime_types);
+    copy->show_hidden = query->show_hidden;
+    if (query->date_range != NULL)
+    {
+        copy->date_range = g_ptr_array_ref (query->date_range);
+    }
+    copy->recursive = query->recursive;
+    copy->search_type = query->search_type;
+    copy->search_content = query->search_content;
+
+    return copy;
+}
+
+static gboolean
+mime_types_equal (GPtrArray *mime_types_a,
+                  GPtrArray *mime_types_b)
+{
+    if (mime_types_a == mime_types_b)
+    {
+        return TRUE;
+    }
+
+    if (mime_types_a->len != mime_types_b->len)
+    {
+        return FALSE;
+    }
+
+    for (guint i = 0; i < mime_types_a->len; i++)
+    {
+        if (g_strcmp0 (g_ptr_array_index (mime_types_a, i),
+                       g_ptr_array_index (mime_types_b, i)) != 0)
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+static gboolean
+date_ranges_equal (GPtrArray *date_range_a,
+                   GPtrArray *date_range_b)
+{
+    if (date_range_a == date_range_b)
+    {
+        return TRUE;
+    }
+
+    if (date_range_a == NULL || date_range_b == NULL)
+    {
+        return FALSE;
+    }
+
+    return g_date_time_equal (g_ptr_array_index (date_range_a, 0),
+                              g_ptr_array_index (date_range_b, 0)) &&
+           g_date_time_equal (g_ptr_array_index (date_range_a, 1),
+                              g_ptr_array_index (date_range_b, 1));
+}
+
+/**
+ * nautilus_query_is_narrowing:
+ * @query: a #NautilusQuery
+ * @previous: the query searched for before
+ *
+ * Tells whether the files found for @query can only be among the ones found
+ * for @previous, as when more letters are typed, so that they can be found
+ * by filtering those instead of searching again. That is the case if the
+ * text of @query contains the one of @previous and nothing else changed.
+ * Full text searches never narrow, as they don't match file names only.
+ *
+ * Returns: %TRUE if @query narrows @previous.
+ */
+gboolean
+nautilus_query_is_narrowing (NautilusQuery *query,
+                             NautilusQuery *previous)
+{
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    g_autoptr (NautilusQueryMatcher) previous_matcher = NULL;
+
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (query), FALSE);
+    g_return_val_if_fail (NAUTILUS_IS_QUERY (previous), FALSE);
+
+    if (query->text == NULL || previous->text == NULL ||
+        query->search_content != NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE ||
+        previous->search_content != NAUTILUS_QUERY_SEARCH_CONTENT_SIMPLE ||
+        query->recursive != previous->recursive ||
+        query->search_type != previous->search_type ||
+        (query->show_hidden && !previous->show_hidden) ||
+        !g_file_equal (query->location, previous->location) ||
+        !mime_types_equal (query->mime_types, previous->mime_types) ||
+        !date_ranges_equal (query->date_range, previous->date_range))
+    {
+        return FALSE;
+    }
+
+    matcher = nautilus_query_get_matcher (query);
+    previous_matcher = nautilus_query_get_matcher (previous);
+
+    return nautilus_query_matcher_is_narrowing (matcher, previous_matcher);
+}
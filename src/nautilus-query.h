@@ -24,6 +24,8 @@
 #include <glib-object.h>
 #include <gio/gio.h>
 
+#include "nautilus-query-matcher.h"
+
 typedef enum {
         NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS,
         NAUTILUS_QUERY_SEARCH_TYPE_LAST_MODIFIED
@@ -81,8 +83,13 @@ gboolean       nautilus_query_get_searching      (NautilusQuery *query);
 void           nautilus_query_set_searching      (NautilusQuery *query,
                                                   gboolean       searching);
 
+NautilusQueryMatcher *nautilus_query_get_matcher (NautilusQuery *query);
 gdouble        nautilus_query_matches_string     (NautilusQuery *query, const gchar *string);
 
 char *         nautilus_query_to_readable_string (NautilusQuery *query);
 
 gboolean       nautilus_query_is_empty           (NautilusQuery *query);
+
+NautilusQuery *nautilus_query_copy               (NautilusQuery *query);
+gboolean       nautilus_query_is_narrowing       (NautilusQuery *query,
+                                                  NautilusQuery *previous);
@@ -0,0 +1,598 @@
+/* nautilus-search-crawler.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-search-crawler.h"
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+#include "nautilus-global-preferences.h"
+#include "nautilus-search-engine-private.h"
+#include "nautilus-search-prune-rules.h"
+
+/* How long an idle worker waits for directories before checking whether
+ * the search was cancelled */
+#define IDLE_WAIT_USEC (100 * G_TIME_SPAN_MILLISECOND)
+
+typedef struct
+{
+    GFile *file;
+    /* The rules for the directories in it */
+    NautilusSearchPruneRules *rules;
+} SearchDirectory;
+
+typedef struct
+{
+    NautilusSearchCrawler *crawler;
+    guint index;
+
+    /* SearchDirectories to visit. The worker takes them from the
+     * tail, going depth first, and idle workers steal them from the head,
+     * where the directories closest to the search root, with the biggest
+     * trees below them, are.
+     */
+    GMutex mutex;
+    GQueue directories;
+
+    /* File system IDs to whether they are remote */
+    GHashTable *remote_filesystems;
+} SearchWorker;
+
+struct _NautilusSearchCrawler
+{
+    GCancellable *cancellable;
+
+    GFile *location;
+    NautilusQueryRecursive recursive;
+    gboolean show_hidden;
+    NautilusSearchPruneRules *prune_rules;
+
+    /* GFiles of the folders other engines search, with their subfolders */
+    GHashTable *excluded;
+
+    SearchWorker *workers;
+    guint n_workers;
+
+    /* Directories queued or being visited, by any worker. The crawl is
+     * over when there are none left. Atomic.
+     */
+    gint n_pending_directories;
+    /* Workers that did not exit yet. Atomic. */
+    gint n_running_workers;
+
+    /* Idle workers wait on work_cond for directories to steal */
+    GMutex work_mutex;
+    GCond work_cond;
+    guint n_idle_workers;
+
+    /* File IDs of the directories queued so far, not to visit the same
+     * one twice through links or bind mounts */
+    GMutex visited_mutex;
+    GHashTable *visited;
+
+    NautilusSearchCrawlerFileFunc file_func;
+    NautilusSearchCrawlerIdleFunc idle_func;
+    NautilusSearchCrawlerDoneFunc done_func;
+    gpointer user_data;
+};
+
+static SearchDirectory *
+search_directory_new (GFile                    *file,
+                      NautilusSearchPruneRules *rules)
+{
+    SearchDirectory *dir;
+
+    dir = g_new0 (SearchDirectory, 1);
+    dir->file = g_object_ref (file);
+    dir->rules = nautilus_search_prune_rules_ref (rules);
+
+    return dir;
+}
+
+static void
+search_directory_free (SearchDirectory *dir)
+{
+    g_object_unref (dir->file);
+    nautilus_search_prune_rules_unref (dir->rules);
+    g_free (dir);
+}
+
+/**
+ * nautilus_search_crawler_new:
+ * @query: the query to search the location of
+ * @max_workers: the most threads to crawl with
+ * @cancellable: the #GCancellable of the search
+ *
+ * Returns: a crawler of the location of @query, which must have one.
+ */
+NautilusSearchCrawler *
+nautilus_search_crawler_new (NautilusQuery *query,
+                             guint          max_workers,
+                             GCancellable  *cancellable)
+{
+    g_auto (GStrv) prune_patterns = NULL;
+    NautilusSearchCrawler *crawler;
+    guint i;
+
+    crawler = g_new0 (NautilusSearchCrawler, 1);
+    crawler->cancellable = g_object_ref (cancellable);
+
+    crawler->location = nautilus_query_get_location (query);
+    crawler->recursive = nautilus_query_get_recursive (query);
+    crawler->show_hidden = nautilus_query_get_show_hidden_files (query);
+    prune_patterns = g_settings_get_strv (nautilus_preferences,
+                                          NAUTILUS_PREFERENCES_SEARCH_PRUNE_PATTERNS);
+    crawler->prune_rules = nautilus_search_prune_rules_new ((const char * const *) prune_patterns);
+
+    crawler->n_workers = CLAMP (g_get_num_processors (), 1, MAX (max_workers, 1));
+    crawler->workers = g_new0 (SearchWorker, crawler->n_workers);
+    for (i = 0; i < crawler->n_workers; i++)
+    {
+        crawler->workers[i].crawler = crawler;
+        crawler->workers[i].index = i;
+        g_mutex_init (&crawler->workers[i].mutex);
+        g_queue_init (&crawler->workers[i].directories);
+        crawler->workers[i].remote_filesystems = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                                                        g_free, NULL);
+    }
+    g_mutex_init (&crawler->work_mutex);
+    g_cond_init (&crawler->work_cond);
+
+    crawler->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    g_mutex_init (&crawler->visited_mutex);
+
+    /* The search location, which the first worker visits */
+    crawler->n_pending_directories = 1;
+    crawler->n_running_workers = crawler->n_workers;
+
+    return crawler;
+}
+
+void
+nautilus_search_crawler_free (NautilusSearchCrawler *crawler)
+{
+    guint i;
+
+    for (i = 0; i < crawler->n_workers; i++)
+    {
+        g_queue_clear_full (&crawler->workers[i].directories, (GDestroyNotify) search_directory_free);
+        g_mutex_clear (&crawler->workers[i].mutex);
+        g_hash_table_destroy (crawler->workers[i].remote_filesystems);
+    }
+    g_free (crawler->workers);
+    g_mutex_clear (&crawler->work_mutex);
+    g_cond_clear (&crawler->work_cond);
+
+    g_hash_table_destroy (crawler->visited);
+    g_mutex_clear (&crawler->visited_mutex);
+
+    g_clear_pointer (&crawler->excluded, g_hash_table_destroy);
+    nautilus_search_prune_rules_unref (crawler->prune_rules);
+    g_clear_object (&crawler->location);
+    g_object_unref (crawler->cancellable);
+
+    g_free (crawler);
+}
+
+/**
+ * nautilus_search_crawler_set_excluded_locations:
+ * @crawler: a #NautilusSearchCrawler
+ * @locations: (element-type GFile): folders not to crawl, with their
+ *   subfolders
+ *
+ * Leaves out the folders other engines search fully. It must be called
+ * before the crawl starts.
+ */
+void
+nautilus_search_crawler_set_excluded_locations (NautilusSearchCrawler *crawler,
+                                                GList                 *locations)
+{
+    GList *l;
+
+    g_clear_pointer (&crawler->excluded, g_hash_table_destroy);
+    if (locations == NULL)
+    {
+        return;
+    }
+
+    crawler->excluded = g_hash_table_new_full (g_file_hash, (GEqualFunc) g_file_equal,
+                                               g_object_unref, NULL);
+    for (l = locations; l != NULL; l = l->next)
+    {
+        g_hash_table_add (crawler->excluded, g_object_ref (l->data));
+    }
+}
+
+/* Returns: the number of workers, which are numbered from 0 on. */
+guint
+nautilus_search_crawler_get_n_workers (NautilusSearchCrawler *crawler)
+{
+    return crawler->n_workers;
+}
+
+/* Returns %TRUE if the directory with file ID @id was not visited yet, and
+ * marks it as visited.
+ */
+static gboolean
+mark_visited (NautilusSearchCrawler *crawler,
+              const char            *id)
+{
+    gboolean visited;
+
+    g_mutex_lock (&crawler->visited_mutex);
+    visited = g_hash_table_contains (crawler->visited, id);
+    if (!visited)
+    {
+        g_hash_table_add (crawler->visited, g_strdup (id));
+    }
+    g_mutex_unlock (&crawler->visited_mutex);
+
+    return !visited;
+}
+
+static void
+push_directory (SearchWorker             *worker,
+                GFile                    *dir,
+                NautilusSearchPruneRules *rules)
+{
+    NautilusSearchCrawler *crawler = worker->crawler;
+
+    g_atomic_int_inc (&crawler->n_pending_directories);
+
+    g_mutex_lock (&worker->mutex);
+    g_queue_push_tail (&worker->directories, search_directory_new (dir, rules));
+    g_mutex_unlock (&worker->mutex);
+
+    g_mutex_lock (&crawler->work_mutex);
+    if (crawler->n_idle_workers > 0)
+    {
+        g_cond_signal (&crawler->work_cond);
+    }
+    g_mutex_unlock (&crawler->work_mutex);
+}
+
+static void
+directory_done (NautilusSearchCrawler *crawler)
+{
+    if (g_atomic_int_dec_and_test (&crawler->n_pending_directories))
+    {
+        /* Let the idle workers know that there is nothing left */
+        g_mutex_lock (&crawler->work_mutex);
+        g_cond_broadcast (&crawler->work_cond);
+        g_mutex_unlock (&crawler->work_mutex);
+    }
+}
+
+/* Takes the oldest directory queued by another worker, if any. */
+static SearchDirectory *
+steal_directory (SearchWorker *worker)
+{
+    NautilusSearchCrawler *crawler = worker->crawler;
+    SearchWorker *victim;
+    SearchDirectory *dir = NULL;
+    guint i;
+
+    for (i = 1; i < crawler->n_workers && dir == NULL; i++)
+    {
+        victim = &crawler->workers[(worker->index + i) % crawler->n_workers];
+
+        g_mutex_lock (&victim->mutex);
+        dir = g_queue_pop_head (&victim->directories);
+        g_mutex_unlock (&victim->mutex);
+    }
+
+    return dir;
+}
+
+/* Returns the next directory for @worker to visit, waiting for the other
+ * workers to queue some if needed, or %NULL when the crawl is over.
+ */
+static SearchDirectory *
+get_next_directory (SearchWorker *worker)
+{
+    NautilusSearchCrawler *crawler = worker->crawler;
+    SearchDirectory *dir;
+
+    while (!g_cancellable_is_cancelled (crawler->cancellable))
+    {
+        g_mutex_lock (&worker->mutex);
+        dir = g_queue_pop_tail (&worker->directories);
+        g_mutex_unlock (&worker->mutex);
+
+        if (dir != NULL)
+        {
+            return dir;
+        }
+
+        /* This worker may wait for a while, so the engine hands over what
+         * it found so far, instead of holding it until the crawl ends */
+        if (crawler->idle_func != NULL)
+        {
+            crawler->idle_func (worker->index, crawler->user_data);
+        }
+
+        /* Directories are only queued by workers that are visiting one,
+         * so if none is pending, none will be queued anymore.
+         */
+        g_mutex_lock (&crawler->work_mutex);
+        dir = steal_directory (worker);
+        if (dir == NULL && g_atomic_int_get (&crawler->n_pending_directories) > 0)
+        {
+            crawler->n_idle_workers++;
+            g_cond_wait_until (&crawler->work_cond, &crawler->work_mutex,
+                               g_get_monotonic_time () + IDLE_WAIT_USEC);
+            crawler->n_idle_workers--;
+        }
+        g_mutex_unlock (&crawler->work_mutex);
+
+        if (dir != NULL)
+        {
+            return dir;
+        }
+
+        if (g_atomic_int_get (&crawler->n_pending_directories) == 0)
+        {
+            return NULL;
+        }
+    }
+
+    return NULL;
+}
+
+/* Queues the subdirectories of @dir that aren't pruned, once the ignore
+ * files that @dir may have are known */
+static void
+push_subdirectories (SearchWorker    *worker,
+                     SearchDirectory *dir,
+                     GPtrArray       *subdirectories,
+                     gboolean         has_ignore_files)
+{
+    g_autoptr (NautilusSearchPruneRules) rules = NULL;
+    GFile *child;
+    guint i;
+
+    if (has_ignore_files)
+    {
+        rules = nautilus_search_prune_rules_new_for_directory (dir->rules, dir->file,
+                                                               worker->crawler->cancellable);
+    }
+    else
+    {
+        rules = nautilus_search_prune_rules_ref (dir->rules);
+    }
+
+    for (i = 0; i < subdirectories->len; i++)
+    {
+        g_autofree gchar *name = NULL;
+
+        child = g_ptr_array_index (subdirectories, i);
+        name = g_file_get_basename (child);
+        if (!nautilus_search_prune_rules_match (rules, child, name))
+        {
+            push_directory (worker, child, rules);
+        }
+    }
+}
+
+static gboolean
+should_visit (SearchWorker *worker,
+              GFile        *child,
+              GFileInfo    *info)
+{
+    NautilusSearchCrawler *crawler = worker->crawler;
+    const char *id;
+
+    if (crawler->recursive == NAUTILUS_QUERY_RECURSIVE_NEVER ||
+        g_file_info_get_file_type (info) != G_FILE_TYPE_DIRECTORY ||
+        !is_recursive_search_cached (NAUTILUS_SEARCH_ENGINE_TYPE_NON_INDEXED,
+                                     crawler->recursive, child,
+                                     g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILESYSTEM),
+                                     worker->remote_filesystems))
+    {
+        return FALSE;
+    }
+
+    if (crawler->excluded != NULL && g_hash_table_contains (crawler->excluded, child))
+    {
+        return FALSE;
+    }
+
+    id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
+
+    return id == NULL || mark_visited (crawler, id);
+}
+
+static void
+visit_directory (SearchDirectory *dir,
+                 SearchWorker    *worker)
+{
+    NautilusSearchCrawler *crawler = worker->crawler;
+    g_autoptr (GFileEnumerator) enumerator = NULL;
+    g_autoptr (GPtrArray) subdirectories = NULL;
+    gboolean has_ignore_files = FALSE;
+    GFileInfo *info;
+    GFile *child;
+
+    /* The content type isn't asked for, as it may mean reading every file,
+     * and the type filters only read the ones they need to */
+    enumerator = g_file_enumerate_children (dir->file,
+                                            NAUTILUS_SEARCH_CRAWLER_ATTRIBUTES,
+                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                            crawler->cancellable, NULL);
+    if (enumerator == NULL)
+    {
+        return;
+    }
+
+    subdirectories = g_ptr_array_new_with_free_func (g_object_unref);
+
+    while (g_file_enumerator_iterate (enumerator, &info, NULL, crawler->cancellable, NULL) &&
+           info != NULL)
+    {
+        if (nautilus_search_prune_rules_is_ignore_file (g_file_info_get_name (info)))
+        {
+            has_ignore_files = TRUE;
+        }
+
+        if (g_file_info_get_display_name (info) == NULL ||
+            (!crawler->show_hidden &&
+             (g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info))))
+        {
+            continue;
+        }
+
+        child = g_file_get_child (dir->file, g_file_info_get_name (info));
+
+        crawler->file_func (child, info, worker->index, crawler->user_data);
+
+        if (should_visit (worker, child, info))
+        {
+            g_ptr_array_add (subdirectories, g_object_ref (child));
+        }
+
+        g_object_unref (child);
+    }
+
+    if (!g_cancellable_is_cancelled (crawler->cancellable))
+    {
+        push_subdirectories (worker, dir, subdirectories, has_ignore_files);
+    }
+}
+
+static gboolean
+is_excluded_location (NautilusSearchCrawler *crawler)
+{
+    GHashTableIter iter;
+    GFile *excluded;
+
+    if (crawler->excluded == NULL)
+    {
+        return FALSE;
+    }
+
+    g_hash_table_iter_init (&iter, crawler->excluded);
+    while (g_hash_table_iter_next (&iter, (gpointer *) &excluded, NULL))
+    {
+        if (g_file_equal (crawler->location, excluded) ||
+            g_file_has_prefix (crawler->location, excluded))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static void
+visit_location (SearchWorker *worker)
+{
+    NautilusSearchCrawler *crawler = worker->crawler;
+    g_autoptr (GFileInfo) info = NULL;
+    SearchDirectory *location;
+    const char *id;
+
+    /* Insert id for toplevel directory into visited */
+    info = g_file_query_info (crawler->location, G_FILE_ATTRIBUTE_ID_FILE, 0,
+                              crawler->cancellable, NULL);
+    id = info != NULL ? g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE) : NULL;
+    if (id != NULL)
+    {
+        mark_visited (crawler, id);
+    }
+
+    if (is_excluded_location (crawler))
+    {
+        DEBUG ("Search crawler skipping a location other engines search");
+    }
+    else if (!g_cancellable_is_cancelled (crawler->cancellable))
+    {
+        location = search_directory_new (crawler->location, crawler->prune_rules);
+        visit_directory (location, worker);
+        search_directory_free (location);
+    }
+    directory_done (crawler);
+}
+
+static gpointer
+crawler_thread_func (gpointer user_data)
+{
+    SearchWorker *worker = user_data;
+    NautilusSearchCrawler *crawler = worker->crawler;
+    SearchDirectory *dir;
+
+    if (worker->index == 0)
+    {
+        visit_location (worker);
+    }
+
+    while ((dir = get_next_directory (worker)) != NULL)
+    {
+        visit_directory (dir, worker);
+        search_directory_free (dir);
+        directory_done (crawler);
+    }
+
+    if (crawler->idle_func != NULL)
+    {
+        crawler->idle_func (worker->index, crawler->user_data);
+    }
+
+    if (g_atomic_int_dec_and_test (&crawler->n_running_workers))
+    {
+        crawler->done_func (crawler->user_data);
+    }
+
+    return NULL;
+}
+
+/**
+ * nautilus_search_crawler_start:
+ * @crawler: a #NautilusSearchCrawler
+ * @file_func: called with each file found
+ * @idle_func: (nullable): called when a worker runs out of folders to visit
+ * @done_func: called once the crawl is over
+ * @user_data: data for the functions
+ *
+ * Starts the worker threads. The crawl stops early once the cancellable
+ * of @crawler is cancelled, and @done_func is called anyway.
+ */
+void
+nautilus_search_crawler_start (NautilusSearchCrawler         *crawler,
+                               NautilusSearchCrawlerFileFunc  file_func,
+                               NautilusSearchCrawlerIdleFunc  idle_func,
+                               NautilusSearchCrawlerDoneFunc  done_func,
+                               gpointer                       user_data)
+{
+    GThread *thread;
+    guint i;
+
+    crawler->file_func = file_func;
+    crawler->idle_func = idle_func;
+    crawler->done_func = done_func;
+    crawler->user_data = user_data;
+
+    DEBUG ("Search crawler crawling with %u threads", crawler->n_workers);
+
+    for (i = 0; i < crawler->n_workers; i++)
+    {
+        thread = g_thread_new ("nautilus-search-crawler", crawler_thread_func,
+                               &crawler->workers[i]);
+        g_thread_unref (thread);
+    }
+}
@@ -0,0 +1,83 @@
+/* nautilus-search-crawler.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+#include "nautilus-query.h"
+
+G_BEGIN_DECLS
+
+/* Walks the folders a search looks into with a few worker threads, for
+ * the search engines that don't use an index.
+ *
+ * Each worker visits the folders it finds depth first, and workers without
+ * any left take the folders closest to the search location from the
+ * others. Hidden files are skipped unless the query shows them, the
+ * subfolders that the prune rules match aren't visited, and neither are
+ * the ones visited already, through links or bind mounts.
+ */
+typedef struct _NautilusSearchCrawler NautilusSearchCrawler;
+
+/* The attributes of the #GFileInfo the functions get */
+#define NAUTILUS_SEARCH_CRAWLER_ATTRIBUTES \
+    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
+    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
+    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
+    G_FILE_ATTRIBUTE_STANDARD_SIZE "," \
+    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
+    G_FILE_ATTRIBUTE_TIME_ACCESS "," \
+    G_FILE_ATTRIBUTE_ID_FILE "," \
+    G_FILE_ATTRIBUTE_ID_FILESYSTEM
+
+/* Called in the thread of @worker for each file in the visited folders,
+ * and has a display name */
+typedef void (*NautilusSearchCrawlerFileFunc) (GFile     *file,
+                                               GFileInfo *info,
+                                               guint      worker,
+                                               gpointer   user_data);
+
+/* Called in the thread of @worker when it has no folders left to visit,
+ * before it waits for more, or exits */
+typedef void (*NautilusSearchCrawlerIdleFunc) (guint    worker,
+                                               gpointer user_data);
+
+/* Called in the thread of the last worker to exit, once every folder is
+ * visited, or the crawl is cancelled. The crawler can be freed then. */
+typedef void (*NautilusSearchCrawlerDoneFunc) (gpointer user_data);
+
+NautilusSearchCrawler *nautilus_search_crawler_new                    (NautilusQuery                 *query,
+                                                                       guint                          max_workers,
+                                                                       GCancellable                  *cancellable);
+void                   nautilus_search_crawler_free                   (NautilusSearchCrawler         *crawler);
+
+void                   nautilus_search_crawler_set_excluded_locations (NautilusSearchCrawler         *crawler,
+                                                                       GList                         *locations);
+
+guint                  nautilus_search_crawler_get_n_workers          (NautilusSearchCrawler         *crawler);
+
+void                   nautilus_search_crawler_start                  (NautilusSearchCrawler         *crawler,
+                                                                       NautilusSearchCrawlerFileFunc  file_func,
+                                                                       NautilusSearchCrawlerIdleFunc  idle_func,
+                                                                       NautilusSearchCrawlerDoneFunc  done_func,
+                                                                       gpointer                       user_data);
+
+G_END_DECLS
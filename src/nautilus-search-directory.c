@@ -33,8 +33,13 @@
 #include "nautilus-search-directory-file.h"
 #include "nautilus-search-engine-model.h"
 #include "nautilus-search-engine.h"
+#include "nautilus-search-hit.h"
 #include "nautilus-search-provider.h"
 
+/* How long hits are added as files for at a time, so that a large number
+ * of them is added over a few frames, rather than blocking drawing */
+#define ADD_HITS_TIME_BUDGET_USEC 8000
+
 struct _NautilusSearchDirectory
 {
     NautilusDirectory parent_instance;
@@ -63,6 +68,22 @@ struct _NautilusSearchDirectory
     GList *files;
     GHashTable *files_hash;
 
+    /* A copy of the query the last search was started for, since the query
+     * is changed in place, and its hits by URI. Once that search completes,
+     * narrower queries are answered by filtering them, without asking the
+     * search engines again.
+     */
+    NautilusQuery *searched_query;
+    GHashTable *hits;
+    gboolean search_complete;
+    guint narrow_search_id;
+
+    /* Hits received from the engine and not added as files yet, and
+     * whether it finished after sending them */
+    GQueue pending_hits;
+    guint add_hits_id;
+    gboolean finish_pending;
+
     GList *monitor_list;
     GList *callback_list;
     GList *pending_callback_list;
@@ -122,6 +143,9 @@ static void search_engine_hits_added (NautilusSearchEngine    *engine,
 static void search_engine_error (NautilusSearchEngine    *engine,
                                  const char              *error,
                                  NautilusSearchDirectory *self);
+static void search_engine_finished (NautilusSearchEngine         *engine,
+                                    NautilusSearchProviderStatus  status,
+                                    NautilusSearchDirectory      *self);
 static void search_callback_file_ready_callback (NautilusFile *file,
                                                  gpointer      data);
 static void file_changed (NautilusFile            *file,
@@ -134,6 +158,11 @@ reset_file_list (NautilusSearchDirectory *self)
     NautilusFile *file;
     SearchMonitor *monitor;
 
+    /* Drop the hits that didn't make it to the list yet */
+    g_queue_clear_full (&self->pending_hits, g_object_unref);
+    g_clear_handle_id (&self->add_hits_id, g_source_remove);
+    self->finish_pending = FALSE;
+
     /* Remove file connections */
     for (list = self->files; list != NULL; list = list->next)
     {
@@ -178,6 +207,48 @@ set_hidden_files (NautilusSearchDirectory *self)
     nautilus_query_set_show_hidden_files (self->query, monitor_hidden);
 }
 
+static gboolean
+narrow_search (gpointer user_data)
+{
+    NautilusSearchDirectory *self = user_data;
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    g_autoptr (NautilusQueryMatcher) previous_matcher = NULL;
+    GHashTableIter iter;
+    gpointer hit;
+    GList *hits = NULL;
+
+    self->narrow_search_id = 0;
+
+    matcher = nautilus_query_get_matcher (self->query);
+    previous_matcher = nautilus_query_get_matcher (self->searched_query);
+
+    g_hash_table_iter_init (&iter, self->hits);
+    while (g_hash_table_iter_next (&iter, NULL, &hit))
+    {
+        if (nautilus_search_hit_narrow (hit, matcher, previous_matcher))
+        {
+            hits = g_list_prepend (hits, hit);
+        }
+        else
+        {
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+
+    g_clear_object (&self->searched_query);
+    self->searched_query = nautilus_query_copy (self->query);
+
+    /* As if the engine had found them again */
+    if (hits != NULL)
+    {
+        search_engine_hits_added (self->engine, hits, self);
+        g_list_free (hits);
+    }
+    search_engine_finished (self->engine, NAUTILUS_SEARCH_PROVIDER_STATUS_NORMAL, self);
+
+    return G_SOURCE_REMOVE;
+}
+
 static void
 start_search (NautilusSearchDirectory *self)
 {
@@ -203,6 +274,20 @@ start_search (NautilusSearchDirectory *self)
     self->search_ready_and_valid = FALSE;
 
     set_hidden_files (self);
+
+    if (self->search_complete &&
+        nautilus_query_is_narrowing (self->query, self->searched_query))
+    {
+        reset_file_list (self);
+        self->narrow_search_id = g_idle_add (narrow_search, self);
+        return;
+    }
+
+    g_clear_object (&self->searched_query);
+    self->searched_query = nautilus_query_copy (self->query);
+    self->search_complete = FALSE;
+    g_hash_table_remove_all (self->hits);
+
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (self->engine),
                                         self->query);
 
@@ -223,7 +308,14 @@ stop_search (NautilusSearchDirectory *self)
     }
 
     self->search_running = FALSE;
-    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (self->engine));
+    if (self->narrow_search_id != 0)
+    {
+        g_clear_handle_id (&self->narrow_search_id, g_source_remove);
+    }
+    else
+    {
+        nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (self->engine));
+    }
 
     reset_file_list (self);
 }
@@ -602,43 +694,62 @@ on_search_directory_search_ready_and_valid (NautilusSearchDirectory *self)
 }
 
 static void
-search_engine_hits_added (NautilusSearchEngine    *engine,
-                          GList                   *hits,
-                          NautilusSearchDirectory *self)
+search_directory_finish (NautilusSearchDirectory *self)
 {
-    GList *hit_list;
+    /* Unless it was stopped, in which case some hits may be missing */
+    self->search_complete = self->search_running;
+
+    on_search_directory_search_ready_and_valid (self);
+    nautilus_directory_emit_done_loading (NAUTILUS_DIRECTORY (self));
+}
+
+static gboolean
+add_pending_hits (gpointer user_data)
+{
+    NautilusSearchDirectory *self = user_data;
+    NautilusSearchHitScoring scoring;
+    NautilusSearchHit *hit;
     GList *file_list;
     NautilusFile *file;
     SearchMonitor *monitor;
-    GList *monitor_list;
+    GList *l;
+    gint64 deadline;
 
     file_list = NULL;
+    deadline = g_get_monotonic_time () + ADD_HITS_TIME_BUDGET_USEC;
 
-    for (hit_list = hits; hit_list != NULL; hit_list = hit_list->next)
-    {
-        NautilusSearchHit *hit = hit_list->data;
-        const char *uri;
+    nautilus_search_hit_scoring_init (&scoring, self->query);
 
-        uri = nautilus_search_hit_get_uri (hit);
+    do
+    {
+        hit = g_queue_pop_head (&self->pending_hits);
 
-        nautilus_search_hit_compute_scores (hit, self->query);
+        nautilus_search_hit_compute_scores (hit, &scoring);
 
-        file = nautilus_file_get_by_uri (uri);
+        file = nautilus_file_get_by_uri (nautilus_search_hit_get_uri (hit));
         nautilus_file_set_search_relevance (file, nautilus_search_hit_get_relevance (hit));
         nautilus_file_set_search_fts_snippet (file, nautilus_search_hit_get_fts_snippet (hit));
 
-        for (monitor_list = self->monitor_list; monitor_list; monitor_list = monitor_list->next)
-        {
-            monitor = monitor_list->data;
-
-            /* Add monitors */
-            nautilus_file_monitor_add (file, monitor, monitor->monitor_attributes);
-        }
-
-        g_signal_connect (file, "changed", G_CALLBACK (file_changed), self),
+        g_signal_connect (file, "changed", G_CALLBACK (file_changed), self);
 
         file_list = g_list_prepend (file_list, file);
         g_hash_table_add (self->files_hash, file);
+
+        g_object_unref (hit);
+    }
+    while (!g_queue_is_empty (&self->pending_hits) &&
+           g_get_monotonic_time () < deadline);
+
+    nautilus_search_hit_scoring_clear (&scoring);
+
+    /* Add monitors */
+    for (l = self->monitor_list; l != NULL; l = l->next)
+    {
+        monitor = l->data;
+        for (GList *f = file_list; f != NULL; f = f->next)
+        {
+            nautilus_file_monitor_add (f->data, monitor, monitor->monitor_attributes);
+        }
     }
 
     self->files = g_list_concat (self->files, file_list);
@@ -650,6 +761,45 @@ search_engine_hits_added (NautilusSearchEngine    *engine,
     nautilus_file_unref (file);
 
     search_directory_add_pending_files_callbacks (self);
+
+    if (!g_queue_is_empty (&self->pending_hits))
+    {
+        return G_SOURCE_CONTINUE;
+    }
+
+    self->add_hits_id = 0;
+
+    if (self->finish_pending)
+    {
+        self->finish_pending = FALSE;
+        search_directory_finish (self);
+    }
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+search_engine_hits_added (NautilusSearchEngine    *engine,
+                          GList                   *hits,
+                          NautilusSearchDirectory *self)
+{
+    GList *l;
+    NautilusSearchHit *hit;
+
+    for (l = hits; l != NULL; l = l->next)
+    {
+        hit = l->data;
+
+        g_hash_table_replace (self->hits,
+                              g_strdup (nautilus_search_hit_get_uri (hit)),
+                              g_object_ref (hit));
+        g_queue_push_tail (&self->pending_hits, g_object_ref (hit));
+    }
+
+    if (self->add_hits_id == 0 && !g_queue_is_empty (&self->pending_hits))
+    {
+        self->add_hits_id = g_idle_add (add_pending_hits, self);
+    }
 }
 
 static void
@@ -681,14 +831,22 @@ search_engine_finished (NautilusSearchEngine         *engine,
      * happening. */
     if (status == NAUTILUS_SEARCH_PROVIDER_STATUS_NORMAL)
     {
-        on_search_directory_search_ready_and_valid (self);
-        nautilus_directory_emit_done_loading (NAUTILUS_DIRECTORY (self));
+        /* Not done before the files of its last hits are added */
+        if (self->add_hits_id != 0)
+        {
+            self->finish_pending = TRUE;
+        }
+        else
+        {
+            search_directory_finish (self);
+        }
     }
     else if (status == NAUTILUS_SEARCH_PROVIDER_STATUS_RESTARTING)
     {
         /* Remove file monitors of the files from an old search that just
          * actually finished */
         reset_file_list (self);
+        g_hash_table_remove_all (self->hits);
     }
 }
 
@@ -711,6 +869,10 @@ search_force_reload (NautilusDirectory *directory)
     reset_file_list (self);
     stop_search (self);
 
+    /* Search everything again, rather than the files found before */
+    self->search_complete = FALSE;
+    g_hash_table_remove_all (self->hits);
+
     file = nautilus_directory_get_corresponding_file (directory);
     nautilus_file_invalidate_all_attributes (file);
     nautilus_file_unref (file);
@@ -905,6 +1067,7 @@ search_dispose (GObject *object)
     }
 
     g_clear_object (&self->query);
+    g_clear_object (&self->searched_query);
     stop_search (self);
     search_disconnect_engine (self);
 
@@ -921,6 +1084,7 @@ search_finalize (GObject *object)
     self = NAUTILUS_SEARCH_DIRECTORY (object);
 
     g_hash_table_destroy (self->files_hash);
+    g_hash_table_destroy (self->hits);
 
     G_OBJECT_CLASS (nautilus_search_directory_parent_class)->finalize (object);
 }
@@ -930,6 +1094,8 @@ nautilus_search_directory_init (NautilusSearchDirectory *self)
 {
     self->query = NULL;
     self->files_hash = g_hash_table_new (g_direct_hash, g_direct_equal);
+    self->hits = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                        g_free, g_object_unref);
 
     self->engine = nautilus_search_engine_new ();
     search_connect_engine (self);
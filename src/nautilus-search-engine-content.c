@@ -0,0 +1,827 @@
+/* nautilus-search-engine-content.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-search-engine-content.h"
+
+#include <errno.h>
+#include <fcntl.h>
+#include <string.h>
+#include <unistd.h>
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+#include "nautilus-query-type-filter.h"
+#include "nautilus-search-crawler.h"
+#include "nautilus-search-hit.h"
+#include "nautilus-search-provider.h"
+#include "nautilus-ui-utilities.h"
+
+/* More scanner threads than this mostly wait on the same disk */
+#define MAX_SCANNERS 8
+
+/* Reading the files is the slow part, so one thread finding them is enough */
+#define MAX_CRAWLERS 1
+
+/* Files the crawler may queue ahead of the scanners, so that it doesn't
+ * hold a whole tree in memory when scanning is the slow part */
+#define MAX_QUEUED_FILES 1024
+
+/* Bigger files are rarely text worth searching, and take long to read */
+#define MAX_FILE_SIZE (16 * 1024 * 1024)
+
+/* Files with a NUL byte this close to the start are taken to be binary */
+#define SNIFF_SIZE 4096
+
+/* Files are read in chunks this big, rather than mapped in memory, where
+ * a file truncated while it is scanned would crash the scanner */
+#define CHUNK_SIZE (64 * 1024)
+
+/* Bytes of context shown around the first match */
+#define SNIPPET_BEFORE 40
+#define SNIPPET_AFTER 80
+
+/* Rank of a content match, raised by how well the name matches too */
+#define CONTENT_MATCH_RANK 5.0
+
+/* How long the crawler waits for the scanners to catch up before checking
+ * whether the search was cancelled */
+#define QUEUE_WAIT_USEC (100 * G_TIME_SPAN_MILLISECOND)
+
+enum
+{
+    PROP_0,
+    PROP_RUNNING,
+    LAST_PROP
+};
+
+/* A crawler thread walks the folders and queues the files worth reading
+ * to a pool of scanner threads, which read them and look for every word
+ * of the query in them.
+ */
+typedef struct
+{
+    NautilusSearchEngineContent *engine;
+    GCancellable *cancellable;
+    gint64 start_time;
+
+    NautilusSearchCrawler *crawler;
+    NautilusQueryMatcher *matcher;
+    /* The words of the query, composed like text files usually are */
+    GPtrArray *words;
+    gsize max_word_length;
+    NautilusQuerySearchType search_type;
+    NautilusQueryTypeFilter *type_filter;
+    GPtrArray *date_range;
+
+    GThreadPool *scanners;
+
+    /* Files queued to the scanners and not scanned yet */
+    GMutex queue_mutex;
+    GCond queue_cond;
+    guint n_queued_files;
+
+    /* Hits not handed to the main thread yet */
+    GMutex hits_mutex;
+    GList *hits;
+    guint hits_idle_id;
+} SearchThreadData;
+
+typedef struct
+{
+    GFile *file;
+    gdouble name_match;
+    guint64 mtime;
+    /* Whether the type filter needs the contents to tell the type */
+    gboolean check_type;
+} ScanJob;
+
+struct _NautilusSearchEngineContent
+{
+    GObject parent_instance;
+
+    NautilusQuery *query;
+    SearchThreadData *active_search;
+};
+
+static void nautilus_search_provider_init (NautilusSearchProviderInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (NautilusSearchEngineContent,
+                         nautilus_search_engine_content,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_SEARCH_PROVIDER,
+                                                nautilus_search_provider_init))
+
+/**
+ * nautilus_search_engine_content_can_search:
+ * @query: a #NautilusQuery
+ *
+ * Returns: %TRUE if @query looks for the contents of files, in a folder the
+ * engine can read them from.
+ */
+gboolean
+nautilus_search_engine_content_can_search (NautilusQuery *query)
+{
+    g_autoptr (GFile) location = NULL;
+
+    if (query == NULL ||
+        nautilus_query_get_search_content (query) != NAUTILUS_QUERY_SEARCH_CONTENT_FULL_TEXT)
+    {
+        return FALSE;
+    }
+
+    location = nautilus_query_get_location (query);
+
+    return location != NULL && g_file_is_native (location);
+}
+
+static void
+scan_job_free (ScanJob *job)
+{
+    g_object_unref (job->file);
+    g_free (job);
+}
+
+static void
+search_thread_data_free (SearchThreadData *data)
+{
+    g_object_unref (data->engine);
+    g_object_unref (data->cancellable);
+    g_clear_pointer (&data->crawler, nautilus_search_crawler_free);
+    g_clear_pointer (&data->matcher, nautilus_query_matcher_unref);
+    g_clear_pointer (&data->words, g_ptr_array_unref);
+    g_clear_pointer (&data->type_filter, nautilus_query_type_filter_unref);
+    g_clear_pointer (&data->date_range, g_ptr_array_unref);
+    g_mutex_clear (&data->queue_mutex);
+    g_cond_clear (&data->queue_cond);
+    g_mutex_clear (&data->hits_mutex);
+    g_list_free_full (data->hits, g_object_unref);
+    g_free (data);
+}
+
+static void
+send_hits (SearchThreadData *data)
+{
+    GList *hits;
+
+    g_mutex_lock (&data->hits_mutex);
+    hits = data->hits;
+    data->hits = NULL;
+    g_clear_handle_id (&data->hits_idle_id, g_source_remove);
+    g_mutex_unlock (&data->hits_mutex);
+
+    if (hits != NULL && !g_cancellable_is_cancelled (data->cancellable))
+    {
+        DEBUG ("Content engine add hits");
+        nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (data->engine), hits);
+    }
+
+    g_list_free_full (hits, g_object_unref);
+}
+
+static gboolean
+send_hits_idle (gpointer user_data)
+{
+    SearchThreadData *data = user_data;
+
+    g_mutex_lock (&data->hits_mutex);
+    data->hits_idle_id = 0;
+    g_mutex_unlock (&data->hits_mutex);
+
+    send_hits (data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gboolean
+search_thread_done_idle (gpointer user_data)
+{
+    SearchThreadData *data = user_data;
+    NautilusSearchEngineContent *self = data->engine;
+
+    /* The scanners are gone, so the last hits can be sent right away */
+    send_hits (data);
+
+    DEBUG ("Content engine finished%s",
+           g_cancellable_is_cancelled (data->cancellable) ? " and cancelled" : "");
+
+    self->active_search = NULL;
+    nautilus_search_provider_finished (NAUTILUS_SEARCH_PROVIDER (self),
+                                       NAUTILUS_SEARCH_PROVIDER_STATUS_NORMAL);
+    g_object_notify (G_OBJECT (self), "running");
+
+    search_thread_data_free (data);
+
+    return G_SOURCE_REMOVE;
+}
+
+/* Scanning */
+
+/* Returns the offset of the first @byte in @haystack from @from on,
+ * before @n_starts, or %G_MAXSIZE.
+ */
+static gsize
+find_byte (const char *haystack,
+           gsize       from,
+           gsize       n_starts,
+           guchar      byte)
+{
+    const char *found;
+
+    if (from >= n_starts)
+    {
+        return G_MAXSIZE;
+    }
+
+    found = memchr (haystack + from, byte, n_starts - from);
+
+    return found != NULL ? (gsize) (found - haystack) : G_MAXSIZE;
+}
+
+/* Finds @word, which is lowercase, in @haystack ignoring the case of ASCII
+ * letters. Only the bytes that can start it are compared with the whole
+ * word, and memchr(), vectorized by the C library, finds them.
+ *
+ * Returns: the offset of the first match, or %G_MAXSIZE.
+ */
+static gsize
+find_word (const char *haystack,
+           gsize       length,
+           const char *word,
+           gsize       word_length)
+{
+    guchar lower;
+    guchar upper;
+    gsize n_starts;
+    gsize lower_offset;
+    gsize upper_offset;
+    gsize offset;
+
+    if (word_length == 0 || word_length > length)
+    {
+        return G_MAXSIZE;
+    }
+
+    n_starts = length - word_length + 1;
+    lower = word[0];
+    upper = g_ascii_toupper (lower);
+
+    lower_offset = find_byte (haystack, 0, n_starts, lower);
+    upper_offset = upper != lower ? find_byte (haystack, 0, n_starts, upper) : G_MAXSIZE;
+
+    while ((offset = MIN (lower_offset, upper_offset)) != G_MAXSIZE)
+    {
+        if (g_ascii_strncasecmp (haystack + offset + 1, word + 1, word_length - 1) == 0)
+        {
+            return offset;
+        }
+
+        if (offset == lower_offset)
+        {
+            lower_offset = find_byte (haystack, offset + 1, n_starts, lower);
+        }
+        else
+        {
+            upper_offset = find_byte (haystack, offset + 1, n_starts, upper);
+        }
+    }
+
+    return G_MAXSIZE;
+}
+
+static gchar *
+get_snippet (const char *contents,
+             gsize       length,
+             gsize       match_offset,
+             gsize       match_length)
+{
+    g_autofree gchar *text = NULL;
+    gsize start;
+    gsize end;
+
+    start = match_offset > SNIPPET_BEFORE ? match_offset - SNIPPET_BEFORE : 0;
+    end = MIN (length, match_offset + match_length + SNIPPET_AFTER);
+
+    /* Don't cut characters in half */
+    while (start < match_offset && ((guchar) contents[start] & 0xc0) == 0x80)
+    {
+        start++;
+    }
+    while (end < length && end > match_offset + match_length &&
+           ((guchar) contents[end] & 0xc0) == 0x80)
+    {
+        end--;
+    }
+
+    text = g_utf8_make_valid (contents + start, end - start);
+
+    return g_strconcat (start > 0 ? "…" : "", text, end < length ? "…" : "", NULL);
+}
+
+static void
+add_hit (SearchThreadData  *data,
+         NautilusSearchHit *hit)
+{
+    g_mutex_lock (&data->hits_mutex);
+    data->hits = g_list_prepend (data->hits, hit);
+    if (data->hits_idle_id == 0)
+    {
+        data->hits_idle_id = g_idle_add (send_hits_idle, data);
+    }
+    g_mutex_unlock (&data->hits_mutex);
+}
+
+/* Reads up to @size bytes at @offset, fewer only at the end of the file.
+ *
+ * Returns: the number of bytes read, or -1.
+ */
+static gssize
+read_at (int      fd,
+         char    *buffer,
+         gsize    size,
+         goffset  offset)
+{
+    gsize n_read = 0;
+    gssize n;
+
+    while (n_read < size)
+    {
+        n = pread (fd, buffer + n_read, size - n_read, offset + n_read);
+        if (n < 0 && errno == EINTR)
+        {
+            continue;
+        }
+        if (n < 0)
+        {
+            return -1;
+        }
+        if (n == 0)
+        {
+            break;
+        }
+        n_read += n;
+    }
+
+    return n_read;
+}
+
+/* Reads the text around a match. A byte more is read on each side, when
+ * there is one, for get_snippet() to tell whether the text goes on. */
+static gchar *
+read_snippet (int     fd,
+              goffset match_offset,
+              gsize   match_length)
+{
+    g_autofree gchar *buffer = NULL;
+    goffset start;
+    gsize size;
+    gssize n_read;
+
+    start = match_offset > SNIPPET_BEFORE ? match_offset - SNIPPET_BEFORE - 1 : 0;
+    size = (match_offset - start) + match_length + SNIPPET_AFTER + 1;
+
+    buffer = g_malloc (size);
+    n_read = read_at (fd, buffer, size, start);
+
+    /* Unless the file changed since */
+    if (n_read < (gssize) ((match_offset - start) + match_length))
+    {
+        return NULL;
+    }
+
+    return get_snippet (buffer, n_read, match_offset - start, match_length);
+}
+
+static void
+scan_file (ScanJob          *job,
+           SearchThreadData *data)
+{
+    g_autofree gchar *path = NULL;
+    g_autofree gchar *buffer = NULL;
+    g_autofree gboolean *found = NULL;
+    g_autofree gchar *uri = NULL;
+    g_autofree gchar *snippet = NULL;
+    NautilusSearchHit *hit;
+    const char *word;
+    goffset buffer_offset = 0;
+    goffset first_offset = 0;
+    gsize first_length = 0;
+    gsize kept = 0;
+    gsize length;
+    gssize n_read;
+    gsize offset;
+    guint n_found = 0;
+    guint i;
+    int fd;
+
+    path = g_file_get_path (job->file);
+    if (path == NULL)
+    {
+        return;
+    }
+
+    fd = g_open (path, O_RDONLY | O_CLOEXEC, 0);
+    if (fd < 0)
+    {
+        return;
+    }
+
+    buffer = g_malloc (CHUNK_SIZE + data->max_word_length);
+    found = g_new0 (gboolean, data->words->len);
+
+    while (n_found < data->words->len && buffer_offset + kept < MAX_FILE_SIZE)
+    {
+        n_read = read_at (fd, buffer + kept, CHUNK_SIZE, buffer_offset + kept);
+        if (n_read <= 0)
+        {
+            break;
+        }
+        length = kept + n_read;
+
+        if (buffer_offset == 0)
+        {
+            if (memchr (buffer, '\0', MIN (length, SNIFF_SIZE)) != NULL)
+            {
+                break;
+            }
+
+            if (job->check_type)
+            {
+                g_autofree gchar *basename = NULL;
+                g_autofree gchar *content_type = NULL;
+
+                basename = g_path_get_basename (path);
+                content_type = g_content_type_guess (basename, (const guchar *) buffer,
+                                                     MIN (length, SNIFF_SIZE), NULL);
+                if (!nautilus_query_type_filter_match_type (data->type_filter, content_type))
+                {
+                    break;
+                }
+            }
+        }
+
+        for (i = 0; i < data->words->len; i++)
+        {
+            if (found[i])
+            {
+                continue;
+            }
+
+            word = g_ptr_array_index (data->words, i);
+            offset = find_word (buffer, length, word, strlen (word));
+            if (offset == G_MAXSIZE)
+            {
+                continue;
+            }
+
+            found[i] = TRUE;
+            n_found++;
+            if (i == 0)
+            {
+                first_offset = buffer_offset + offset;
+                first_length = strlen (word);
+            }
+        }
+
+        /* Words may start at the end of this chunk and end in the next */
+        kept = MIN (length, data->max_word_length - 1);
+        memmove (buffer, buffer + length - kept, kept);
+        buffer_offset += length - kept;
+    }
+
+    if (n_found < data->words->len)
+    {
+        g_close (fd, NULL);
+        return;
+    }
+
+    uri = g_file_get_uri (job->file);
+    snippet = read_snippet (fd, first_offset, first_length);
+    g_close (fd, NULL);
+
+    hit = nautilus_search_hit_new (uri);
+    nautilus_search_hit_set_fts_rank (hit, CONTENT_MATCH_RANK + MAX (job->name_match, 0));
+    nautilus_search_hit_set_modification_time (hit, job->mtime);
+    nautilus_search_hit_set_fts_snippet (hit, snippet);
+
+    add_hit (data, hit);
+}
+
+static void
+scanner_func (gpointer data,
+              gpointer user_data)
+{
+    ScanJob *job = data;
+    SearchThreadData *thread_data = user_data;
+
+    if (!g_cancellable_is_cancelled (thread_data->cancellable))
+    {
+        scan_file (job, thread_data);
+    }
+    scan_job_free (job);
+
+    g_mutex_lock (&thread_data->queue_mutex);
+    thread_data->n_queued_files--;
+    g_cond_signal (&thread_data->queue_cond);
+    g_mutex_unlock (&thread_data->queue_mutex);
+}
+
+/* Crawling */
+
+static void
+queue_file (SearchThreadData *data,
+            GFile            *file,
+            gdouble           name_match,
+            guint64           mtime,
+            gboolean          check_type)
+{
+    ScanJob *job;
+
+    g_mutex_lock (&data->queue_mutex);
+    while (data->n_queued_files >= MAX_QUEUED_FILES &&
+           !g_cancellable_is_cancelled (data->cancellable))
+    {
+        g_cond_wait_until (&data->queue_cond, &data->queue_mutex,
+                           g_get_monotonic_time () + QUEUE_WAIT_USEC);
+    }
+    data->n_queued_files++;
+    g_mutex_unlock (&data->queue_mutex);
+
+    job = g_new0 (ScanJob, 1);
+    job->file = g_object_ref (file);
+    job->name_match = name_match;
+    job->mtime = mtime;
+    job->check_type = check_type;
+
+    g_thread_pool_push (data->scanners, job, NULL);
+}
+
+static gboolean
+matches_date_range (SearchThreadData *data,
+                    GFileInfo        *info)
+{
+    guint64 time;
+
+    if (data->date_range == NULL)
+    {
+        return TRUE;
+    }
+
+    if (data->search_type == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS)
+    {
+        time = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_ACCESS);
+    }
+    else
+    {
+        time = g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED);
+    }
+
+    return nautilus_file_date_in_between (time,
+                                          g_ptr_array_index (data->date_range, 0),
+                                          g_ptr_array_index (data->date_range, 1));
+}
+
+static void
+on_crawler_file (GFile     *child,
+                 GFileInfo *info,
+                 guint      worker,
+                 gpointer   user_data)
+{
+    SearchThreadData *data = user_data;
+    NautilusQueryTypeFilterResult type_match;
+    GFileType type;
+    goffset size;
+
+    type = g_file_info_get_file_type (info);
+    size = g_file_info_get_size (info);
+    if (type != G_FILE_TYPE_REGULAR ||
+        size <= 0 || size > MAX_FILE_SIZE ||
+        !matches_date_range (data, info))
+    {
+        return;
+    }
+
+    /* Files whose names don't tell their type are checked by the
+     * scanners, which read them anyway */
+    type_match = nautilus_query_type_filter_match_name (data->type_filter,
+                                                        g_file_info_get_name (info),
+                                                        type);
+    if (type_match != NAUTILUS_QUERY_TYPE_FILTER_NO_MATCH)
+    {
+        queue_file (data, child,
+                    nautilus_query_matcher_match (data->matcher, g_file_info_get_display_name (info)),
+                    g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                    type_match == NAUTILUS_QUERY_TYPE_FILTER_UNSURE);
+    }
+}
+
+static void
+on_crawler_done (gpointer user_data)
+{
+    SearchThreadData *data = user_data;
+
+    /* Waits for the queued files to be scanned, quickly if cancelled */
+    g_thread_pool_free (data->scanners, FALSE, TRUE);
+    data->scanners = NULL;
+
+    DEBUG ("Content engine scanned files in %" G_GINT64_FORMAT " ms",
+           (g_get_monotonic_time () - data->start_time) / 1000);
+
+    g_idle_add (search_thread_done_idle, data);
+}
+
+static GPtrArray *
+get_words (NautilusQueryMatcher *matcher)
+{
+    GPtrArray *words;
+    const char *word;
+    guint i;
+
+    words = g_ptr_array_new_with_free_func (g_free);
+    for (i = 0; i < nautilus_query_matcher_get_n_words (matcher); i++)
+    {
+        word = nautilus_query_matcher_get_word (matcher, i);
+        if (*word != '\0')
+        {
+            g_ptr_array_add (words, g_utf8_normalize (word, -1, G_NORMALIZE_NFC));
+        }
+    }
+
+    return words;
+}
+
+static gsize
+get_max_length (GPtrArray *words)
+{
+    gsize max_length = 0;
+    guint i;
+
+    for (i = 0; i < words->len; i++)
+    {
+        max_length = MAX (max_length, strlen (g_ptr_array_index (words, i)));
+    }
+
+    return max_length;
+}
+
+static void
+nautilus_search_engine_content_start (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineContent *self = NAUTILUS_SEARCH_ENGINE_CONTENT (provider);
+    g_autoptr (GPtrArray) mime_types = NULL;
+    SearchThreadData *data;
+
+    g_return_if_fail (self->query != NULL);
+
+    if (self->active_search != NULL)
+    {
+        return;
+    }
+
+    data = g_new0 (SearchThreadData, 1);
+    data->engine = g_object_ref (self);
+    data->cancellable = g_cancellable_new ();
+    g_mutex_init (&data->queue_mutex);
+    g_cond_init (&data->queue_cond);
+    g_mutex_init (&data->hits_mutex);
+
+    self->active_search = data;
+
+    data->matcher = nautilus_query_get_matcher (self->query);
+    data->words = get_words (data->matcher);
+    data->max_word_length = get_max_length (data->words);
+
+    if (!nautilus_search_engine_content_can_search (self->query) || data->words->len == 0)
+    {
+        g_idle_add (search_thread_done_idle, data);
+        g_object_notify (G_OBJECT (provider), "running");
+        return;
+    }
+
+    data->search_type = nautilus_query_get_search_type (self->query);
+    mime_types = nautilus_query_get_mime_types (self->query);
+    data->type_filter = nautilus_query_type_filter_new (mime_types);
+    data->date_range = nautilus_query_get_date_range (self->query);
+    data->crawler = nautilus_search_crawler_new (self->query, MAX_CRAWLERS, data->cancellable);
+    data->scanners = g_thread_pool_new (scanner_func, data,
+                                        CLAMP (g_get_num_processors (), 1, MAX_SCANNERS),
+                                        FALSE, NULL);
+
+    DEBUG ("Content engine start");
+
+    data->start_time = g_get_monotonic_time ();
+    nautilus_search_crawler_start (data->crawler, on_crawler_file, NULL,
+                                   on_crawler_done, data);
+
+    g_object_notify (G_OBJECT (provider), "running");
+}
+
+static void
+nautilus_search_engine_content_stop (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineContent *self = NAUTILUS_SEARCH_ENGINE_CONTENT (provider);
+
+    if (self->active_search != NULL)
+    {
+        DEBUG ("Content engine stop");
+        g_cancellable_cancel (self->active_search->cancellable);
+    }
+}
+
+static void
+nautilus_search_engine_content_set_query (NautilusSearchProvider *provider,
+                                          NautilusQuery          *query)
+{
+    NautilusSearchEngineContent *self = NAUTILUS_SEARCH_ENGINE_CONTENT (provider);
+
+    g_clear_object (&self->query);
+    self->query = g_object_ref (query);
+}
+
+static gboolean
+nautilus_search_engine_content_is_running (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineContent *self = NAUTILUS_SEARCH_ENGINE_CONTENT (provider);
+
+    return self->active_search != NULL;
+}
+
+static void
+nautilus_search_engine_content_finalize (GObject *object)
+{
+    NautilusSearchEngineContent *self = NAUTILUS_SEARCH_ENGINE_CONTENT (object);
+
+    g_clear_object (&self->query);
+
+    G_OBJECT_CLASS (nautilus_search_engine_content_parent_class)->finalize (object);
+}
+
+static void
+nautilus_search_engine_content_get_property (GObject    *object,
+                                             guint       prop_id,
+                                             GValue     *value,
+                                             GParamSpec *pspec)
+{
+    NautilusSearchProvider *provider = NAUTILUS_SEARCH_PROVIDER (object);
+
+    switch (prop_id)
+    {
+        case PROP_RUNNING:
+        {
+            g_value_set_boolean (value, nautilus_search_engine_content_is_running (provider));
+        }
+        break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+nautilus_search_provider_init (NautilusSearchProviderInterface *iface)
+{
+    iface->set_query = nautilus_search_engine_content_set_query;
+    iface->start = nautilus_search_engine_content_start;
+    iface->stop = nautilus_search_engine_content_stop;
+    iface->is_running = nautilus_search_engine_content_is_running;
+}
+
+static void
+nautilus_search_engine_content_class_init (NautilusSearchEngineContentClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = nautilus_search_engine_content_finalize;
+    object_class->get_property = nautilus_search_engine_content_get_property;
+
+    g_object_class_override_property (object_class, PROP_RUNNING, "running");
+}
+
+static void
+nautilus_search_engine_content_init (NautilusSearchEngineContent *self)
+{
+}
+
+NautilusSearchEngineContent *
+nautilus_search_engine_content_new (void)
+{
+    return g_object_new (NAUTILUS_TYPE_SEARCH_ENGINE_CONTENT, NULL);
+}
@@ -0,0 +1,35 @@
+/* nautilus-search-engine-content.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib-object.h>
+
+#include "nautilus-query.h"
+
+G_BEGIN_DECLS
+
+#define NAUTILUS_TYPE_SEARCH_ENGINE_CONTENT (nautilus_search_engine_content_get_type ())
+
+G_DECLARE_FINAL_TYPE (NautilusSearchEngineContent, nautilus_search_engine_content, NAUTILUS, SEARCH_ENGINE_CONTENT, GObject)
+
+NautilusSearchEngineContent *nautilus_search_engine_content_new        (void);
+
+gboolean                     nautilus_search_engine_content_can_search (NautilusQuery *query);
+
+G_END_DECLS
@@ -0,0 +1,1126 @@
+/* nautilus-search-engine-index.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-search-engine-index.h"
+
+#include <gio/gio.h>
+#include <glib/gstdio.h>
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
+#include "nautilus-debug.h"
+
+#include "nautilus-directory-notify.h"
+#include "nautilus-filename-index.h"
+#include "nautilus-global-preferences.h"
+#include "nautilus-search-engine-private.h"
+#include "nautilus-search-hit.h"
+#include "nautilus-search-provider.h"
+#include "nautilus-ui-utilities.h"
+
+/* Only the indexed folders themselves are monitored, so files changing in
+ * their subfolders are only found once the index is rebuilt, which it is
+ * this often while Nautilus runs. An index older than twice that, like one
+ * loaded at startup, doesn't replace crawling the folders.
+ */
+#define REFRESH_INTERVAL_SECONDS (15 * 60)
+#define MAX_FRESH_INDEX_AGE_SECONDS (2 * REFRESH_INTERVAL_SECONDS)
+
+/* Until then, the changes Nautilus sees are applied to the results, unless
+ * this many files changed, which starts a rebuild right away */
+#define MAX_PENDING_CHANGES 10000
+
+struct _NautilusSearchEngineIndex
+{
+    GObject parent_instance;
+
+    NautilusQuery *query;
+    GCancellable *cancellable;
+    gboolean running;
+};
+
+static void nautilus_search_provider_init (NautilusSearchProviderInterface *iface);
+
+G_DEFINE_TYPE_WITH_CODE (NautilusSearchEngineIndex,
+                         nautilus_search_engine_index,
+                         G_TYPE_OBJECT,
+                         G_IMPLEMENT_INTERFACE (NAUTILUS_TYPE_SEARCH_PROVIDER,
+                                                nautilus_search_provider_init))
+
+enum
+{
+    PROP_0,
+    PROP_RUNNING,
+    LAST_PROP
+};
+
+/* The index of the folders in the search-index-locations preference, kept
+ * for the whole process, and the files that changed since it was built.
+ */
+
+typedef struct
+{
+    GFile *file;
+    /* Real time it changed at, to know whether a new index has it */
+    gint64 time;
+} IndexChange;
+
+typedef struct
+{
+    /* GFile */
+    GList *locations;
+    gchar *path;
+
+    NautilusFilenameIndex *index;
+
+    /* URI to IndexChange */
+    GHashTable *added;
+    GHashTable *removed;
+
+    GCancellable *build_cancellable;
+    guint rebuild_id;
+
+    /* Of the listings of moved folders */
+    GCancellable *moves_cancellable;
+
+    /* GFileMonitor of each location */
+    GList *monitors;
+} IndexManager;
+
+typedef struct
+{
+    GList *locations;
+    gchar *path;
+    gint64 start_time;
+} BuildData;
+
+static IndexManager *manager = NULL;
+
+static void start_build (void);
+
+static IndexChange *
+index_change_new (GFile *file)
+{
+    IndexChange *change;
+
+    change = g_new0 (IndexChange, 1);
+    change->file = g_object_ref (file);
+    change->time = g_get_real_time ();
+
+    return change;
+}
+
+static void
+index_change_free (IndexChange *change)
+{
+    g_object_unref (change->file);
+    g_free (change);
+}
+
+static void
+build_data_free (BuildData *data)
+{
+    g_list_free_full (data->locations, g_object_unref);
+    g_free (data->path);
+    g_free (data);
+}
+
+static gboolean
+is_in_locations (GFile *file)
+{
+    GList *l;
+
+    for (l = manager->locations; l != NULL; l = l->next)
+    {
+        if (g_file_equal (file, l->data) || g_file_has_prefix (file, l->data))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+index_has_locations (NautilusFilenameIndex *index)
+{
+    g_auto (GStrv) uris = NULL;
+    GList *l;
+    guint i;
+
+    uris = nautilus_filename_index_get_locations (index);
+    for (i = 0, l = manager->locations; uris[i] != NULL && l != NULL; i++, l = l->next)
+    {
+        g_autoptr (GFile) location = NULL;
+
+        location = g_file_new_for_uri (uris[i]);
+        if (!g_file_equal (location, l->data))
+        {
+            return FALSE;
+        }
+    }
+
+    return uris[i] == NULL && l == NULL;
+}
+
+static gboolean
+on_rebuild_timeout (gpointer user_data)
+{
+    manager->rebuild_id = 0;
+    start_build ();
+
+    return G_SOURCE_REMOVE;
+}
+
+static void
+schedule_refresh (guint seconds)
+{
+    g_clear_handle_id (&manager->rebuild_id, g_source_remove);
+    manager->rebuild_id = g_timeout_add_seconds (seconds, on_rebuild_timeout, NULL);
+}
+
+static void
+schedule_rebuild (void)
+{
+    /* Changes during a build are checked again once it is done */
+    if (manager->build_cancellable != NULL)
+    {
+        return;
+    }
+
+    if (g_hash_table_size (manager->added) + g_hash_table_size (manager->removed) > MAX_PENDING_CHANGES)
+    {
+        start_build ();
+    }
+    else if (manager->rebuild_id == 0)
+    {
+        schedule_refresh (REFRESH_INTERVAL_SECONDS);
+    }
+}
+
+/* Forgets the changes a new index has */
+static void
+forget_changes_before (gint64 time)
+{
+    GHashTableIter iter;
+    IndexChange *change;
+
+    g_hash_table_iter_init (&iter, manager->added);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &change))
+    {
+        if (change->time < time || nautilus_filename_index_contains (manager->index, change->file))
+        {
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+
+    g_hash_table_iter_init (&iter, manager->removed);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &change))
+    {
+        if (change->time < time || !nautilus_filename_index_contains (manager->index, change->file))
+        {
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+
+    if (g_hash_table_size (manager->added) + g_hash_table_size (manager->removed) > 0)
+    {
+        schedule_rebuild ();
+    }
+}
+
+static void
+build_thread_func (GTask        *task,
+                   gpointer      source_object,
+                   gpointer      task_data,
+                   GCancellable *cancellable)
+{
+    BuildData *data = task_data;
+    GError *error = NULL;
+
+    if (nautilus_filename_index_build (data->locations, data->path, cancellable, &error))
+    {
+        g_task_return_boolean (task, TRUE);
+    }
+    else
+    {
+        g_task_return_error (task, error);
+    }
+}
+
+static void
+on_build_finished (GObject      *source_object,
+                   GAsyncResult *result,
+                   gpointer      user_data)
+{
+    GTask *task = G_TASK (result);
+    BuildData *data = g_task_get_task_data (task);
+    NautilusFilenameIndex *index;
+    g_autoptr (GError) error = NULL;
+
+    /* Superseded by a build for other locations */
+    if (g_task_get_cancellable (task) != manager->build_cancellable)
+    {
+        return;
+    }
+    g_clear_object (&manager->build_cancellable);
+
+    schedule_refresh (REFRESH_INTERVAL_SECONDS);
+
+    if (!g_task_propagate_boolean (task, &error))
+    {
+        g_warning ("Could not index file names: %s", error->message);
+        return;
+    }
+
+    index = nautilus_filename_index_new_for_path (data->path, &error);
+    if (index == NULL)
+    {
+        g_warning ("Could not load the file name index: %s", error->message);
+        return;
+    }
+
+    DEBUG ("Loaded new file name index of %u files", nautilus_filename_index_get_n_files (index));
+
+    g_clear_pointer (&manager->index, nautilus_filename_index_unref);
+    manager->index = index;
+
+    forget_changes_before (data->start_time);
+}
+
+static void
+start_build (void)
+{
+    g_autoptr (GTask) task = NULL;
+    BuildData *data;
+
+    g_clear_handle_id (&manager->rebuild_id, g_source_remove);
+
+    if (manager->build_cancellable != NULL || manager->locations == NULL)
+    {
+        return;
+    }
+
+    data = g_new0 (BuildData, 1);
+    data->locations = g_list_copy_deep (manager->locations, (GCopyFunc) g_object_ref, NULL);
+    data->path = g_strdup (manager->path);
+    data->start_time = g_get_real_time ();
+
+    DEBUG ("Building the file name index");
+
+    manager->build_cancellable = g_cancellable_new ();
+    task = g_task_new (NULL, manager->build_cancellable, on_build_finished, NULL);
+    g_task_set_task_data (task, data, (GDestroyNotify) build_data_free);
+    g_task_run_in_thread (task, build_thread_func);
+}
+
+static void
+add_file (GFile *file)
+{
+    g_autofree gchar *uri = NULL;
+
+    if (!is_in_locations (file))
+    {
+        return;
+    }
+
+    uri = g_file_get_uri (file);
+    g_hash_table_remove (manager->removed, uri);
+    if (!nautilus_filename_index_contains (manager->index, file))
+    {
+        g_hash_table_replace (manager->added, g_steal_pointer (&uri), index_change_new (file));
+    }
+
+    schedule_rebuild ();
+}
+
+static void
+remove_file (GFile *file)
+{
+    g_autofree gchar *uri = NULL;
+
+    if (!is_in_locations (file))
+    {
+        return;
+    }
+
+    uri = g_file_get_uri (file);
+    g_hash_table_remove (manager->added, uri);
+    if (nautilus_filename_index_contains (manager->index, file))
+    {
+        g_hash_table_replace (manager->removed, g_steal_pointer (&uri), index_change_new (file));
+    }
+
+    schedule_rebuild ();
+}
+
+static void
+file_list_free (GList *files)
+{
+    g_list_free_full (files, g_object_unref);
+}
+
+/* Lists the contents of the moved files that are folders, stopping once
+ * a rebuild is due anyway */
+static void
+list_moved_files_thread_func (GTask        *task,
+                              gpointer      source_object,
+                              gpointer      task_data,
+                              GCancellable *cancellable)
+{
+    GList *moved_files = task_data;
+    GQueue *folders;
+    GList *files = NULL;
+    guint n_files = 0;
+    GList *l;
+
+    folders = g_queue_new ();
+    for (l = moved_files; l != NULL; l = l->next)
+    {
+        g_queue_push_tail (folders, g_object_ref (l->data));
+    }
+    while (n_files <= MAX_PENDING_CHANGES &&
+           !g_cancellable_is_cancelled (cancellable) &&
+           !g_queue_is_empty (folders))
+    {
+        g_autoptr (GFile) directory = NULL;
+        g_autoptr (GFileEnumerator) enumerator = NULL;
+        GFileInfo *info;
+        GFile *child;
+
+        directory = g_queue_pop_head (folders);
+        enumerator = g_file_enumerate_children (directory,
+                                                G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                                                G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                                                G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                                cancellable, NULL);
+        if (enumerator == NULL)
+        {
+            continue;
+        }
+
+        while (n_files <= MAX_PENDING_CHANGES &&
+               g_file_enumerator_iterate (enumerator, &info, &child, cancellable, NULL) &&
+               info != NULL)
+        {
+            files = g_list_prepend (files, g_object_ref (child));
+            n_files++;
+
+            if (g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY)
+            {
+                g_queue_push_tail (folders, g_object_ref (child));
+            }
+        }
+    }
+    g_queue_free_full (folders, g_object_unref);
+
+    g_task_return_pointer (task, files, (GDestroyNotify) file_list_free);
+}
+
+static void
+on_moved_files_listed (GObject      *source_object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+    g_autolist (GFile) files = NULL;
+    GList *l;
+
+    files = g_task_propagate_pointer (G_TASK (result), NULL);
+    if (files == NULL || manager->index == NULL)
+    {
+        return;
+    }
+
+    DEBUG ("Adding %u files of moved folders to the file name index changes",
+           g_list_length (files));
+
+    for (l = files; l != NULL; l = l->next)
+    {
+        add_file (l->data);
+    }
+}
+
+/* The index only has the contents of a moved folder at its old path, so
+ * they are listed again at the new one, rather than going missing until
+ * the next rebuild.
+ */
+static void
+list_moved_files (GList *files)
+{
+    g_autoptr (GTask) task = NULL;
+
+    if (files == NULL)
+    {
+        return;
+    }
+
+    if (manager->moves_cancellable == NULL)
+    {
+        manager->moves_cancellable = g_cancellable_new ();
+    }
+
+    task = g_task_new (NULL, manager->moves_cancellable, on_moved_files_listed, NULL);
+    g_task_set_task_data (task, files, (GDestroyNotify) file_list_free);
+    g_task_run_in_thread (task, list_moved_files_thread_func);
+}
+
+/* Returns %TRUE if @to is in the indexed folders, and so are its contents */
+static gboolean
+move_file (GFile *from,
+           GFile *to)
+{
+    if (from != NULL)
+    {
+        remove_file (from);
+    }
+    add_file (to);
+
+    return is_in_locations (to);
+}
+
+/* Changes reported by Nautilus, for the folders it shows and for its own
+ * file operations.
+ */
+
+void
+nautilus_search_engine_index_files_added (GList *files)
+{
+    GList *l;
+
+    if (manager == NULL || manager->index == NULL)
+    {
+        return;
+    }
+
+    for (l = files; l != NULL; l = l->next)
+    {
+        add_file (l->data);
+    }
+}
+
+void
+nautilus_search_engine_index_files_removed (GList *files)
+{
+    GList *l;
+
+    if (manager == NULL || manager->index == NULL)
+    {
+        return;
+    }
+
+    for (l = files; l != NULL; l = l->next)
+    {
+        remove_file (l->data);
+    }
+}
+
+void
+nautilus_search_engine_index_files_moved (GList *file_pairs)
+{
+    GFilePair *pair;
+    GList *moved_files = NULL;
+    GList *l;
+
+    if (manager == NULL || manager->index == NULL)
+    {
+        return;
+    }
+
+    for (l = file_pairs; l != NULL; l = l->next)
+    {
+        pair = l->data;
+        if (move_file (pair->from, pair->to))
+        {
+            moved_files = g_list_prepend (moved_files, g_object_ref (pair->to));
+        }
+    }
+
+    list_moved_files (moved_files);
+}
+
+/* Changes in the indexed folders themselves, which might not be shown */
+static void
+on_location_changed (GFileMonitor      *monitor,
+                     GFile             *file,
+                     GFile             *other_file,
+                     GFileMonitorEvent  event_type,
+                     gpointer           user_data)
+{
+    if (manager->index == NULL)
+    {
+        return;
+    }
+
+    switch (event_type)
+    {
+        case G_FILE_MONITOR_EVENT_CREATED:
+        {
+            add_file (file);
+        }
+        break;
+
+        case G_FILE_MONITOR_EVENT_MOVED_IN:
+        {
+            if (move_file (other_file, file))
+            {
+                list_moved_files (g_list_prepend (NULL, g_object_ref (file)));
+            }
+        }
+        break;
+
+        case G_FILE_MONITOR_EVENT_DELETED:
+        case G_FILE_MONITOR_EVENT_MOVED_OUT:
+        {
+            remove_file (file);
+        }
+        break;
+
+        case G_FILE_MONITOR_EVENT_RENAMED:
+        {
+            if (move_file (file, other_file))
+            {
+                list_moved_files (g_list_prepend (NULL, g_object_ref (other_file)));
+            }
+        }
+        break;
+
+        default:
+            break;
+    }
+}
+
+static void
+monitor_free (GFileMonitor *monitor)
+{
+    g_file_monitor_cancel (monitor);
+    g_object_unref (monitor);
+}
+
+static void
+update_monitors (void)
+{
+    GFileMonitor *monitor;
+    GList *l;
+
+    g_list_free_full (manager->monitors, (GDestroyNotify) monitor_free);
+    manager->monitors = NULL;
+
+    for (l = manager->locations; l != NULL; l = l->next)
+    {
+        monitor = g_file_monitor_directory (l->data, G_FILE_MONITOR_WATCH_MOVES, NULL, NULL);
+        if (monitor != NULL)
+        {
+            g_signal_connect (monitor, "changed", G_CALLBACK (on_location_changed), NULL);
+            manager->monitors = g_list_prepend (manager->monitors, monitor);
+        }
+    }
+}
+
+static void
+load_index (void)
+{
+    g_autoptr (NautilusFilenameIndex) index = NULL;
+    g_autoptr (GError) error = NULL;
+    gint64 age;
+
+    index = nautilus_filename_index_new_for_path (manager->path, &error);
+    if (index == NULL || !index_has_locations (index))
+    {
+        DEBUG ("No file name index to load: %s",
+               error != NULL ? error->message : "other locations");
+        start_build ();
+        return;
+    }
+
+    manager->index = g_steal_pointer (&index);
+    age = (g_get_real_time () - nautilus_filename_index_get_build_time (manager->index)) / G_USEC_PER_SEC;
+
+    DEBUG ("Loaded file name index of %u files, %" G_GINT64_FORMAT " s old",
+           nautilus_filename_index_get_n_files (manager->index), age);
+
+    /* Until the new one is ready, the old one is better than nothing */
+    if (age >= REFRESH_INTERVAL_SECONDS || age < 0)
+    {
+        start_build ();
+    }
+    else
+    {
+        schedule_refresh (REFRESH_INTERVAL_SECONDS - age);
+    }
+}
+
+static void
+search_index_locations_changed_callback (gpointer callback_data)
+{
+    g_auto (GStrv) locations = NULL;
+    guint i;
+
+    if (manager->build_cancellable != NULL)
+    {
+        g_cancellable_cancel (manager->build_cancellable);
+        g_clear_object (&manager->build_cancellable);
+    }
+    if (manager->moves_cancellable != NULL)
+    {
+        g_cancellable_cancel (manager->moves_cancellable);
+        g_clear_object (&manager->moves_cancellable);
+    }
+    g_clear_handle_id (&manager->rebuild_id, g_source_remove);
+    g_clear_pointer (&manager->index, nautilus_filename_index_unref);
+    g_hash_table_remove_all (manager->added);
+    g_hash_table_remove_all (manager->removed);
+
+    g_list_free_full (manager->locations, g_object_unref);
+    manager->locations = NULL;
+
+    locations = g_settings_get_strv (nautilus_preferences,
+                                     NAUTILUS_PREFERENCES_SEARCH_INDEX_LOCATIONS);
+    for (i = 0; locations[i] != NULL; i++)
+    {
+        manager->locations = g_list_prepend (manager->locations,
+                                             g_file_new_for_commandline_arg (locations[i]));
+    }
+    manager->locations = g_list_reverse (manager->locations);
+
+    update_monitors ();
+
+    if (manager->locations == NULL)
+    {
+        g_unlink (manager->path);
+        return;
+    }
+
+    load_index ();
+}
+
+/**
+ * nautilus_search_engine_index_setup:
+ *
+ * Loads the file name index, and builds it in the background if it is
+ * missing or old, for the folders in the search-index-locations
+ * preference, if any.
+ */
+void
+nautilus_search_engine_index_setup (void)
+{
+    if (manager != NULL)
+    {
+        return;
+    }
+
+    manager = g_new0 (IndexManager, 1);
+    manager->path = g_build_filename (g_get_user_cache_dir (), "nautilus", "filename-index", NULL);
+    manager->added = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                            g_free, (GDestroyNotify) index_change_free);
+    manager->removed = g_hash_table_new_full (g_str_hash, g_str_equal,
+                                              g_free, (GDestroyNotify) index_change_free);
+
+    g_signal_connect_swapped (nautilus_preferences,
+                              "changed::" NAUTILUS_PREFERENCES_SEARCH_INDEX_LOCATIONS,
+                              G_CALLBACK (search_index_locations_changed_callback),
+                              NULL);
+    search_index_locations_changed_callback (NULL);
+}
+
+/**
+ * nautilus_search_engine_index_can_search:
+ * @query: a #NautilusQuery
+ *
+ * Returns: %TRUE if the index has the location of @query, and the engine
+ * can find every file matching it there.
+ */
+gboolean
+nautilus_search_engine_index_can_search (NautilusQuery *query)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GPtrArray) mime_types = NULL;
+    g_autoptr (GPtrArray) date_range = NULL;
+
+    if (query == NULL || manager == NULL || manager->index == NULL)
+    {
+        return FALSE;
+    }
+
+    /* Only the names and modification times are indexed */
+    mime_types = nautilus_query_get_mime_types (query);
+    date_range = nautilus_query_get_date_range (query);
+    if (mime_types->len > 0 ||
+        (date_range != NULL &&
+         nautilus_query_get_search_type (query) == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS))
+    {
+        return FALSE;
+    }
+
+    location = nautilus_query_get_location (query);
+
+    return location != NULL && nautilus_filename_index_has_folder (manager->index, location);
+}
+
+/**
+ * nautilus_search_engine_index_is_fresh:
+ *
+ * Returns: %TRUE if the index was rebuilt recently enough that it finds
+ * the files crawling the indexed folders would, even the ones changed in
+ * subfolders that aren't monitored.
+ */
+gboolean
+nautilus_search_engine_index_is_fresh (void)
+{
+    gint64 age;
+
+    if (manager == NULL || manager->index == NULL)
+    {
+        return FALSE;
+    }
+
+    age = (g_get_real_time () - nautilus_filename_index_get_build_time (manager->index)) / G_USEC_PER_SEC;
+
+    return age >= 0 && age < MAX_FRESH_INDEX_AGE_SECONDS;
+}
+
+/* Searching */
+
+typedef struct
+{
+    NautilusSearchEngineIndex *engine;
+    GCancellable *cancellable;
+
+    NautilusFilenameIndex *index;
+    NautilusQueryMatcher *matcher;
+    GFile *location;
+    gboolean recursive;
+    gboolean show_hidden;
+    GPtrArray *date_range;
+
+    /* GFile, changed since the index was built */
+    GList *added;
+    GList *removed;
+
+    GList *hits;
+} SearchThreadData;
+
+static void
+search_thread_data_free (SearchThreadData *data)
+{
+    g_object_unref (data->engine);
+    g_object_unref (data->cancellable);
+    g_clear_pointer (&data->index, nautilus_filename_index_unref);
+    g_clear_pointer (&data->matcher, nautilus_query_matcher_unref);
+    g_clear_object (&data->location);
+    g_clear_pointer (&data->date_range, g_ptr_array_unref);
+    g_list_free_full (data->added, g_object_unref);
+    g_list_free_full (data->removed, g_object_unref);
+    g_list_free_full (data->hits, g_object_unref);
+    g_free (data);
+}
+
+static GList *
+get_changed_files (GHashTable *changes)
+{
+    GHashTableIter iter;
+    IndexChange *change;
+    GList *files = NULL;
+
+    g_hash_table_iter_init (&iter, changes);
+    while (g_hash_table_iter_next (&iter, NULL, (gpointer *) &change))
+    {
+        files = g_list_prepend (files, g_object_ref (change->file));
+    }
+
+    return files;
+}
+
+static void
+add_hit (GFile    *file,
+         gdouble   rank,
+         guint64   mtime,
+         gpointer  user_data)
+{
+    SearchThreadData *data = user_data;
+    NautilusSearchHit *hit;
+    g_autofree gchar *uri = NULL;
+
+    if (data->date_range != NULL &&
+        !nautilus_file_date_in_between (mtime,
+                                        g_ptr_array_index (data->date_range, 0),
+                                        g_ptr_array_index (data->date_range, 1)))
+    {
+        return;
+    }
+
+    uri = g_file_get_uri (file);
+    hit = nautilus_search_hit_new (uri);
+    nautilus_search_hit_set_fts_rank (hit, rank);
+    nautilus_search_hit_set_modification_time (hit, mtime);
+
+    data->hits = g_list_prepend (data->hits, hit);
+}
+
+static gboolean
+is_hidden_name (const char *name)
+{
+    return name[0] == '.' || g_str_has_suffix (name, "~");
+}
+
+/* Matches the files added since the index was built, which are few */
+static void
+search_added_files (SearchThreadData *data)
+{
+    GList *l;
+
+    for (l = data->added; l != NULL; l = l->next)
+    {
+        g_autofree gchar *relative_path = NULL;
+        g_autofree gchar *basename = NULL;
+        g_autofree gchar *display_name = NULL;
+        g_auto (GStrv) names = NULL;
+        g_autoptr (GFileInfo) info = NULL;
+        gboolean hidden = FALSE;
+        gdouble rank;
+        guint i;
+
+        if (g_cancellable_is_cancelled (data->cancellable))
+        {
+            return;
+        }
+
+        relative_path = g_file_get_relative_path (data->location, l->data);
+        if (relative_path == NULL)
+        {
+            continue;
+        }
+
+        names = g_strsplit (relative_path, G_DIR_SEPARATOR_S, -1);
+        if (!data->recursive && g_strv_length (names) > 1)
+        {
+            continue;
+        }
+        for (i = 0; names[i] != NULL; i++)
+        {
+            hidden |= is_hidden_name (names[i]);
+        }
+        if (hidden && !data->show_hidden)
+        {
+            continue;
+        }
+
+        basename = g_file_get_basename (l->data);
+        display_name = g_filename_display_name (basename);
+        rank = nautilus_query_matcher_match (data->matcher, display_name);
+        if (rank <= -1)
+        {
+            continue;
+        }
+
+        /* Unless it is gone again */
+        info = g_file_query_info (l->data, G_FILE_ATTRIBUTE_TIME_MODIFIED,
+                                  G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
+                                  data->cancellable, NULL);
+        if (info != NULL)
+        {
+            add_hit (l->data, rank,
+                     g_file_info_get_attribute_uint64 (info, G_FILE_ATTRIBUTE_TIME_MODIFIED),
+                     data);
+        }
+    }
+}
+
+static gboolean
+search_thread_done_idle (gpointer user_data)
+{
+    SearchThreadData *data = user_data;
+    NautilusSearchEngineIndex *self = data->engine;
+    NautilusSearchProvider *provider = NAUTILUS_SEARCH_PROVIDER (self);
+
+    if (!g_cancellable_is_cancelled (data->cancellable) && data->hits != NULL)
+    {
+        DEBUG ("Index engine add hits");
+        nautilus_search_provider_hits_added (provider, data->hits);
+    }
+
+    if (self->cancellable == data->cancellable)
+    {
+        g_clear_object (&self->cancellable);
+    }
+    self->running = FALSE;
+
+    nautilus_search_provider_finished (provider, NAUTILUS_SEARCH_PROVIDER_STATUS_NORMAL);
+    g_object_notify (G_OBJECT (provider), "running");
+
+    search_thread_data_free (data);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gpointer
+search_thread_func (gpointer user_data)
+{
+    SearchThreadData *data = user_data;
+    gint64 start_time;
+
+    start_time = g_get_monotonic_time ();
+
+    nautilus_filename_index_search (data->index, data->matcher, data->location,
+                                    data->recursive, data->show_hidden, data->removed,
+                                    data->cancellable, add_hit, data);
+    search_added_files (data);
+
+    DEBUG ("Index engine found %u files in %" G_GINT64_FORMAT " ms",
+           g_list_length (data->hits), (g_get_monotonic_time () - start_time) / 1000);
+
+    g_idle_add (search_thread_done_idle, data);
+
+    return NULL;
+}
+
+static void
+nautilus_search_engine_index_start (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineIndex *self = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+    g_autoptr (GThread) thread = NULL;
+    SearchThreadData *data;
+
+    g_return_if_fail (self->query != NULL);
+    g_return_if_fail (self->cancellable == NULL);
+
+    self->running = TRUE;
+    self->cancellable = g_cancellable_new ();
+
+    data = g_new0 (SearchThreadData, 1);
+    data->engine = g_object_ref (self);
+    data->cancellable = g_object_ref (self->cancellable);
+
+    if (!nautilus_search_engine_index_can_search (self->query))
+    {
+        g_idle_add (search_thread_done_idle, data);
+        g_object_notify (G_OBJECT (provider), "running");
+        return;
+    }
+
+    DEBUG ("Index engine start");
+
+    data->index = nautilus_filename_index_ref (manager->index);
+    data->matcher = nautilus_query_get_matcher (self->query);
+    data->location = nautilus_query_get_location (self->query);
+    data->recursive = is_recursive_search (NAUTILUS_SEARCH_ENGINE_TYPE_INDEXED,
+                                           nautilus_query_get_recursive (self->query),
+                                           data->location);
+    data->show_hidden = nautilus_query_get_show_hidden_files (self->query);
+    data->date_range = nautilus_query_get_date_range (self->query);
+    data->added = get_changed_files (manager->added);
+    data->removed = get_changed_files (manager->removed);
+
+    thread = g_thread_new ("nautilus-search-index", search_thread_func, data);
+
+    g_object_notify (G_OBJECT (provider), "running");
+}
+
+static void
+nautilus_search_engine_index_stop (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineIndex *self = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    if (self->cancellable != NULL)
+    {
+        DEBUG ("Index engine stop");
+        g_cancellable_cancel (self->cancellable);
+    }
+
+    self->running = FALSE;
+}
+
+static void
+nautilus_search_engine_index_set_query (NautilusSearchProvider *provider,
+                                        NautilusQuery          *query)
+{
+    NautilusSearchEngineIndex *self = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    g_clear_object (&self->query);
+    self->query = g_object_ref (query);
+}
+
+static gboolean
+nautilus_search_engine_index_is_running (NautilusSearchProvider *provider)
+{
+    NautilusSearchEngineIndex *self = NAUTILUS_SEARCH_ENGINE_INDEX (provider);
+
+    return self->running;
+}
+
+static void
+nautilus_search_engine_index_finalize (GObject *object)
+{
+    NautilusSearchEngineIndex *self = NAUTILUS_SEARCH_ENGINE_INDEX (object);
+
+    g_clear_object (&self->query);
+    g_clear_object (&self->cancellable);
+
+    G_OBJECT_CLASS (nautilus_search_engine_index_parent_class)->finalize (object);
+}
+
+static void
+nautilus_search_engine_index_get_property (GObject    *object,
+                                           guint       prop_id,
+                                           GValue     *value,
+                                           GParamSpec *pspec)
+{
+    NautilusSearchProvider *provider = NAUTILUS_SEARCH_PROVIDER (object);
+
+    switch (prop_id)
+    {
+        case PROP_RUNNING:
+        {
+            g_value_set_boolean (value, nautilus_search_engine_index_is_running (provider));
+        }
+        break;
+
+        default:
+            G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
+    }
+}
+
+static void
+nautilus_search_provider_init (NautilusSearchProviderInterface *iface)
+{
+    iface->set_query = nautilus_search_engine_index_set_query;
+    iface->start = nautilus_search_engine_index_start;
+    iface->stop = nautilus_search_engine_index_stop;
+    iface->is_running = nautilus_search_engine_index_is_running;
+}
+
+static void
+nautilus_search_engine_index_class_init (NautilusSearchEngineIndexClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+
+    object_class->finalize = nautilus_search_engine_index_finalize;
+    object_class->get_property = nautilus_search_engine_index_get_property;
+
+    g_object_class_override_property (object_class, PROP_RUNNING, "running");
+}
+
+static void
+nautilus_search_engine_index_init (NautilusSearchEngineIndex *self)
+{
+}
+
+NautilusSearchEngineIndex *
+nautilus_search_engine_index_new (void)
+{
+    return g_object_new (NAUTILUS_TYPE_SEARCH_ENGINE_INDEX, NULL);
+}
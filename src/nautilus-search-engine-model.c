@@ -131,6 +131,7 @@ model_directory_ready_cb (NautilusDirectory *directory,
 {
     NautilusSearchEngineModel *model = user_data;
     g_autoptr (GPtrArray) mime_types = NULL;
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
     gchar *uri, *display_name;
     GList *files, *hits, *l;
     NautilusFile *file;
@@ -143,6 +144,7 @@ model_directory_ready_cb (NautilusDirectory *directory,
 
     files = nautilus_directory_get_file_list (directory);
     mime_types = nautilus_query_get_mime_types (model->query);
+    matcher = nautilus_query_get_matcher (model->query);
     hits = NULL;
 
     for (l = files; l != NULL; l = l->next)
@@ -150,7 +152,7 @@ model_directory_ready_cb (NautilusDirectory *directory,
         file = l->data;
 
         display_name = nautilus_file_get_display_name (file);
-        match = nautilus_query_matches_string (model->query, display_name);
+        match = nautilus_query_matcher_match (matcher, display_name);
         found = (match > -1);
 
         if (found && mime_types->len > 0)
@@ -29,3 +29,4 @@ typedef enum {
 } NautilusSearchEngineType;
 
 gboolean is_recursive_search (NautilusSearchEngineType engine_type, NautilusQueryRecursive recursive, GFile *location);
+gboolean is_recursive_search_cached (NautilusSearchEngineType engine_type, NautilusQueryRecursive recursive, GFile *location, const char *filesystem_id, GHashTable *remote_filesystems);
@@ -233,8 +233,6 @@ recent_thread_func (gpointer user_data)
         {
             NautilusSearchHit *hit;
             time_t modified, visited;
-            g_autoptr (GDateTime) gmodified = NULL;
-            g_autoptr (GDateTime) gvisited = NULL;
 
             if (gtk_recent_info_is_local (info))
             {
@@ -281,9 +279,6 @@ recent_thread_func (gpointer user_data)
             modified = gtk_recent_info_get_modified (info);
             visited = gtk_recent_info_get_visited (info);
 
-            gmodified = g_date_time_new_from_unix_local (modified);
-            gvisited = g_date_time_new_from_unix_local (visited);
-
             if (date_range != NULL)
             {
                 NautilusQuerySearchType type;
@@ -306,8 +301,8 @@ recent_thread_func (gpointer user_data)
 
             hit = nautilus_search_hit_new (uri);
             nautilus_search_hit_set_fts_rank (hit, rank);
-            nautilus_search_hit_set_modification_time (hit, gmodified);
-            nautilus_search_hit_set_access_time (hit, gvisited);
+            nautilus_search_hit_set_modification_time (hit, modified);
+            nautilus_search_hit_set_access_time (hit, visited);
 
             hits = g_list_prepend (hits, hit);
         }
@@ -22,7 +22,8 @@
 #include <config.h>
 #include "nautilus-search-engine-simple.h"
 
-#include "nautilus-search-engine-private.h"
+#include "nautilus-query-type-filter.h"
+#include "nautilus-search-crawler.h"
 #include "nautilus-search-hit.h"
 #include "nautilus-search-provider.h"
 #include "nautilus-ui-utilities.h"
@@ -35,6 +36,9 @@
 
 #define BATCH_SIZE 500
 
+/* More crawler threads than this mostly wait on the same disk */
+#define MAX_WORKERS 8
+
 enum
 {
     PROP_0,
@@ -42,37 +46,48 @@ enum
     NUM_PROPERTIES
 };
 
+typedef struct _SearchThreadData SearchThreadData;
+
+/* What each worker of the crawler found */
 typedef struct
 {
-    NautilusSearchEngineSimple *engine;
-    GCancellable *cancellable;
+    SearchThreadData *data;
 
-    GPtrArray *mime_types;
-    GList *found_list;
+    /* Hits not handed to the main thread yet */
+    GList *hits;
+    gint n_processed_files;
+} SearchWorker;
 
-    GQueue *directories;     /* GFiles */
+struct _SearchThreadData
+{
+    NautilusSearchEngineSimple *engine;
+    GCancellable *cancellable;
 
-    GHashTable *visited;
+    NautilusSearchCrawler *crawler;
+    SearchWorker *workers;
 
-    gint n_processed_files;
-    GList *hits;
+    NautilusQueryTypeFilter *type_filter;
+    NautilusQuerySearchType search_type;
+    GPtrArray *date_range;
 
     NautilusQuery *query;
+    NautilusQueryMatcher *matcher;
 
-    gint processing_id;
-    GMutex idle_mutex;
     /* The following data can be accessed from different threads
      * and needs to lock the mutex
      */
+    GMutex idle_mutex;
+    guint processing_id;
     GQueue *idle_queue;
     gboolean finished;
-} SearchThreadData;
+};
 
 
 struct _NautilusSearchEngineSimple
 {
     GObject parent_instance;
     NautilusQuery *query;
+    GList *excluded_locations;
 
     SearchThreadData *active_search;
 };
@@ -90,6 +105,7 @@ finalize (GObject *object)
 {
     NautilusSearchEngineSimple *simple = NAUTILUS_SEARCH_ENGINE_SIMPLE (object);
     g_clear_object (&simple->query);
+    g_list_free_full (simple->excluded_locations, g_object_unref);
 
     G_OBJECT_CLASS (nautilus_search_engine_simple_parent_class)->finalize (object);
 }
@@ -98,23 +114,31 @@ static SearchThreadData *
 search_thread_data_new (NautilusSearchEngineSimple *engine,
                         NautilusQuery              *query)
 {
+    g_autoptr (GPtrArray) mime_types = NULL;
     SearchThreadData *data;
-    GFile *location;
+    guint i;
 
     data = g_new0 (SearchThreadData, 1);
 
     data->engine = g_object_ref (engine);
-    data->directories = g_queue_new ();
-    data->visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
     data->query = g_object_ref (query);
+    data->matcher = nautilus_query_get_matcher (query);
 
-    location = nautilus_query_get_location (query);
-
-    g_queue_push_tail (data->directories, location);
-    data->mime_types = nautilus_query_get_mime_types (query);
+    mime_types = nautilus_query_get_mime_types (query);
+    data->type_filter = nautilus_query_type_filter_new (mime_types);
+    data->search_type = nautilus_query_get_search_type (query);
+    data->date_range = nautilus_query_get_date_range (query);
 
     data->cancellable = g_cancellable_new ();
 
+    data->crawler = nautilus_search_crawler_new (query, MAX_WORKERS, data->cancellable);
+    nautilus_search_crawler_set_excluded_locations (data->crawler, engine->excluded_locations);
+    data->workers = g_new0 (SearchWorker, nautilus_search_crawler_get_n_workers (data->crawler));
+    for (i = 0; i < nautilus_search_crawler_get_n_workers (data->crawler); i++)
+    {
+        data->workers[i].data = data;
+    }
+
     g_mutex_init (&data->idle_mutex);
     data->idle_queue = g_queue_new ();
 
@@ -125,15 +149,20 @@ static void
 search_thread_data_free (SearchThreadData *data)
 {
     GList *hits;
+    guint i;
+
+    for (i = 0; i < nautilus_search_crawler_get_n_workers (data->crawler); i++)
+    {
+        g_list_free_full (data->workers[i].hits, g_object_unref);
+    }
+    g_free (data->workers);
+    nautilus_search_crawler_free (data->crawler);
 
-    g_queue_foreach (data->directories,
-                     (GFunc) g_object_unref, NULL);
-    g_queue_free (data->directories);
-    g_hash_table_destroy (data->visited);
     g_object_unref (data->cancellable);
     g_object_unref (data->query);
-    g_clear_pointer (&data->mime_types, g_ptr_array_unref);
-    g_list_free_full (data->hits, g_object_unref);
+    nautilus_query_matcher_unref (data->matcher);
+    nautilus_query_type_filter_unref (data->type_filter);
+    g_clear_pointer (&data->date_range, g_ptr_array_unref);
     g_object_unref (data->engine);
     g_mutex_clear (&data->idle_mutex);
 
@@ -193,9 +222,9 @@ search_thread_process_idle (gpointer user_data)
     g_mutex_lock (&thread_data->idle_mutex);
     hits = g_queue_pop_head (thread_data->idle_queue);
     /* Even if the cancellable is cancelled, we need to make sure the search
-     * thread has aknowledge it, and therefore not using the thread data after
-     * freeing it. The search thread will mark as finished whenever the search
-     * is finished or cancelled.
+     * threads have aknowledged it, and therefore are not using the thread
+     * data after freeing it. The last search thread to exit marks the
+     * search as finished whenever it is finished or cancelled.
      * Nonetheless, we should stop yielding results if the search was cancelled
      */
     if (thread_data->finished)
@@ -228,14 +257,17 @@ search_thread_process_idle (gpointer user_data)
 static void
 finish_search_thread (SearchThreadData *thread_data)
 {
+    gboolean processing;
+
     g_mutex_lock (&thread_data->idle_mutex);
     thread_data->finished = TRUE;
+    processing = thread_data->processing_id != 0;
     g_mutex_unlock (&thread_data->idle_mutex);
 
     /* If no results were processed, direclty finish the search, in the main
      * thread.
      */
-    if (thread_data->processing_id == 0)
+    if (!processing)
     {
         g_idle_add (G_SOURCE_FUNC (search_thread_done), thread_data);
     }
@@ -249,227 +281,101 @@ process_batch_in_idle (SearchThreadData *thread_data,
 
     g_mutex_lock (&thread_data->idle_mutex);
     g_queue_push_tail (thread_data->idle_queue, hits);
-    g_mutex_unlock (&thread_data->idle_mutex);
-
     if (thread_data->processing_id == 0)
     {
         thread_data->processing_id = g_idle_add (search_thread_process_idle, thread_data);
     }
+    g_mutex_unlock (&thread_data->idle_mutex);
 }
 
 static void
-send_batch_in_idle (SearchThreadData *thread_data)
+send_batch_in_idle (SearchWorker *worker)
 {
-    thread_data->n_processed_files = 0;
+    worker->n_processed_files = 0;
 
-    if (thread_data->hits)
+    if (worker->hits)
     {
-        process_batch_in_idle (thread_data, thread_data->hits);
+        process_batch_in_idle (worker->data, worker->hits);
     }
-    thread_data->hits = NULL;
+    worker->hits = NULL;
 }
 
-#define STD_ATTRIBUTES \
-    G_FILE_ATTRIBUTE_STANDARD_NAME "," \
-    G_FILE_ATTRIBUTE_STANDARD_DISPLAY_NAME "," \
-    G_FILE_ATTRIBUTE_STANDARD_IS_BACKUP "," \
-    G_FILE_ATTRIBUTE_STANDARD_IS_HIDDEN "," \
-    G_FILE_ATTRIBUTE_STANDARD_TYPE "," \
-    G_FILE_ATTRIBUTE_TIME_MODIFIED "," \
-    G_FILE_ATTRIBUTE_TIME_ACCESS "," \
-    G_FILE_ATTRIBUTE_ID_FILE
+/* Called in the crawler threads */
 
 static void
-visit_directory (GFile            *dir,
-                 SearchThreadData *data)
+on_crawler_file (GFile     *child,
+                 GFileInfo *info,
+                 guint      worker_index,
+                 gpointer   user_data)
 {
-    g_autoptr (GPtrArray) date_range = NULL;
-    NautilusQuerySearchType type;
-    NautilusQueryRecursive recursive;
-    GFileEnumerator *enumerator;
-    GFileInfo *info;
-    GFile *child;
-    const char *mime_type, *display_name;
+    SearchThreadData *data = user_data;
+    SearchWorker *worker = &data->workers[worker_index];
+    NautilusSearchHit *hit;
+    g_autofree gchar *uri = NULL;
     gdouble match;
-    gboolean is_hidden, found;
-    const char *id;
-    gboolean visited;
-    guint64 atime;
+    gboolean found;
     guint64 mtime;
-    GDateTime *initial_date;
-    GDateTime *end_date;
-    gchar *uri;
-
-    enumerator = g_file_enumerate_children (dir,
-                                            data->mime_types->len > 0 ?
-                                            STD_ATTRIBUTES ","
-                                            G_FILE_ATTRIBUTE_STANDARD_CONTENT_TYPE
-                                            :
-                                            STD_ATTRIBUTES
-                                            ,
-                                            G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS,
-                                            data->cancellable, NULL);
-
-    if (enumerator == NULL)
-    {
-        return;
-    }
+    guint64 time;
 
-    type = nautilus_query_get_search_type (data->query);
-    recursive = nautilus_query_get_recursive (data->query);
-    date_range = nautilus_query_get_date_range (data->query);
+    match = nautilus_query_matcher_match (data->matcher, g_file_info_get_display_name (info));
+    found = (match > -1);
 
-    while ((info = g_file_enumerator_next_file (enumerator, data->cancellable, NULL)) != NULL)
+    if (found && !nautilus_query_type_filter_is_empty (data->type_filter))
     {
-        display_name = g_file_info_get_display_name (info);
-        if (display_name == NULL)
-        {
-            goto next;
-        }
-
-        is_hidden = g_file_info_get_is_hidden (info) || g_file_info_get_is_backup (info);
-        if (is_hidden && !nautilus_query_get_show_hidden_files (data->query))
-        {
-            goto next;
-        }
-
-        child = g_file_get_child (dir, g_file_info_get_name (info));
-        match = nautilus_query_matches_string (data->query, display_name);
-        found = (match > -1);
-
-        if (found && data->mime_types->len > 0)
-        {
-            mime_type = g_file_info_get_content_type (info);
-            found = FALSE;
-
-            for (gint i = 0; i < data->mime_types->len; i++)
-            {
-                if (g_content_type_is_a (mime_type, g_ptr_array_index (data->mime_types, i)))
-                {
-                    found = TRUE;
-                    break;
-                }
-            }
-        }
-
-        mtime = g_file_info_get_attribute_uint64 (info, "time::modified");
-        atime = g_file_info_get_attribute_uint64 (info, "time::access");
-
-        if (found && date_range != NULL)
-        {
-            guint64 current_file_time;
-
-            initial_date = g_ptr_array_index (date_range, 0);
-            end_date = g_ptr_array_index (date_range, 1);
-
-            if (type == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS)
-            {
-                current_file_time = atime;
-            }
-            else
-            {
-                current_file_time = mtime;
-            }
-            found = nautilus_file_date_in_between (current_file_time,
-                                                   initial_date,
-                                                   end_date);
-        }
+        found = nautilus_query_type_filter_match_file (data->type_filter, child, info,
+                                                       data->cancellable);
+    }
 
-        if (found)
-        {
-            NautilusSearchHit *hit;
-            GDateTime *date;
-
-            uri = g_file_get_uri (child);
-            hit = nautilus_search_hit_new (uri);
-            g_free (uri);
-            nautilus_search_hit_set_fts_rank (hit, match);
-            date = g_date_time_new_from_unix_local (mtime);
-            nautilus_search_hit_set_modification_time (hit, date);
-            g_date_time_unref (date);
-
-            data->hits = g_list_prepend (data->hits, hit);
-        }
+    mtime = g_file_info_get_attribute_uint64 (info, "time::modified");
 
-        data->n_processed_files++;
-        if (data->n_processed_files > BATCH_SIZE)
+    if (found && data->date_range != NULL)
+    {
+        if (data->search_type == NAUTILUS_QUERY_SEARCH_TYPE_LAST_ACCESS)
         {
-            send_batch_in_idle (data);
+            time = g_file_info_get_attribute_uint64 (info, "time::access");
         }
-
-        if (recursive != NAUTILUS_QUERY_RECURSIVE_NEVER &&
-            g_file_info_get_file_type (info) == G_FILE_TYPE_DIRECTORY &&
-            is_recursive_search (NAUTILUS_SEARCH_ENGINE_TYPE_NON_INDEXED,
-                                 recursive, child))
+        else
         {
-            id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
-            visited = FALSE;
-            if (id)
-            {
-                if (g_hash_table_lookup_extended (data->visited,
-                                                  id, NULL, NULL))
-                {
-                    visited = TRUE;
-                }
-                else
-                {
-                    g_hash_table_insert (data->visited, g_strdup (id), NULL);
-                }
-            }
-
-            if (!visited)
-            {
-                g_queue_push_tail (data->directories, g_object_ref (child));
-            }
+            time = mtime;
         }
-
-        g_object_unref (child);
-next:
-        g_object_unref (info);
+        found = nautilus_file_date_in_between (time,
+                                               g_ptr_array_index (data->date_range, 0),
+                                               g_ptr_array_index (data->date_range, 1));
     }
 
-    g_object_unref (enumerator);
-}
-
-
-static gpointer
-search_thread_func (gpointer user_data)
-{
-    SearchThreadData *data;
-    GFile *dir;
-    GFileInfo *info;
-    const char *id;
-
-    data = user_data;
-
-    /* Insert id for toplevel directory into visited */
-    dir = g_queue_peek_head (data->directories);
-    info = g_file_query_info (dir, G_FILE_ATTRIBUTE_ID_FILE, 0, data->cancellable, NULL);
-    if (info)
+    if (found)
     {
-        id = g_file_info_get_attribute_string (info, G_FILE_ATTRIBUTE_ID_FILE);
-        if (id)
-        {
-            g_hash_table_insert (data->visited, g_strdup (id), NULL);
-        }
-        g_object_unref (info);
+        uri = g_file_get_uri (child);
+        hit = nautilus_search_hit_new (uri);
+        nautilus_search_hit_set_fts_rank (hit, match);
+        nautilus_search_hit_set_modification_time (hit, mtime);
+
+        worker->hits = g_list_prepend (worker->hits, hit);
     }
 
-    while (!g_cancellable_is_cancelled (data->cancellable) &&
-           (dir = g_queue_pop_head (data->directories)) != NULL)
+    worker->n_processed_files++;
+    if (worker->n_processed_files > BATCH_SIZE)
     {
-        visit_directory (dir, data);
-        g_object_unref (dir);
+        send_batch_in_idle (worker);
     }
+}
+
+static void
+on_crawler_idle (guint    worker_index,
+                 gpointer user_data)
+{
+    SearchThreadData *data = user_data;
 
     if (!g_cancellable_is_cancelled (data->cancellable))
     {
-        send_batch_in_idle (data);
+        send_batch_in_idle (&data->workers[worker_index]);
     }
+}
 
-    finish_search_thread (data);
-
-    return NULL;
+static void
+on_crawler_done (gpointer user_data)
+{
+    finish_search_thread (user_data);
 }
 
 static void
@@ -477,7 +383,6 @@ nautilus_search_engine_simple_start (NautilusSearchProvider *provider)
 {
     NautilusSearchEngineSimple *simple;
     SearchThreadData *data;
-    GThread *thread;
 
     simple = NAUTILUS_SEARCH_ENGINE_SIMPLE (provider);
 
@@ -489,13 +394,12 @@ nautilus_search_engine_simple_start (NautilusSearchProvider *provider)
     DEBUG ("Simple engine start");
 
     data = search_thread_data_new (simple, simple->query);
-
-    thread = g_thread_new ("nautilus-search-simple", search_thread_func, data);
     simple->active_search = data;
 
-    g_object_notify (G_OBJECT (provider), "running");
+    nautilus_search_crawler_start (data->crawler, on_crawler_file, on_crawler_idle,
+                                   on_crawler_done, data);
 
-    g_thread_unref (thread);
+    g_object_notify (G_OBJECT (provider), "running");
 }
 
 static void
@@ -582,6 +486,23 @@ nautilus_search_engine_simple_init (NautilusSearchEngineSimple *engine)
     engine->active_search = NULL;
 }
 
+/**
+ * nautilus_search_engine_simple_set_excluded_locations:
+ * @engine: a #NautilusSearchEngineSimple
+ * @locations: (element-type GFile): folders not to search, with their
+ * subfolders
+ *
+ * Makes the next searches leave out folders that other engines search
+ * already, such as the ones Tracker indexes.
+ */
+void
+nautilus_search_engine_simple_set_excluded_locations (NautilusSearchEngineSimple *engine,
+                                                      GList                      *locations)
+{
+    g_list_free_full (engine->excluded_locations, g_object_unref);
+    engine->excluded_locations = g_list_copy_deep (locations, (GCopyFunc) g_object_ref, NULL);
+}
+
 NautilusSearchEngineSimple *
 nautilus_search_engine_simple_new (void)
 {
@@ -31,4 +31,7 @@ G_DECLARE_FINAL_TYPE (NautilusSearchEngineSimple, nautilus_search_engine_simple,
 
 NautilusSearchEngineSimple* nautilus_search_engine_simple_new (void);
 
+void nautilus_search_engine_simple_set_excluded_locations (NautilusSearchEngineSimple *engine,
+                                                           GList                      *locations);
+
 G_END_DECLS
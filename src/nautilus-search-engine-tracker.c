@@ -41,7 +41,16 @@ struct _NautilusSearchEngineTracker
     NautilusQuery *query;
 
     gboolean query_pending;
-    GQueue *hits_pending;
+
+    /* The statement of the running search, its prepared statements by
+     * SPARQL text, and the rank and URL of the last row of the last page,
+     * which the next page starts after */
+    TrackerSparqlStatement *statement;
+    GHashTable *statements;
+    NautilusQueryMatcher *matcher;
+    gdouble last_rank;
+    gchar *last_url;
+    gint page_size;
 
     gboolean recursive;
     gboolean fts_enabled;
@@ -78,38 +87,27 @@ finalize (GObject *object)
     }
 
     g_clear_object (&tracker->query);
-    g_queue_free_full (tracker->hits_pending, g_object_unref);
+    g_clear_object (&tracker->statement);
+    g_hash_table_destroy (tracker->statements);
+    g_clear_pointer (&tracker->last_url, g_free);
+    g_clear_pointer (&tracker->matcher, nautilus_query_matcher_unref);
     /* This is a singleton, no need to unref. */
     tracker->connection = NULL;
 
     G_OBJECT_CLASS (nautilus_search_engine_tracker_parent_class)->finalize (object);
 }
 
-#define BATCH_SIZE 100
-
-static void
-check_pending_hits (NautilusSearchEngineTracker *tracker,
-                    gboolean                     force_send)
-{
-    GList *hits = NULL;
-    NautilusSearchHit *hit;
-
-    DEBUG ("Tracker engine add hits");
-
-    if (!force_send &&
-        g_queue_get_length (tracker->hits_pending) < BATCH_SIZE)
-    {
-        return;
-    }
-
-    while ((hit = g_queue_pop_head (tracker->hits_pending)))
-    {
-        hits = g_list_prepend (hits, hit);
-    }
+/* The first page of results is small, for the first hits to show up
+ * quickly. Each page after it is twice as large as the one before, so
+ * that searches with many results take few queries, each of which has
+ * Tracker rank all the matches left.
+ */
+#define FIRST_PAGE_SIZE 50
+#define MAX_PAGE_SIZE (1 << 20)
 
-    nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (tracker), hits);
-    g_list_free_full (hits, g_object_unref);
-}
+/* Statements are kept by SPARQL text, which only changes with the options
+ * of the query, not with its text or location */
+#define MAX_CACHED_STATEMENTS 8
 
 static void
 search_finished (NautilusSearchEngineTracker *tracker,
@@ -117,17 +115,10 @@ search_finished (NautilusSearchEngineTracker *tracker,
 {
     DEBUG ("Tracker engine finished");
 
-    if (error == NULL)
-    {
-        check_pending_hits (tracker, TRUE);
-    }
-    else
-    {
-        g_queue_foreach (tracker->hits_pending, (GFunc) g_object_unref, NULL);
-        g_queue_clear (tracker->hits_pending);
-    }
-
     tracker->query_pending = FALSE;
+    g_clear_object (&tracker->statement);
+    g_clear_pointer (&tracker->matcher, nautilus_query_matcher_unref);
+    g_clear_pointer (&tracker->last_url, g_free);
 
     g_object_notify (G_OBJECT (tracker), "running");
 
@@ -153,77 +144,77 @@ search_finished (NautilusSearchEngineTracker *tracker,
     g_object_unref (tracker);
 }
 
-static void cursor_callback (GObject      *object,
-                             GAsyncResult *result,
-                             gpointer      user_data);
+typedef struct
+{
+    NautilusSearchEngineTracker *tracker;
+    GCancellable *cancellable;
+    NautilusQueryMatcher *matcher;
+    gboolean fts_enabled;
 
-static void
-cursor_next (NautilusSearchEngineTracker *tracker,
-             TrackerSparqlCursor         *cursor)
+    TrackerSparqlCursor *cursor;
+    GList *hits;
+    gint n_rows;
+    gdouble last_rank;
+    gchar *last_url;
+} PageData;
+
+static PageData *
+page_data_new (NautilusSearchEngineTracker *tracker)
 {
-    tracker_sparql_cursor_next_async (cursor,
-                                      tracker->cancellable,
-                                      cursor_callback,
-                                      tracker);
+    PageData *data;
+
+    data = g_new0 (PageData, 1);
+    data->tracker = tracker;
+    data->cancellable = g_object_ref (tracker->cancellable);
+    data->matcher = nautilus_query_matcher_ref (tracker->matcher);
+    data->fts_enabled = tracker->fts_enabled;
+
+    return data;
 }
 
 static void
-cursor_callback (GObject      *object,
-                 GAsyncResult *result,
-                 gpointer      user_data)
+page_data_free (PageData *data)
+{
+    g_clear_object (&data->cancellable);
+    g_clear_pointer (&data->matcher, nautilus_query_matcher_unref);
+    g_clear_object (&data->cursor);
+    g_list_free_full (data->hits, g_object_unref);
+    g_free (data->last_url);
+
+    g_free (data);
+}
+
+static NautilusSearchHit *
+create_hit (PageData *data)
 {
-    NautilusSearchEngineTracker *tracker;
-    GError *error = NULL;
-    TrackerSparqlCursor *cursor;
     NautilusSearchHit *hit;
     const char *uri;
     const char *mtime_str;
     const char *atime_str;
     const gchar *snippet;
+    g_autofree gchar *basename = NULL;
     GTimeVal tv;
     gdouble rank, match;
-    gboolean success;
-    gchar *basename;
-
-    tracker = NAUTILUS_SEARCH_ENGINE_TRACKER (user_data);
-
-    cursor = TRACKER_SPARQL_CURSOR (object);
-    success = tracker_sparql_cursor_next_finish (cursor, result, &error);
-
-    if (!success)
-    {
-        search_finished (tracker, error);
-
-        g_clear_error (&error);
-        g_clear_object (&cursor);
-
-        return;
-    }
 
-    /* We iterate result by result, not n at a time. */
-    uri = tracker_sparql_cursor_get_string (cursor, 0, NULL);
-    rank = tracker_sparql_cursor_get_double (cursor, 1);
-    mtime_str = tracker_sparql_cursor_get_string (cursor, 2, NULL);
-    atime_str = tracker_sparql_cursor_get_string (cursor, 3, NULL);
+    uri = tracker_sparql_cursor_get_string (data->cursor, 0, NULL);
+    rank = tracker_sparql_cursor_get_double (data->cursor, 1);
+    mtime_str = tracker_sparql_cursor_get_string (data->cursor, 2, NULL);
+    atime_str = tracker_sparql_cursor_get_string (data->cursor, 3, NULL);
     basename = g_path_get_basename (uri);
 
     hit = nautilus_search_hit_new (uri);
-    match = nautilus_query_matches_string (tracker->query, basename);
+    match = nautilus_query_matcher_match (data->matcher, basename);
     nautilus_search_hit_set_fts_rank (hit, rank + match);
-    g_free (basename);
 
-    if (tracker->fts_enabled)
+    if (data->fts_enabled)
     {
-        snippet = tracker_sparql_cursor_get_string (cursor, 4, NULL);
+        snippet = tracker_sparql_cursor_get_string (data->cursor, 4, NULL);
         nautilus_search_hit_set_fts_snippet (hit, snippet);
     }
 
     if (g_time_val_from_iso8601 (mtime_str, &tv))
     {
-        GDateTime *date;
-        date = g_date_time_new_from_timeval_local (&tv);
-        nautilus_search_hit_set_modification_time (hit, date);
-        g_date_time_unref (date);
+        nautilus_search_hit_set_modification_time (hit, tv.tv_sec);
     }
     else
     {
@@ -231,49 +222,161 @@ cursor_callback (GObject      *object,
     }
     if (g_time_val_from_iso8601 (atime_str, &tv))
     {
-        GDateTime *date;
-        date = g_date_time_new_from_timeval_local (&tv);
-        nautilus_search_hit_set_access_time (hit, date);
-        g_date_time_unref (date);
+        nautilus_search_hit_set_access_time (hit, tv.tv_sec);
     }
     else
     {
         g_warning ("unable to parse atime: %s", atime_str);
     }
 
-    g_queue_push_head (tracker->hits_pending, hit);
-    check_pending_hits (tracker, FALSE);
-
-    /* Get next */
-    cursor_next (tracker, cursor);
+    return hit;
 }
 
+/* Reads a whole page of results, rather than a result per main loop
+ * iteration, to hand its hits over at once */
 static void
-query_callback (GObject      *object,
-                GAsyncResult *result,
-                gpointer      user_data)
+read_page_thread (GTask        *task,
+                  gpointer      source_object,
+                  gpointer      task_data,
+                  GCancellable *cancellable)
 {
-    NautilusSearchEngineTracker *tracker;
-    TrackerSparqlConnection *connection;
-    TrackerSparqlCursor *cursor;
+    PageData *data = task_data;
     GError *error = NULL;
 
-    tracker = NAUTILUS_SEARCH_ENGINE_TRACKER (user_data);
+    while (tracker_sparql_cursor_next (data->cursor, cancellable, &error))
+    {
+        data->hits = g_list_prepend (data->hits, create_hit (data));
+        data->n_rows++;
+
+        g_free (data->last_url);
+        data->last_url = g_strdup (tracker_sparql_cursor_get_string (data->cursor, 0, NULL));
+        data->last_rank = tracker_sparql_cursor_get_double (data->cursor, 1);
+    }
 
-    connection = TRACKER_SPARQL_CONNECTION (object);
-    cursor = tracker_sparql_connection_query_finish (connection,
-                                                     result,
-                                                     &error);
+    tracker_sparql_cursor_close (data->cursor);
 
     if (error != NULL)
+    {
+        g_task_return_error (task, error);
+    }
+    else
+    {
+        g_task_return_boolean (task, TRUE);
+    }
+}
+
+static void fetch_page (NautilusSearchEngineTracker *tracker);
+
+static void
+on_page_read (GObject      *source_object,
+              GAsyncResult *result,
+              gpointer      user_data)
+{
+    NautilusSearchEngineTracker *tracker;
+    PageData *data;
+    g_autoptr (GError) error = NULL;
+
+    tracker = NAUTILUS_SEARCH_ENGINE_TRACKER (source_object);
+    data = g_task_get_task_data (G_TASK (result));
+
+    if (!g_task_propagate_boolean (G_TASK (result), &error))
     {
         search_finished (tracker, error);
+        return;
+    }
+
+    DEBUG ("Tracker engine add %d hits", data->n_rows);
+
+    if (data->hits != NULL)
+    {
+        data->hits = g_list_reverse (data->hits);
+        nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (tracker), data->hits);
+    }
+
+    if (data->n_rows < tracker->page_size)
+    {
+        search_finished (tracker, NULL);
+        return;
+    }
+
+    tracker->last_rank = data->last_rank;
+    g_free (tracker->last_url);
+    tracker->last_url = g_steal_pointer (&data->last_url);
+    tracker->page_size = MIN (tracker->page_size * 2, MAX_PAGE_SIZE);
+    fetch_page (tracker);
+}
+
+static void
+on_statement_executed (GObject      *object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+    PageData *data = user_data;
+    g_autoptr (GTask) task = NULL;
+    GError *error = NULL;
+
+    data->cursor = tracker_sparql_statement_execute_finish (TRACKER_SPARQL_STATEMENT (object),
+                                                            result,
+                                                            &error);
+    if (data->cursor == NULL)
+    {
+        search_finished (data->tracker, error);
         g_error_free (error);
+        page_data_free (data);
+        return;
     }
-    else
+
+    task = g_task_new (data->tracker, data->cancellable, on_page_read, NULL);
+    g_task_set_source_tag (task, on_statement_executed);
+    g_task_set_task_data (task, data, (GDestroyNotify) page_data_free);
+    g_task_run_in_thread (task, read_page_thread);
+}
+
+static void
+fetch_page (NautilusSearchEngineTracker *tracker)
+{
+    DEBUG ("Tracker engine fetch %d results after %s", tracker->page_size, tracker->last_url);
+
+    tracker_sparql_statement_bind_double (tracker->statement, "lastRank", tracker->last_rank);
+    tracker_sparql_statement_bind_string (tracker->statement, "lastUrl", tracker->last_url);
+    tracker_sparql_statement_bind_int (tracker->statement, "limit", tracker->page_size);
+
+    tracker_sparql_statement_execute_async (tracker->statement,
+                                            tracker->cancellable,
+                                            on_statement_executed,
+                                            page_data_new (tracker));
+}
+
+static TrackerSparqlStatement *
+get_statement (NautilusSearchEngineTracker  *tracker,
+               const gchar                  *sparql,
+               GError                      **error)
+{
+    TrackerSparqlStatement *statement;
+
+    statement = g_hash_table_lookup (tracker->statements, sparql);
+    if (statement != NULL)
+    {
+        tracker_sparql_statement_clear_bindings (statement);
+        return g_object_ref (statement);
+    }
+
+    statement = tracker_sparql_connection_query_statement (tracker->connection,
+                                                           sparql,
+                                                           NULL,
+                                                           error);
+    if (statement == NULL)
     {
-        cursor_next (tracker, cursor);
+        return NULL;
     }
+
+    if (g_hash_table_size (tracker->statements) >= MAX_CACHED_STATEMENTS)
+    {
+        g_hash_table_remove_all (tracker->statements);
+    }
+    g_hash_table_insert (tracker->statements, g_strdup (sparql), g_object_ref (statement));
+
+    return statement;
 }
 
 static gboolean
@@ -298,8 +401,14 @@ static void
 nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
 {
     NautilusSearchEngineTracker *tracker;
-    gchar *query_text, *search_text, *location_uri, *downcase;
-    GFile *location;
+    g_autofree gchar *query_text = NULL;
+    g_autofree gchar *search_text = NULL;
+    g_autofree gchar *filename_text = NULL;
+    g_autofree gchar *location_uri = NULL;
+    g_autofree gchar *match_text = NULL;
+    g_autofree gchar *location_prefix = NULL;
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GError) error = NULL;
     GString *sparql;
     g_autoptr (GPtrArray) mimetypes = NULL;
     GPtrArray *date_range;
@@ -326,18 +435,17 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
     tracker->fts_enabled = nautilus_query_get_search_content (tracker->query);
 
     query_text = nautilus_query_get_text (tracker->query);
-    downcase = g_utf8_strdown (query_text, -1);
-    search_text = tracker_sparql_escape_string (downcase);
-    g_free (query_text);
-    g_free (downcase);
+    search_text = g_utf8_strdown (query_text, -1);
 
     location = nautilus_query_get_location (tracker->query);
-    location_uri = location ? g_file_get_uri (location) : NULL;
+    location_uri = location ? g_file_get_uri (location) : g_strdup ("");
     mimetypes = nautilus_query_get_mime_types (tracker->query);
 
+    /* The text and location of the query are bound as parameters, so that
+     * typing reuses the same statement */
     sparql = g_string_new ("SELECT DISTINCT"
                            " ?url"
-                           " xsd:double(COALESCE(?rank2, ?rank1)) AS ?rank"
+                           " ?rank"
                            " nfo:fileLastModified(?file)"
                            " nfo:fileLastAccessed(?file)");
 
@@ -371,35 +479,35 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
     if (tracker->fts_enabled && *search_text)
     {
         /* Use fts:match only for content search to not lose some filename results due to stop words. */
-        g_string_append_printf (sparql,
-                                " { "
-                                " ?content nie:isStoredAs ?file ."
-                                " ?content fts:match \"%s*\" ."
-                                " BIND(fts:rank(?content) AS ?rank1) ."
-                                " } UNION",
-                                search_text);
+        g_string_append (sparql,
+                         " { "
+                         " ?content nie:isStoredAs ?file ."
+                         " ?content fts:match ~match ."
+                         " BIND(fts:rank(?content) AS ?rank1) ."
+                         " } UNION");
     }
 
-    g_string_append_printf (sparql,
-                            " {"
-                            " ?file nfo:fileName ?filename ."
-                            " FILTER(fn:contains(fn:lower-case(?filename), '%s')) ."
-                            " BIND(" FILENAME_RANK " AS ?rank2) ."
-                            " }",
-                            search_text);
+    g_string_append (sparql,
+                     " {"
+                     " ?file nfo:fileName ?filename ."
+                     " FILTER(fn:contains(tracker:normalize(fn:lower-case(?filename), 'nfd'), ~text)) ."
+                     " BIND(" FILENAME_RANK " AS ?rank2) ."
+                     " }");
 
-    g_string_append_printf (sparql, " . FILTER( ");
+    /* Bound in the pattern, rather than selected, for pages to be filtered
+     * by it */
+    g_string_append (sparql, " . BIND(xsd:double(COALESCE(?rank2, ?rank1)) AS ?rank) FILTER( ");
 
     if (!tracker->recursive)
     {
-        g_string_append_printf (sparql, "tracker:uri-is-parent('%s', ?url)", location_uri);
+        g_string_append (sparql, "tracker:uri-is-parent(~location, ?url)");
     }
     else
     {
         /* STRSTARTS is faster than tracker:uri-is-descendant().
          * See https://gitlab.gnome.org/GNOME/tracker/-/issues/243
          */
-        g_string_append_printf (sparql, "STRSTARTS(?url, '%s/')", location_uri);
+        g_string_append (sparql, "STRSTARTS(?url, ~locationPrefix)");
     }
 
     date_range = nautilus_query_get_date_range (tracker->query);
@@ -438,6 +546,7 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
 
         g_free (initial_date_format);
         g_free (end_date_format);
+        g_date_time_unref (shifted_end_date);
         g_ptr_array_unref (date_range);
     }
 
@@ -458,19 +567,51 @@ nautilus_search_engine_tracker_start (NautilusSearchProvider *provider)
         g_string_append (sparql, ")\n");
     }
 
-    g_string_append (sparql, ")} ORDER BY DESC (?rank)");
+    /* The best hits come first, for the provider to keep the top ones
+     * early. The URL breaks ties, so that each page can start right after
+     * the last row of the one before, instead of making Tracker skip the
+     * rows of all the pages before with OFFSET. */
+    g_string_append (sparql,
+                     " && (?rank < ~lastRank || (?rank = ~lastRank && ?url > ~lastUrl))"
+                     ")} ORDER BY DESC(?rank) ?url LIMIT ~limit");
 
-    tracker->cancellable = g_cancellable_new ();
-    tracker_sparql_connection_query_async (tracker->connection,
-                                           sparql->str,
-                                           tracker->cancellable,
-                                           query_callback,
-                                           tracker);
+    tracker->statement = get_statement (tracker, sparql->str, &error);
     g_string_free (sparql, TRUE);
 
-    g_free (search_text);
-    g_free (location_uri);
-    g_object_unref (location);
+    if (tracker->statement == NULL)
+    {
+        g_warning ("Unable to prepare the Tracker search query: %s", error->message);
+        g_idle_add (search_finished_idle, provider);
+        return;
+    }
+
+    location_prefix = g_strconcat (location_uri, "/", NULL);
+    match_text = g_strconcat (search_text, "*", NULL);
+    /* Prepared like the names are, and the way other engines compare them */
+    filename_text = nautilus_query_matcher_prepare_string (query_text);
+
+    tracker_sparql_statement_bind_string (tracker->statement, "text", filename_text);
+    if (!tracker->recursive)
+    {
+        tracker_sparql_statement_bind_string (tracker->statement, "location", location_uri);
+    }
+    else
+    {
+        tracker_sparql_statement_bind_string (tracker->statement, "locationPrefix", location_prefix);
+    }
+    if (tracker->fts_enabled && *search_text)
+    {
+        tracker_sparql_statement_bind_string (tracker->statement, "match", match_text);
+    }
+
+    tracker->matcher = nautilus_query_get_matcher (tracker->query);
+    /* Before any row */
+    tracker->last_rank = G_MAXDOUBLE;
+    tracker->last_url = g_strdup ("");
+    tracker->page_size = FIRST_PAGE_SIZE;
+
+    tracker->cancellable = g_cancellable_new ();
+    fetch_page (tracker);
 }
 
 static void
@@ -571,7 +712,7 @@ nautilus_search_engine_tracker_init (NautilusSearchEngineTracker *engine)
 {
     GError *error = NULL;
 
-    engine->hits_pending = g_queue_new ();
+    engine->statements = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
 
     engine->connection = nautilus_tracker_get_miner_fs_connection (&error);
     if (error)
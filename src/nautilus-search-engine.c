@@ -24,6 +24,8 @@
 #include "nautilus-search-engine-private.h"
 
 #include "nautilus-file-utilities.h"
+#include "nautilus-search-engine-content.h"
+#include "nautilus-search-engine-index.h"
 #include "nautilus-search-engine-model.h"
 #include <glib/gi18n.h>
 #define DEBUG_FLAG NAUTILUS_DEBUG_SEARCH
@@ -31,6 +33,11 @@
 #include "nautilus-search-engine-recent.h"
 #include "nautilus-search-engine-simple.h"
 #include "nautilus-search-engine-tracker.h"
+#include "nautilus-search-hit.h"
+#include "nautilus-tracker-utilities.h"
+
+/* How long providers may look for better hits once enough are found */
+#define BEST_HITS_GRACE_PERIOD_MS 300
 
 typedef struct
 {
@@ -38,7 +45,20 @@ typedef struct
     NautilusSearchEngineRecent *recent;
     NautilusSearchEngineSimple *simple;
     NautilusSearchEngineModel *model;
+    NautilusSearchEngineIndex *index;
+    NautilusSearchEngineContent *content;
+
+    NautilusQuery *query;
+
+    /* With a maximum number of results, the best hits so far, in a min-heap
+     * by relevance, instead of passing every hit on */
+    guint max_results;
+    GPtrArray *best_hits;
+    NautilusSearchHitScoring scoring;
+    guint best_hits_timeout_id;
 
+    /* The hits passed on, or kept, by the URIs they own, so that they are
+     * not copied */
     GHashTable *uris;
     guint providers_running;
     guint providers_finished;
@@ -80,6 +100,18 @@ nautilus_search_engine_set_query (NautilusSearchProvider *provider,
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->recent), query);
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->model), query);
     nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->simple), query);
+    nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->index), query);
+    nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (priv->content), query);
+
+    g_set_object (&priv->query, query);
+}
+
+static void
+clear_best_hits (NautilusSearchEnginePrivate *priv)
+{
+    g_ptr_array_set_size (priv->best_hits, 0);
+    nautilus_search_hit_scoring_clear (&priv->scoring);
+    g_clear_handle_id (&priv->best_hits_timeout_id, g_source_remove);
 }
 
 static void
@@ -89,6 +121,12 @@ search_engine_start_real_setup (NautilusSearchEngine *engine)
 
     priv = nautilus_search_engine_get_instance_private (engine);
 
+    clear_best_hits (priv);
+    if (priv->max_results > 0)
+    {
+        nautilus_search_hit_scoring_init (&priv->scoring, priv->query);
+    }
+
     priv->providers_running = 0;
     priv->providers_finished = 0;
     priv->providers_error = 0;
@@ -135,17 +173,91 @@ search_engine_start_real_model (NautilusSearchEngine *engine)
     }
 }
 
+/* Returns the folders Tracker searches fully for the current query, which
+ * the simple engine needn't crawl when Tracker runs too */
+static GList *
+get_tracker_locations (NautilusSearchEnginePrivate *priv)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    g_autoptr (GPtrArray) mime_types = NULL;
+    g_autoptr (GPtrArray) date_range = NULL;
+
+    /* Tracker doesn't index hidden files */
+    if (nautilus_query_get_show_hidden_files (priv->query))
+    {
+        return NULL;
+    }
+
+    /* Tracker looks for the whole text in file names, and crawling for each
+     * word, which is the same only for a single word. Types and dates are
+     * told apart differently too. */
+    matcher = nautilus_query_get_matcher (priv->query);
+    mime_types = nautilus_query_get_mime_types (priv->query);
+    date_range = nautilus_query_get_date_range (priv->query);
+    if (nautilus_query_matcher_get_n_words (matcher) != 1 ||
+        mime_types->len > 0 || date_range != NULL)
+    {
+        return NULL;
+    }
+
+    /* Files Tracker ignores, or hasn't indexed yet, are only found by
+     * crawling */
+    if (!nautilus_tracker_is_index_complete ())
+    {
+        return NULL;
+    }
+
+    location = nautilus_query_get_location (priv->query);
+    if (location == NULL ||
+        !is_recursive_search (NAUTILUS_SEARCH_ENGINE_TYPE_INDEXED,
+                              nautilus_query_get_recursive (priv->query),
+                              location))
+    {
+        return NULL;
+    }
+
+    return nautilus_tracker_get_indexed_locations ();
+}
+
 static void
-search_engine_start_real_simple (NautilusSearchEngine *engine)
+search_engine_start_real_simple (NautilusSearchEngine *engine,
+                                 GList                *excluded_locations)
 {
     NautilusSearchEnginePrivate *priv;
 
     priv = nautilus_search_engine_get_instance_private (engine);
     priv->providers_running++;
 
+    nautilus_search_engine_simple_set_excluded_locations (priv->simple, excluded_locations);
+
     nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->simple));
 }
 
+static void
+search_engine_start_real_index (NautilusSearchEngine *engine)
+{
+    NautilusSearchEnginePrivate *priv;
+
+    priv = nautilus_search_engine_get_instance_private (engine);
+    priv->providers_running++;
+
+    nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->index));
+}
+
+static void
+search_engine_start_real_content (NautilusSearchEngine *engine)
+{
+    NautilusSearchEnginePrivate *priv;
+
+    priv = nautilus_search_engine_get_instance_private (engine);
+    if (nautilus_search_engine_content_can_search (priv->query))
+    {
+        priv->providers_running++;
+        nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (priv->content));
+    }
+}
+
 static void
 search_engine_start_real (NautilusSearchEngine       *engine,
                           NautilusSearchEngineTarget  target_engine)
@@ -174,17 +286,54 @@ search_engine_start_real (NautilusSearchEngine       *engine,
 
         case NAUTILUS_SEARCH_ENGINE_SIMPLE_ENGINE:
         {
-            search_engine_start_real_simple (engine);
+            search_engine_start_real_simple (engine, NULL);
+        }
+        break;
+
+        case NAUTILUS_SEARCH_ENGINE_INDEX_ENGINE:
+        {
+            search_engine_start_real_index (engine);
+        }
+        break;
+
+        case NAUTILUS_SEARCH_ENGINE_CONTENT_ENGINE:
+        {
+            search_engine_start_real_content (engine);
         }
         break;
 
         case NAUTILUS_SEARCH_ENGINE_ALL_ENGINES:
         default:
         {
+            NautilusSearchEnginePrivate *priv;
+            gboolean index_can_search;
+
+            priv = nautilus_search_engine_get_instance_private (engine);
+            index_can_search = nautilus_search_engine_index_can_search (priv->query);
+
             search_engine_start_real_tracker (engine);
             search_engine_start_real_recent (engine);
             search_engine_start_real_model (engine);
-            search_engine_start_real_simple (engine);
+
+            /* The index finds the same files as crawling the folders, without
+             * reading them, so only crawl the ones that aren't indexed, or
+             * whose index might miss files changed since it was built. Both
+             * find the files that didn't change, but hits are only added once. */
+            if (index_can_search)
+            {
+                search_engine_start_real_index (engine);
+            }
+            if (!index_can_search || !nautilus_search_engine_index_is_fresh ())
+            {
+                g_autolist (GFile) tracker_locations = NULL;
+
+                /* Tracker finds the same files in the folders it indexes */
+                tracker_locations = get_tracker_locations (priv);
+                search_engine_start_real_simple (engine, tracker_locations);
+            }
+
+            /* Tracker only finds contents in the folders it indexes */
+            search_engine_start_real_content (engine);
         }
     }
 }
@@ -270,6 +419,17 @@ nautilus_search_engine_start (NautilusSearchProvider *provider)
     }
 }
 
+static void
+stop_providers (NautilusSearchEnginePrivate *priv)
+{
+    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->tracker));
+    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->recent));
+    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->model));
+    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->simple));
+    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->index));
+    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->content));
+}
+
 static void
 nautilus_search_engine_stop (NautilusSearchProvider *provider)
 {
@@ -281,10 +441,8 @@ nautilus_search_engine_stop (NautilusSearchProvider *provider)
 
     DEBUG ("Search engine stop");
 
-    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->tracker));
-    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->recent));
-    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->model));
-    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (priv->simple));
+    stop_providers (priv);
+    clear_best_hits (priv);
 
     priv->running = FALSE;
     priv->restart = FALSE;
@@ -292,6 +450,146 @@ nautilus_search_engine_stop (NautilusSearchProvider *provider)
     g_object_notify (G_OBJECT (provider), "running");
 }
 
+static gboolean
+best_hits_grace_period_over (gpointer user_data)
+{
+    NautilusSearchEngine *engine = user_data;
+    NautilusSearchEnginePrivate *priv;
+
+    priv = nautilus_search_engine_get_instance_private (engine);
+    priv->best_hits_timeout_id = 0;
+
+    /* The providers report they finished once stopped, which completes the
+     * search with the hits found so far */
+    DEBUG ("Search engine found %u hits, stopping the providers", priv->max_results);
+    stop_providers (priv);
+
+    return G_SOURCE_REMOVE;
+}
+
+static gdouble
+get_best_hit_relevance (NautilusSearchEnginePrivate *priv,
+                        guint                        index)
+{
+    return nautilus_search_hit_get_relevance (g_ptr_array_index (priv->best_hits, index));
+}
+
+static void
+swap_best_hits (NautilusSearchEnginePrivate *priv,
+                guint                        a,
+                guint                        b)
+{
+    gpointer hit;
+
+    hit = priv->best_hits->pdata[a];
+    priv->best_hits->pdata[a] = priv->best_hits->pdata[b];
+    priv->best_hits->pdata[b] = hit;
+}
+
+/* Keeps @hit if it's one of the best max_results hits so far, dropping the
+ * worst one kept to make room. Returns whether it was kept. */
+static gboolean
+add_best_hit (NautilusSearchEngine *engine,
+              NautilusSearchHit    *hit)
+{
+    NautilusSearchEnginePrivate *priv;
+    NautilusSearchHit *worst_hit;
+    guint i;
+    guint parent;
+    guint child;
+
+    priv = nautilus_search_engine_get_instance_private (engine);
+
+    nautilus_search_hit_compute_scores (hit, &priv->scoring);
+
+    if (priv->best_hits->len < priv->max_results)
+    {
+        g_ptr_array_add (priv->best_hits, g_object_ref (hit));
+
+        for (i = priv->best_hits->len - 1; i > 0; i = parent)
+        {
+            parent = (i - 1) / 2;
+            if (get_best_hit_relevance (priv, parent) <= get_best_hit_relevance (priv, i))
+            {
+                break;
+            }
+            swap_best_hits (priv, i, parent);
+        }
+
+        if (priv->best_hits->len == priv->max_results)
+        {
+            priv->best_hits_timeout_id = g_timeout_add (BEST_HITS_GRACE_PERIOD_MS,
+                                                        best_hits_grace_period_over,
+                                                        engine);
+        }
+
+        return TRUE;
+    }
+
+    worst_hit = g_ptr_array_index (priv->best_hits, 0);
+    if (nautilus_search_hit_get_relevance (hit) <= nautilus_search_hit_get_relevance (worst_hit))
+    {
+        return FALSE;
+    }
+
+    g_hash_table_remove (priv->uris, nautilus_search_hit_get_uri (worst_hit));
+    g_object_unref (worst_hit);
+    priv->best_hits->pdata[0] = g_object_ref (hit);
+
+    for (i = 0; 2 * i + 1 < priv->best_hits->len; i = child)
+    {
+        child = 2 * i + 1;
+        if (child + 1 < priv->best_hits->len &&
+            get_best_hit_relevance (priv, child + 1) < get_best_hit_relevance (priv, child))
+        {
+            child++;
+        }
+        if (get_best_hit_relevance (priv, i) <= get_best_hit_relevance (priv, child))
+        {
+            break;
+        }
+        swap_best_hits (priv, i, child);
+    }
+
+    return TRUE;
+}
+
+static gint
+compare_best_hits (gconstpointer a,
+                   gconstpointer b)
+{
+    gdouble relevance_a;
+    gdouble relevance_b;
+
+    relevance_a = nautilus_search_hit_get_relevance (*(NautilusSearchHit **) a);
+    relevance_b = nautilus_search_hit_get_relevance (*(NautilusSearchHit **) b);
+
+    return (relevance_a < relevance_b) - (relevance_a > relevance_b);
+}
+
+static void
+emit_best_hits (NautilusSearchEngine *engine)
+{
+    NautilusSearchEnginePrivate *priv;
+    GList *hits = NULL;
+    guint i;
+
+    priv = nautilus_search_engine_get_instance_private (engine);
+
+    /* Best first */
+    g_ptr_array_sort (priv->best_hits, compare_best_hits);
+    for (i = priv->best_hits->len; i > 0; i--)
+    {
+        hits = g_list_prepend (hits, g_ptr_array_index (priv->best_hits, i - 1));
+    }
+
+    if (hits != NULL)
+    {
+        nautilus_search_provider_hits_added (NAUTILUS_SEARCH_PROVIDER (engine), hits);
+        g_list_free (hits);
+    }
+}
+
 static void
 search_provider_hits_added (NautilusSearchProvider *provider,
                             GList                  *hits,
@@ -313,16 +611,27 @@ search_provider_hits_added (NautilusSearchProvider *provider,
     for (l = hits; l != NULL; l = l->next)
     {
         NautilusSearchHit *hit = l->data;
-        int count;
         const char *uri;
 
         uri = nautilus_search_hit_get_uri (hit);
-        count = GPOINTER_TO_INT (g_hash_table_lookup (priv->uris, uri));
-        if (count == 0)
+        if (g_hash_table_contains (priv->uris, uri))
+        {
+            continue;
+        }
+
+        /* Only the hits kept are remembered then, so that memory doesn't
+         * grow with the number of hits */
+        if (priv->max_results > 0)
         {
-            added = g_list_prepend (added, hit);
+            if (add_best_hit (engine, hit))
+            {
+                g_hash_table_insert (priv->uris, (gpointer) uri, g_object_ref (hit));
+            }
+            continue;
         }
-        g_hash_table_replace (priv->uris, g_strdup (uri), GINT_TO_POINTER (++count));
+
+        added = g_list_prepend (added, hit);
+        g_hash_table_insert (priv->uris, (gpointer) uri, g_object_ref (hit));
     }
     if (added != NULL)
     {
@@ -361,6 +670,7 @@ check_providers_status (NautilusSearchEngine *engine)
         else
         {
             DEBUG ("Search engine finished");
+            emit_best_hits (engine);
         }
         nautilus_search_provider_finished (NAUTILUS_SEARCH_PROVIDER (engine),
                                            priv->restart ? NAUTILUS_SEARCH_PROVIDER_STATUS_RESTARTING :
@@ -371,6 +681,7 @@ check_providers_status (NautilusSearchEngine *engine)
     g_object_notify (G_OBJECT (engine), "running");
 
     g_hash_table_remove_all (priv->uris);
+    clear_best_hits (priv);
 
     if (priv->restart)
     {
@@ -456,11 +767,17 @@ nautilus_search_engine_finalize (GObject *object)
     priv = nautilus_search_engine_get_instance_private (engine);
 
     g_hash_table_destroy (priv->uris);
+    clear_best_hits (priv);
+    g_ptr_array_unref (priv->best_hits);
 
     g_clear_object (&priv->tracker);
     g_clear_object (&priv->recent);
     g_clear_object (&priv->model);
     g_clear_object (&priv->simple);
+    g_clear_object (&priv->index);
+    g_clear_object (&priv->content);
+
+    g_clear_object (&priv->query);
 
     G_OBJECT_CLASS (nautilus_search_engine_parent_class)->finalize (object);
 }
@@ -510,7 +827,8 @@ nautilus_search_engine_init (NautilusSearchEngine *engine)
     NautilusSearchEnginePrivate *priv;
 
     priv = nautilus_search_engine_get_instance_private (engine);
-    priv->uris = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    priv->uris = g_hash_table_new_full (g_str_hash, g_str_equal, NULL, g_object_unref);
+    priv->best_hits = g_ptr_array_new_with_free_func (g_object_unref);
 
     priv->tracker = nautilus_search_engine_tracker_new ();
     connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (priv->tracker));
@@ -521,6 +839,12 @@ nautilus_search_engine_init (NautilusSearchEngine *engine)
     priv->simple = nautilus_search_engine_simple_new ();
     connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (priv->simple));
 
+    priv->index = nautilus_search_engine_index_new ();
+    connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (priv->index));
+
+    priv->content = nautilus_search_engine_content_new ();
+    connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (priv->content));
+
     priv->recent = nautilus_search_engine_recent_new ();
     connect_provider_signals (engine, NAUTILUS_SEARCH_PROVIDER (priv->recent));
 }
@@ -535,6 +859,27 @@ nautilus_search_engine_new (void)
     return engine;
 }
 
+/**
+ * nautilus_search_engine_set_max_results:
+ * @engine: a #NautilusSearchEngine
+ * @max_results: the number of hits to report, or 0 for all of them
+ *
+ * Makes searches report only the @max_results hits with the highest
+ * relevance, all at once when they finish, instead of every hit as it's
+ * found. Memory then doesn't grow with the number of hits, and once that
+ * many are found, searches finish after a short while, even if there are
+ * folders left to look in.
+ */
+void
+nautilus_search_engine_set_max_results (NautilusSearchEngine *engine,
+                                        guint                 max_results)
+{
+    NautilusSearchEnginePrivate *priv;
+
+    priv = nautilus_search_engine_get_instance_private (engine);
+    priv->max_results = max_results;
+}
+
 NautilusSearchEngineModel *
 nautilus_search_engine_get_model_provider (NautilusSearchEngine *engine)
 {
@@ -584,3 +929,39 @@ is_recursive_search (NautilusSearchEngineType  engine_type,
 
     return TRUE;
 }
+
+/**
+ * is_recursive_search_cached:
+ * @engine_type: the type of the engine asking
+ * @recursive: the recursive setting of the query
+ * @location: a folder
+ * @filesystem_id: (nullable): the ID of the file system @location is in
+ * @remote_filesystems: a table of file system IDs to whether they are
+ * remote, which the caller keeps for the whole search
+ *
+ * Like is_recursive_search(), but only queries the file system of
+ * @location when it is one not seen before in @remote_filesystems, which
+ * only happens when crossing a mount point.
+ */
+gboolean
+is_recursive_search_cached (NautilusSearchEngineType  engine_type,
+                            NautilusQueryRecursive    recursive,
+                            GFile                    *location,
+                            const char               *filesystem_id,
+                            GHashTable               *remote_filesystems)
+{
+    gpointer remote;
+
+    if (recursive != NAUTILUS_QUERY_RECURSIVE_LOCAL_ONLY || filesystem_id == NULL)
+    {
+        return is_recursive_search (engine_type, recursive, location);
+    }
+
+    if (!g_hash_table_lookup_extended (remote_filesystems, filesystem_id, NULL, &remote))
+    {
+        remote = GINT_TO_POINTER (!is_recursive_search (engine_type, recursive, location));
+        g_hash_table_insert (remote_filesystems, g_strdup (filesystem_id), remote);
+    }
+
+    return !GPOINTER_TO_INT (remote);
+}
@@ -39,6 +39,8 @@ struct _NautilusSearchEngineClass
 };
 
 NautilusSearchEngine *nautilus_search_engine_new                (void);
+void                  nautilus_search_engine_set_max_results    (NautilusSearchEngine *engine,
+                                                                 guint                 max_results);
 NautilusSearchEngineModel *
                       nautilus_search_engine_get_model_provider (NautilusSearchEngine *engine);
 
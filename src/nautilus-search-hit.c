@@ -33,8 +33,9 @@ struct _NautilusSearchHit
 
     char *uri;
 
-    GDateTime *modification_time;
-    GDateTime *access_time;
+    /* In seconds since the epoch, or 0 if unknown */
+    gint64 modification_time;
+    gint64 access_time;
     gdouble fts_rank;
     gchar *fts_snippet;
 
@@ -54,57 +55,110 @@ enum
 
 G_DEFINE_TYPE (NautilusSearchHit, nautilus_search_hit, G_TYPE_OBJECT)
 
+/**
+ * nautilus_search_hit_scoring_init:
+ * @scoring: the scoring to initialize
+ * @query: the query hits are scored for
+ *
+ * Gets what scoring hits of @query depends on, to score a batch of them.
+ * Clear it with nautilus_search_hit_scoring_clear().
+ */
 void
-nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
-                                    NautilusQuery     *query)
+nautilus_search_hit_scoring_init (NautilusSearchHitScoring *scoring,
+                                  NautilusQuery            *query)
 {
-    GDateTime *now;
-    GFile *query_location;
-    GFile *hit_location;
-    GTimeSpan m_diff = G_MAXINT64;
-    GTimeSpan a_diff = G_MAXINT64;
-    GTimeSpan t_diff = G_MAXINT64;
-    gdouble recent_bonus = 0.0;
-    gdouble proximity_bonus = 0.0;
-    gdouble match_bonus = 0.0;
+    g_autoptr (GFile) location = NULL;
 
-    query_location = nautilus_query_get_location (query);
-    hit_location = g_file_new_for_uri (hit->uri);
+    scoring->now = g_get_real_time () / G_USEC_PER_SEC;
+    scoring->location_uri = NULL;
+    scoring->location_uri_length = 0;
 
-    if (g_file_has_prefix (hit_location, query_location))
+    location = nautilus_query_get_location (query);
+    if (location != NULL)
     {
-        GFile *parent, *location;
-        guint dir_count = 0;
+        scoring->location_uri = g_file_get_uri (location);
+        scoring->location_uri_length = strlen (scoring->location_uri);
 
-        parent = g_file_get_parent (hit_location);
-
-        while (!g_file_equal (parent, query_location))
+        /* Compare the path components only */
+        while (scoring->location_uri_length > 0 &&
+               scoring->location_uri[scoring->location_uri_length - 1] == '/')
         {
-            dir_count++;
-            location = parent;
-            parent = g_file_get_parent (location);
-            g_object_unref (location);
+            scoring->location_uri_length--;
         }
-        g_object_unref (parent);
+    }
+}
+
+void
+nautilus_search_hit_scoring_clear (NautilusSearchHitScoring *scoring)
+{
+    g_clear_pointer (&scoring->location_uri, g_free);
+}
+
+/* How many folders down from the query location the hit is, if it's in
+ * there, comparing the URIs instead of making a GFile of each parent */
+static gboolean
+get_folder_depth (NautilusSearchHit              *hit,
+                  const NautilusSearchHitScoring *scoring,
+                  guint                          *depth)
+{
+    const char *relative_path;
+    const char *p;
 
-        if (dir_count < 10)
+    if (scoring->location_uri == NULL ||
+        strncmp (hit->uri, scoring->location_uri, scoring->location_uri_length) != 0 ||
+        hit->uri[scoring->location_uri_length] != '/')
+    {
+        return FALSE;
+    }
+
+    relative_path = hit->uri + scoring->location_uri_length;
+    while (*relative_path == '/')
+    {
+        relative_path++;
+    }
+    if (*relative_path == '\0')
+    {
+        return FALSE;
+    }
+
+    *depth = 0;
+    for (p = relative_path; *p != '\0'; p++)
+    {
+        /* Trailing slashes don't make another folder */
+        if (*p == '/' && p[1] != '/' && p[1] != '\0')
         {
-            proximity_bonus = 10000.0 - 1000.0 * dir_count;
+            *depth += 1;
         }
     }
-    g_object_unref (hit_location);
 
-    now = g_date_time_new_now_local ();
-    if (hit->modification_time != NULL)
+    return TRUE;
+}
+
+void
+nautilus_search_hit_compute_scores (NautilusSearchHit              *hit,
+                                    const NautilusSearchHitScoring *scoring)
+{
+    gint64 m_diff = G_MAXINT64;
+    gint64 a_diff = G_MAXINT64;
+    gint64 t_diff = G_MAXINT64;
+    gdouble recent_bonus = 0.0;
+    gdouble proximity_bonus = 0.0;
+    gdouble match_bonus = 0.0;
+    guint dir_count;
+
+    if (get_folder_depth (hit, scoring, &dir_count) && dir_count < 10)
     {
-        m_diff = g_date_time_difference (now, hit->modification_time);
+        proximity_bonus = 10000.0 - 1000.0 * dir_count;
     }
-    if (hit->access_time != NULL)
+
+    if (hit->modification_time != 0)
+    {
+        m_diff = (scoring->now - hit->modification_time) / (G_TIME_SPAN_DAY / G_TIME_SPAN_SECOND);
+    }
+    if (hit->access_time != 0)
     {
-        a_diff = g_date_time_difference (now, hit->access_time);
+        a_diff = (scoring->now - hit->access_time) / (G_TIME_SPAN_DAY / G_TIME_SPAN_SECOND);
     }
-    m_diff /= G_TIME_SPAN_DAY;
-    a_diff /= G_TIME_SPAN_DAY;
     t_diff = MIN (m_diff, a_diff);
     if (t_diff > 90)
     {
@@ -143,9 +197,50 @@ nautilus_search_hit_compute_scores (NautilusSearchHit *hit,
     hit->relevance = recent_bonus + proximity_bonus + match_bonus;
     DEBUG ("Hit %s computed relevance %.2f (%.2f + %.2f + %.2f)", hit->uri, hit->relevance,
            proximity_bonus, recent_bonus, match_bonus);
+}
 
-    g_date_time_unref (now);
-    g_object_unref (query_location);
+/**
+ * nautilus_search_hit_narrow:
+ * @hit: a hit found for the query of @previous_matcher
+ * @matcher: the matcher of a query that narrows that one
+ * @previous_matcher: the matcher of the query @hit was found for
+ *
+ * Checks whether the file name of @hit matches a narrower query too, and
+ * updates its rank for it, to filter hits instead of searching again.
+ * nautilus_search_hit_compute_scores() has to be called again after.
+ *
+ * Returns: %TRUE if @hit matches @matcher.
+ */
+gboolean
+nautilus_search_hit_narrow (NautilusSearchHit    *hit,
+                            NautilusQueryMatcher *matcher,
+                            NautilusQueryMatcher *previous_matcher)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autofree gchar *basename = NULL;
+    g_autofree gchar *name = NULL;
+    gdouble match;
+    gdouble previous_match;
+
+    location = g_file_new_for_uri (hit->uri);
+    basename = g_file_get_basename (location);
+    if (basename == NULL)
+    {
+        return FALSE;
+    }
+
+    name = g_filename_display_name (basename);
+    match = nautilus_query_matcher_match (matcher, name);
+    if (match <= -1)
+    {
+        return FALSE;
+    }
+
+    /* Engines add the match of the name to ranks of their own */
+    previous_match = nautilus_query_matcher_match (previous_matcher, name);
+    hit->fts_rank += match - MAX (previous_match, 0);
+
+    return TRUE;
 }
 
 const char *
@@ -181,40 +276,30 @@ nautilus_search_hit_set_fts_rank (NautilusSearchHit *hit,
     hit->fts_rank = rank;
 }
 
+/**
+ * nautilus_search_hit_set_modification_time:
+ * @hit: a #NautilusSearchHit
+ * @time: the modification time of the file, in seconds since the epoch,
+ *   or 0 if unknown
+ */
 void
 nautilus_search_hit_set_modification_time (NautilusSearchHit *hit,
-                                           GDateTime         *date)
+                                           gint64             time)
 {
-    if (hit->modification_time != NULL)
-    {
-        g_date_time_unref (hit->modification_time);
-    }
-    if (date != NULL)
-    {
-        hit->modification_time = g_date_time_ref (date);
-    }
-    else
-    {
-        hit->modification_time = NULL;
-    }
+    hit->modification_time = time;
 }
 
+/**
+ * nautilus_search_hit_set_access_time:
+ * @hit: a #NautilusSearchHit
+ * @time: the access time of the file, in seconds since the epoch, or 0
+ *   if unknown
+ */
 void
 nautilus_search_hit_set_access_time (NautilusSearchHit *hit,
-                                     GDateTime         *date)
+                                     gint64             time)
 {
-    if (hit->access_time != NULL)
-    {
-        g_date_time_unref (hit->access_time);
-    }
-    if (date != NULL)
-    {
-        hit->access_time = g_date_time_ref (date);
-    }
-    else
-    {
-        hit->access_time = NULL;
-    }
+    hit->access_time = time;
 }
 
 void
@@ -258,13 +343,13 @@ nautilus_search_hit_set_property (GObject      *object,
 
         case PROP_MODIFICATION_TIME:
         {
-            nautilus_search_hit_set_modification_time (hit, g_value_get_boxed (value));
+            nautilus_search_hit_set_modification_time (hit, g_value_get_int64 (value));
         }
         break;
 
         case PROP_ACCESS_TIME:
         {
-            nautilus_search_hit_set_access_time (hit, g_value_get_boxed (value));
+            nautilus_search_hit_set_access_time (hit, g_value_get_int64 (value));
         }
         break;
 
@@ -315,13 +400,13 @@ nautilus_search_hit_get_property (GObject    *object,
 
         case PROP_MODIFICATION_TIME:
         {
-            g_value_set_boxed (value, hit->modification_time);
+            g_value_set_int64 (value, hit->modification_time);
         }
         break;
 
         case PROP_ACCESS_TIME:
         {
-            g_value_set_boxed (value, hit->access_time);
+            g_value_set_int64 (value, hit->access_time);
         }
         break;
 
@@ -345,16 +430,6 @@ nautilus_search_hit_finalize (GObject *object)
     NautilusSearchHit *hit = NAUTILUS_SEARCH_HIT (object);
 
     g_free (hit->uri);
-
-    if (hit->access_time != NULL)
-    {
-        g_date_time_unref (hit->access_time);
-    }
-    if (hit->modification_time != NULL)
-    {
-        g_date_time_unref (hit->modification_time);
-    }
-
     g_free (hit->fts_snippet);
 
     G_OBJECT_CLASS (nautilus_search_hit_parent_class)->finalize (object);
@@ -380,18 +455,20 @@ nautilus_search_hit_class_init (NautilusSearchHitClass *class)
                                                           G_PARAM_CONSTRUCT_ONLY | G_PARAM_WRITABLE | G_PARAM_READABLE));
     g_object_class_install_property (object_class,
                                      PROP_MODIFICATION_TIME,
-                                     g_param_spec_boxed ("modification-time",
-                                                         "Modification time",
+                                     g_param_spec_int64 ("modification-time",
                                                          "Modification time",
-                                                         G_TYPE_DATE_TIME,
-                                                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+                                                         "Modification time, in seconds since the epoch",
+                                                         0, G_MAXINT64,
+                                                         0,
+                                                         G_PARAM_READWRITE));
     g_object_class_install_property (object_class,
                                      PROP_ACCESS_TIME,
-                                     g_param_spec_boxed ("access-time",
-                                                         "acess time",
-                                                         "access time",
-                                                         G_TYPE_DATE_TIME,
-                                                         G_PARAM_READWRITE | G_PARAM_CONSTRUCT));
+                                     g_param_spec_int64 ("access-time",
+                                                         "Access time",
+                                                         "Access time, in seconds since the epoch",
+                                                         0, G_MAXINT64,
+                                                         0,
+                                                         G_PARAM_READWRITE));
     g_object_class_install_property (object_class,
                                      PROP_RELEVANCE,
                                      g_param_spec_double ("relevance",
@@ -28,18 +28,35 @@ G_BEGIN_DECLS
 
 G_DECLARE_FINAL_TYPE (NautilusSearchHit, nautilus_search_hit, NAUTILUS, SEARCH_HIT, GObject);
 
+/* What scoring the hits of a query depends on, other than the hits
+ * themselves. It's computed once per batch of hits, rather than per hit.
+ */
+typedef struct
+{
+    gint64 now;
+    gchar *location_uri;
+    gsize location_uri_length;
+} NautilusSearchHitScoring;
+
+void                nautilus_search_hit_scoring_init          (NautilusSearchHitScoring *scoring,
+                                                               NautilusQuery            *query);
+void                nautilus_search_hit_scoring_clear         (NautilusSearchHitScoring *scoring);
+
 NautilusSearchHit * nautilus_search_hit_new                   (const char        *uri);
 
 void                nautilus_search_hit_set_fts_rank          (NautilusSearchHit *hit,
 							       gdouble            fts_rank);
 void                nautilus_search_hit_set_modification_time (NautilusSearchHit *hit,
-							       GDateTime         *date);
+							       gint64             time);
 void                nautilus_search_hit_set_access_time       (NautilusSearchHit *hit,
-							       GDateTime         *date);
+							       gint64             time);
 void                nautilus_search_hit_set_fts_snippet       (NautilusSearchHit *hit,
                                                                const gchar       *snippet);
-void                nautilus_search_hit_compute_scores        (NautilusSearchHit *hit,
-							       NautilusQuery     *query);
+void                nautilus_search_hit_compute_scores        (NautilusSearchHit              *hit,
+							       const NautilusSearchHitScoring *scoring);
+gboolean            nautilus_search_hit_narrow                (NautilusSearchHit    *hit,
+							       NautilusQueryMatcher *matcher,
+							       NautilusQueryMatcher *previous_matcher);
 
 const char *        nautilus_search_hit_get_uri               (NautilusSearchHit *hit);
 gdouble             nautilus_search_hit_get_relevance         (NautilusSearchHit *hit);
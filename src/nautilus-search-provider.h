@@ -34,6 +34,8 @@ typedef enum {
   NAUTILUS_SEARCH_ENGINE_RECENT_ENGINE,
   NAUTILUS_SEARCH_ENGINE_MODEL_ENGINE,
   NAUTILUS_SEARCH_ENGINE_SIMPLE_ENGINE,
+  NAUTILUS_SEARCH_ENGINE_INDEX_ENGINE,
+  NAUTILUS_SEARCH_ENGINE_CONTENT_ENGINE,
 } NautilusSearchEngineTarget;
 
 #define NAUTILUS_TYPE_SEARCH_PROVIDER (nautilus_search_provider_get_type ())
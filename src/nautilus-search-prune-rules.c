@@ -0,0 +1,349 @@
+/* nautilus-search-prune-rules.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-search-prune-rules.h"
+
+#include <string.h>
+
+/* Version control data, which is never worth searching */
+static const char * const always_pruned[] =
+{
+    ".git", ".hg", ".svn", ".bzr", NULL
+};
+
+static const char * const ignore_files[] =
+{
+    ".gitignore", ".ignore", NULL
+};
+
+struct _NautilusSearchPruneRules
+{
+    NautilusSearchPruneRules *parent;
+
+    /* The folder of the ignore files the rules come from, if any, which
+     * patterns with a slash are relative to */
+    GFile *base;
+
+    /* Names without wildcards, the most common rules, to look up at once */
+    GHashTable *names;
+    /* GPatternSpecs for names */
+    GPtrArray *patterns;
+    /* GPatternSpecs for paths relative to @base */
+    GPtrArray *paths;
+    /* GPatternSpecs for names negated with "!", which are never pruned */
+    GPtrArray *exceptions;
+};
+
+static NautilusSearchPruneRules *
+prune_rules_new (NautilusSearchPruneRules *parent,
+                 GFile                    *base)
+{
+    NautilusSearchPruneRules *rules;
+
+    rules = g_atomic_rc_box_new0 (NautilusSearchPruneRules);
+    rules->parent = parent != NULL ? nautilus_search_prune_rules_ref (parent) : NULL;
+    rules->base = base != NULL ? g_object_ref (base) : NULL;
+    rules->names = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+    rules->patterns = g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+    rules->paths = g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+    rules->exceptions = g_ptr_array_new_with_free_func ((GDestroyNotify) g_pattern_spec_free);
+
+    return rules;
+}
+
+static gboolean
+prune_rules_is_empty (NautilusSearchPruneRules *rules)
+{
+    return g_hash_table_size (rules->names) == 0 &&
+           rules->patterns->len == 0 &&
+           rules->paths->len == 0 &&
+           rules->exceptions->len == 0;
+}
+
+/* Adds a line of an ignore file, in the syntax of .gitignore. Only folders
+ * are pruned, so a trailing slash changes nothing. Character classes are
+ * not supported, and such rules are left out rather than pruning too much.
+ */
+static void
+prune_rules_add_pattern (NautilusSearchPruneRules *rules,
+                         const char               *line)
+{
+    g_autofree gchar *pattern = NULL;
+    gchar *p;
+    gchar *slash;
+    gsize length;
+    gboolean negated = FALSE;
+    gboolean anchored = FALSE;
+
+    pattern = g_strstrip (g_strdup (line));
+    p = pattern;
+
+    if (*p == '\0' || *p == '#')
+    {
+        return;
+    }
+
+    if (*p == '!')
+    {
+        negated = TRUE;
+        p++;
+    }
+    else if (*p == '\\')
+    {
+        p++;
+    }
+
+    if (g_str_has_prefix (p, "**/"))
+    {
+        p += strlen ("**/");
+    }
+    else if (*p == '/')
+    {
+        anchored = TRUE;
+        p++;
+    }
+
+    length = strlen (p);
+    while (length > 0 && p[length - 1] == '/')
+    {
+        p[--length] = '\0';
+    }
+
+    if (length == 0 || strchr (p, '[') != NULL)
+    {
+        return;
+    }
+
+    anchored = anchored || strchr (p, '/') != NULL;
+
+    if (negated)
+    {
+        /* A folder the rule might include again is kept, whatever its
+         * parents are */
+        slash = strrchr (p, '/');
+        g_ptr_array_add (rules->exceptions, g_pattern_spec_new (slash != NULL ? slash + 1 : p));
+    }
+    else if (anchored)
+    {
+        if (rules->base != NULL)
+        {
+            g_ptr_array_add (rules->paths, g_pattern_spec_new (p));
+        }
+    }
+    else if (strpbrk (p, "*?") == NULL)
+    {
+        g_hash_table_add (rules->names, g_strdup (p));
+    }
+    else
+    {
+        g_ptr_array_add (rules->patterns, g_pattern_spec_new (p));
+    }
+}
+
+/**
+ * nautilus_search_prune_rules_new:
+ * @patterns: (nullable) (array zero-terminated=1): patterns of the names of
+ * folders to prune, in the syntax of .gitignore
+ *
+ * Returns: (transfer full): rules pruning @patterns, and version control
+ * data.
+ */
+NautilusSearchPruneRules *
+nautilus_search_prune_rules_new (const char * const *patterns)
+{
+    NautilusSearchPruneRules *rules;
+    guint i;
+
+    rules = prune_rules_new (NULL, NULL);
+    for (i = 0; always_pruned[i] != NULL; i++)
+    {
+        g_hash_table_add (rules->names, g_strdup (always_pruned[i]));
+    }
+
+    for (i = 0; patterns != NULL && patterns[i] != NULL; i++)
+    {
+        prune_rules_add_pattern (rules, patterns[i]);
+    }
+
+    return rules;
+}
+
+/**
+ * nautilus_search_prune_rules_new_for_directory:
+ * @parent: the rules of the parent of @directory
+ * @directory: a folder with ignore files
+ * @cancellable: (nullable): a #GCancellable
+ *
+ * Reads the ignore files of @directory. This blocks, so it should be called
+ * from a thread.
+ *
+ * Returns: (transfer full): the rules for the contents of @directory, which
+ * are @parent if its ignore files add none.
+ */
+NautilusSearchPruneRules *
+nautilus_search_prune_rules_new_for_directory (NautilusSearchPruneRules *parent,
+                                               GFile                    *directory,
+                                               GCancellable             *cancellable)
+{
+    NautilusSearchPruneRules *rules;
+    guint i;
+    guint j;
+
+    g_return_val_if_fail (parent != NULL, NULL);
+
+    rules = prune_rules_new (parent, directory);
+    for (i = 0; ignore_files[i] != NULL; i++)
+    {
+        g_autoptr (GFile) file = NULL;
+        g_autofree gchar *contents = NULL;
+        g_auto (GStrv) lines = NULL;
+
+        file = g_file_get_child (directory, ignore_files[i]);
+        if (!g_file_load_contents (file, cancellable, &contents, NULL, NULL, NULL))
+        {
+            continue;
+        }
+
+        lines = g_strsplit (contents, "\n", -1);
+        for (j = 0; lines[j] != NULL; j++)
+        {
+            prune_rules_add_pattern (rules, lines[j]);
+        }
+    }
+
+    if (prune_rules_is_empty (rules))
+    {
+        nautilus_search_prune_rules_unref (rules);
+        return nautilus_search_prune_rules_ref (parent);
+    }
+
+    return rules;
+}
+
+NautilusSearchPruneRules *
+nautilus_search_prune_rules_ref (NautilusSearchPruneRules *rules)
+{
+    g_return_val_if_fail (rules != NULL, NULL);
+
+    return g_atomic_rc_box_acquire (rules);
+}
+
+static void
+nautilus_search_prune_rules_clear (NautilusSearchPruneRules *rules)
+{
+    g_clear_pointer (&rules->parent, nautilus_search_prune_rules_unref);
+    g_clear_object (&rules->base);
+    g_hash_table_destroy (rules->names);
+    g_ptr_array_unref (rules->patterns);
+    g_ptr_array_unref (rules->paths);
+    g_ptr_array_unref (rules->exceptions);
+}
+
+void
+nautilus_search_prune_rules_unref (NautilusSearchPruneRules *rules)
+{
+    g_return_if_fail (rules != NULL);
+
+    g_atomic_rc_box_release_full (rules, (GDestroyNotify) nautilus_search_prune_rules_clear);
+}
+
+/**
+ * nautilus_search_prune_rules_is_ignore_file:
+ * @name: the name of a file
+ *
+ * Returns: %TRUE if a file named @name has rules for its folder.
+ */
+gboolean
+nautilus_search_prune_rules_is_ignore_file (const char *name)
+{
+    return g_strv_contains (ignore_files, name);
+}
+
+static gboolean
+match_any (GPtrArray  *patterns,
+           const char *string)
+{
+    guint i;
+
+    for (i = 0; i < patterns->len; i++)
+    {
+        if (g_pattern_match_string (g_ptr_array_index (patterns, i), string))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+static gboolean
+prune_rules_match_own (NautilusSearchPruneRules *rules,
+                       GFile                    *directory,
+                       const char               *name)
+{
+    g_autofree gchar *path = NULL;
+
+    if (g_hash_table_contains (rules->names, name) || match_any (rules->patterns, name))
+    {
+        return TRUE;
+    }
+
+    if (rules->paths->len == 0)
+    {
+        return FALSE;
+    }
+
+    path = g_file_get_relative_path (rules->base, directory);
+
+    return path != NULL && match_any (rules->paths, path);
+}
+
+/**
+ * nautilus_search_prune_rules_match:
+ * @rules: a #NautilusSearchPruneRules
+ * @directory: a folder
+ * @name: the name of @directory
+ *
+ * Returns: %TRUE if searches shouldn't look into @directory.
+ */
+gboolean
+nautilus_search_prune_rules_match (NautilusSearchPruneRules *rules,
+                                   GFile                    *directory,
+                                   const char               *name)
+{
+    NautilusSearchPruneRules *level;
+
+    for (level = rules; level != NULL; level = level->parent)
+    {
+        if (match_any (level->exceptions, name))
+        {
+            return FALSE;
+        }
+    }
+
+    for (level = rules; level != NULL; level = level->parent)
+    {
+        if (prune_rules_match_own (level, directory, name))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
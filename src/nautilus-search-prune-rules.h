@@ -0,0 +1,49 @@
+/* nautilus-search-prune-rules.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gio/gio.h>
+
+G_BEGIN_DECLS
+
+/* Rules for the folders that searches walking the file system don't look
+ * into, such as version control data or installed dependencies: names
+ * that are always pruned, the search-prune-patterns preference, and the
+ * .gitignore and .ignore files of the folders walked.
+ *
+ * The rules of a folder with ignore files add to the ones of its parent
+ * folder. Rules are immutable, and can be shared by search threads.
+ */
+typedef struct _NautilusSearchPruneRules NautilusSearchPruneRules;
+
+NautilusSearchPruneRules *nautilus_search_prune_rules_new               (const char * const       *patterns);
+NautilusSearchPruneRules *nautilus_search_prune_rules_new_for_directory (NautilusSearchPruneRules *parent,
+                                                                         GFile                    *directory,
+                                                                         GCancellable             *cancellable);
+NautilusSearchPruneRules *nautilus_search_prune_rules_ref               (NautilusSearchPruneRules *rules);
+void                      nautilus_search_prune_rules_unref             (NautilusSearchPruneRules *rules);
+
+gboolean                  nautilus_search_prune_rules_is_ignore_file    (const char               *name);
+gboolean                  nautilus_search_prune_rules_match             (NautilusSearchPruneRules *rules,
+                                                                         GFile                    *directory,
+                                                                         const char               *name);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (NautilusSearchPruneRules, nautilus_search_prune_rules_unref)
+
+G_END_DECLS
@@ -0,0 +1,276 @@
+/* nautilus-selection-set.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-selection-set.h"
+
+#include "nautilus-file.h"
+
+struct _NautilusSelectionSet
+{
+    /* NautilusFile, owning a reference, to the last replacement it was
+     * part of, see nautilus_selection_set_replace() */
+    GHashTable *files;
+    guint generation;
+};
+
+static GHashTable *
+files_table_new (void)
+{
+    return g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                  (GDestroyNotify) nautilus_file_unref, NULL);
+}
+
+NautilusSelectionSet *
+nautilus_selection_set_new (void)
+{
+    NautilusSelectionSet *set;
+
+    set = g_new0 (NautilusSelectionSet, 1);
+    set->files = files_table_new ();
+
+    return set;
+}
+
+NautilusSelectionSet *
+nautilus_selection_set_new_from_list (GList *files)
+{
+    NautilusSelectionSet *set;
+    GList *l;
+
+    set = nautilus_selection_set_new ();
+    for (l = files; l != NULL; l = l->next)
+    {
+        nautilus_selection_set_add (set, NAUTILUS_FILE (l->data));
+    }
+
+    return set;
+}
+
+void
+nautilus_selection_set_free (NautilusSelectionSet *set)
+{
+    if (set == NULL)
+    {
+        return;
+    }
+
+    g_hash_table_destroy (set->files);
+    g_free (set);
+}
+
+/* Returns %TRUE if @file was not in @set already. */
+gboolean
+nautilus_selection_set_add (NautilusSelectionSet *set,
+                            NautilusFile         *file)
+{
+    g_return_val_if_fail (set != NULL, FALSE);
+    g_return_val_if_fail (NAUTILUS_IS_FILE (file), FALSE);
+
+    if (g_hash_table_contains (set->files, file))
+    {
+        return FALSE;
+    }
+
+    return g_hash_table_insert (set->files, nautilus_file_ref (file), NULL);
+}
+
+/* Returns %TRUE if @file was in @set. */
+gboolean
+nautilus_selection_set_remove (NautilusSelectionSet *set,
+                               NautilusFile         *file)
+{
+    g_return_val_if_fail (set != NULL, FALSE);
+
+    return g_hash_table_remove (set->files, file);
+}
+
+void
+nautilus_selection_set_remove_all (NautilusSelectionSet *set)
+{
+    g_return_if_fail (set != NULL);
+
+    g_hash_table_remove_all (set->files);
+}
+
+gboolean
+nautilus_selection_set_contains (const NautilusSelectionSet *set,
+                                 NautilusFile               *file)
+{
+    g_return_val_if_fail (set != NULL, FALSE);
+
+    return g_hash_table_contains (set->files, file);
+}
+
+guint
+nautilus_selection_set_get_size (const NautilusSelectionSet *set)
+{
+    g_return_val_if_fail (set != NULL, 0);
+
+    return g_hash_table_size (set->files);
+}
+
+/* Returns a list of the files in @set, in no particular order, with a
+ * reference each. Free with nautilus_file_list_free().
+ */
+GList *
+nautilus_selection_set_get_files (const NautilusSelectionSet *set)
+{
+    GHashTableIter iter;
+    gpointer file;
+    GList *files = NULL;
+
+    g_return_val_if_fail (set != NULL, NULL);
+
+    g_hash_table_iter_init (&iter, set->files);
+    while (g_hash_table_iter_next (&iter, &file, NULL))
+    {
+        files = g_list_prepend (files, nautilus_file_ref (file));
+    }
+
+    return files;
+}
+
+gboolean
+nautilus_selection_set_equal (const NautilusSelectionSet *set_a,
+                              const NautilusSelectionSet *set_b)
+{
+    GHashTableIter iter;
+    gpointer file;
+
+    g_return_val_if_fail (set_a != NULL && set_b != NULL, FALSE);
+
+    if (g_hash_table_size (set_a->files) != g_hash_table_size (set_b->files))
+    {
+        return FALSE;
+    }
+
+    g_hash_table_iter_init (&iter, set_a->files);
+    while (g_hash_table_iter_next (&iter, &file, NULL))
+    {
+        if (!g_hash_table_contains (set_b->files, file))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/* Returns %TRUE if any of @files is in @set. Takes time in the length of
+ * @files only.
+ */
+gboolean
+nautilus_selection_set_intersects (const NautilusSelectionSet *set,
+                                   GList                      *files)
+{
+    GList *l;
+
+    g_return_val_if_fail (set != NULL, FALSE);
+
+    if (g_hash_table_size (set->files) == 0)
+    {
+        return FALSE;
+    }
+
+    for (l = files; l != NULL; l = l->next)
+    {
+        if (g_hash_table_contains (set->files, l->data))
+        {
+            return TRUE;
+        }
+    }
+
+    return FALSE;
+}
+
+/**
+ * nautilus_selection_set_replace:
+ * @set: the set to update
+ * @files: (element-type NautilusFile): the new contents of @set
+ * @added: (out) (optional) (transfer full): files in @files that were not in @set
+ * @removed: (out) (optional) (transfer full): files in @set that are not in @files
+ *
+ * Makes @set contain exactly @files, reporting the difference, so that
+ * callers can keep derived data up to date from the changes only. This
+ * takes time in the size of @files and @set, so callers that know what
+ * changed should use nautilus_selection_set_add() and
+ * nautilus_selection_set_remove() instead.
+ *
+ * Returns: %TRUE if @set changed.
+ */
+gboolean
+nautilus_selection_set_replace (NautilusSelectionSet  *set,
+                                GList                 *files,
+                                GList                **added,
+                                GList                **removed)
+{
+    GHashTableIter iter;
+    gpointer file;
+    gpointer generation;
+    GList *l;
+    gboolean changed = FALSE;
+
+    g_return_val_if_fail (set != NULL, FALSE);
+
+    /* Mark the files that stay with a new generation, in place, and drop
+     * the ones left with an older one. Files added with
+     * nautilus_selection_set_add() are marked with 0. */
+    set->generation++;
+    if (set->generation == 0)
+    {
+        set->generation = 1;
+    }
+    generation = GUINT_TO_POINTER (set->generation);
+
+    for (l = files; l != NULL; l = l->next)
+    {
+        if (!g_hash_table_contains (set->files, l->data))
+        {
+            changed = TRUE;
+            if (added != NULL)
+            {
+                *added = g_list_prepend (*added, nautilus_file_ref (l->data));
+            }
+        }
+
+        /* The table keeps the key it has, and drops this reference */
+        g_hash_table_insert (set->files, nautilus_file_ref (l->data), generation);
+    }
+
+    if (g_hash_table_size (set->files) == g_list_length (files) && !changed)
+    {
+        return FALSE;
+    }
+
+    g_hash_table_iter_init (&iter, set->files);
+    while (g_hash_table_iter_next (&iter, &file, &generation))
+    {
+        if (GPOINTER_TO_UINT (generation) != set->generation)
+        {
+            changed = TRUE;
+            if (removed != NULL)
+            {
+                *removed = g_list_prepend (*removed, nautilus_file_ref (file));
+            }
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+
+    return changed;
+}
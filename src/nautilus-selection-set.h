@@ -0,0 +1,59 @@
+/* nautilus-selection-set.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "nautilus-types.h"
+
+G_BEGIN_DECLS
+
+/* A set of files, hashed by NautilusFile, meant to hold a view selection.
+ * Lookups are constant time, and comparing or updating a set costs time in
+ * the size of the change rather than in the product of the sizes, as it
+ * would with GLists.
+ */
+typedef struct _NautilusSelectionSet NautilusSelectionSet;
+
+NautilusSelectionSet *nautilus_selection_set_new            (void);
+NautilusSelectionSet *nautilus_selection_set_new_from_list  (GList                      *files);
+void                  nautilus_selection_set_free           (NautilusSelectionSet       *set);
+
+gboolean              nautilus_selection_set_add            (NautilusSelectionSet       *set,
+                                                             NautilusFile               *file);
+gboolean              nautilus_selection_set_remove         (NautilusSelectionSet       *set,
+                                                             NautilusFile               *file);
+void                  nautilus_selection_set_remove_all     (NautilusSelectionSet       *set);
+gboolean              nautilus_selection_set_contains       (const NautilusSelectionSet *set,
+                                                             NautilusFile               *file);
+guint                 nautilus_selection_set_get_size       (const NautilusSelectionSet *set);
+GList                *nautilus_selection_set_get_files      (const NautilusSelectionSet *set);
+
+gboolean              nautilus_selection_set_equal          (const NautilusSelectionSet *set_a,
+                                                             const NautilusSelectionSet *set_b);
+gboolean              nautilus_selection_set_intersects     (const NautilusSelectionSet *set,
+                                                             GList                      *files);
+gboolean              nautilus_selection_set_replace        (NautilusSelectionSet       *set,
+                                                             GList                      *files,
+                                                             GList                     **added,
+                                                             GList                     **removed);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (NautilusSelectionSet, nautilus_selection_set_free)
+
+G_END_DECLS
@@ -0,0 +1,326 @@
+/* nautilus-selection-summary.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-selection-summary.h"
+
+#include <string.h>
+
+#include "nautilus-file.h"
+
+/* What a file added to the totals, so that it can be taken back out when the
+ * file leaves the selection or changes, whatever the file looks like then.
+ */
+typedef struct
+{
+    NautilusSelectionSummaryFlags flags;
+    gboolean item_count_known;
+    guint item_count;
+    gboolean size_known;
+    goffset size;
+} FileContribution;
+
+struct _NautilusSelectionSummary
+{
+    /* NautilusFile, owning a reference, to FileContribution */
+    GHashTable *files;
+
+    guint folder_count;
+    guint folders_without_item_count;
+    guint folder_item_count;
+    guint sized_non_folder_count;
+    goffset non_folder_size;
+    guint flag_counts[NAUTILUS_SELECTION_SUMMARY_N_FLAGS];
+};
+
+static void
+get_file_contribution (NautilusFile     *file,
+                       FileContribution *contribution)
+{
+    *contribution = (FileContribution) { 0 };
+
+    if (nautilus_file_is_directory (file))
+    {
+        contribution->flags |= NAUTILUS_SELECTION_SUMMARY_DIRECTORY;
+        contribution->item_count_known = nautilus_file_get_directory_item_count (file,
+                                                                                 &contribution->item_count,
+                                                                                 NULL);
+    }
+    else if (!nautilus_file_can_get_size (file))
+    {
+        /* Despite its name, this means the size is known */
+        contribution->size_known = TRUE;
+        contribution->size = nautilus_file_get_size (file);
+    }
+
+    if (nautilus_file_is_home (file))
+    {
+        contribution->flags |= NAUTILUS_SELECTION_SUMMARY_HOME;
+    }
+    if (nautilus_file_can_delete (file))
+    {
+        contribution->flags |= NAUTILUS_SELECTION_SUMMARY_CAN_DELETE;
+    }
+    if (nautilus_file_can_trash (file))
+    {
+        contribution->flags |= NAUTILUS_SELECTION_SUMMARY_CAN_TRASH;
+    }
+    if (nautilus_file_can_rename (file))
+    {
+        contribution->flags |= NAUTILUS_SELECTION_SUMMARY_CAN_RENAME;
+    }
+    if (nautilus_file_is_in_trash (file))
+    {
+        contribution->flags |= NAUTILUS_SELECTION_SUMMARY_IN_TRASH;
+    }
+    if (nautilus_file_is_archive (file))
+    {
+        contribution->flags |= NAUTILUS_SELECTION_SUMMARY_ARCHIVE;
+    }
+    if (nautilus_file_can_mount (file) ||
+        nautilus_file_can_unmount (file) ||
+        nautilus_file_can_eject (file) ||
+        nautilus_file_can_start (file) ||
+        nautilus_file_can_start_degraded (file) ||
+        nautilus_file_can_stop (file) ||
+        nautilus_file_can_poll_for_media (file))
+    {
+        contribution->flags |= NAUTILUS_SELECTION_SUMMARY_VOLUME;
+    }
+}
+
+static void
+apply_contribution (NautilusSelectionSummary *summary,
+                    const FileContribution   *contribution,
+                    int                       sign)
+{
+    if (contribution->flags & NAUTILUS_SELECTION_SUMMARY_DIRECTORY)
+    {
+        summary->folder_count += sign;
+        if (contribution->item_count_known)
+        {
+            summary->folder_item_count += sign * (int) contribution->item_count;
+        }
+        else
+        {
+            summary->folders_without_item_count += sign;
+        }
+    }
+    else if (contribution->size_known)
+    {
+        summary->sized_non_folder_count += sign;
+        summary->non_folder_size += sign * contribution->size;
+    }
+
+    for (guint i = 0; i < NAUTILUS_SELECTION_SUMMARY_N_FLAGS; i++)
+    {
+        if (contribution->flags & (1 << i))
+        {
+            summary->flag_counts[i] += sign;
+        }
+    }
+}
+
+NautilusSelectionSummary *
+nautilus_selection_summary_new (void)
+{
+    NautilusSelectionSummary *summary;
+
+    summary = g_new0 (NautilusSelectionSummary, 1);
+    summary->files = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            (GDestroyNotify) nautilus_file_unref,
+                                            g_free);
+
+    return summary;
+}
+
+void
+nautilus_selection_summary_free (NautilusSelectionSummary *summary)
+{
+    if (summary == NULL)
+    {
+        return;
+    }
+
+    g_hash_table_destroy (summary->files);
+    g_free (summary);
+}
+
+void
+nautilus_selection_summary_add_file (NautilusSelectionSummary *summary,
+                                     NautilusFile             *file)
+{
+    FileContribution *contribution;
+
+    g_return_if_fail (summary != NULL);
+    g_return_if_fail (NAUTILUS_IS_FILE (file));
+
+    if (g_hash_table_contains (summary->files, file))
+    {
+        return;
+    }
+
+    contribution = g_new (FileContribution, 1);
+    get_file_contribution (file, contribution);
+    apply_contribution (summary, contribution, 1);
+    g_hash_table_insert (summary->files, nautilus_file_ref (file), contribution);
+}
+
+void
+nautilus_selection_summary_remove_file (NautilusSelectionSummary *summary,
+                                        NautilusFile             *file)
+{
+    FileContribution *contribution;
+
+    g_return_if_fail (summary != NULL);
+
+    contribution = g_hash_table_lookup (summary->files, file);
+    if (contribution == NULL)
+    {
+        return;
+    }
+
+    apply_contribution (summary, contribution, -1);
+    g_hash_table_remove (summary->files, file);
+}
+
+/* Recomputes what @file adds to the totals, after it changed. Returns %TRUE
+ * if @file is part of @summary.
+ */
+gboolean
+nautilus_selection_summary_update_file (NautilusSelectionSummary *summary,
+                                        NautilusFile             *file)
+{
+    FileContribution *contribution;
+
+    g_return_val_if_fail (summary != NULL, FALSE);
+
+    contribution = g_hash_table_lookup (summary->files, file);
+    if (contribution == NULL)
+    {
+        return FALSE;
+    }
+
+    apply_contribution (summary, contribution, -1);
+    get_file_contribution (file, contribution);
+    apply_contribution (summary, contribution, 1);
+
+    return TRUE;
+}
+
+void
+nautilus_selection_summary_clear (NautilusSelectionSummary *summary)
+{
+    g_return_if_fail (summary != NULL);
+
+    g_hash_table_remove_all (summary->files);
+    summary->folder_count = 0;
+    summary->folders_without_item_count = 0;
+    summary->folder_item_count = 0;
+    summary->sized_non_folder_count = 0;
+    summary->non_folder_size = 0;
+    memset (summary->flag_counts, 0, sizeof (summary->flag_counts));
+}
+
+guint
+nautilus_selection_summary_get_count (const NautilusSelectionSummary *summary)
+{
+    g_return_val_if_fail (summary != NULL, 0);
+
+    return g_hash_table_size (summary->files);
+}
+
+/* Returns one of the files, or %NULL if there are none. Meant for when there
+ * is a single one. */
+NautilusFile *
+nautilus_selection_summary_get_any_file (const NautilusSelectionSummary *summary)
+{
+    GHashTableIter iter;
+    gpointer file = NULL;
+
+    g_return_val_if_fail (summary != NULL, NULL);
+
+    g_hash_table_iter_init (&iter, summary->files);
+    g_hash_table_iter_next (&iter, &file, NULL);
+
+    return file;
+}
+
+guint
+nautilus_selection_summary_get_folder_count (const NautilusSelectionSummary *summary)
+{
+    g_return_val_if_fail (summary != NULL, 0);
+
+    return summary->folder_count;
+}
+
+/* Returns %FALSE if the item count of some folder is not known yet. */
+gboolean
+nautilus_selection_summary_get_folder_item_count (const NautilusSelectionSummary *summary,
+                                                  guint                          *item_count)
+{
+    g_return_val_if_fail (summary != NULL, FALSE);
+
+    *item_count = summary->folder_item_count;
+
+    return summary->folders_without_item_count == 0;
+}
+
+/* Returns %FALSE if the size of none of the files that are not folders is
+ * known.
+ */
+gboolean
+nautilus_selection_summary_get_non_folder_size (const NautilusSelectionSummary *summary,
+                                                goffset                        *size)
+{
+    g_return_val_if_fail (summary != NULL, FALSE);
+
+    *size = summary->non_folder_size;
+
+    return summary->sized_non_folder_count > 0;
+}
+
+static guint
+get_flag_count (const NautilusSelectionSummary *summary,
+                NautilusSelectionSummaryFlags   flag)
+{
+    g_return_val_if_fail (flag != 0 && (flag & (flag - 1)) == 0, 0);
+
+    return summary->flag_counts[g_bit_nth_lsf (flag, -1)];
+}
+
+/* Whether all the files have @flag, which is also the case when there are
+ * no files at all.
+ */
+gboolean
+nautilus_selection_summary_all (const NautilusSelectionSummary *summary,
+                                NautilusSelectionSummaryFlags   flag)
+{
+    g_return_val_if_fail (summary != NULL, FALSE);
+
+    return get_flag_count (summary, flag) == g_hash_table_size (summary->files);
+}
+
+gboolean
+nautilus_selection_summary_any (const NautilusSelectionSummary *summary,
+                                NautilusSelectionSummaryFlags   flag)
+{
+    g_return_val_if_fail (summary != NULL, FALSE);
+
+    return get_flag_count (summary, flag) > 0;
+}
@@ -0,0 +1,75 @@
+/* nautilus-selection-summary.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <glib.h>
+
+#include "nautilus-types.h"
+
+G_BEGIN_DECLS
+
+/* Running totals over the files of a selection: counts, sizes, and how many
+ * of the files have each of the properties the view actions depend on. Files
+ * are added and removed as the selection changes, and updated when they
+ * change, so reading the totals does not need to go over the selection.
+ */
+typedef struct _NautilusSelectionSummary NautilusSelectionSummary;
+
+typedef enum
+{
+    NAUTILUS_SELECTION_SUMMARY_DIRECTORY  = 1 << 0,
+    NAUTILUS_SELECTION_SUMMARY_HOME       = 1 << 1,
+    NAUTILUS_SELECTION_SUMMARY_CAN_DELETE = 1 << 2,
+    NAUTILUS_SELECTION_SUMMARY_CAN_TRASH  = 1 << 3,
+    NAUTILUS_SELECTION_SUMMARY_CAN_RENAME = 1 << 4,
+    NAUTILUS_SELECTION_SUMMARY_IN_TRASH   = 1 << 5,
+    NAUTILUS_SELECTION_SUMMARY_ARCHIVE    = 1 << 6,
+    /* Can be mounted, unmounted, ejected, started, stopped or polled */
+    NAUTILUS_SELECTION_SUMMARY_VOLUME     = 1 << 7,
+} NautilusSelectionSummaryFlags;
+
+#define NAUTILUS_SELECTION_SUMMARY_N_FLAGS 8
+
+NautilusSelectionSummary *nautilus_selection_summary_new                  (void);
+void                      nautilus_selection_summary_free                 (NautilusSelectionSummary       *summary);
+
+void                      nautilus_selection_summary_add_file             (NautilusSelectionSummary       *summary,
+                                                                           NautilusFile                   *file);
+void                      nautilus_selection_summary_remove_file          (NautilusSelectionSummary       *summary,
+                                                                           NautilusFile                   *file);
+gboolean                  nautilus_selection_summary_update_file          (NautilusSelectionSummary       *summary,
+                                                                           NautilusFile                   *file);
+void                      nautilus_selection_summary_clear                (NautilusSelectionSummary       *summary);
+
+guint                     nautilus_selection_summary_get_count            (const NautilusSelectionSummary *summary);
+NautilusFile             *nautilus_selection_summary_get_any_file         (const NautilusSelectionSummary *summary);
+guint                     nautilus_selection_summary_get_folder_count     (const NautilusSelectionSummary *summary);
+gboolean                  nautilus_selection_summary_get_folder_item_count (const NautilusSelectionSummary *summary,
+                                                                           guint                          *item_count);
+gboolean                  nautilus_selection_summary_get_non_folder_size  (const NautilusSelectionSummary *summary,
+                                                                           goffset                        *size);
+
+gboolean                  nautilus_selection_summary_all                  (const NautilusSelectionSummary *summary,
+                                                                           NautilusSelectionSummaryFlags   flag);
+gboolean                  nautilus_selection_summary_any                  (const NautilusSelectionSummary *summary,
+                                                                           NautilusSelectionSummaryFlags   flag);
+
+G_DEFINE_AUTOPTR_CLEANUP_FUNC (NautilusSelectionSummary, nautilus_selection_summary_free)
+
+G_END_DECLS
@@ -39,6 +39,9 @@
 #include "nautilus-shell-search-provider-generated.h"
 #include "nautilus-shell-search-provider.h"
 
+/* The shell shows only a few results, so only the best ones are looked for */
+#define MAX_RESULTS 100
+
 typedef struct
 {
     NautilusShellSearchProvider *self;
@@ -46,10 +49,13 @@ typedef struct
     NautilusSearchEngine *engine;
     NautilusQuery *query;
 
+    /* Hits of the search engine, and of bookmarks and mounts, by URI */
     GHashTable *hits;
+    GHashTable *places;
     GDBusMethodInvocation *invocation;
 
     gint64 start_time;
+    gboolean cancelled;
 } PendingSearch;
 
 struct _NautilusShellSearchProvider
@@ -60,6 +66,12 @@ struct _NautilusShellSearchProvider
 
     PendingSearch *current_search;
 
+    /* The last search that completed, and the hits the search engine found
+     * for it, to answer narrower subsearches from.
+     */
+    NautilusQuery *last_query;
+    GHashTable *last_hits;
+
     GHashTable *metas_cache;
 };
 
@@ -113,10 +125,31 @@ get_gicon (NautilusShellSearchProvider *self,
     }
 }
 
+static PendingSearch *
+pending_search_new (NautilusShellSearchProvider *self,
+                    GDBusMethodInvocation       *invocation,
+                    NautilusQuery               *query)
+{
+    PendingSearch *search;
+
+    search = g_slice_new0 (PendingSearch);
+    search->invocation = g_object_ref (invocation);
+    search->hits = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+    search->places = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
+    search->query = query;
+    search->start_time = g_get_monotonic_time ();
+    search->self = self;
+
+    g_application_hold (g_application_get_default ());
+
+    return search;
+}
+
 static void
 pending_search_free (PendingSearch *search)
 {
-    g_hash_table_destroy (search->hits);
+    g_hash_table_unref (search->hits);
+    g_hash_table_destroy (search->places);
     g_clear_object (&search->query);
     g_clear_object (&search->engine);
     g_clear_object (&search->invocation);
@@ -147,6 +180,7 @@ cancel_current_search (NautilusShellSearchProvider *self)
 {
     if (self->current_search != NULL)
     {
+        self->current_search->cancelled = TRUE;
         nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (self->current_search->engine));
     }
 }
@@ -157,21 +191,26 @@ search_hits_added_cb (NautilusSearchEngine *engine,
                       gpointer              user_data)
 {
     PendingSearch *search = user_data;
+    NautilusSearchHitScoring scoring;
     GList *l;
     NautilusSearchHit *hit;
     const gchar *hit_uri;
 
     g_debug ("*** Search engine hits added");
 
+    nautilus_search_hit_scoring_init (&scoring, search->query);
+
     for (l = hits; l != NULL; l = l->next)
     {
         hit = l->data;
-        nautilus_search_hit_compute_scores (hit, search->query);
+        nautilus_search_hit_compute_scores (hit, &scoring);
         hit_uri = nautilus_search_hit_get_uri (hit);
         g_debug ("    %s", hit_uri);
 
         g_hash_table_replace (search->hits, g_strdup (hit_uri), g_object_ref (hit));
     }
+
+    nautilus_search_hit_scoring_clear (&scoring);
 }
 
 static gint
@@ -205,8 +244,12 @@ search_finished_cb (NautilusSearchEngine         *engine,
                     gpointer                      user_data)
 {
     PendingSearch *search = user_data;
+    NautilusShellSearchProvider *self = search->self;
     GList *hits, *l;
     NautilusSearchHit *hit;
+    GHashTableIter iter;
+    gpointer uri;
+    gpointer place;
     GVariantBuilder builder;
     gint64 current_time;
 
@@ -214,7 +257,26 @@ search_finished_cb (NautilusSearchEngine         *engine,
     g_debug ("*** Search engine search finished - time elapsed %dms",
              (gint) ((current_time - search->start_time) / 1000));
 
+    /* A stopped search may have missed some files, and so may one that
+     * found as many as it keeps */
+    if (!search->cancelled &&
+        g_hash_table_size (search->hits) < MAX_RESULTS)
+    {
+        g_clear_object (&self->last_query);
+        g_clear_pointer (&self->last_hits, g_hash_table_unref);
+        self->last_query = g_object_ref (search->query);
+        self->last_hits = g_hash_table_ref (search->hits);
+    }
+
     hits = g_hash_table_get_values (search->hits);
+    g_hash_table_iter_init (&iter, search->places);
+    while (g_hash_table_iter_next (&iter, &uri, &place))
+    {
+        if (!g_hash_table_contains (search->hits, uri))
+        {
+            hits = g_list_prepend (hits, place);
+        }
+    }
     hits = g_list_sort (hits, search_hit_compare_relevance);
 
     g_variant_builder_init (&builder, G_VARIANT_TYPE ("as"));
@@ -274,6 +336,7 @@ static void
 search_add_volumes_and_bookmarks (PendingSearch *search)
 {
     NautilusSearchHit *hit;
+    NautilusSearchHitScoring scoring;
     NautilusBookmark *bookmark;
     const gchar *name;
     gchar *string, *uri;
@@ -407,6 +470,7 @@ search_add_volumes_and_bookmarks (PendingSearch *search)
 
     /* now do the actual string matching */
     candidates = g_list_reverse (candidates);
+    nautilus_search_hit_scoring_init (&scoring, search->query);
 
     for (l = candidates; l != NULL; l = l->next)
     {
@@ -418,10 +482,11 @@ search_add_volumes_and_bookmarks (PendingSearch *search)
         {
             hit = nautilus_search_hit_new (candidate->uri);
             nautilus_search_hit_set_fts_rank (hit, match);
-            nautilus_search_hit_compute_scores (hit, search->query);
-            g_hash_table_replace (search->hits, g_strdup (candidate->uri), hit);
+            nautilus_search_hit_compute_scores (hit, &scoring);
+            g_hash_table_replace (search->places, g_strdup (candidate->uri), hit);
         }
     }
+    nautilus_search_hit_scoring_clear (&scoring);
     g_list_free_full (candidates, (GDestroyNotify) search_hit_candidate_free);
     g_object_unref (volume_monitor);
 }
@@ -439,6 +504,8 @@ shell_query_new (gchar **terms)
     query = nautilus_query_new ();
     nautilus_query_set_text (query, terms_joined);
     nautilus_query_set_location (query, home);
+    nautilus_query_set_recursive (query, NAUTILUS_QUERY_RECURSIVE_INDEXED_ONLY);
+    nautilus_query_set_show_hidden_files (query, FALSE);
 
     return query;
 }
@@ -462,16 +529,10 @@ execute_search (NautilusShellSearchProvider  *self,
     }
 
     query = shell_query_new (terms);
-    nautilus_query_set_recursive (query, NAUTILUS_QUERY_RECURSIVE_INDEXED_ONLY);
-    nautilus_query_set_show_hidden_files (query, FALSE);
 
-    pending_search = g_slice_new0 (PendingSearch);
-    pending_search->invocation = g_object_ref (invocation);
-    pending_search->hits = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, g_object_unref);
-    pending_search->query = query;
+    pending_search = pending_search_new (self, invocation, query);
     pending_search->engine = nautilus_search_engine_new ();
-    pending_search->start_time = g_get_monotonic_time ();
-    pending_search->self = self;
+    nautilus_search_engine_set_max_results (pending_search->engine, MAX_RESULTS);
 
     g_signal_connect (pending_search->engine, "hits-added",
                       G_CALLBACK (search_hits_added_cb), pending_search);
@@ -481,7 +542,6 @@ execute_search (NautilusShellSearchProvider  *self,
                       G_CALLBACK (search_error_cb), pending_search);
 
     self->current_search = pending_search;
-    g_application_hold (g_application_get_default ());
 
     search_add_volumes_and_bookmarks (pending_search);
 
@@ -492,6 +552,64 @@ execute_search (NautilusShellSearchProvider  *self,
     nautilus_search_provider_start (NAUTILUS_SEARCH_PROVIDER (pending_search->engine));
 }
 
+/* Answers a search for @terms by filtering the hits of the last search, if
+ * it narrows it, as when more letters are typed. Otherwise returns %FALSE,
+ * and the search engine has to be asked.
+ */
+static gboolean
+execute_subsearch (NautilusShellSearchProvider  *self,
+                   GDBusMethodInvocation        *invocation,
+                   gchar                       **terms)
+{
+    NautilusQuery *query;
+    PendingSearch *pending_search;
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    g_autoptr (NautilusQueryMatcher) previous_matcher = NULL;
+    NautilusSearchHitScoring scoring;
+    GHashTableIter iter;
+    gpointer uri;
+    gpointer hit;
+
+    if (self->current_search != NULL || self->last_query == NULL)
+    {
+        return FALSE;
+    }
+
+    query = shell_query_new (terms);
+    if (!nautilus_query_is_narrowing (query, self->last_query))
+    {
+        g_object_unref (query);
+        return FALSE;
+    }
+
+    pending_search = pending_search_new (self, invocation, query);
+
+    matcher = nautilus_query_get_matcher (query);
+    previous_matcher = nautilus_query_get_matcher (self->last_query);
+    nautilus_search_hit_scoring_init (&scoring, query);
+
+    g_hash_table_iter_init (&iter, self->last_hits);
+    while (g_hash_table_iter_next (&iter, &uri, &hit))
+    {
+        if (nautilus_search_hit_narrow (hit, matcher, previous_matcher))
+        {
+            nautilus_search_hit_compute_scores (hit, &scoring);
+            g_hash_table_replace (pending_search->hits, g_strdup (uri), g_object_ref (hit));
+        }
+    }
+
+    nautilus_search_hit_scoring_clear (&scoring);
+
+    g_debug ("*** Search narrowed from %u to %u hits",
+             g_hash_table_size (self->last_hits),
+             g_hash_table_size (pending_search->hits));
+
+    search_add_volumes_and_bookmarks (pending_search);
+    search_finished_cb (NULL, NAUTILUS_SEARCH_PROVIDER_STATUS_NORMAL, pending_search);
+
+    return TRUE;
+}
+
 static gboolean
 handle_get_initial_result_set (NautilusShellSearchProvider2  *skeleton,
                                GDBusMethodInvocation         *invocation,
@@ -515,7 +633,10 @@ handle_get_subsearch_result_set (NautilusShellSearchProvider2  *skeleton,
     NautilusShellSearchProvider *self = user_data;
 
     g_debug ("****** GetSubSearchResultSet");
-    execute_search (self, invocation, terms);
+    if (!execute_subsearch (self, invocation, terms))
+    {
+        execute_search (self, invocation, terms);
+    }
     return TRUE;
 }
 
@@ -755,6 +876,8 @@ search_provider_dispose (GObject *obj)
     g_clear_object (&self->skeleton);
     g_hash_table_destroy (self->metas_cache);
     cancel_current_search (self);
+    g_clear_object (&self->last_query);
+    g_clear_pointer (&self->last_hits, g_hash_table_unref);
 
     G_OBJECT_CLASS (nautilus_shell_search_provider_parent_class)->dispose (obj);
 }
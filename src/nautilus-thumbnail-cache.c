@@ -0,0 +1,484 @@
+/* nautilus-thumbnail-cache.c
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#include "config.h"
+#include "nautilus-thumbnail-cache.h"
+
+#include <gio/gio.h>
+#include <math.h>
+#include <string.h>
+
+#define DEBUG_FLAG NAUTILUS_DEBUG_THUMBNAILS
+#include "nautilus-debug.h"
+
+#include "nautilus-file-private.h"
+#include "nautilus-global-preferences.h"
+
+/* Scaled copies kept per thumbnail. Enough for every zoom level of a view
+ * type, or for a couple of views and scale factors showing the same file.
+ */
+#define MAX_SCALED_THUMBNAILS 6
+
+typedef struct
+{
+    GdkPixbuf *pixbuf;
+    double thumb_scale;
+} ScaledThumbnail;
+
+typedef struct
+{
+    /* Not referenced; files remove themselves when finalized */
+    NautilusFile *file;
+
+    GdkPixbuf *thumbnail;
+
+    /* Most recently used first */
+    ScaledThumbnail scaled[MAX_SCALED_THUMBNAILS];
+    guint n_scaled;
+
+    gsize cost;
+
+    /* Views showing the file. Their thumbnails are never evicted. */
+    guint n_views;
+
+    /* Link in the LRU queue, while there is a thumbnail and no view shows
+     * it, so that evicting never has to skip over visible thumbnails */
+    GList *link;
+} CacheEntry;
+
+typedef struct
+{
+    /* NautilusFile to CacheEntry */
+    GHashTable *entries;
+
+    /* CacheEntry that can be evicted, least recently used first */
+    GQueue lru;
+
+    gsize size;
+    gsize budget;
+
+    GMemoryMonitor *memory_monitor;
+} ThumbnailCache;
+
+static ThumbnailCache *cache = NULL;
+
+static void
+entry_clear_thumbnail (CacheEntry *entry)
+{
+    guint i;
+
+    g_clear_object (&entry->thumbnail);
+    for (i = 0; i < entry->n_scaled; i++)
+    {
+        g_clear_object (&entry->scaled[i].pixbuf);
+    }
+    entry->n_scaled = 0;
+
+    cache->size -= entry->cost;
+    entry->cost = 0;
+
+    if (entry->link != NULL)
+    {
+        g_queue_delete_link (&cache->lru, entry->link);
+        entry->link = NULL;
+    }
+}
+
+static void
+entry_free (CacheEntry *entry)
+{
+    entry_clear_thumbnail (entry);
+    g_free (entry);
+}
+
+static void
+entry_update_cost (CacheEntry *entry)
+{
+    gsize cost = 0;
+    guint i;
+
+    if (entry->thumbnail != NULL)
+    {
+        cost += gdk_pixbuf_get_byte_length (entry->thumbnail);
+    }
+    for (i = 0; i < entry->n_scaled; i++)
+    {
+        cost += gdk_pixbuf_get_byte_length (entry->scaled[i].pixbuf);
+    }
+
+    cache->size = cache->size - entry->cost + cost;
+    entry->cost = cost;
+}
+
+static void
+entry_push_to_lru (CacheEntry *entry)
+{
+    g_queue_push_tail (&cache->lru, entry);
+    entry->link = cache->lru.tail;
+}
+
+static void
+entry_touch (CacheEntry *entry)
+{
+    if (entry->link == NULL || entry->link == cache->lru.tail)
+    {
+        return;
+    }
+
+    g_queue_unlink (&cache->lru, entry->link);
+    g_queue_push_tail_link (&cache->lru, entry->link);
+}
+
+static void
+evict_entry (CacheEntry *entry)
+{
+    NautilusFile *file = entry->file;
+
+    DEBUG ("Evicting thumbnail of %p, %" G_GSIZE_FORMAT " bytes", file, entry->cost);
+
+    entry_clear_thumbnail (entry);
+    if (entry->n_views == 0)
+    {
+        g_hash_table_remove (cache->entries, file);
+    }
+
+    /* Read it again from the thumbnail store when it is next needed */
+    file->details->thumbnail_was_evicted = TRUE;
+}
+
+/* Evicts thumbnails of files that are not visible, least recently used
+ * first, until the cache holds at most @size bytes. Visible thumbnails
+ * are kept even if that is over @size.
+ */
+static void
+trim_to_size (gsize size)
+{
+    while (cache->lru.head != NULL && cache->size > size)
+    {
+        evict_entry (cache->lru.head->data);
+    }
+}
+
+static void
+thumbnail_cache_size_changed_callback (gpointer callback_data)
+{
+    guint64 megabytes;
+
+    megabytes = g_settings_get_uint64 (nautilus_preferences,
+                                       NAUTILUS_PREFERENCES_THUMBNAIL_CACHE_SIZE);
+    cache->budget = megabytes * 1024 * 1024;
+    trim_to_size (cache->budget);
+}
+
+static void
+on_low_memory_warning (GMemoryMonitor             *monitor,
+                       GMemoryMonitorWarningLevel  level,
+                       gpointer                    user_data)
+{
+    DEBUG ("Low memory warning, level %d, cache holds %" G_GSIZE_FORMAT " bytes",
+           level, cache->size);
+
+    if (level >= G_MEMORY_MONITOR_WARNING_LEVEL_MEDIUM)
+    {
+        trim_to_size (0);
+    }
+    else
+    {
+        trim_to_size (MIN (cache->size, cache->budget) / 2);
+    }
+}
+
+static void
+ensure_cache (void)
+{
+    if (cache != NULL)
+    {
+        return;
+    }
+
+    cache = g_new0 (ThumbnailCache, 1);
+    cache->entries = g_hash_table_new_full (g_direct_hash, g_direct_equal,
+                                            NULL, (GDestroyNotify) entry_free);
+    g_queue_init (&cache->lru);
+
+    g_signal_connect_swapped (nautilus_preferences,
+                              "changed::" NAUTILUS_PREFERENCES_THUMBNAIL_CACHE_SIZE,
+                              G_CALLBACK (thumbnail_cache_size_changed_callback),
+                              NULL);
+    thumbnail_cache_size_changed_callback (NULL);
+
+    cache->memory_monitor = g_memory_monitor_dup_default ();
+    g_signal_connect (cache->memory_monitor, "low-memory-warning",
+                      G_CALLBACK (on_low_memory_warning), NULL);
+}
+
+static CacheEntry *
+lookup_entry (NautilusFile *file)
+{
+    if (cache == NULL)
+    {
+        return NULL;
+    }
+
+    return g_hash_table_lookup (cache->entries, file);
+}
+
+static CacheEntry *
+ensure_entry (NautilusFile *file)
+{
+    CacheEntry *entry;
+
+    ensure_cache ();
+
+    entry = g_hash_table_lookup (cache->entries, file);
+    if (entry == NULL)
+    {
+        entry = g_new0 (CacheEntry, 1);
+        entry->file = file;
+        g_hash_table_insert (cache->entries, file, entry);
+    }
+
+    return entry;
+}
+
+/* Returns the thumbnail of @file, if loaded, and marks it as recently used. */
+GdkPixbuf *
+nautilus_thumbnail_cache_lookup (NautilusFile *file)
+{
+    CacheEntry *entry;
+
+    entry = lookup_entry (file);
+    if (entry == NULL)
+    {
+        return NULL;
+    }
+
+    entry_touch (entry);
+
+    return entry->thumbnail;
+}
+
+/* Like nautilus_thumbnail_cache_lookup(), without marking it as used. */
+GdkPixbuf *
+nautilus_thumbnail_cache_peek (NautilusFile *file)
+{
+    CacheEntry *entry;
+
+    entry = lookup_entry (file);
+
+    return entry != NULL ? entry->thumbnail : NULL;
+}
+
+/* Moves the scaled copy at @index to the front, as the most recently used. */
+static void
+entry_use_scaled (CacheEntry *entry,
+                  guint       index)
+{
+    ScaledThumbnail used;
+
+    used = entry->scaled[index];
+    memmove (&entry->scaled[1], &entry->scaled[0], index * sizeof (ScaledThumbnail));
+    entry->scaled[0] = used;
+}
+
+/* Returns the copy of the thumbnail of @file scaled by @thumb_scale, if
+ * there is one. Otherwise, sets @closest, if given, to the copy whose scale
+ * is closest, to show until the right one is made.
+ */
+GdkPixbuf *
+nautilus_thumbnail_cache_get_scaled (NautilusFile  *file,
+                                     double         thumb_scale,
+                                     GdkPixbuf    **closest)
+{
+    CacheEntry *entry;
+    guint i;
+    guint closest_index = 0;
+
+    if (closest != NULL)
+    {
+        *closest = NULL;
+    }
+
+    entry = lookup_entry (file);
+    if (entry == NULL || entry->n_scaled == 0)
+    {
+        return NULL;
+    }
+
+    for (i = 0; i < entry->n_scaled; i++)
+    {
+        if (entry->scaled[i].thumb_scale == thumb_scale)
+        {
+            entry_use_scaled (entry, i);
+            return entry->scaled[0].pixbuf;
+        }
+
+        if (fabs (entry->scaled[i].thumb_scale - thumb_scale) <
+            fabs (entry->scaled[closest_index].thumb_scale - thumb_scale))
+        {
+            closest_index = i;
+        }
+    }
+
+    if (closest != NULL)
+    {
+        *closest = entry->scaled[closest_index].pixbuf;
+    }
+
+    return NULL;
+}
+
+/* Sets the thumbnail of @file, dropping any scaled copy of the previous
+ * one. Passing %NULL forgets the thumbnail.
+ */
+void
+nautilus_thumbnail_cache_insert (NautilusFile *file,
+                                 GdkPixbuf    *thumbnail)
+{
+    CacheEntry *entry;
+
+    if (thumbnail == NULL)
+    {
+        entry = lookup_entry (file);
+        if (entry != NULL && entry->n_views > 0)
+        {
+            entry_clear_thumbnail (entry);
+        }
+        else if (entry != NULL)
+        {
+            g_hash_table_remove (cache->entries, file);
+        }
+        return;
+    }
+
+    entry = ensure_entry (file);
+    entry_clear_thumbnail (entry);
+
+    entry->thumbnail = g_object_ref (thumbnail);
+    entry_update_cost (entry);
+    if (entry->n_views == 0)
+    {
+        entry_push_to_lru (entry);
+    }
+
+    file->details->thumbnail_was_evicted = FALSE;
+
+    trim_to_size (cache->budget);
+}
+
+/* Stores a scaled copy of @thumbnail, if it is still the thumbnail of
+ * @file, replacing the least recently used copy if there are too many.
+ * Returns whether it was stored.
+ */
+gboolean
+nautilus_thumbnail_cache_add_scaled (NautilusFile *file,
+                                     GdkPixbuf    *thumbnail,
+                                     GdkPixbuf    *scaled_thumbnail,
+                                     double        thumb_scale)
+{
+    CacheEntry *entry;
+    guint i;
+
+    entry = lookup_entry (file);
+    if (entry == NULL || entry->thumbnail == NULL || entry->thumbnail != thumbnail)
+    {
+        return FALSE;
+    }
+
+    for (i = 0; i < entry->n_scaled; i++)
+    {
+        if (entry->scaled[i].thumb_scale == thumb_scale)
+        {
+            break;
+        }
+    }
+
+    if (i == entry->n_scaled)
+    {
+        if (entry->n_scaled < MAX_SCALED_THUMBNAILS)
+        {
+            entry->n_scaled++;
+        }
+        i = entry->n_scaled - 1;
+        entry->scaled[i].thumb_scale = thumb_scale;
+    }
+
+    g_set_object (&entry->scaled[i].pixbuf, scaled_thumbnail);
+    entry_use_scaled (entry, i);
+    entry_update_cost (entry);
+    entry_touch (entry);
+
+    trim_to_size (cache->budget);
+
+    return TRUE;
+}
+
+/* Forgets everything about @file, which is being finalized. */
+void
+nautilus_thumbnail_cache_remove (NautilusFile *file)
+{
+    if (cache != NULL)
+    {
+        g_hash_table_remove (cache->entries, file);
+    }
+}
+
+/* Each view showing @file calls this with %TRUE when it starts showing it,
+ * and with %FALSE when it stops, so that the thumbnail is not evicted while
+ * any view shows it.
+ */
+void
+nautilus_thumbnail_cache_set_visible (NautilusFile *file,
+                                      gboolean      visible)
+{
+    CacheEntry *entry;
+
+    if (visible)
+    {
+        entry = ensure_entry (file);
+        entry->n_views++;
+        if (entry->link != NULL)
+        {
+            g_queue_delete_link (&cache->lru, entry->link);
+            entry->link = NULL;
+        }
+        return;
+    }
+
+    entry = lookup_entry (file);
+    g_return_if_fail (entry != NULL && entry->n_views > 0);
+
+    entry->n_views--;
+    if (entry->n_views > 0)
+    {
+        return;
+    }
+
+    if (entry->thumbnail == NULL)
+    {
+        g_hash_table_remove (cache->entries, file);
+        return;
+    }
+
+    /* Just seen, so the most recently used of the ones that can go */
+    entry_push_to_lru (entry);
+    if (cache->size > cache->budget)
+    {
+        trim_to_size (cache->budget);
+    }
+}
@@ -0,0 +1,57 @@
+/* nautilus-thumbnail-cache.h
+ *
+ * This program is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * This program is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ * SPDX-License-Identifier: GPL-3.0-or-later
+ */
+
+#pragma once
+
+#include <gdk-pixbuf/gdk-pixbuf.h>
+
+#include "nautilus-types.h"
+
+G_BEGIN_DECLS
+
+/* Process-wide cache of loaded thumbnails, and of a few copies of each
+ * scaled for display at different zoom levels, keyed by NautilusFile. It
+ * holds at most the number of bytes set in the thumbnail-cache-size
+ * preference, evicting the least recently used thumbnails of files that are
+ * not visible in any view first, and it shrinks when the system reports low
+ * memory.
+ *
+ * An evicted thumbnail is read again from the thumbnail store the next time
+ * the file's icon is asked for.
+ *
+ * To be used from the main thread only.
+ */
+
+GdkPixbuf *nautilus_thumbnail_cache_lookup      (NautilusFile *file);
+GdkPixbuf *nautilus_thumbnail_cache_peek        (NautilusFile *file);
+GdkPixbuf *nautilus_thumbnail_cache_get_scaled  (NautilusFile  *file,
+                                                 double         thumb_scale,
+                                                 GdkPixbuf    **closest);
+
+void       nautilus_thumbnail_cache_insert      (NautilusFile *file,
+                                                 GdkPixbuf    *thumbnail);
+gboolean   nautilus_thumbnail_cache_add_scaled  (NautilusFile *file,
+                                                 GdkPixbuf    *thumbnail,
+                                                 GdkPixbuf    *scaled_thumbnail,
+                                                 double        thumb_scale);
+void       nautilus_thumbnail_cache_remove      (NautilusFile *file);
+
+void       nautilus_thumbnail_cache_set_visible (NautilusFile *file,
+                                                 gboolean      visible);
+
+G_END_DECLS
@@ -40,6 +40,7 @@
 #include <sys/wait.h>
 #include <unistd.h>
 #include <signal.h>
+#include <gexiv2/gexiv2.h>
 #include <libgnome-desktop/gnome-desktop-thumbnail.h>
 #define DEBUG_FLAG NAUTILUS_DEBUG_THUMBNAILS
 #include "nautilus-debug.h"
@@ -52,10 +53,14 @@
 /* Cool-off period between last file modification time and thumbnail creation */
 #define THUMBNAIL_CREATION_DELAY_SECS 3
 
-static void thumbnail_thread_func (GTask        *task,
-                                   gpointer      source_object,
-                                   gpointer      task_data,
-                                   GCancellable *cancellable);
+/* Size of the thumbnails we make, GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE */
+#define THUMBNAIL_SIZE 256
+
+/* Upper bound for the automatic number of thumbnail threads. Most of the
+ * work happens in thumbnailer processes, which can use lots of memory. */
+#define MAX_AUTOMATIC_THUMBNAIL_THREADS 8
+
+static gpointer thumbnail_thread_func (gpointer data);
 
 /* structure used for making thumbnails, associating a uri with where the thumbnail is to be stored */
 
@@ -64,36 +69,47 @@ typedef struct
     char *image_uri;
     char *mime_type;
     time_t original_file_mtime;
+
+    /* The queue the info is in, or NULL while a thread is making the
+     * thumbnail. */
+    GQueue *queue;
 } NautilusThumbnailInfo;
 
 /*
  * Thumbnail thread state.
  */
 
-/* The id of the idle handler used to start the thumbnail thread, or 0 if no
+/* The id of the idle handler used to start thumbnail threads, or 0 if no
  *  idle handler is currently registered. */
 static guint thumbnail_thread_starter_id = 0;
 
+/* Set once gexiv2 is ready to read embedded previews */
+static gboolean gexiv2_initialized = FALSE;
+
 /* Our mutex used when accessing data shared between the main thread and the
- *  thumbnail thread, i.e. the thumbnail_thread_is_running flag and the
- *  thumbnails_to_make list. */
+ *  thumbnail threads, i.e. the thread counts and the queues. */
 static GMutex thumbnails_mutex;
 
-/* A flag to indicate whether a thumbnail thread is running, so we don't
- *  start more than one. Lock thumbnails_mutex when accessing this. */
-static volatile gboolean thumbnail_thread_is_running = FALSE;
-
-/* The list of NautilusThumbnailInfo structs containing information about the
- *  thumbnails we are making. Lock thumbnails_mutex when accessing this. */
-static volatile GQueue thumbnails_to_make = G_QUEUE_INIT;
-
-/* Quickly check if uri is in thumbnails_to_make list */
+/* How many thumbnail threads are running, and how many may run at once.
+ *  Lock thumbnails_mutex when accessing these. */
+static guint n_thumbnail_threads = 0;
+static guint max_thumbnail_threads = 1;
+
+/* The NautilusThumbnailInfo structs of the thumbnails waiting to be made.
+ *  Threads take the ones that are visible in a view first, most recently
+ *  prioritized first, then the ones a view is about to scroll to, and then
+ *  the others in the order they were requested.
+ *  Lock thumbnails_mutex when accessing these. */
+static GQueue visible_thumbnails_to_make = G_QUEUE_INIT;
+static GQueue prefetched_thumbnails_to_make = G_QUEUE_INIT;
+static GQueue thumbnails_to_make = G_QUEUE_INIT;
+
+/* Maps uris to the list link holding their NautilusThumbnailInfo, either in
+ *  one of the queues or, while the thumbnail is being made, owned by the
+ *  thread making it, so that it is not added again meanwhile. Lock
+ *  thumbnails_mutex when accessing this. */
 static GHashTable *thumbnails_to_make_hash = NULL;
 
-/* The currently thumbnailed icon. it also exists in the thumbnails_to_make list
- * to avoid adding it again. Lock thumbnails_mutex when accessing this. */
-static NautilusThumbnailInfo *currently_thumbnailing = NULL;
-
 static gboolean
 get_file_mtime (const char *file_uri,
                 time_t     *mtime)
@@ -144,36 +160,76 @@ get_thumbnail_factory (void)
 }
 
 
+static guint
+get_max_thumbnail_threads (void)
+{
+    int threads;
+
+    threads = g_settings_get_int (nautilus_preferences,
+                                  NAUTILUS_PREFERENCES_THUMBNAIL_THREADS);
+    if (threads > 0)
+    {
+        return threads;
+    }
+
+    /* Leave a processor for the rest of the desktop */
+    return CLAMP (g_get_num_processors () - 1, 1, MAX_AUTOMATIC_THUMBNAIL_THREADS);
+}
+
+static guint
+get_n_thumbnails_to_make (void)
+{
+    return visible_thumbnails_to_make.length +
+           prefetched_thumbnails_to_make.length +
+           thumbnails_to_make.length;
+}
+
 /* This function is added as a very low priority idle function to start the
- *  thread to create any needed thumbnails. It is added with a very low priority
+ *  threads to create any needed thumbnails. It is added with a very low priority
  *  so that it doesn't delay showing the directory in the icon/list views.
  *  We want to show the files in the directory as quickly as possible. */
 static gboolean
 thumbnail_thread_starter_cb (gpointer data)
 {
-    GTask *task;
-
-    DEBUG ("(Main Thread) Creating thumbnails thread\n");
-
-    /* We set a flag to indicate the thread is running, so we don't create
-     *  a new one. We don't need to lock a mutex here, as the thumbnail
-     *  thread isn't running yet. And we know we won't create the thread
-     *  twice, as we also check thumbnail_thread_starter_id before
-     *  scheduling this idle function. */
-    thumbnail_thread_is_running = TRUE;
-    task = g_task_new (NULL, NULL, NULL, NULL);
-    g_task_run_in_thread (task, thumbnail_thread_func);
+    guint max_threads;
+
+    max_threads = get_max_thumbnail_threads ();
+
+    /* Must happen before gexiv2 is used from several threads */
+    if (!gexiv2_initialized)
+    {
+        gexiv2_initialized = gexiv2_initialize ();
+    }
+
+    g_mutex_lock (&thumbnails_mutex);
+
     thumbnail_thread_starter_id = 0;
+    max_thumbnail_threads = max_threads;
+
+    /* Threads exit when they find nothing left to do, so there is no point
+     *  in starting more than there are thumbnails to make. They are threads
+     *  of their own rather than GTask ones, as they would tie up the shared
+     *  GTask pool for as long as there are thumbnails to make. */
+    while (n_thumbnail_threads < max_thumbnail_threads &&
+           n_thumbnail_threads < get_n_thumbnails_to_make ())
+    {
+        DEBUG ("(Main Thread) Creating thumbnails thread\n");
+
+        n_thumbnail_threads++;
+        g_thread_unref (g_thread_new ("nautilus-thumbnails",
+                                      thumbnail_thread_func, NULL));
+    }
 
-    g_object_unref (task);
+    g_mutex_unlock (&thumbnails_mutex);
 
-    return FALSE;
+    return G_SOURCE_REMOVE;
 }
 
 void
 nautilus_thumbnail_remove_from_queue (const char *file_uri)
 {
     GList *node;
+    NautilusThumbnailInfo *info;
 
     DEBUG ("(Remove from queue) Locking mutex\n");
 
@@ -186,12 +242,13 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
     if (thumbnails_to_make_hash)
     {
         node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
+        info = node != NULL ? node->data : NULL;
 
-        if (node && node->data != currently_thumbnailing)
+        if (info != NULL && info->queue != NULL)
         {
             g_hash_table_remove (thumbnails_to_make_hash, file_uri);
-            free_thumbnail_info (node->data);
-            g_queue_delete_link ((GQueue *) &thumbnails_to_make, node);
+            g_queue_delete_link (info->queue, node);
+            free_thumbnail_info (info);
         }
     }
 
@@ -204,11 +261,36 @@ nautilus_thumbnail_remove_from_queue (const char *file_uri)
     g_mutex_unlock (&thumbnails_mutex);
 }
 
-void
-nautilus_thumbnail_prioritize (const char *file_uri)
+/* Moves the thumbnail to make for @file_uri to the head of @queue, if it is
+ *  not being made already. */
+static void
+move_to_queue_head (const char *file_uri,
+                    GQueue     *queue)
 {
     GList *node;
+    NautilusThumbnailInfo *info;
+
+    if (thumbnails_to_make_hash == NULL)
+    {
+        return;
+    }
+
+    node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
+    info = node != NULL ? node->data : NULL;
+
+    if (info != NULL && info->queue != NULL)
+    {
+        g_queue_unlink (info->queue, node);
+        g_queue_push_head_link (queue, node);
+        info->queue = queue;
+    }
+}
 
+/* Called for files that are visible in a view, so their thumbnails are made
+ *  before the others. */
+void
+nautilus_thumbnail_prioritize (const char *file_uri)
+{
     DEBUG ("(Prioritize) Locking mutex\n");
 
     g_mutex_lock (&thumbnails_mutex);
@@ -217,16 +299,7 @@ nautilus_thumbnail_prioritize (const char *file_uri)
      * MUTEX LOCKED
      *********************************/
 
-    if (thumbnails_to_make_hash)
-    {
-        node = g_hash_table_lookup (thumbnails_to_make_hash, file_uri);
-
-        if (node && node->data != currently_thumbnailing)
-        {
-            g_queue_unlink ((GQueue *) &thumbnails_to_make, node);
-            g_queue_push_head_link ((GQueue *) &thumbnails_to_make, node);
-        }
-    }
+    move_to_queue_head (file_uri, &visible_thumbnails_to_make);
 
     /*********************************
      * MUTEX UNLOCKED
@@ -237,6 +310,65 @@ nautilus_thumbnail_prioritize (const char *file_uri)
     g_mutex_unlock (&thumbnails_mutex);
 }
 
+/* Called for files that were scrolled out of view. Their thumbnails stay
+ *  ahead of the ones that were never shown, as they are likely to be
+ *  scrolled back into view, but behind the visible ones. */
+void
+nautilus_thumbnail_deprioritize (const char *file_uri)
+{
+    DEBUG ("(Deprioritize) Locking mutex\n");
+
+    g_mutex_lock (&thumbnails_mutex);
+
+    /*********************************
+     * MUTEX LOCKED
+     *********************************/
+
+    move_to_queue_head (file_uri, &thumbnails_to_make);
+
+    /*********************************
+     * MUTEX UNLOCKED
+     *********************************/
+
+    DEBUG ("(Deprioritize) Unlocking mutex\n");
+
+    g_mutex_unlock (&thumbnails_mutex);
+}
+
+/* Called for files that a view is about to scroll to. Their thumbnails are
+ *  made after the visible ones, but before any other. */
+void
+nautilus_thumbnail_prefetch (const char *file_uri)
+{
+    g_mutex_lock (&thumbnails_mutex);
+
+    move_to_queue_head (file_uri, &prefetched_thumbnails_to_make);
+
+    g_mutex_unlock (&thumbnails_mutex);
+}
+
+/* Called for prefetched files that are no longer ahead of the scrolling,
+ *  e.g. because it went the other way. */
+void
+nautilus_thumbnail_cancel_prefetch (const char *file_uri)
+{
+    GList *node;
+    NautilusThumbnailInfo *info;
+
+    g_mutex_lock (&thumbnails_mutex);
+
+    node = thumbnails_to_make_hash != NULL ?
+           g_hash_table_lookup (thumbnails_to_make_hash, file_uri) : NULL;
+    info = node != NULL ? node->data : NULL;
+
+    if (info != NULL && info->queue == &prefetched_thumbnails_to_make)
+    {
+        move_to_queue_head (file_uri, &thumbnails_to_make);
+    }
+
+    g_mutex_unlock (&thumbnails_mutex);
+}
+
 
 /***************************************************************************
  * Thumbnail Thread Functions.
@@ -399,16 +531,17 @@ nautilus_create_thumbnail (NautilusFile *file)
         /* Add the thumbnail to the list. */
         DEBUG ("(Main Thread) Adding thumbnail: %s\n",
                info->image_uri);
-        g_queue_push_tail ((GQueue *) &thumbnails_to_make, info);
-        node = g_queue_peek_tail_link ((GQueue *) &thumbnails_to_make);
+        g_queue_push_tail (&thumbnails_to_make, info);
+        info->queue = &thumbnails_to_make;
+        node = g_queue_peek_tail_link (&thumbnails_to_make);
         g_hash_table_insert (thumbnails_to_make_hash,
                              info->image_uri,
                              node);
-        /* If the thumbnail thread isn't running, and we haven't
-         *  scheduled an idle function to start it up, do that now.
-         *  We don't want to start it until all the other work is done,
+        /* If not all the thumbnail threads are running, and we haven't
+         *  scheduled an idle function to start more, do that now.
+         *  We don't want to start them until all the other work is done,
          *  so the GUI will be updated as quickly as possible.*/
-        if (thumbnail_thread_is_running == FALSE &&
+        if (n_thumbnail_threads < max_thumbnail_threads &&
             thumbnail_thread_starter_id == 0)
         {
             thumbnail_thread_starter_id = g_idle_add_full (G_PRIORITY_LOW, thumbnail_thread_starter_cb, NULL, NULL);
@@ -434,21 +567,149 @@ nautilus_create_thumbnail (NautilusFile *file)
     g_mutex_unlock (&thumbnails_mutex);
 }
 
-/* thumbnail_thread is invoked as a separate thread to to make thumbnails. */
+/* Whether files of @mime_type may carry a preview in their Exif data */
+static gboolean
+has_embedded_preview (const char *mime_type)
+{
+    /* Camera raw formats are all subclasses of image/x-dcraw */
+    return g_content_type_is_a (mime_type, "image/jpeg") ||
+           g_content_type_is_a (mime_type, "image/tiff") ||
+           g_content_type_is_a (mime_type, "image/x-dcraw");
+}
+
 static void
-thumbnail_thread_func (GTask        *task,
-                       gpointer      source_object,
-                       gpointer      task_data,
-                       GCancellable *cancellable)
+embedded_preview_size_prepared (GdkPixbufLoader *loader,
+                                int              width,
+                                int              height,
+                                gpointer         user_data)
+{
+    if (MAX (width, height) > THUMBNAIL_SIZE)
+    {
+        double scale = (double) THUMBNAIL_SIZE / MAX (width, height);
+
+        gdk_pixbuf_loader_set_size (loader,
+                                    MAX (width * scale, 1),
+                                    MAX (height * scale, 1));
+    }
+}
+
+static GdkPixbuf *
+load_embedded_preview (GExiv2Metadata *metadata,
+                       const char     *image_uri)
+{
+    g_autoptr (GdkPixbufLoader) loader = NULL;
+    GExiv2PreviewProperties **properties;
+    GExiv2PreviewProperties *best = NULL;
+    GExiv2PreviewImage *preview;
+    GExiv2Orientation orientation;
+    const guint8 *data;
+    guint32 size;
+    gboolean loaded;
+    GdkPixbuf *pixbuf;
+    int i;
+
+    /* Use the smallest preview that is not smaller than a thumbnail */
+    properties = gexiv2_metadata_get_preview_properties (metadata);
+    for (i = 0; properties != NULL && properties[i] != NULL; i++)
+    {
+        guint32 width = gexiv2_preview_properties_get_width (properties[i]);
+        guint32 height = gexiv2_preview_properties_get_height (properties[i]);
+
+        if (MAX (width, height) < THUMBNAIL_SIZE)
+        {
+            continue;
+        }
+
+        if (best == NULL ||
+            width * height < gexiv2_preview_properties_get_width (best) *
+                             gexiv2_preview_properties_get_height (best))
+        {
+            best = properties[i];
+        }
+    }
+
+    if (best == NULL)
+    {
+        DEBUG ("(Thumbnail Thread) No usable embedded preview: %s\n", image_uri);
+        return NULL;
+    }
+
+    preview = gexiv2_metadata_get_preview_image (metadata, best);
+    data = gexiv2_preview_image_get_data (preview, &size);
+
+    loader = gdk_pixbuf_loader_new ();
+    g_signal_connect (loader, "size-prepared",
+                      G_CALLBACK (embedded_preview_size_prepared), NULL);
+    /* The loader must be closed even if writing failed */
+    loaded = gdk_pixbuf_loader_write (loader, data, size, NULL);
+    loaded = gdk_pixbuf_loader_close (loader, NULL) && loaded;
+    g_object_unref (preview);
+
+    pixbuf = loaded ? gdk_pixbuf_loader_get_pixbuf (loader) : NULL;
+    if (pixbuf == NULL)
+    {
+        return NULL;
+    }
+
+    /* Previews are usually stored unrotated, without a tag of their own */
+    orientation = gexiv2_metadata_get_orientation (metadata);
+    if (orientation > GEXIV2_ORIENTATION_NORMAL &&
+        gdk_pixbuf_get_option (pixbuf, "orientation") == NULL)
+    {
+        g_autofree char *value = g_strdup_printf ("%d", orientation);
+
+        gdk_pixbuf_set_option (pixbuf, "orientation", value);
+    }
+
+    DEBUG ("(Thumbnail Thread) Using embedded preview: %s\n", image_uri);
+
+    return gdk_pixbuf_apply_embedded_orientation (pixbuf);
+}
+
+/* Makes the thumbnail from the preview image that cameras embed in photos
+ * and raw files, which is much faster than decoding the image itself.
+ * Returns %NULL if there is no preview at least as large as a thumbnail,
+ * in which case the thumbnail has to be generated as usual.
+ *
+ * Called from the thumbnail threads.
+ */
+static GdkPixbuf *
+get_embedded_preview_thumbnail (const char *image_uri)
+{
+    g_autofree char *path = NULL;
+    GExiv2Metadata *metadata;
+    GdkPixbuf *pixbuf = NULL;
+
+    /* Only local files; remote ones are better left to the thumbnailers */
+    path = g_filename_from_uri (image_uri, NULL, NULL);
+    if (path == NULL)
+    {
+        return NULL;
+    }
+
+    metadata = gexiv2_metadata_new ();
+    if (gexiv2_metadata_open_path (metadata, path, NULL))
+    {
+        pixbuf = load_embedded_preview (metadata, image_uri);
+    }
+    g_object_unref (metadata);
+
+    return pixbuf;
+}
+
+/* thumbnail_thread is invoked as a separate thread to to make thumbnails.
+ *  Several of them may run at once, each with a factory of its own. */
+static gpointer
+thumbnail_thread_func (gpointer data)
 {
     GnomeDesktopThumbnailFactory *thumbnail_factory;
     NautilusThumbnailInfo *info = NULL;
     GdkPixbuf *pixbuf;
     time_t current_orig_mtime = 0;
     time_t current_time;
-    GList *node;
+    GList *node = NULL;
 
-    thumbnail_factory = get_thumbnail_factory ();
+    thumbnail_factory = gnome_desktop_thumbnail_factory_new (GNOME_DESKTOP_THUMBNAIL_SIZE_LARGE);
 
     /* We loop until there are no more thumbails to make, at which point
      *  we exit the thread. */
@@ -462,42 +723,57 @@ thumbnail_thread_func (GTask        *task,
          * MUTEX LOCKED
          *********************************/
 
-        /* Pop the last thumbnail we just made off the head of the
-         *  list and free it. I did this here so we only have to lock
-         *  the mutex once per thumbnail, rather than once before
-         *  creating it and once after.
-         *  Don't pop the thumbnail off the queue if the original file
+        /* Forget the last thumbnail we just made and free it. I did
+         *  this here so we only have to lock the mutex once per
+         *  thumbnail, rather than once before creating it and once after.
+         *  Put it back at the head of the queue if the original file
          *  mtime of the request changed. Then we need to redo the thumbnail.
          */
-        if (currently_thumbnailing &&
-            currently_thumbnailing->original_file_mtime == current_orig_mtime)
+        if (node != NULL)
         {
-            g_assert (info == currently_thumbnailing);
-            node = g_hash_table_lookup (thumbnails_to_make_hash, info->image_uri);
-            g_assert (node != NULL);
-            g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
-            free_thumbnail_info (info);
-            g_queue_delete_link ((GQueue *) &thumbnails_to_make, node);
+            if (info->original_file_mtime == current_orig_mtime)
+            {
+                g_hash_table_remove (thumbnails_to_make_hash, info->image_uri);
+                free_thumbnail_info (info);
+                g_list_free_1 (node);
+            }
+            else
+            {
+                g_queue_push_head_link (&thumbnails_to_make, node);
+                info->queue = &thumbnails_to_make;
+            }
         }
-        currently_thumbnailing = NULL;
 
-        /* If there are no more thumbnails to make, reset the
-         *  thumbnail_thread_is_running flag, unlock the mutex, and
-         *  exit the thread. */
-        if (g_queue_is_empty ((GQueue *) &thumbnails_to_make))
+        /* If there are no more thumbnails to make, or there are more
+         *  threads than wanted now, unlock the mutex and exit the thread. */
+        if (get_n_thumbnails_to_make () == 0 ||
+            n_thumbnail_threads > max_thumbnail_threads)
         {
             DEBUG ("(Thumbnail Thread) Exiting\n");
 
-            thumbnail_thread_is_running = FALSE;
+            n_thumbnail_threads--;
             g_mutex_unlock (&thumbnails_mutex);
-            return;
+            g_object_unref (thumbnail_factory);
+            return NULL;
         }
 
-        /* Get the next one to make. We leave it on the list until it
-         *  is created so the main thread doesn't add it again while we
-         *  are creating it. */
-        info = g_queue_peek_head ((GQueue *) &thumbnails_to_make);
-        currently_thumbnailing = info;
+        /* Get the next one to make. We take it off the queues, but leave it
+         *  in the hash table until it is created so the main thread doesn't
+         *  add it again while we are creating it. */
+        if (!g_queue_is_empty (&visible_thumbnails_to_make))
+        {
+            node = g_queue_pop_head_link (&visible_thumbnails_to_make);
+        }
+        else if (!g_queue_is_empty (&prefetched_thumbnails_to_make))
+        {
+            node = g_queue_pop_head_link (&prefetched_thumbnails_to_make);
+        }
+        else
+        {
+            node = g_queue_pop_head_link (&thumbnails_to_make);
+        }
+        info = node->data;
+        info->queue = NULL;
         current_orig_mtime = info->original_file_mtime;
         /*********************************
          * MUTEX UNLOCKED
@@ -527,9 +803,18 @@ thumbnail_thread_func (GTask        *task,
         DEBUG ("(Thumbnail Thread) Creating thumbnail: %s\n",
                info->image_uri);
 
-        pixbuf = gnome_desktop_thumbnail_factory_generate_thumbnail (thumbnail_factory,
-                                                                     info->image_uri,
-                                                                     info->mime_type);
+        pixbuf = NULL;
+        if (gexiv2_initialized && has_embedded_preview (info->mime_type))
+        {
+            pixbuf = get_embedded_preview_thumbnail (info->image_uri);
+        }
+
+        if (pixbuf == NULL)
+        {
+            pixbuf = gnome_desktop_thumbnail_factory_generate_thumbnail (thumbnail_factory,
+                                                                         info->image_uri,
+                                                                         info->mime_type);
+        }
 
         if (pixbuf)
         {
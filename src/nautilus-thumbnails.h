@@ -32,4 +32,7 @@ gboolean   nautilus_thumbnail_is_mimetype_limited_by_size
 
 /* Queue handling: */
 void       nautilus_thumbnail_remove_from_queue     (const char   *file_uri);
-void       nautilus_thumbnail_prioritize            (const char   *file_uri);
\ No newline at end of file
+void       nautilus_thumbnail_prioritize            (const char   *file_uri);
+void       nautilus_thumbnail_deprioritize          (const char   *file_uri);
+void       nautilus_thumbnail_prefetch              (const char   *file_uri);
+void       nautilus_thumbnail_cancel_prefetch       (const char   *file_uri);
\ No newline at end of file
@@ -22,15 +22,29 @@
 #include "config.h"
 #include "nautilus-tracker-utilities.h"
 
+#include <string.h>
+
+#include "nautilus-global-preferences.h"
+#include "nautilus-search-prune-rules.h"
+
+#define HOST_MINER_FS_BUSNAME "org.freedesktop.Tracker3.Miner.Files"
+#define MINER_FS_SCHEMA "org.freedesktop.Tracker3.Miner.Files"
+#define MINER_FS_OBJECT_PATH "/org/freedesktop/Tracker3/Miner/Files"
+#define MINER_INTERFACE "org.freedesktop.Tracker3.Miner"
+
 /* Shared global connection to Tracker Miner FS */
 static const gchar *tracker_miner_fs_busname = NULL;
 static TrackerSparqlConnection *tracker_miner_fs_connection = NULL;
 static GError *tracker_miner_fs_error = NULL;
 
+/* Whether the session-wide Tracker Miner FS reported that it indexed
+ * everything, which is unknown until it answers */
+static gboolean tracker_miner_fs_done = FALSE;
+
 static gboolean
 get_host_tracker_miner_fs (GError **error)
 {
-    const gchar *busname = "org.freedesktop.Tracker3.Miner.Files";
+    const gchar *busname = HOST_MINER_FS_BUSNAME;
 
     g_message ("Connecting to %s", busname);
     tracker_miner_fs_connection = tracker_sparql_connection_bus_new (busname, NULL, NULL, error);
@@ -140,3 +154,300 @@ nautilus_tracker_get_miner_fs_busname (GError **error)
 
     return tracker_miner_fs_busname;
 }
+
+/* Expands a folder of the Tracker Miner FS settings the way it does. Special
+ * folders that are the home folder are left out, as it leaves them out too.
+ */
+static gchar *
+expand_indexed_directory (const char *directory)
+{
+    static const struct
+    {
+        const char *name;
+        GUserDirectory directory;
+    } special_directories[] =
+    {
+        { "&DESKTOP", G_USER_DIRECTORY_DESKTOP },
+        { "&DOCUMENTS", G_USER_DIRECTORY_DOCUMENTS },
+        { "&DOWNLOAD", G_USER_DIRECTORY_DOWNLOAD },
+        { "&MUSIC", G_USER_DIRECTORY_MUSIC },
+        { "&PICTURES", G_USER_DIRECTORY_PICTURES },
+        { "&PUBLIC_SHARE", G_USER_DIRECTORY_PUBLIC_SHARE },
+        { "&TEMPLATES", G_USER_DIRECTORY_TEMPLATES },
+        { "&VIDEOS", G_USER_DIRECTORY_VIDEOS },
+    };
+    const char *path;
+
+    if (directory[0] == '&')
+    {
+        for (guint i = 0; i < G_N_ELEMENTS (special_directories); i++)
+        {
+            if (g_strcmp0 (directory, special_directories[i].name) == 0)
+            {
+                path = g_get_user_special_dir (special_directories[i].directory);
+                if (path == NULL || g_strcmp0 (path, g_get_home_dir ()) == 0)
+                {
+                    return NULL;
+                }
+
+                return g_strdup (path);
+            }
+        }
+
+        return NULL;
+    }
+
+    if (g_str_has_prefix (directory, "$HOME"))
+    {
+        return g_build_filename (g_get_home_dir (), directory + strlen ("$HOME"), NULL);
+    }
+
+    if (directory[0] == '~')
+    {
+        return g_build_filename (g_get_home_dir (), directory + 1, NULL);
+    }
+
+    return g_path_is_absolute (directory) ? g_strdup (directory) : NULL;
+}
+
+static GSettings *
+get_miner_fs_settings (void)
+{
+    GSettingsSchemaSource *source;
+    g_autoptr (GSettingsSchema) schema = NULL;
+
+    if (g_strcmp0 (nautilus_tracker_get_miner_fs_busname (NULL), HOST_MINER_FS_BUSNAME) != 0)
+    {
+        return NULL;
+    }
+
+    source = g_settings_schema_source_get_default ();
+    schema = source != NULL ? g_settings_schema_source_lookup (source, MINER_FS_SCHEMA, TRUE) : NULL;
+    if (schema == NULL ||
+        !g_settings_schema_has_key (schema, "index-recursive-directories") ||
+        !g_settings_schema_has_key (schema, "ignored-files") ||
+        !g_settings_schema_has_key (schema, "ignored-directories") ||
+        !g_settings_schema_has_key (schema, "ignored-directories-with-content") ||
+        !g_settings_schema_has_key (schema, "enable-monitors"))
+    {
+        return NULL;
+    }
+
+    return g_settings_new_full (schema, NULL, NULL);
+}
+
+/**
+ * nautilus_tracker_get_indexed_locations:
+ *
+ * Gets the folders that Tracker Miner FS indexes along with all their
+ * subfolders, from its settings. They are only known for the session-wide
+ * indexer, and not for one started for Nautilus alone.
+ *
+ * Returns: (transfer full) (element-type GFile): the folders, or %NULL if
+ * they can't be known.
+ */
+GList *
+nautilus_tracker_get_indexed_locations (void)
+{
+    g_autoptr (GSettings) settings = NULL;
+    g_auto (GStrv) directories = NULL;
+    GList *locations = NULL;
+
+    settings = get_miner_fs_settings ();
+    if (settings == NULL)
+    {
+        return NULL;
+    }
+
+    directories = g_settings_get_strv (settings, "index-recursive-directories");
+    for (guint i = 0; directories[i] != NULL; i++)
+    {
+        g_autofree gchar *path = NULL;
+
+        path = expand_indexed_directory (directories[i]);
+        if (path != NULL)
+        {
+            locations = g_list_prepend (locations, g_file_new_for_path (path));
+        }
+    }
+
+    return g_list_reverse (locations);
+}
+
+static void
+set_miner_fs_progress (gdouble progress)
+{
+    tracker_miner_fs_done = progress >= 1.0;
+}
+
+static void
+on_miner_fs_progress (GDBusConnection *connection,
+                      const gchar     *sender_name,
+                      const gchar     *object_path,
+                      const gchar     *interface_name,
+                      const gchar     *signal_name,
+                      GVariant        *parameters,
+                      gpointer         user_data)
+{
+    gdouble progress;
+
+    if (g_variant_is_of_type (parameters, G_VARIANT_TYPE ("(sdi)")))
+    {
+        g_variant_get (parameters, "(&sdi)", NULL, &progress, NULL);
+        set_miner_fs_progress (progress);
+    }
+}
+
+static void
+on_get_progress_ready (GObject      *source_object,
+                       GAsyncResult *result,
+                       gpointer      user_data)
+{
+    g_autoptr (GVariant) reply = NULL;
+    gdouble progress;
+
+    reply = g_dbus_connection_call_finish (G_DBUS_CONNECTION (source_object), result, NULL);
+    if (reply != NULL)
+    {
+        g_variant_get (reply, "(d)", &progress);
+        set_miner_fs_progress (progress);
+    }
+}
+
+static void
+on_session_bus_ready (GObject      *source_object,
+                      GAsyncResult *result,
+                      gpointer      user_data)
+{
+    GDBusConnection *connection;
+
+    /* Kept for the whole process */
+    connection = g_bus_get_finish (result, NULL);
+    if (connection == NULL)
+    {
+        return;
+    }
+
+    g_dbus_connection_signal_subscribe (connection, HOST_MINER_FS_BUSNAME,
+                                        MINER_INTERFACE, "Progress", MINER_FS_OBJECT_PATH,
+                                        NULL, G_DBUS_SIGNAL_FLAGS_NONE,
+                                        on_miner_fs_progress, NULL, NULL);
+    g_dbus_connection_call (connection, HOST_MINER_FS_BUSNAME, MINER_FS_OBJECT_PATH,
+                            MINER_INTERFACE, "GetProgress", NULL, G_VARIANT_TYPE ("(d)"),
+                            G_DBUS_CALL_FLAGS_NO_AUTO_START, -1, NULL,
+                            on_get_progress_ready, NULL);
+}
+
+/* Keeps track of whether Tracker Miner FS is done indexing, as it reports
+ * its progress. */
+static void
+watch_miner_fs_progress (void)
+{
+    static gboolean watching = FALSE;
+
+    if (watching)
+    {
+        return;
+    }
+    watching = TRUE;
+
+    g_bus_get (G_BUS_TYPE_SESSION, NULL, on_session_bus_ready, NULL);
+}
+
+/* Returns %TRUE if crawling with @rules skips what @pattern matches too */
+typedef gboolean (*IsSkippedFunc) (const char               *pattern,
+                                   NautilusSearchPruneRules *rules);
+
+/* Hidden files, and backup files, are skipped by crawling too */
+static gboolean
+is_skipped_file_pattern (const char               *pattern,
+                         NautilusSearchPruneRules *rules)
+{
+    return pattern[0] == '.' || g_str_has_suffix (pattern, "~");
+}
+
+static gboolean
+is_skipped_directory_pattern (const char               *pattern,
+                              NautilusSearchPruneRules *rules)
+{
+    /* Crawling still finds a pruned folder itself, though not what is in
+     * it. The rules of the preference have no paths, which the folder is
+     * only needed for. */
+    return pattern[0] == '.' || nautilus_search_prune_rules_match (rules, NULL, pattern);
+}
+
+/* Returns %TRUE if every entry of the @key list is either one that Tracker
+ * ignores by default, or one that @is_skipped tells crawling skips too.
+ * The defaults are backup, build and system files, which are not worth the
+ * crawl to find. */
+static gboolean
+ignores_only_skipped (GSettings                *settings,
+                      const char               *key,
+                      IsSkippedFunc             is_skipped,
+                      NautilusSearchPruneRules *rules)
+{
+    g_autoptr (GVariant) default_value = NULL;
+    g_autofree const gchar **defaults = NULL;
+    g_auto (GStrv) values = NULL;
+
+    default_value = g_settings_get_default_value (settings, key);
+    defaults = default_value != NULL ? g_variant_get_strv (default_value, NULL) : NULL;
+    values = g_settings_get_strv (settings, key);
+
+    for (guint i = 0; values[i] != NULL; i++)
+    {
+        if ((defaults == NULL || !g_strv_contains ((const gchar * const *) defaults, values[i])) &&
+            (is_skipped == NULL || !is_skipped (values[i], rules)))
+        {
+            return FALSE;
+        }
+    }
+
+    return TRUE;
+}
+
+/**
+ * nautilus_tracker_is_index_complete:
+ *
+ * Tells whether Tracker Miner FS has every file of the folders it indexes,
+ * so that searching them with Tracker finds the files walking them would.
+ * That is only known for the session-wide indexer, once it reported that
+ * it is done indexing. It must keep the index up to date as files change,
+ * and only ignore the files it ignores by default, or ones that crawling
+ * skips too: hidden and backup files, and the folders the
+ * search-prune-patterns preference prunes.
+ *
+ * The first call starts following the progress of the indexer, and the
+ * index is taken to be incomplete until it answers.
+ *
+ * Returns: %TRUE if the index is known to be complete.
+ */
+gboolean
+nautilus_tracker_is_index_complete (void)
+{
+    g_autoptr (GSettings) settings = NULL;
+    g_autoptr (NautilusSearchPruneRules) rules = NULL;
+    g_auto (GStrv) prune_patterns = NULL;
+
+    settings = get_miner_fs_settings ();
+    if (settings == NULL)
+    {
+        return FALSE;
+    }
+
+    watch_miner_fs_progress ();
+
+    if (!tracker_miner_fs_done ||
+        !g_settings_get_boolean (settings, "enable-monitors"))
+    {
+        return FALSE;
+    }
+
+    prune_patterns = g_settings_get_strv (nautilus_preferences,
+                                          NAUTILUS_PREFERENCES_SEARCH_PRUNE_PATTERNS);
+    rules = nautilus_search_prune_rules_new ((const char * const *) prune_patterns);
+
+    return ignores_only_skipped (settings, "ignored-files", is_skipped_file_pattern, rules) &&
+           ignores_only_skipped (settings, "ignored-directories", is_skipped_directory_pattern, rules) &&
+           ignores_only_skipped (settings, "ignored-directories-with-content", NULL, rules);
+}
@@ -26,3 +26,5 @@
 
 TrackerSparqlConnection * nautilus_tracker_get_miner_fs_connection (GError **error);
 const gchar *             nautilus_tracker_get_miner_fs_busname    (GError **error);
+GList *                   nautilus_tracker_get_indexed_locations   (void);
+gboolean                  nautilus_tracker_is_index_complete       (void);
@@ -28,7 +28,7 @@
 
 #include <gio/gio.h>
 #include <gtk/gtk.h>
-#include <libgd/gd.h>
+#include <math.h>
 #include <string.h>
 #include <glib/gi18n.h>
 
@@ -73,20 +73,110 @@ nautilus_gmenu_set_from_model (GMenu      *target_menu,
 #define NAUTILUS_THUMBNAIL_FRAME_RIGHT 3
 #define NAUTILUS_THUMBNAIL_FRAME_BOTTOM 3
 
+static gpointer
+load_thumbnail_frame (gpointer data)
+{
+    return gdk_pixbuf_new_from_resource ("/org/gnome/nautilus/icons/thumbnail_frame.png", NULL);
+}
+
+/* Draws the part of @frame from (src_x, src_y) and of size src_width x
+ * src_height stretched over the part of @dest from (dest_x, dest_y) and of
+ * size dest_width x dest_height.
+ */
+static void
+composite_frame_slice (GdkPixbuf *frame,
+                       GdkPixbuf *dest,
+                       int        src_x,
+                       int        src_y,
+                       int        src_width,
+                       int        src_height,
+                       int        dest_x,
+                       int        dest_y,
+                       int        dest_width,
+                       int        dest_height)
+{
+    double scale_x;
+    double scale_y;
+
+    if (src_width <= 0 || src_height <= 0 || dest_width <= 0 || dest_height <= 0)
+    {
+        return;
+    }
+
+    scale_x = (double) dest_width / src_width;
+    scale_y = (double) dest_height / src_height;
+
+    gdk_pixbuf_composite (frame, dest,
+                          dest_x, dest_y, dest_width, dest_height,
+                          dest_x - src_x * scale_x, dest_y - src_y * scale_y,
+                          scale_x, scale_y,
+                          GDK_INTERP_BILINEAR, 255);
+}
+
+/* Only uses GdkPixbuf, unlike the CSS border-image it does the same as, so
+ * that thumbnails can be framed from any thread. */
 void
 nautilus_ui_frame_image (GdkPixbuf **pixbuf)
 {
-    GtkBorder border;
+    static GOnce frame_once = G_ONCE_INIT;
+    GdkPixbuf *frame;
     GdkPixbuf *pixbuf_with_frame;
+    int width, height;
+    int frame_width, frame_height;
+    int left, top, right, bottom;
 
-    border.left = NAUTILUS_THUMBNAIL_FRAME_LEFT;
-    border.top = NAUTILUS_THUMBNAIL_FRAME_TOP;
-    border.right = NAUTILUS_THUMBNAIL_FRAME_RIGHT;
-    border.bottom = NAUTILUS_THUMBNAIL_FRAME_BOTTOM;
+    frame = g_once (&frame_once, load_thumbnail_frame, NULL);
+    if (frame == NULL)
+    {
+        return;
+    }
+
+    left = NAUTILUS_THUMBNAIL_FRAME_LEFT;
+    top = NAUTILUS_THUMBNAIL_FRAME_TOP;
+    right = NAUTILUS_THUMBNAIL_FRAME_RIGHT;
+    bottom = NAUTILUS_THUMBNAIL_FRAME_BOTTOM;
+
+    width = gdk_pixbuf_get_width (*pixbuf);
+    height = gdk_pixbuf_get_height (*pixbuf);
+    frame_width = gdk_pixbuf_get_width (frame);
+    frame_height = gdk_pixbuf_get_height (frame);
+
+    /* The whole image shows, with the frame around it */
+    pixbuf_with_frame = gdk_pixbuf_new (GDK_COLORSPACE_RGB, TRUE, 8,
+                                        width + left + right, height + top + bottom);
+    gdk_pixbuf_fill (pixbuf_with_frame, 0);
+    gdk_pixbuf_composite (*pixbuf, pixbuf_with_frame,
+                          left, top, width, height,
+                          left, top, 1, 1, GDK_INTERP_NEAREST, 255);
+
+    /* Corners */
+    composite_frame_slice (frame, pixbuf_with_frame,
+                           0, 0, left, top,
+                           0, 0, left, top);
+    composite_frame_slice (frame, pixbuf_with_frame,
+                           frame_width - right, 0, right, top,
+                           left + width, 0, right, top);
+    composite_frame_slice (frame, pixbuf_with_frame,
+                           0, frame_height - bottom, left, bottom,
+                           0, top + height, left, bottom);
+    composite_frame_slice (frame, pixbuf_with_frame,
+                           frame_width - right, frame_height - bottom, right, bottom,
+                           left + width, top + height, right, bottom);
+
+    /* Edges, stretched */
+    composite_frame_slice (frame, pixbuf_with_frame,
+                           left, 0, frame_width - left - right, top,
+                           left, 0, width, top);
+    composite_frame_slice (frame, pixbuf_with_frame,
+                           left, frame_height - bottom, frame_width - left - right, bottom,
+                           left, top + height, width, bottom);
+    composite_frame_slice (frame, pixbuf_with_frame,
+                           0, top, left, frame_height - top - bottom,
+                           0, top, left, height);
+    composite_frame_slice (frame, pixbuf_with_frame,
+                           frame_width - right, top, right, frame_height - top - bottom,
+                           left + width, top, right, height);
 
-    pixbuf_with_frame = gd_embed_image_in_frame (*pixbuf,
-                                                 "resource:///org/gnome/nautilus/icons/thumbnail_frame.png",
-                                                 &border, &border);
     g_object_unref (*pixbuf);
 
     *pixbuf = pixbuf_with_frame;
@@ -98,14 +188,18 @@ static GdkPixbuf *filmholes_right = NULL;
 static gboolean
 ensure_filmholes (void)
 {
-    if (filmholes_left == NULL)
+    static gsize filmholes_initialized = 0;
+
+    /* Videos can be framed from any thread */
+    if (g_once_init_enter (&filmholes_initialized))
     {
         filmholes_left = gdk_pixbuf_new_from_resource ("/org/gnome/nautilus/icons/filmholes.png", NULL);
-    }
-    if (filmholes_right == NULL &&
-        filmholes_left != NULL)
-    {
-        filmholes_right = gdk_pixbuf_flip (filmholes_left, TRUE);
+        if (filmholes_left != NULL)
+        {
+            filmholes_right = gdk_pixbuf_flip (filmholes_left, TRUE);
+        }
+
+        g_once_init_leave (&filmholes_initialized, 1);
     }
 
     return (filmholes_left && filmholes_right);
@@ -379,3 +473,60 @@ show_unmount_progress_aborted_cb (GMountOperation *op,
 {
     notify_unmount_done (op, NULL);
 }
+
+/* Above this speed, prefetch two pages ahead instead of one */
+#define FAST_SCROLL_PAGES_PER_SECOND 1.0
+
+/* Scroll events further apart than this are not fast scrolling */
+#define SCROLL_SPEED_SAMPLE_MAX_USEC (G_USEC_PER_SEC / 2)
+
+void
+nautilus_scroll_tracker_update (NautilusScrollTracker *tracker,
+                                double                 value,
+                                double                 page_size)
+{
+    gint64 now;
+    gint64 elapsed;
+    double delta;
+
+    now = g_get_monotonic_time ();
+    delta = value - tracker->value;
+
+    if (tracker->time != 0 && delta != 0)
+    {
+        tracker->direction = delta > 0 ? 1 : -1;
+
+        elapsed = now - tracker->time;
+        if (elapsed > 0 && elapsed < SCROLL_SPEED_SAMPLE_MAX_USEC && page_size > 0)
+        {
+            tracker->pages_per_second = fabs (delta) / page_size *
+                                        G_USEC_PER_SEC / elapsed;
+        }
+        else
+        {
+            tracker->pages_per_second = 0;
+        }
+    }
+
+    tracker->value = value;
+    tracker->time = now;
+}
+
+void
+nautilus_scroll_tracker_reset (NautilusScrollTracker *tracker)
+{
+    memset (tracker, 0, sizeof (NautilusScrollTracker));
+}
+
+/* Returns 1 if the view was last scrolled down, or not yet, -1 if up. */
+int
+nautilus_scroll_tracker_get_direction (NautilusScrollTracker *tracker)
+{
+    return tracker->direction < 0 ? -1 : 1;
+}
+
+guint
+nautilus_scroll_tracker_get_pages_ahead (NautilusScrollTracker *tracker)
+{
+    return tracker->pages_per_second > FAST_SCROLL_PAGES_PER_SECOND ? 2 : 1;
+}
@@ -49,3 +49,22 @@ void        show_unmount_progress_cb                (GMountOperation   *op,
                                                      gpointer           user_data);
 void        show_unmount_progress_aborted_cb        (GMountOperation   *op,
                                                      gpointer           user_data);
+
+/* Follows the scrolling of a view, to know which way and how far ahead to
+ * prefetch. Zero-initialize it; until the view is scrolled, it assumes that
+ * it will be scrolled down.
+ */
+typedef struct
+{
+    double value;
+    gint64 time;
+    int direction;
+    double pages_per_second;
+} NautilusScrollTracker;
+
+void        nautilus_scroll_tracker_update          (NautilusScrollTracker *tracker,
+                                                     double                 value,
+                                                     double                 page_size);
+void        nautilus_scroll_tracker_reset           (NautilusScrollTracker *tracker);
+int         nautilus_scroll_tracker_get_direction   (NautilusScrollTracker *tracker);
+guint       nautilus_scroll_tracker_get_pages_ahead (NautilusScrollTracker *tracker);
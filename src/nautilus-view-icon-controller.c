@@ -282,12 +282,12 @@ real_get_selection (NautilusFilesView *files_view)
     g_autoptr (GList) selected_items = NULL;
 
     self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    selected_items = gtk_flow_box_get_selected_children (GTK_FLOW_BOX (self->view_ui));
+    selected_items = nautilus_view_icon_ui_get_selection (self->view_ui);
     for (l = selected_items; l != NULL; l = l->next)
     {
         NautilusViewItemModel *item_model;
 
-        item_model = nautilus_view_icon_item_ui_get_model (NAUTILUS_VIEW_ICON_ITEM_UI (l->data));
+        item_model = NAUTILUS_VIEW_ITEM_MODEL (l->data);
         selected_files = g_list_prepend (selected_files,
                                          g_object_ref (nautilus_view_item_model_get_file (item_model)));
     }
@@ -314,19 +314,12 @@ real_remove_file (NautilusFilesView *files_view,
                   NautilusDirectory *directory)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    NautilusFile *current_file;
-    NautilusViewItemModel *current_item_model;
-    guint i = 0;
+    NautilusViewItemModel *item_model;
 
-    while ((current_item_model = NAUTILUS_VIEW_ITEM_MODEL (g_list_model_get_item (G_LIST_MODEL (nautilus_view_model_get_g_model (self->model)), i))))
+    item_model = nautilus_view_model_get_item_from_file (self->model, file);
+    if (item_model != NULL)
     {
-        current_file = nautilus_view_item_model_get_file (current_item_model);
-        if (current_file == file)
-        {
-            g_list_store_remove (nautilus_view_model_get_g_model (self->model), i);
-            break;
-        }
-        i++;
+        nautilus_view_model_remove_item (self->model, item_model);
     }
 }
 
@@ -375,19 +368,19 @@ real_set_selection (NautilusFilesView *files_view,
 
     selection_files = convert_glist_to_queue (selection);
     selection_item_models = nautilus_view_model_get_items_from_files (self->model, selection_files);
+    /* Notifies the view of the changes */
     nautilus_view_icon_ui_set_selection (self->view_ui, selection_item_models);
-    nautilus_files_view_notify_selection_changed (files_view);
 }
 
 static void
 real_select_all (NautilusFilesView *files_view)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    gtk_flow_box_select_all (GTK_FLOW_BOX (self->view_ui));
+    nautilus_view_icon_ui_select_all (self->view_ui);
 }
 
-static GtkWidget *
-get_first_selected_item_ui (NautilusViewIconController *self)
+static NautilusViewItemModel *
+get_first_selected_item_model (NautilusViewIconController *self)
 {
     g_autolist (NautilusFile) selection = NULL;
     NautilusFile *file;
@@ -402,48 +395,20 @@ get_first_selected_item_ui (NautilusViewIconController *self)
     file = NAUTILUS_FILE (selection->data);
     item_model = nautilus_view_model_get_item_from_file (self->model, file);
 
-    return nautilus_view_item_model_get_item_ui (item_model);
-}
-
-static void
-reveal_item_ui (NautilusViewIconController *self,
-                GtkWidget                  *item_ui)
-{
-    GtkAllocation allocation;
-    GtkWidget *content_widget;
-    GtkAdjustment *vadjustment;
-    int view_height;
-
-    gtk_widget_get_allocation (item_ui, &allocation);
-    content_widget = nautilus_files_view_get_content_widget (NAUTILUS_FILES_VIEW (self));
-    view_height = gtk_widget_get_allocated_height (content_widget);
-    vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (content_widget));
-
-    /* Scroll only as necessary. TODO: Would be nice to have this as part of
-     * GtkFlowBox. GtkTreeView has something similar. */
-    if (allocation.y < gtk_adjustment_get_value (vadjustment))
-    {
-        gtk_adjustment_set_value (vadjustment, allocation.y);
-    }
-    else if (allocation.y + allocation.height >
-             gtk_adjustment_get_value (vadjustment) + view_height)
-    {
-        gtk_adjustment_set_value (vadjustment,
-                                  allocation.y + allocation.height - view_height);
-    }
+    return item_model;
 }
 
 static void
 real_reveal_selection (NautilusFilesView *files_view)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    GtkWidget *item_ui;
+    NautilusViewItemModel *item_model;
 
-    item_ui = get_first_selected_item_ui (self);
+    item_model = get_first_selected_item_model (self);
 
-    if (item_ui != NULL)
+    if (item_model != NULL)
     {
-        reveal_item_ui (self, item_ui);
+        nautilus_view_icon_ui_reveal_item (self->view_ui, item_model);
     }
 }
 
@@ -577,6 +542,8 @@ set_zoom_level (NautilusViewIconController *self,
     self->zoom_level = new_level;
 
     set_icon_size (self, get_icon_size_for_zoom_level (new_level));
+    nautilus_view_icon_ui_set_icon_size (self->view_ui,
+                                         get_icon_size_for_zoom_level (new_level));
 
     nautilus_files_view_update_toolbar_menus (NAUTILUS_FILES_VIEW (self));
 }
@@ -626,23 +593,13 @@ real_can_zoom_out (NautilusFilesView *files_view)
 }
 
 static GdkRectangle *
-get_rectangle_for_item_ui (NautilusViewIconController *self,
-                           GtkWidget                  *item_ui)
+get_rectangle_for_item_model (NautilusViewIconController *self,
+                              NautilusViewItemModel      *item_model)
 {
     GdkRectangle *rectangle;
-    GtkWidget *content_widget;
-    GtkAdjustment *vadjustment;
-    GtkAdjustment *hadjustment;
 
     rectangle = g_new0 (GdkRectangle, 1);
-    gtk_widget_get_allocation (item_ui, rectangle);
-
-    content_widget = nautilus_files_view_get_content_widget (NAUTILUS_FILES_VIEW (self));
-    vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (content_widget));
-    hadjustment = gtk_scrolled_window_get_hadjustment (GTK_SCROLLED_WINDOW (content_widget));
-
-    rectangle->x -= gtk_adjustment_get_value (hadjustment);
-    rectangle->y -= gtk_adjustment_get_value (vadjustment);
+    nautilus_view_icon_ui_get_item_area (self->view_ui, item_model, rectangle);
 
     return rectangle;
 }
@@ -651,13 +608,13 @@ static GdkRectangle *
 real_compute_rename_popover_pointing_to (NautilusFilesView *files_view)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    GtkWidget *item_ui;
+    NautilusViewItemModel *item_model;
 
     /* We only allow one item to be renamed with a popover */
-    item_ui = get_first_selected_item_ui (self);
-    g_return_val_if_fail (item_ui != NULL, NULL);
+    item_model = get_first_selected_item_model (self);
+    g_return_val_if_fail (item_model != NULL, NULL);
 
-    return get_rectangle_for_item_ui (self, item_ui);
+    return get_rectangle_for_item_model (self, item_model);
 }
 
 static GdkRectangle *
@@ -665,25 +622,23 @@ real_reveal_for_selection_context_menu (NautilusFilesView *files_view)
 {
     g_autolist (NautilusFile) selection = NULL;
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
-    GtkWidget *item_ui;
+    NautilusViewItemModel *item_model;
 
     selection = nautilus_view_get_selection (NAUTILUS_VIEW (files_view));
     g_return_val_if_fail (selection != NULL, NULL);
 
-    /* Get the focused item_ui, if selected.
-     * Otherwise, get the selected item_ui which is sorted the lowest.*/
-    item_ui = gtk_container_get_focus_child (GTK_CONTAINER (self->view_ui));
-    if (item_ui == NULL || !gtk_flow_box_child_is_selected (GTK_FLOW_BOX_CHILD (item_ui)))
+    /* Get the item at the cursor, if selected.
+     * Otherwise, get any of the selected items.*/
+    item_model = nautilus_view_icon_ui_get_cursor_item (self->view_ui);
+    if (item_model == NULL ||
+        g_list_find (selection, nautilus_view_item_model_get_file (item_model)) == NULL)
     {
-        g_autoptr (GList) list = gtk_flow_box_get_selected_children (GTK_FLOW_BOX (self->view_ui));
-
-        list = g_list_last (list);
-        item_ui = GTK_WIDGET (list->data);
+        item_model = nautilus_view_model_get_item_from_file (self->model, selection->data);
     }
 
-    reveal_item_ui (self, item_ui);
+    nautilus_view_icon_ui_reveal_item (self->view_ui, item_model);
 
-    return get_rectangle_for_item_ui (self, item_ui);
+    return get_rectangle_for_item_model (self, item_model);
 }
 
 static void
@@ -702,24 +657,36 @@ on_button_press_event (GtkGestureMultiPress *gesture,
     guint button;
     GdkEventSequence *sequence;
     const GdkEvent *event;
+    GdkModifierType state = 0;
     g_autolist (NautilusFile) selection = NULL;
-    GtkWidget *child_at_pos;
+    NautilusViewItemModel *item_model;
+    gint view_x;
+    gint view_y;
 
     self = NAUTILUS_VIEW_ICON_CONTROLLER (user_data);
     button = gtk_gesture_single_get_current_button (GTK_GESTURE_SINGLE (gesture));
     sequence = gtk_gesture_single_get_current_sequence (GTK_GESTURE_SINGLE (gesture));
     event = gtk_gesture_get_last_event (GTK_GESTURE (gesture), sequence);
+    gdk_event_get_state (event, &state);
+
+    /* Adding to the selection with the modifiers is handled by the view ui */
+    if (button == GDK_BUTTON_PRIMARY &&
+        (state & (GDK_CONTROL_MASK | GDK_SHIFT_MASK)) != 0)
+    {
+        return;
+    }
+
+    gtk_widget_translate_coordinates (gtk_event_controller_get_widget (GTK_EVENT_CONTROLLER (gesture)),
+                                      GTK_WIDGET (self->view_ui),
+                                      x, y, &view_x, &view_y);
 
     /* Need to update the selection so the popup has the right actions enabled */
     selection = nautilus_view_get_selection (NAUTILUS_VIEW (self));
-    child_at_pos = GTK_WIDGET (gtk_flow_box_get_child_at_pos (GTK_FLOW_BOX (self->view_ui),
-                                                              x, y));
-    if (child_at_pos != NULL)
+    item_model = nautilus_view_icon_ui_get_item_at_pos (self->view_ui, view_x, view_y);
+    if (item_model != NULL)
     {
         NautilusFile *selected_file;
-        NautilusViewItemModel *item_model;
 
-        item_model = nautilus_view_icon_item_ui_get_model (NAUTILUS_VIEW_ICON_ITEM_UI (child_at_pos));
         selected_file = nautilus_view_item_model_get_file (item_model);
         if (g_list_find (selection, selected_file) == NULL)
         {
@@ -758,8 +725,7 @@ on_longpress_gesture_pressed_callback (GtkGestureLongPress *gesture,
 {
     NautilusViewIconController *self;
     g_autoptr (GList) selection = NULL;
-    GtkWidget *child_at_pos;
-    GdkEventButton *event_button;
+    NautilusViewItemModel *item_model;
     GdkEventSequence *event_sequence;
     GdkEvent *event;
 
@@ -767,18 +733,14 @@ on_longpress_gesture_pressed_callback (GtkGestureLongPress *gesture,
     event = (GdkEvent *) gtk_gesture_get_last_event (GTK_GESTURE (gesture), event_sequence);
 
     self = NAUTILUS_VIEW_ICON_CONTROLLER (user_data);
-    event_button = (GdkEventButton *) event;
 
     /* Need to update the selection so the popup has the right actions enabled */
     selection = nautilus_view_get_selection (NAUTILUS_VIEW (self));
-    child_at_pos = GTK_WIDGET (gtk_flow_box_get_child_at_pos (GTK_FLOW_BOX (self->view_ui),
-                                                              event_button->x, event_button->y));
-    if (child_at_pos != NULL)
+    item_model = nautilus_view_icon_ui_get_item_at_pos (self->view_ui, x, y);
+    if (item_model != NULL)
     {
         NautilusFile *selected_file;
-        NautilusViewItemModel *item_model;
 
-        item_model = nautilus_view_icon_item_ui_get_model (NAUTILUS_VIEW_ICON_ITEM_UI (child_at_pos));
         selected_file = nautilus_view_item_model_get_file (item_model);
         if (g_list_find (selection, selected_file) == NULL)
         {
@@ -927,14 +889,13 @@ real_preview_selection_event (NautilusFilesView *files_view,
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (files_view);
     GtkMovementStep step;
     gint count;
-    gboolean handled;
 
     step = (direction == GTK_DIR_UP || direction == GTK_DIR_DOWN) ?
            GTK_MOVEMENT_DISPLAY_LINES : GTK_MOVEMENT_VISUAL_POSITIONS;
     count = (direction == GTK_DIR_RIGHT || direction == GTK_DIR_DOWN) ?
             1 : -1;
 
-    g_signal_emit_by_name (self->view_ui, "move-cursor", step, count, &handled);
+    nautilus_view_icon_ui_move_cursor (self->view_ui, step, count);
 }
 
 static void
@@ -988,23 +949,17 @@ constructed (GObject *object)
 {
     NautilusViewIconController *self = NAUTILUS_VIEW_ICON_CONTROLLER (object);
     GtkWidget *content_widget;
-    GtkAdjustment *hadjustment;
-    GtkAdjustment *vadjustment;
     GActionGroup *view_action_group;
     GtkGesture *longpress_gesture;
 
     content_widget = nautilus_files_view_get_content_widget (NAUTILUS_FILES_VIEW (self));
-    hadjustment = gtk_scrolled_window_get_hadjustment (GTK_SCROLLED_WINDOW (content_widget));
-    vadjustment = gtk_scrolled_window_get_vadjustment (GTK_SCROLLED_WINDOW (content_widget));
 
     self->model = nautilus_view_model_new ();
     self->view_ui = nautilus_view_icon_ui_new (self);
-    gtk_flow_box_set_hadjustment (GTK_FLOW_BOX (self->view_ui), hadjustment);
-    gtk_flow_box_set_vadjustment (GTK_FLOW_BOX (self->view_ui), vadjustment);
     gtk_widget_show (GTK_WIDGET (self->view_ui));
     self->view_icon = g_themed_icon_new ("view-grid-symbolic");
 
-    /* Compensating for the lack of event boxen to allow clicks outside the flow box. */
+    /* Compensating for the lack of event boxen to allow clicks outside the grid. */
     self->multi_press_gesture = gtk_gesture_multi_press_new (GTK_WIDGET (content_widget));
     gtk_event_controller_set_propagation_phase (GTK_EVENT_CONTROLLER (self->multi_press_gesture),
                                                 GTK_PHASE_CAPTURE);
@@ -1038,6 +993,8 @@ constructed (GObject *object)
                                      G_N_ELEMENTS (view_icon_actions),
                                      self);
     self->zoom_level = get_default_zoom_level ();
+    nautilus_view_icon_ui_set_icon_size (self->view_ui,
+                                         get_icon_size_for_zoom_level (self->zoom_level));
     /* Keep the action synced with the actual value, so the toolbar can poll it */
     g_action_group_change_action_state (nautilus_files_view_get_action_group (NAUTILUS_FILES_VIEW (self)),
                                         "zoom-to-level", g_variant_new_int32 (self->zoom_level));
@@ -6,7 +6,7 @@
 
 struct _NautilusViewIconItemUi
 {
-    GtkFlowBoxChild parent_instance;
+    GtkBin parent_instance;
 
     NautilusViewItemModel *model;
 
@@ -15,7 +15,7 @@ struct _NautilusViewIconItemUi
     GtkLabel *label;
 };
 
-G_DEFINE_TYPE (NautilusViewIconItemUi, nautilus_view_icon_item_ui, GTK_TYPE_FLOW_BOX_CHILD)
+G_DEFINE_TYPE (NautilusViewIconItemUi, nautilus_view_icon_item_ui, GTK_TYPE_BIN)
 
 enum
 {
@@ -73,14 +73,21 @@ update_icon (NautilusViewIconItemUi *self)
     GtkBox *box;
     guint icon_size;
 
-    icon_size = nautilus_view_item_model_get_icon_size (self->model);
-    nautilus_container_max_width_set_max_width (NAUTILUS_CONTAINER_MAX_WIDTH (self->item_container),
-                                                icon_size);
     box = GTK_BOX (gtk_bin_get_child (GTK_BIN (self->item_container)));
     if (self->icon)
     {
         gtk_container_remove (GTK_CONTAINER (box), GTK_WIDGET (self->icon));
+        self->icon = NULL;
     }
+
+    if (self->model == NULL)
+    {
+        return;
+    }
+
+    icon_size = nautilus_view_item_model_get_icon_size (self->model);
+    nautilus_container_max_width_set_max_width (NAUTILUS_CONTAINER_MAX_WIDTH (self->item_container),
+                                                icon_size);
     self->icon = create_icon (self);
     gtk_widget_show_all (GTK_WIDGET (self->icon));
     gtk_box_pack_start (box, GTK_WIDGET (self->icon), FALSE, FALSE, 0);
@@ -96,16 +103,9 @@ on_view_item_file_changed (GObject    *object,
 
     file = nautilus_view_item_model_get_file (self->model);
 
-    if (self->icon)
-    {
-        update_icon (self);
-    }
-
-    if (self->label)
-    {
-        gtk_label_set_text (self->label,
-                            nautilus_file_get_display_name (file));
-    }
+    update_icon (self);
+    gtk_label_set_text (self->label,
+                        nautilus_file_get_display_name (file));
 }
 
 static void
@@ -115,10 +115,7 @@ on_view_item_size_changed (GObject    *object,
 {
     NautilusViewIconItemUi *self = NAUTILUS_VIEW_ICON_ITEM_UI (user_data);
 
-    if (self->icon)
-    {
-        update_icon (self);
-    }
+    update_icon (self);
 }
 
 static void
@@ -129,25 +126,19 @@ constructed (GObject *object)
     GtkBox *item_selection_background;
     GtkLabel *label;
     GtkStyleContext *style_context;
-    NautilusFile *file;
-    guint icon_size;
 
     G_OBJECT_CLASS (nautilus_view_icon_item_ui_parent_class)->constructed (object);
 
-    file = nautilus_view_item_model_get_file (self->model);
-    icon_size = nautilus_view_item_model_get_icon_size (self->model);
     container = GTK_BOX (gtk_box_new (GTK_ORIENTATION_VERTICAL, 0));
     /* This container is for having a constant selection background, instead of
-     * the dinamically sized one of the GtkFlowBox
+     * the dinamically sized one of the grid cell
      */
     item_selection_background = GTK_BOX (gtk_box_new (GTK_ORIENTATION_VERTICAL, 0));
     gtk_widget_set_halign (GTK_WIDGET (item_selection_background), GTK_ALIGN_CENTER);
     gtk_widget_set_valign (GTK_WIDGET (item_selection_background), GTK_ALIGN_START);
     self->item_container = nautilus_container_max_width_new ();
-    self->icon = create_icon (self);
-    gtk_box_pack_start (container, GTK_WIDGET (self->icon), FALSE, FALSE, 0);
 
-    label = GTK_LABEL (gtk_label_new (nautilus_file_get_display_name (file)));
+    label = GTK_LABEL (gtk_label_new (NULL));
     gtk_widget_show (GTK_WIDGET (label));
 
 #if PANGO_VERSION_CHECK (1, 44, 4)
@@ -166,6 +157,7 @@ constructed (GObject *object)
     gtk_label_set_justify (label, GTK_JUSTIFY_CENTER);
     gtk_widget_set_valign (GTK_WIDGET (label), GTK_ALIGN_START);
     gtk_box_pack_end (container, GTK_WIDGET (label), TRUE, TRUE, 0);
+    self->label = label;
 
     style_context = gtk_widget_get_style_context (GTK_WIDGET (item_selection_background));
     gtk_style_context_add_class (style_context, "icon-item-background");
@@ -175,8 +167,6 @@ constructed (GObject *object)
 
     gtk_container_add (GTK_CONTAINER (self->item_container),
                        GTK_WIDGET (container));
-    nautilus_container_max_width_set_max_width (NAUTILUS_CONTAINER_MAX_WIDTH (self->item_container),
-                                                icon_size);
 
     gtk_container_add (GTK_CONTAINER (item_selection_background),
                        GTK_WIDGET (self->item_container));
@@ -184,10 +174,16 @@ constructed (GObject *object)
                        GTK_WIDGET (item_selection_background));
     gtk_widget_show_all (GTK_WIDGET (self));
 
-    g_signal_connect (self->model, "notify::icon-size",
-                      (GCallback) on_view_item_size_changed, self);
-    g_signal_connect (self->model, "notify::file",
-                      (GCallback) on_view_item_file_changed, self);
+    /* The model might have been given at construction time, before the
+     * widgets it fills in existed. */
+    if (self->model != NULL)
+    {
+        NautilusViewItemModel *model;
+
+        model = g_steal_pointer (&self->model);
+        nautilus_view_icon_item_ui_set_model (self, model);
+        g_object_unref (model);
+    }
 }
 
 static void
@@ -195,7 +191,12 @@ finalize (GObject *object)
 {
     NautilusViewIconItemUi *self = (NautilusViewIconItemUi *) object;
 
-    g_signal_handlers_disconnect_by_data (self->model, self);
+    if (self->model != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->model, self);
+        g_object_unref (self->model);
+    }
+
     G_OBJECT_CLASS (nautilus_view_icon_item_ui_parent_class)->finalize (object);
 }
 
@@ -220,13 +221,6 @@ get_property (GObject    *object,
     }
 }
 
-static void
-set_model (NautilusViewIconItemUi *self,
-           NautilusViewItemModel  *model)
-{
-    self->model = g_object_ref (model);
-}
-
 static void
 set_property (GObject      *object,
               guint         prop_id,
@@ -239,7 +233,15 @@ set_property (GObject      *object,
     {
         case PROP_MODEL:
         {
-            set_model (self, g_value_get_object (value));
+            if (self->label == NULL)
+            {
+                /* Not constructed yet, see constructed (). */
+                g_set_object (&self->model, g_value_get_object (value));
+            }
+            else
+            {
+                nautilus_view_icon_item_ui_set_model (self, g_value_get_object (value));
+            }
         }
         break;
 
@@ -264,7 +266,7 @@ nautilus_view_icon_item_ui_class_init (NautilusViewIconItemUiClass *klass)
                                                           "Item model",
                                                           "The item model that this UI reprensents",
                                                           NAUTILUS_TYPE_VIEW_ITEM_MODEL,
-                                                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT_ONLY));
+                                                          G_PARAM_READWRITE | G_PARAM_CONSTRUCT | G_PARAM_EXPLICIT_NOTIFY));
 }
 
 static void
@@ -285,3 +287,47 @@ nautilus_view_icon_item_ui_get_model (NautilusViewIconItemUi *self)
 {
     return self->model;
 }
+
+/* Rebinds the widget to another item, so that the grid can recycle item
+ * widgets as they scroll in and out of view instead of creating one for every
+ * item in the folder. Passing %NULL unbinds it.
+ */
+void
+nautilus_view_icon_item_ui_set_model (NautilusViewIconItemUi *self,
+                                      NautilusViewItemModel  *model)
+{
+    g_return_if_fail (NAUTILUS_IS_VIEW_ICON_ITEM_UI (self));
+
+    if (self->model == model)
+    {
+        return;
+    }
+
+    if (self->model != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->model, self);
+    }
+
+    g_set_object (&self->model, model);
+
+    if (self->model != NULL)
+    {
+        NautilusFile *file;
+
+        file = nautilus_view_item_model_get_file (self->model);
+        gtk_label_set_text (self->label, nautilus_file_get_display_name (file));
+
+        g_signal_connect (self->model, "notify::icon-size",
+                          (GCallback) on_view_item_size_changed, self);
+        g_signal_connect (self->model, "notify::file",
+                          (GCallback) on_view_item_file_changed, self);
+    }
+    else
+    {
+        gtk_label_set_text (self->label, NULL);
+    }
+
+    update_icon (self);
+
+    g_object_notify (G_OBJECT (self), "model");
+}
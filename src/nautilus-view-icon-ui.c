@@ -18,28 +18,103 @@
 
 #include <config.h>
 #include <glib.h>
+#include <math.h>
 
 #include "nautilus-view-icon-ui.h"
 #include "nautilus-view-icon-item-ui.h"
 #include "nautilus-view-icon-controller.h"
+#include "nautilus-enums.h"
 #include "nautilus-files-view.h"
 #include "nautilus-file.h"
 #include "nautilus-directory.h"
 #include "nautilus-global-preferences.h"
+#include "nautilus-thumbnail-cache.h"
+
+/* The grid only creates item widgets for the rows in view, plus this many
+ * rows above and below, and recycles them while scrolling. This keeps the
+ * number of widgets bounded by the size of the window, not of the folder.
+ */
+#define PREFETCH_ROWS 2
+
+#define MARGIN 10
+/* Keep in sync with the padding of .icon-item-background in Adwaita.css */
+#define ITEM_PADDING 4
+#define ITEM_SPACING 6
+#define LABEL_LINES 3
+
+/* Interval for scrolling while the rubberband is at the edge of the view,
+ * in milliseconds, and how close to the edge it has to be. */
+#define RUBBERBAND_TIMEOUT_INTERVAL 10
+#define RUBBERBAND_SCROLL_THRESHOLD 5
 
 struct _NautilusViewIconUi
 {
-    GtkFlowBox parent_instance;
+    GtkContainer parent_instance;
 
     NautilusViewIconController *controller;
+    GListModel *model;
+
+    GtkAdjustment *hadjustment;
+    GtkAdjustment *vadjustment;
+    guint hscroll_policy : 1;
+    guint vscroll_policy : 1;
+
+    guint icon_size;
+    int cell_width;
+    int cell_height;
+    int column_width;
+    guint n_columns;
+
+    /* Item widgets bound to the items from bound_start on, in model order */
+    guint bound_start;
+    GPtrArray *bound_items_ui;
+    /* Item widgets that are not bound to any item, ready to be reused */
+    GPtrArray *free_items_ui;
+
+    /* Selected NautilusViewItemModels. The selection lives here and not in
+     * the item widgets, since most items don't have one. */
+    GHashTable *selection;
+    /* Items whose selection state flipped since the view was last notified,
+     * so that it gets the changes instead of the whole selection. */
+    GHashTable *selection_changes;
+    guint cursor;
+    guint anchor;
+
+    /* Positions of the items in the model before n_known_positions.
+     * Changes to the model shift the positions after them, so those are
+     * dropped and looked up again as needed. */
+    GHashTable *positions;
+    guint n_known_positions;
+
+    /* Selecting with a rubberband. The start and end are in content
+     * coordinates, the pointer in widget coordinates. The initial selection
+     * is only set while a press on the background may start a rubberband. */
+    gboolean rubberband_active;
+    double rubberband_start_x;
+    double rubberband_start_y;
+    double rubberband_end_x;
+    double rubberband_end_y;
+    double rubberband_pointer_x;
+    double rubberband_pointer_y;
+    gboolean rubberband_toggles;
+    GHashTable *rubberband_initial_selection;
+    guint rubberband_timeout_id;
+
+    GtkGesture *multi_press_gesture;
+    GtkGesture *drag_gesture;
 };
 
-G_DEFINE_TYPE (NautilusViewIconUi, nautilus_view_icon_ui, GTK_TYPE_FLOW_BOX)
+G_DEFINE_TYPE_WITH_CODE (NautilusViewIconUi, nautilus_view_icon_ui, GTK_TYPE_CONTAINER,
+                         G_IMPLEMENT_INTERFACE (GTK_TYPE_SCROLLABLE, NULL))
 
 enum
 {
     PROP_0,
     PROP_CONTROLLER,
+    PROP_HADJUSTMENT,
+    PROP_VADJUSTMENT,
+    PROP_HSCROLL_POLICY,
+    PROP_VSCROLL_POLICY,
     N_PROPS
 };
 
@@ -52,6 +127,47 @@ set_controller (NautilusViewIconUi         *self,
     g_object_notify (G_OBJECT (self), "controller");
 }
 
+static void
+on_adjustment_value_changed (GtkAdjustment *adjustment,
+                             gpointer       user_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
+
+    /* The bound range is updated on allocation, see size_allocate (). */
+    gtk_widget_queue_allocate (GTK_WIDGET (self));
+}
+
+static void
+set_adjustment (NautilusViewIconUi  *self,
+                GtkAdjustment      **self_adjustment,
+                GtkAdjustment       *adjustment,
+                const char          *property_name)
+{
+    if (adjustment != NULL && *self_adjustment == adjustment)
+    {
+        return;
+    }
+
+    if (*self_adjustment != NULL)
+    {
+        g_signal_handlers_disconnect_by_func (*self_adjustment,
+                                              on_adjustment_value_changed,
+                                              self);
+        g_object_unref (*self_adjustment);
+    }
+
+    if (adjustment == NULL)
+    {
+        adjustment = gtk_adjustment_new (0.0, 0.0, 0.0, 0.0, 0.0, 0.0);
+    }
+
+    g_signal_connect (adjustment, "value-changed",
+                      G_CALLBACK (on_adjustment_value_changed), self);
+    *self_adjustment = g_object_ref_sink (adjustment);
+
+    g_object_notify (G_OBJECT (self), property_name);
+}
+
 static void
 get_property (GObject    *object,
               guint       prop_id,
@@ -68,6 +184,30 @@ get_property (GObject    *object,
         }
         break;
 
+        case PROP_HADJUSTMENT:
+        {
+            g_value_set_object (value, self->hadjustment);
+        }
+        break;
+
+        case PROP_VADJUSTMENT:
+        {
+            g_value_set_object (value, self->vadjustment);
+        }
+        break;
+
+        case PROP_HSCROLL_POLICY:
+        {
+            g_value_set_enum (value, self->hscroll_policy);
+        }
+        break;
+
+        case PROP_VSCROLL_POLICY:
+        {
+            g_value_set_enum (value, self->vscroll_policy);
+        }
+        break;
+
         default:
         {
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -91,6 +231,34 @@ set_property (GObject      *object,
         }
         break;
 
+        case PROP_HADJUSTMENT:
+        {
+            set_adjustment (self, &self->hadjustment,
+                            g_value_get_object (value), "hadjustment");
+        }
+        break;
+
+        case PROP_VADJUSTMENT:
+        {
+            set_adjustment (self, &self->vadjustment,
+                            g_value_get_object (value), "vadjustment");
+        }
+        break;
+
+        case PROP_HSCROLL_POLICY:
+        {
+            self->hscroll_policy = g_value_get_enum (value);
+            gtk_widget_queue_resize (GTK_WIDGET (self));
+        }
+        break;
+
+        case PROP_VSCROLL_POLICY:
+        {
+            self->vscroll_policy = g_value_get_enum (value);
+            gtk_widget_queue_resize (GTK_WIDGET (self));
+        }
+        break;
+
         default:
         {
             G_OBJECT_WARN_INVALID_PROPERTY_ID (object, prop_id, pspec);
@@ -98,158 +266,1590 @@ set_property (GObject      *object,
     }
 }
 
-void
-nautilus_view_icon_ui_set_selection (NautilusViewIconUi *self,
-                                     GQueue             *selection)
+static guint
+get_n_items (NautilusViewIconUi *self)
+{
+    return g_list_model_get_n_items (self->model);
+}
+
+static NautilusViewItemModel *
+get_item (NautilusViewIconUi *self,
+          guint               position)
 {
     NautilusViewItemModel *item_model;
-    NautilusViewModel *model;
-    GListStore *gmodel;
-    gint i = 0;
 
-    model = nautilus_view_icon_controller_get_model (self->controller);
-    gmodel = nautilus_view_model_get_g_model (model);
-    while ((item_model = NAUTILUS_VIEW_ITEM_MODEL (g_list_model_get_item (G_LIST_MODEL (gmodel), i))))
+    /* The model keeps the item alive, no need for the extra reference. */
+    item_model = g_list_model_get_item (self->model, position);
+    if (item_model != NULL)
     {
-        GtkWidget *item_ui;
+        g_object_unref (item_model);
+    }
 
-        item_ui = nautilus_view_item_model_get_item_ui (item_model);
-        if (g_queue_find (selection, item_model) != NULL)
-        {
-            gtk_flow_box_select_child (GTK_FLOW_BOX (self),
-                                       GTK_FLOW_BOX_CHILD (item_ui));
-        }
-        else
-        {
-            gtk_flow_box_unselect_child (GTK_FLOW_BOX (self),
-                                         GTK_FLOW_BOX_CHILD (item_ui));
-        }
+    return item_model;
+}
+
+static void
+update_cell_size (NautilusViewIconUi *self)
+{
+    PangoContext *context;
+    PangoFontMetrics *metrics;
+    int line_height;
+
+    context = gtk_widget_get_pango_context (GTK_WIDGET (self));
+    metrics = pango_context_get_metrics (context,
+                                         pango_context_get_font_description (context),
+                                         pango_context_get_language (context));
+    line_height = PANGO_PIXELS (pango_font_metrics_get_ascent (metrics) +
+                                pango_font_metrics_get_descent (metrics));
+    pango_font_metrics_unref (metrics);
+
+    /* All cells have the same size, so that the position of any item can be
+     * computed without measuring the ones before it. The label takes at most
+     * LABEL_LINES lines, see the item widget. */
+    self->cell_width = self->icon_size + 2 * ITEM_PADDING + ITEM_SPACING;
+    self->cell_height = self->icon_size + LABEL_LINES * line_height +
+                        2 * ITEM_PADDING + ITEM_SPACING;
+}
+
+static void
+update_columns (NautilusViewIconUi *self,
+                int                 width)
+{
+    int available_width;
+
+    available_width = MAX (0, width - 2 * MARGIN);
+    self->n_columns = MAX (1, available_width / self->cell_width);
+    /* Spread the remaining space between the columns */
+    self->column_width = MAX (self->cell_width,
+                              available_width / (int) self->n_columns);
+}
+
+static int
+get_content_height (NautilusViewIconUi *self)
+{
+    guint n_rows;
+
+    n_rows = (get_n_items (self) + self->n_columns - 1) / self->n_columns;
+
+    return 2 * MARGIN + n_rows * self->cell_height;
+}
+
+/* In content coordinates, that is, not taking scrolling into account. */
+static void
+get_cell_area (NautilusViewIconUi *self,
+               guint               position,
+               GdkRectangle       *area)
+{
+    guint row;
+    guint column;
+
+    row = position / self->n_columns;
+    column = position % self->n_columns;
+    if (gtk_widget_get_direction (GTK_WIDGET (self)) == GTK_TEXT_DIR_RTL)
+    {
+        column = self->n_columns - 1 - column;
+    }
+
+    area->x = MARGIN + column * self->column_width +
+              (self->column_width - self->cell_width) / 2;
+    area->y = MARGIN + row * self->cell_height;
+    area->width = self->cell_width;
+    area->height = self->cell_height;
+}
+
+static gboolean
+get_position_at (NautilusViewIconUi *self,
+                 double              x,
+                 double              y,
+                 guint              *position)
+{
+    GdkRectangle area;
+    guint row;
+    guint column;
+    guint result;
+
+    if (x < MARGIN || y < MARGIN)
+    {
+        return FALSE;
+    }
+
+    column = (x - MARGIN) / self->column_width;
+    row = (y - MARGIN) / self->cell_height;
+    if (column >= self->n_columns)
+    {
+        return FALSE;
+    }
+
+    if (gtk_widget_get_direction (GTK_WIDGET (self)) == GTK_TEXT_DIR_RTL)
+    {
+        column = self->n_columns - 1 - column;
+    }
+
+    result = row * self->n_columns + column;
+    if (result >= get_n_items (self))
+    {
+        return FALSE;
+    }
+
+    /* Clicks in the space between cells are on the background */
+    get_cell_area (self, result, &area);
+    if (x < area.x || x >= area.x + area.width)
+    {
+        return FALSE;
+    }
+
+    *position = result;
+
+    return TRUE;
+}
+
+static void
+get_bound_range (NautilusViewIconUi *self,
+                 guint              *start,
+                 guint              *end)
+{
+    guint n_items;
+    int value;
+    int height;
+    int first_row;
+    int last_row;
 
-        i++;
+    n_items = get_n_items (self);
+    value = self->vadjustment != NULL ? gtk_adjustment_get_value (self->vadjustment) : 0;
+    height = gtk_widget_get_allocated_height (GTK_WIDGET (self));
+
+    first_row = MAX (0, (value - MARGIN) / self->cell_height - PREFETCH_ROWS);
+    last_row = MAX (0, (value + height - MARGIN) / self->cell_height + 1 + PREFETCH_ROWS);
+
+    *start = MIN (n_items, first_row * self->n_columns);
+    *end = MIN (n_items, last_row * self->n_columns);
+}
+
+static void
+update_item_ui_selected (NautilusViewIconUi *self,
+                         GtkWidget          *item_ui)
+{
+    NautilusViewItemModel *item_model;
+
+    item_model = nautilus_view_icon_item_ui_get_model (NAUTILUS_VIEW_ICON_ITEM_UI (item_ui));
+    if (item_model != NULL && g_hash_table_contains (self->selection, item_model))
+    {
+        gtk_widget_set_state_flags (item_ui, GTK_STATE_FLAG_SELECTED, FALSE);
+    }
+    else
+    {
+        gtk_widget_unset_state_flags (item_ui, GTK_STATE_FLAG_SELECTED);
     }
 }
 
+static void
+update_selected_items_ui (NautilusViewIconUi *self)
+{
+    guint i;
+
+    for (i = 0; i < self->bound_items_ui->len; i++)
+    {
+        update_item_ui_selected (self, g_ptr_array_index (self->bound_items_ui, i));
+    }
+}
 
 static GtkWidget *
-create_widget_func (gpointer item,
-                    gpointer user_data)
+acquire_item_ui (NautilusViewIconUi *self)
 {
-    NautilusViewItemModel *item_model = NAUTILUS_VIEW_ITEM_MODEL (item);
-    NautilusViewIconItemUi *child;
+    GtkWidget *item_ui;
+
+    if (self->free_items_ui->len > 0)
+    {
+        item_ui = g_ptr_array_remove_index_fast (self->free_items_ui,
+                                                 self->free_items_ui->len - 1);
+    }
+    else
+    {
+        item_ui = GTK_WIDGET (nautilus_view_icon_item_ui_new (NULL));
+        gtk_widget_set_parent (item_ui, GTK_WIDGET (self));
+    }
 
-    child = nautilus_view_icon_item_ui_new (item_model);
-    nautilus_view_item_model_set_item_ui (item_model, GTK_WIDGET (child));
-    gtk_widget_show (GTK_WIDGET (child));
+    gtk_widget_set_child_visible (item_ui, TRUE);
 
-    return GTK_WIDGET (child);
+    return item_ui;
 }
 
 static void
-on_child_activated (GtkFlowBox      *flow_box,
-                    GtkFlowBoxChild *child,
-                    gpointer         user_data)
+bind_item_ui (NautilusViewIconUi    *self,
+              GtkWidget             *item_ui,
+              NautilusViewItemModel *item_model)
+{
+    nautilus_view_icon_item_ui_set_model (NAUTILUS_VIEW_ICON_ITEM_UI (item_ui), item_model);
+    nautilus_view_item_model_set_item_ui (item_model, item_ui);
+    update_item_ui_selected (self, item_ui);
+    /* Keep the thumbnail cached while the item is shown */
+    nautilus_thumbnail_cache_set_visible (nautilus_view_item_model_get_file (item_model), TRUE);
+}
+
+static void
+unbind_item_ui (NautilusViewIconUi *self,
+                GtkWidget          *item_ui)
 {
-    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
     NautilusViewItemModel *item_model;
-    NautilusFile *file;
-    g_autoptr (GList) list = NULL;
-    GdkEvent *event;
-    guint keyval;
-    gboolean is_preview = FALSE;
 
-    item_model = nautilus_view_icon_item_ui_get_model (NAUTILUS_VIEW_ICON_ITEM_UI (child));
-    file = nautilus_view_item_model_get_file (item_model);
-    list = g_list_append (list, file);
+    item_model = nautilus_view_icon_item_ui_get_model (NAUTILUS_VIEW_ICON_ITEM_UI (item_ui));
+    if (item_model != NULL &&
+        nautilus_view_item_model_get_item_ui (item_model) == item_ui)
+    {
+        nautilus_view_item_model_set_item_ui (item_model, NULL);
+    }
+    if (item_model != NULL)
+    {
+        nautilus_thumbnail_cache_set_visible (nautilus_view_item_model_get_file (item_model), FALSE);
+    }
+
+    nautilus_view_icon_item_ui_set_model (NAUTILUS_VIEW_ICON_ITEM_UI (item_ui), NULL);
+    gtk_widget_set_child_visible (item_ui, FALSE);
+    g_ptr_array_add (self->free_items_ui, item_ui);
+}
+
+/* Binds item widgets to the items in view, reusing the widgets of items that
+ * stay in view and recycling the ones of items that went out of it.
+ */
+static void
+update_bound_range (NautilusViewIconUi *self)
+{
+    g_autoptr (GHashTable) reusable = NULL;
+    g_autoptr (GPtrArray) items = NULL;
+    GHashTableIter iter;
+    gpointer item_ui;
+    guint start;
+    guint end;
+    guint i;
+
+    get_bound_range (self, &start, &end);
 
-    event = gtk_get_current_event ();
-    if (event && gdk_event_get_keyval (event, &keyval))
+    reusable = g_hash_table_new (NULL, NULL);
+    for (i = 0; i < self->bound_items_ui->len; i++)
     {
-        if (keyval == GDK_KEY_space)
+        item_ui = g_ptr_array_index (self->bound_items_ui, i);
+        g_hash_table_insert (reusable,
+                             nautilus_view_icon_item_ui_get_model (item_ui),
+                             item_ui);
+    }
+    g_ptr_array_set_size (self->bound_items_ui, 0);
+
+    items = g_ptr_array_sized_new (end - start);
+    for (i = start; i < end; i++)
+    {
+        NautilusViewItemModel *item_model;
+
+        item_model = get_item (self, i);
+        item_ui = g_hash_table_lookup (reusable, item_model);
+        if (item_ui != NULL)
         {
-            is_preview = TRUE;
+            g_hash_table_remove (reusable, item_model);
         }
+
+        g_ptr_array_add (items, item_model);
+        g_ptr_array_add (self->bound_items_ui, item_ui);
     }
 
-    if (is_preview)
+    g_hash_table_iter_init (&iter, reusable);
+    while (g_hash_table_iter_next (&iter, NULL, &item_ui))
     {
-        nautilus_files_view_preview_files (NAUTILUS_FILES_VIEW (self->controller), list, NULL);
+        unbind_item_ui (self, item_ui);
     }
-    else
+
+    for (i = 0; i < self->bound_items_ui->len; i++)
     {
-        nautilus_files_view_activate_files (NAUTILUS_FILES_VIEW (self->controller), list, 0, TRUE);
+        if (g_ptr_array_index (self->bound_items_ui, i) == NULL)
+        {
+            item_ui = acquire_item_ui (self);
+            bind_item_ui (self, item_ui, g_ptr_array_index (items, i));
+            self->bound_items_ui->pdata[i] = item_ui;
+        }
     }
 
-    g_clear_pointer (&event, gdk_event_free);
+    self->bound_start = start;
 }
 
 static void
-on_ui_selected_children_changed (GtkFlowBox *box,
-                                 gpointer    user_data)
+configure_adjustments (NautilusViewIconUi *self)
 {
-    NautilusViewIconUi *self;
+    int width;
+    int height;
 
-    self = NAUTILUS_VIEW_ICON_UI (user_data);
-    nautilus_files_view_notify_selection_changed (NAUTILUS_FILES_VIEW (self->controller));
+    width = gtk_widget_get_allocated_width (GTK_WIDGET (self));
+    height = gtk_widget_get_allocated_height (GTK_WIDGET (self));
+
+    /* We are allocating already, avoid queueing another allocation. */
+    g_signal_handlers_block_by_func (self->hadjustment, on_adjustment_value_changed, self);
+    g_signal_handlers_block_by_func (self->vadjustment, on_adjustment_value_changed, self);
+
+    gtk_adjustment_configure (self->hadjustment,
+                              0.0, 0.0, width,
+                              width * 0.1, width * 0.9, width);
+    gtk_adjustment_configure (self->vadjustment,
+                              gtk_adjustment_get_value (self->vadjustment),
+                              0.0, MAX (height, get_content_height (self)),
+                              self->cell_height, height * 0.9, height);
+
+    g_signal_handlers_unblock_by_func (self->hadjustment, on_adjustment_value_changed, self);
+    g_signal_handlers_unblock_by_func (self->vadjustment, on_adjustment_value_changed, self);
+}
+
+static gboolean
+is_position_from (gpointer key,
+                  gpointer value,
+                  gpointer user_data)
+{
+    return GPOINTER_TO_UINT (value) >= GPOINTER_TO_UINT (user_data);
 }
 
+/* Forgets the positions from @position on. The table holds no reference on
+ * the items, so the entries of removed items must go, or a new item at the
+ * same address would get a stale position. */
 static void
-finalize (GObject *object)
+invalidate_positions (NautilusViewIconUi *self,
+                      guint               position)
 {
-    G_OBJECT_CLASS (nautilus_view_icon_ui_parent_class)->finalize (object);
+    if (position >= self->n_known_positions)
+    {
+        return;
+    }
+
+    self->n_known_positions = position;
+    if (position == 0)
+    {
+        g_hash_table_remove_all (self->positions);
+    }
+    else
+    {
+        g_hash_table_foreach_remove (self->positions, is_position_from,
+                                     GUINT_TO_POINTER (position));
+    }
+}
+
+static gboolean
+find_item_position (NautilusViewIconUi    *self,
+                    NautilusViewItemModel *item_model,
+                    guint                 *position)
+{
+    gpointer value;
+    guint n_items;
+    guint i;
+
+    if (g_hash_table_lookup_extended (self->positions, item_model, NULL, &value) &&
+        GPOINTER_TO_UINT (value) < self->n_known_positions)
+    {
+        *position = GPOINTER_TO_UINT (value);
+        return TRUE;
+    }
+
+    /* Learn the positions in model order up to the item, so that each item
+     * is looked at once until the model changes before it. */
+    n_items = get_n_items (self);
+    for (i = self->n_known_positions; i < n_items; i++)
+    {
+        NautilusViewItemModel *item;
+
+        item = get_item (self, i);
+        g_hash_table_insert (self->positions, item, GUINT_TO_POINTER (i));
+        self->n_known_positions = i + 1;
+
+        if (item == item_model)
+        {
+            *position = i;
+            return TRUE;
+        }
+    }
+
+    return FALSE;
 }
 
 static void
-constructed (GObject *object)
+reveal_position (NautilusViewIconUi *self,
+                 guint               position)
 {
-    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (object);
-    NautilusViewModel *model;
-    GListStore *gmodel;
+    GdkRectangle area;
+    double value;
+    int height;
 
-    G_OBJECT_CLASS (nautilus_view_icon_ui_parent_class)->constructed (object);
+    get_cell_area (self, position, &area);
+    value = gtk_adjustment_get_value (self->vadjustment);
+    height = gtk_widget_get_allocated_height (GTK_WIDGET (self));
 
-    gtk_flow_box_set_activate_on_single_click (GTK_FLOW_BOX (self), FALSE);
-    gtk_flow_box_set_max_children_per_line (GTK_FLOW_BOX (self), 20);
-    gtk_flow_box_set_selection_mode (GTK_FLOW_BOX (self), GTK_SELECTION_MULTIPLE);
-    gtk_flow_box_set_homogeneous (GTK_FLOW_BOX (self), FALSE);
-    gtk_widget_set_can_focus (GTK_WIDGET (self), TRUE);
-    gtk_widget_set_valign (GTK_WIDGET (self), GTK_ALIGN_START);
-    gtk_widget_set_margin_top (GTK_WIDGET (self), 10);
-    gtk_widget_set_margin_start (GTK_WIDGET (self), 10);
-    gtk_widget_set_margin_bottom (GTK_WIDGET (self), 10);
-    gtk_widget_set_margin_end (GTK_WIDGET (self), 10);
+    /* Scroll only as necessary. */
+    if (area.y < value)
+    {
+        gtk_adjustment_set_value (self->vadjustment, area.y);
+    }
+    else if (area.y + area.height > value + height)
+    {
+        gtk_adjustment_set_value (self->vadjustment,
+                                  area.y + area.height - height);
+    }
+}
 
-    model = nautilus_view_icon_controller_get_model (self->controller);
-    gmodel = nautilus_view_model_get_g_model (model);
-    gtk_flow_box_bind_model (GTK_FLOW_BOX (self),
-                             G_LIST_MODEL (gmodel),
-                             create_widget_func, self, NULL);
+static void
+record_selection_change (NautilusViewIconUi    *self,
+                         NautilusViewItemModel *item_model)
+{
+    /* Flipping back cancels the change out */
+    if (!g_hash_table_remove (self->selection_changes, item_model))
+    {
+        g_hash_table_add (self->selection_changes, g_object_ref (item_model));
+    }
+}
 
-    g_signal_connect (self, "child-activated", (GCallback) on_child_activated, self);
-    g_signal_connect (self, "selected-children-changed", (GCallback) on_ui_selected_children_changed, self);
+static void
+select_item (NautilusViewIconUi    *self,
+             NautilusViewItemModel *item_model)
+{
+    if (g_hash_table_add (self->selection, g_object_ref (item_model)))
+    {
+        record_selection_change (self, item_model);
+    }
 }
 
 static void
-nautilus_view_icon_ui_class_init (NautilusViewIconUiClass *klass)
+toggle_item (NautilusViewIconUi    *self,
+             NautilusViewItemModel *item_model)
 {
-    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    record_selection_change (self, item_model);
+    if (!g_hash_table_remove (self->selection, item_model))
+    {
+        g_hash_table_add (self->selection, g_object_ref (item_model));
+    }
+}
 
-    object_class->finalize = finalize;
-    object_class->set_property = set_property;
-    object_class->get_property = get_property;
-    object_class->constructed = constructed;
+static void
+unselect_all (NautilusViewIconUi *self)
+{
+    GHashTableIter iter;
+    gpointer item_model;
 
-    g_object_class_install_property (object_class,
-                                     PROP_CONTROLLER,
-                                     g_param_spec_object ("controller",
-                                                          "Controller",
-                                                          "The controller of the view",
-                                                          NAUTILUS_TYPE_VIEW_ICON_CONTROLLER,
-                                                          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+    g_hash_table_iter_init (&iter, self->selection);
+    while (g_hash_table_iter_next (&iter, &item_model, NULL))
+    {
+        record_selection_change (self, item_model);
+    }
+    g_hash_table_remove_all (self->selection);
+}
+
+static void
+select_range (NautilusViewIconUi *self,
+              guint               from,
+              guint               to)
+{
+    guint i;
+
+    unselect_all (self);
+    for (i = MIN (from, to); i <= MAX (from, to) && i < get_n_items (self); i++)
+    {
+        select_item (self, get_item (self, i));
+    }
+}
+
+static void
+selection_changed (NautilusViewIconUi *self)
+{
+    g_autoptr (GList) added = NULL;
+    g_autoptr (GList) removed = NULL;
+    g_autoptr (GHashTable) changes = NULL;
+    GHashTableIter iter;
+    gpointer item_model;
+
+    update_selected_items_ui (self);
+
+    /* The changes keep the items, and so their files, alive until the view
+     * got them. */
+    changes = g_steal_pointer (&self->selection_changes);
+    self->selection_changes = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+
+    g_hash_table_iter_init (&iter, changes);
+    while (g_hash_table_iter_next (&iter, &item_model, NULL))
+    {
+        NautilusFile *file;
+
+        file = nautilus_view_item_model_get_file (item_model);
+        if (g_hash_table_contains (self->selection, item_model))
+        {
+            added = g_list_prepend (added, file);
+        }
+        else
+        {
+            removed = g_list_prepend (removed, file);
+        }
+    }
+
+    nautilus_files_view_notify_selection_changes (NAUTILUS_FILES_VIEW (self->controller),
+                                                  added, removed);
+}
+
+static void
+set_cursor (NautilusViewIconUi *self,
+            guint               position,
+            gboolean            extend,
+            gboolean            modify)
+{
+    self->cursor = position;
+    reveal_position (self, position);
+
+    if (modify)
+    {
+        return;
+    }
+
+    if (extend)
+    {
+        select_range (self, self->anchor, position);
+    }
+    else
+    {
+        self->anchor = position;
+        select_range (self, position, position);
+    }
+
+    selection_changed (self);
+}
+
+static void
+move_cursor (NautilusViewIconUi *self,
+             GtkMovementStep     step,
+             gint                count,
+             gboolean            extend,
+             gboolean            modify)
+{
+    guint n_items;
+    gint64 position;
+    int rows_per_page;
+
+    n_items = get_n_items (self);
+    if (n_items == 0)
+    {
+        return;
+    }
+
+    position = MIN (self->cursor, n_items - 1);
+    switch (step)
+    {
+        case GTK_MOVEMENT_VISUAL_POSITIONS:
+        {
+            if (gtk_widget_get_direction (GTK_WIDGET (self)) == GTK_TEXT_DIR_RTL)
+            {
+                count = -count;
+            }
+            position += count;
+        }
+        break;
+
+        case GTK_MOVEMENT_DISPLAY_LINES:
+        {
+            position += (gint64) count * self->n_columns;
+        }
+        break;
+
+        case GTK_MOVEMENT_PAGES:
+        {
+            rows_per_page = MAX (1, gtk_widget_get_allocated_height (GTK_WIDGET (self)) /
+                                    self->cell_height);
+            position += (gint64) count * rows_per_page * self->n_columns;
+        }
+        break;
+
+        case GTK_MOVEMENT_BUFFER_ENDS:
+        {
+            position = count < 0 ? 0 : n_items - 1;
+        }
+        break;
+
+        default:
+        {
+            return;
+        }
+    }
+
+    set_cursor (self, CLAMP (position, 0, (gint64) n_items - 1), extend, modify);
+}
+
+static void
+activate_item (NautilusViewIconUi    *self,
+               NautilusViewItemModel *item_model,
+               gboolean               is_preview)
+{
+    NautilusFile *file;
+    g_autoptr (GList) list = NULL;
+
+    file = nautilus_view_item_model_get_file (item_model);
+    list = g_list_append (list, file);
+
+    if (is_preview)
+    {
+        nautilus_files_view_preview_files (NAUTILUS_FILES_VIEW (self->controller), list, NULL);
+    }
+    else
+    {
+        nautilus_files_view_activate_files (NAUTILUS_FILES_VIEW (self->controller), list, 0, TRUE);
+    }
+}
+
+static void
+on_multi_press_pressed (GtkGestureMultiPress *gesture,
+                        gint                  n_press,
+                        gdouble               x,
+                        gdouble               y,
+                        gpointer              user_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
+    GdkEventSequence *sequence;
+    const GdkEvent *event;
+    GdkModifierType state = 0;
+    guint button;
+    guint position;
+
+    button = gtk_gesture_single_get_current_button (GTK_GESTURE_SINGLE (gesture));
+    sequence = gtk_gesture_single_get_current_sequence (GTK_GESTURE_SINGLE (gesture));
+    event = gtk_gesture_get_last_event (GTK_GESTURE (gesture), sequence);
+    gdk_event_get_state (event, &state);
+
+    gtk_widget_grab_focus (GTK_WIDGET (self));
+
+    if (!get_position_at (self,
+                          x + gtk_adjustment_get_value (self->hadjustment),
+                          y + gtk_adjustment_get_value (self->vadjustment),
+                          &position))
+    {
+        return;
+    }
+
+    /* The controller updates the selection for plain and secondary clicks,
+     * since it needs it before popping up the context menu. */
+    if (button == GDK_BUTTON_PRIMARY && (state & GDK_CONTROL_MASK))
+    {
+        NautilusViewItemModel *item_model;
+
+        item_model = get_item (self, position);
+        toggle_item (self, item_model);
+        self->cursor = position;
+        self->anchor = position;
+        selection_changed (self);
+    }
+    else if (button == GDK_BUTTON_PRIMARY && (state & GDK_SHIFT_MASK))
+    {
+        self->cursor = position;
+        select_range (self, self->anchor, position);
+        selection_changed (self);
+    }
+    else
+    {
+        self->cursor = position;
+        self->anchor = position;
+
+        if (button == GDK_BUTTON_PRIMARY && n_press == 2)
+        {
+            activate_item (self, get_item (self, position), FALSE);
+        }
+    }
+}
+
+static void
+get_rubberband_area (NautilusViewIconUi *self,
+                     GdkRectangle       *area)
+{
+    area->x = floor (MIN (self->rubberband_start_x, self->rubberband_end_x));
+    area->y = floor (MIN (self->rubberband_start_y, self->rubberband_end_y));
+    area->width = MAX (1, ceil (ABS (self->rubberband_end_x - self->rubberband_start_x)));
+    area->height = MAX (1, ceil (ABS (self->rubberband_end_y - self->rubberband_start_y)));
+}
+
+/* Selects the items the rubberband touches, on top of the ones selected
+ * before it started, or toggles them when it was started with Control. */
+static void
+rubberband_select (NautilusViewIconUi *self)
+{
+    GdkRectangle band;
+    GdkRectangle area;
+    GHashTableIter iter;
+    gpointer item_model;
+    guint n_items;
+    int first_row;
+    int last_row;
+    int row;
+    guint column;
+
+    get_rubberband_area (self, &band);
+
+    unselect_all (self);
+    g_hash_table_iter_init (&iter, self->rubberband_initial_selection);
+    while (g_hash_table_iter_next (&iter, &item_model, NULL))
+    {
+        select_item (self, item_model);
+    }
+
+    n_items = get_n_items (self);
+    first_row = MAX (0, (band.y - MARGIN) / self->cell_height);
+    last_row = MAX (0, (band.y + band.height - MARGIN) / self->cell_height);
+    for (row = first_row; row <= last_row; row++)
+    {
+        for (column = 0; column < self->n_columns; column++)
+        {
+            guint position;
+
+            position = row * self->n_columns + column;
+            if (position >= n_items)
+            {
+                break;
+            }
+
+            get_cell_area (self, position, &area);
+            if (!gdk_rectangle_intersect (&band, &area, NULL))
+            {
+                continue;
+            }
+
+            item_model = get_item (self, position);
+            if (self->rubberband_toggles)
+            {
+                toggle_item (self, item_model);
+            }
+            else
+            {
+                select_item (self, item_model);
+            }
+        }
+    }
+
+    selection_changed (self);
+}
+
+/* Scrolls when the pointer is at the edges of the view, moves the end of the
+ * rubberband to the pointer and updates the selection. */
+static void
+update_rubberband (NautilusViewIconUi *self)
+{
+    GtkWidget *widget = GTK_WIDGET (self);
+    double x;
+    double y;
+    double x_scroll;
+    double y_scroll;
+    int width;
+    int height;
+
+    width = gtk_widget_get_allocated_width (widget);
+    height = gtk_widget_get_allocated_height (widget);
+    x = CLAMP (self->rubberband_pointer_x, 0, width - 1);
+    y = CLAMP (self->rubberband_pointer_y, 0, height - 1);
+
+    x_scroll = 0;
+    if (self->rubberband_pointer_x < RUBBERBAND_SCROLL_THRESHOLD)
+    {
+        x_scroll = self->rubberband_pointer_x - RUBBERBAND_SCROLL_THRESHOLD;
+    }
+    else if (self->rubberband_pointer_x >= width - RUBBERBAND_SCROLL_THRESHOLD)
+    {
+        x_scroll = self->rubberband_pointer_x - width + RUBBERBAND_SCROLL_THRESHOLD + 1;
+    }
+
+    y_scroll = 0;
+    if (self->rubberband_pointer_y < RUBBERBAND_SCROLL_THRESHOLD)
+    {
+        y_scroll = self->rubberband_pointer_y - RUBBERBAND_SCROLL_THRESHOLD;
+    }
+    else if (self->rubberband_pointer_y >= height - RUBBERBAND_SCROLL_THRESHOLD)
+    {
+        y_scroll = self->rubberband_pointer_y - height + RUBBERBAND_SCROLL_THRESHOLD + 1;
+    }
+
+    if (x_scroll != 0)
+    {
+        gtk_adjustment_set_value (self->hadjustment,
+                                  gtk_adjustment_get_value (self->hadjustment) + x_scroll);
+    }
+    if (y_scroll != 0)
+    {
+        gtk_adjustment_set_value (self->vadjustment,
+                                  gtk_adjustment_get_value (self->vadjustment) + y_scroll);
+    }
+
+    self->rubberband_end_x = x + gtk_adjustment_get_value (self->hadjustment);
+    self->rubberband_end_y = y + gtk_adjustment_get_value (self->vadjustment);
+
+    rubberband_select (self);
+    gtk_widget_queue_draw (widget);
+}
+
+static gboolean
+rubberband_timeout_callback (gpointer user_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
+    int width;
+    int height;
+
+    width = gtk_widget_get_allocated_width (GTK_WIDGET (self));
+    height = gtk_widget_get_allocated_height (GTK_WIDGET (self));
+
+    /* Motion updates the rubberband already, this keeps scrolling while the
+     * pointer stays at the edge. */
+    if (self->rubberband_pointer_x < RUBBERBAND_SCROLL_THRESHOLD ||
+        self->rubberband_pointer_x >= width - RUBBERBAND_SCROLL_THRESHOLD ||
+        self->rubberband_pointer_y < RUBBERBAND_SCROLL_THRESHOLD ||
+        self->rubberband_pointer_y >= height - RUBBERBAND_SCROLL_THRESHOLD)
+    {
+        update_rubberband (self);
+    }
+
+    return G_SOURCE_CONTINUE;
+}
+
+static void
+stop_rubberband (NautilusViewIconUi *self)
+{
+    g_clear_handle_id (&self->rubberband_timeout_id, g_source_remove);
+    g_clear_pointer (&self->rubberband_initial_selection, g_hash_table_destroy);
+
+    if (self->rubberband_active)
+    {
+        self->rubberband_active = FALSE;
+        nautilus_files_view_stop_batching_selection_changes (NAUTILUS_FILES_VIEW (self->controller));
+        gtk_widget_queue_draw (GTK_WIDGET (self));
+    }
+}
+
+static void
+on_drag_begin (GtkGestureDrag *gesture,
+               gdouble         start_x,
+               gdouble         start_y,
+               gpointer        user_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
+    GdkEventSequence *sequence;
+    const GdkEvent *event;
+    GdkModifierType state = 0;
+    GHashTableIter iter;
+    gpointer item_model;
+    double x;
+    double y;
+    guint position;
+
+    x = start_x + gtk_adjustment_get_value (self->hadjustment);
+    y = start_y + gtk_adjustment_get_value (self->vadjustment);
+
+    /* Presses on items select them, see on_multi_press_pressed () */
+    if (get_position_at (self, x, y, &position))
+    {
+        gtk_gesture_set_state (GTK_GESTURE (gesture), GTK_EVENT_SEQUENCE_DENIED);
+        return;
+    }
+
+    sequence = gtk_gesture_single_get_current_sequence (GTK_GESTURE_SINGLE (gesture));
+    event = gtk_gesture_get_last_event (GTK_GESTURE (gesture), sequence);
+    gdk_event_get_state (event, &state);
+
+    stop_rubberband (self);
+
+    self->rubberband_start_x = x;
+    self->rubberband_start_y = y;
+    self->rubberband_pointer_x = start_x;
+    self->rubberband_pointer_y = start_y;
+    self->rubberband_toggles = (state & GDK_CONTROL_MASK) != 0;
+
+    /* The controller clears the selection on plain presses on the background */
+    self->rubberband_initial_selection = g_hash_table_new_full (NULL, NULL,
+                                                                g_object_unref, NULL);
+    g_hash_table_iter_init (&iter, self->selection);
+    while (g_hash_table_iter_next (&iter, &item_model, NULL))
+    {
+        g_hash_table_add (self->rubberband_initial_selection, g_object_ref (item_model));
+    }
+}
+
+static void
+on_drag_update (GtkGestureDrag *gesture,
+                gdouble         offset_x,
+                gdouble         offset_y,
+                gpointer        user_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
+    double start_x;
+    double start_y;
+
+    if (self->rubberband_initial_selection == NULL)
+    {
+        return;
+    }
+
+    gtk_gesture_drag_get_start_point (gesture, &start_x, &start_y);
+    self->rubberband_pointer_x = start_x + offset_x;
+    self->rubberband_pointer_y = start_y + offset_y;
+
+    if (!self->rubberband_active)
+    {
+        if (!gtk_drag_check_threshold (GTK_WIDGET (self),
+                                       start_x, start_y,
+                                       self->rubberband_pointer_x,
+                                       self->rubberband_pointer_y))
+        {
+            return;
+        }
+
+        gtk_gesture_set_state (GTK_GESTURE (gesture), GTK_EVENT_SEQUENCE_CLAIMED);
+        self->rubberband_active = TRUE;
+        /* Like the canvas view does while band selecting */
+        nautilus_files_view_start_batching_selection_changes (NAUTILUS_FILES_VIEW (self->controller));
+        self->rubberband_timeout_id = g_timeout_add (RUBBERBAND_TIMEOUT_INTERVAL,
+                                                     rubberband_timeout_callback,
+                                                     self);
+    }
+
+    update_rubberband (self);
+}
+
+static void
+on_drag_end (GtkGestureDrag *gesture,
+             gdouble         offset_x,
+             gdouble         offset_y,
+             gpointer        user_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
+
+    stop_rubberband (self);
+}
+
+static gboolean
+key_press_event (GtkWidget   *widget,
+                 GdkEventKey *event)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+    gboolean extend;
+    gboolean modify;
+
+    extend = (event->state & GDK_SHIFT_MASK) != 0;
+    modify = (event->state & GDK_CONTROL_MASK) != 0;
+
+    switch (event->keyval)
+    {
+        case GDK_KEY_Up:
+        case GDK_KEY_KP_Up:
+        {
+            move_cursor (self, GTK_MOVEMENT_DISPLAY_LINES, -1, extend, modify);
+        }
+        break;
+
+        case GDK_KEY_Down:
+        case GDK_KEY_KP_Down:
+        {
+            move_cursor (self, GTK_MOVEMENT_DISPLAY_LINES, 1, extend, modify);
+        }
+        break;
+
+        case GDK_KEY_Left:
+        case GDK_KEY_KP_Left:
+        {
+            move_cursor (self, GTK_MOVEMENT_VISUAL_POSITIONS, -1, extend, modify);
+        }
+        break;
+
+        case GDK_KEY_Right:
+        case GDK_KEY_KP_Right:
+        {
+            move_cursor (self, GTK_MOVEMENT_VISUAL_POSITIONS, 1, extend, modify);
+        }
+        break;
+
+        case GDK_KEY_Page_Up:
+        case GDK_KEY_KP_Page_Up:
+        {
+            move_cursor (self, GTK_MOVEMENT_PAGES, -1, extend, modify);
+        }
+        break;
+
+        case GDK_KEY_Page_Down:
+        case GDK_KEY_KP_Page_Down:
+        {
+            move_cursor (self, GTK_MOVEMENT_PAGES, 1, extend, modify);
+        }
+        break;
+
+        case GDK_KEY_Home:
+        case GDK_KEY_KP_Home:
+        {
+            move_cursor (self, GTK_MOVEMENT_BUFFER_ENDS, -1, extend, modify);
+        }
+        break;
+
+        case GDK_KEY_End:
+        case GDK_KEY_KP_End:
+        {
+            move_cursor (self, GTK_MOVEMENT_BUFFER_ENDS, 1, extend, modify);
+        }
+        break;
+
+        case GDK_KEY_space:
+        case GDK_KEY_Return:
+        case GDK_KEY_ISO_Enter:
+        case GDK_KEY_KP_Enter:
+        {
+            if (self->cursor >= get_n_items (self))
+            {
+                return GDK_EVENT_PROPAGATE;
+            }
+
+            if (event->keyval == GDK_KEY_space && modify)
+            {
+                NautilusViewItemModel *item_model;
+
+                item_model = get_item (self, self->cursor);
+                toggle_item (self, item_model);
+                selection_changed (self);
+            }
+            else
+            {
+                activate_item (self, get_item (self, self->cursor),
+                               event->keyval == GDK_KEY_space);
+            }
+        }
+        break;
+
+        default:
+        {
+            return GTK_WIDGET_CLASS (nautilus_view_icon_ui_parent_class)->key_press_event (widget, event);
+        }
+    }
+
+    return GDK_EVENT_STOP;
+}
+
+static guint
+adjust_position (guint position,
+                 guint changed_position,
+                 guint removed,
+                 guint added)
+{
+    if (position >= changed_position + removed)
+    {
+        return position - removed + added;
+    }
+    else if (position >= changed_position)
+    {
+        return changed_position;
+    }
+
+    return position;
+}
+
+static void
+prune_selection (NautilusViewIconUi *self,
+                 GHashTable         *selection)
+{
+    NautilusViewModel *model;
+    GHashTableIter iter;
+    gpointer item_model;
+
+    model = nautilus_view_icon_controller_get_model (self->controller);
+    g_hash_table_iter_init (&iter, selection);
+    while (g_hash_table_iter_next (&iter, &item_model, NULL))
+    {
+        NautilusFile *file;
+
+        file = nautilus_view_item_model_get_file (item_model);
+        if (nautilus_view_model_get_item_from_file (model, file) != item_model)
+        {
+            if (selection == self->selection)
+            {
+                record_selection_change (self, item_model);
+            }
+            g_hash_table_iter_remove (&iter);
+        }
+    }
+}
+
+static void
+on_model_items_changed (GListModel *model,
+                        guint       position,
+                        guint       removed,
+                        guint       added,
+                        gpointer    user_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (user_data);
+
+    if (removed > 0)
+    {
+        prune_selection (self, self->selection);
+        if (self->rubberband_initial_selection != NULL)
+        {
+            prune_selection (self, self->rubberband_initial_selection);
+        }
+    }
+
+    invalidate_positions (self, position);
+
+    self->cursor = adjust_position (self->cursor, position, removed, added);
+    self->anchor = adjust_position (self->anchor, position, removed, added);
+
+    /* Keep the bound widgets in sync with the positions of their items right
+     * away, the geometry is updated on the next allocation. */
+    update_bound_range (self);
+    gtk_widget_queue_allocate (GTK_WIDGET (self));
+}
+
+static void
+realize (GtkWidget *widget)
+{
+    GtkAllocation allocation;
+    GdkWindowAttr attributes;
+    gint attributes_mask;
+    GdkWindow *window;
+
+    gtk_widget_set_realized (widget, TRUE);
+    gtk_widget_get_allocation (widget, &allocation);
+
+    attributes.window_type = GDK_WINDOW_CHILD;
+    attributes.x = allocation.x;
+    attributes.y = allocation.y;
+    attributes.width = allocation.width;
+    attributes.height = allocation.height;
+    attributes.wclass = GDK_INPUT_OUTPUT;
+    attributes.visual = gtk_widget_get_visual (widget);
+    attributes.event_mask = gtk_widget_get_events (widget) |
+                            GDK_BUTTON_PRESS_MASK |
+                            GDK_BUTTON_RELEASE_MASK |
+                            GDK_BUTTON_MOTION_MASK |
+                            GDK_KEY_PRESS_MASK |
+                            GDK_TOUCH_MASK;
+    attributes_mask = GDK_WA_X | GDK_WA_Y | GDK_WA_VISUAL;
+
+    /* The window clips the item widgets that are partially scrolled out */
+    window = gdk_window_new (gtk_widget_get_parent_window (widget),
+                             &attributes, attributes_mask);
+    gtk_widget_set_window (widget, window);
+    gtk_widget_register_window (widget, window);
+}
+
+static void
+size_allocate (GtkWidget     *widget,
+               GtkAllocation *allocation)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+    GtkAllocation child_allocation;
+    double hvalue;
+    double vvalue;
+    guint i;
+
+    gtk_widget_set_allocation (widget, allocation);
+    if (gtk_widget_get_realized (widget))
+    {
+        gdk_window_move_resize (gtk_widget_get_window (widget),
+                                allocation->x, allocation->y,
+                                allocation->width, allocation->height);
+    }
+
+    update_columns (self, allocation->width);
+    configure_adjustments (self);
+    update_bound_range (self);
+
+    hvalue = gtk_adjustment_get_value (self->hadjustment);
+    vvalue = gtk_adjustment_get_value (self->vadjustment);
+    for (i = 0; i < self->bound_items_ui->len; i++)
+    {
+        GtkWidget *item_ui;
+
+        item_ui = g_ptr_array_index (self->bound_items_ui, i);
+        get_cell_area (self, self->bound_start + i, &child_allocation);
+        child_allocation.x -= hvalue;
+        child_allocation.y -= vvalue;
+
+        gtk_widget_get_preferred_size (item_ui, NULL, NULL);
+        gtk_widget_size_allocate (item_ui, &child_allocation);
+    }
+}
+
+static gboolean
+draw (GtkWidget *widget,
+      cairo_t   *cr)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+    GtkStyleContext *context;
+    GdkRectangle band;
+
+    context = gtk_widget_get_style_context (widget);
+
+    if (gtk_cairo_should_draw_window (cr, gtk_widget_get_window (widget)))
+    {
+        gtk_render_background (context, cr,
+                               0, 0,
+                               gtk_widget_get_allocated_width (widget),
+                               gtk_widget_get_allocated_height (widget));
+    }
+
+    GTK_WIDGET_CLASS (nautilus_view_icon_ui_parent_class)->draw (widget, cr);
+
+    /* Over the items, like the canvas view does */
+    if (self->rubberband_active &&
+        gtk_cairo_should_draw_window (cr, gtk_widget_get_window (widget)))
+    {
+        get_rubberband_area (self, &band);
+        band.x -= gtk_adjustment_get_value (self->hadjustment);
+        band.y -= gtk_adjustment_get_value (self->vadjustment);
+
+        gtk_style_context_save (context);
+        gtk_style_context_add_class (context, GTK_STYLE_CLASS_RUBBERBAND);
+        gtk_render_background (context, cr, band.x, band.y, band.width, band.height);
+        gtk_render_frame (context, cr, band.x, band.y, band.width, band.height);
+        gtk_style_context_restore (context);
+    }
+
+    return GDK_EVENT_PROPAGATE;
+}
+
+static void
+get_preferred_width (GtkWidget *widget,
+                     gint      *minimum,
+                     gint      *natural)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+
+    *minimum = *natural = self->cell_width + 2 * MARGIN;
+}
+
+static void
+get_preferred_height (GtkWidget *widget,
+                      gint      *minimum,
+                      gint      *natural)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+
+    *minimum = *natural = self->cell_height + 2 * MARGIN;
+}
+
+static void
+style_updated (GtkWidget *widget)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (widget);
+
+    GTK_WIDGET_CLASS (nautilus_view_icon_ui_parent_class)->style_updated (widget);
+
+    update_cell_size (self);
+    gtk_widget_queue_resize (widget);
+}
+
+static void
+forall (GtkContainer *container,
+        gboolean      include_internals,
+        GtkCallback   callback,
+        gpointer      callback_data)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (container);
+    guint i;
+
+    /* Backwards, so that the callback can remove the child */
+    for (i = self->bound_items_ui->len; i > 0; i--)
+    {
+        (*callback)(g_ptr_array_index (self->bound_items_ui, i - 1), callback_data);
+    }
+
+    for (i = self->free_items_ui->len; i > 0; i--)
+    {
+        (*callback)(g_ptr_array_index (self->free_items_ui, i - 1), callback_data);
+    }
+}
+
+static void
+remove_child (GtkContainer *container,
+              GtkWidget    *widget)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (container);
+    NautilusViewItemModel *item_model;
+
+    item_model = nautilus_view_icon_item_ui_get_model (NAUTILUS_VIEW_ICON_ITEM_UI (widget));
+    if (item_model != NULL &&
+        nautilus_view_item_model_get_item_ui (item_model) == widget)
+    {
+        nautilus_view_item_model_set_item_ui (item_model, NULL);
+    }
+
+    if (g_ptr_array_remove (self->bound_items_ui, widget))
+    {
+        if (item_model != NULL)
+        {
+            nautilus_thumbnail_cache_set_visible (nautilus_view_item_model_get_file (item_model), FALSE);
+        }
+    }
+    else
+    {
+        g_ptr_array_remove (self->free_items_ui, widget);
+    }
+
+    gtk_widget_unparent (widget);
+}
+
+void
+nautilus_view_icon_ui_set_selection (NautilusViewIconUi *self,
+                                     GQueue             *selection)
+{
+    GList *l;
+
+    g_return_if_fail (NAUTILUS_IS_VIEW_ICON_UI (self));
+
+    unselect_all (self);
+    for (l = g_queue_peek_head_link (selection); l != NULL; l = l->next)
+    {
+        select_item (self, l->data);
+    }
+
+    selection_changed (self);
+}
+
+/* Returns the selected items, in no particular order. */
+GList *
+nautilus_view_icon_ui_get_selection (NautilusViewIconUi *self)
+{
+    g_return_val_if_fail (NAUTILUS_IS_VIEW_ICON_UI (self), NULL);
+
+    return g_hash_table_get_keys (self->selection);
+}
+
+void
+nautilus_view_icon_ui_select_all (NautilusViewIconUi *self)
+{
+    g_return_if_fail (NAUTILUS_IS_VIEW_ICON_UI (self));
+
+    if (get_n_items (self) == 0)
+    {
+        return;
+    }
+
+    select_range (self, 0, get_n_items (self) - 1);
+    selection_changed (self);
+}
+
+void
+nautilus_view_icon_ui_set_icon_size (NautilusViewIconUi *self,
+                                     guint               icon_size)
+{
+    g_return_if_fail (NAUTILUS_IS_VIEW_ICON_UI (self));
+
+    if (self->icon_size == icon_size)
+    {
+        return;
+    }
+
+    self->icon_size = icon_size;
+    update_cell_size (self);
+    gtk_widget_queue_resize (GTK_WIDGET (self));
+}
+
+void
+nautilus_view_icon_ui_move_cursor (NautilusViewIconUi *self,
+                                   GtkMovementStep     step,
+                                   gint                count)
+{
+    g_return_if_fail (NAUTILUS_IS_VIEW_ICON_UI (self));
+
+    move_cursor (self, step, count, FALSE, FALSE);
+}
+
+NautilusViewItemModel *
+nautilus_view_icon_ui_get_cursor_item (NautilusViewIconUi *self)
+{
+    g_return_val_if_fail (NAUTILUS_IS_VIEW_ICON_UI (self), NULL);
+
+    return get_item (self, self->cursor);
+}
+
+/* @x and @y are in widget coordinates. */
+NautilusViewItemModel *
+nautilus_view_icon_ui_get_item_at_pos (NautilusViewIconUi *self,
+                                       gdouble             x,
+                                       gdouble             y)
+{
+    guint position;
+
+    g_return_val_if_fail (NAUTILUS_IS_VIEW_ICON_UI (self), NULL);
+
+    if (!get_position_at (self,
+                          x + gtk_adjustment_get_value (self->hadjustment),
+                          y + gtk_adjustment_get_value (self->vadjustment),
+                          &position))
+    {
+        return NULL;
+    }
+
+    return get_item (self, position);
+}
+
+/* Gets the area of @item_model in widget coordinates, even if it is not in
+ * view and has no item widget. */
+gboolean
+nautilus_view_icon_ui_get_item_area (NautilusViewIconUi    *self,
+                                     NautilusViewItemModel *item_model,
+                                     GdkRectangle          *area)
+{
+    guint position;
+
+    g_return_val_if_fail (NAUTILUS_IS_VIEW_ICON_UI (self), FALSE);
+
+    if (!find_item_position (self, item_model, &position))
+    {
+        return FALSE;
+    }
+
+    get_cell_area (self, position, area);
+    area->x -= gtk_adjustment_get_value (self->hadjustment);
+    area->y -= gtk_adjustment_get_value (self->vadjustment);
+
+    return TRUE;
+}
+
+void
+nautilus_view_icon_ui_reveal_item (NautilusViewIconUi    *self,
+                                   NautilusViewItemModel *item_model)
+{
+    guint position;
+
+    g_return_if_fail (NAUTILUS_IS_VIEW_ICON_UI (self));
+
+    if (find_item_position (self, item_model, &position))
+    {
+        reveal_position (self, position);
+    }
+}
+
+static void
+dispose (GObject *object)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (object);
+
+    if (self->model != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->model, self);
+        g_clear_object (&self->model);
+    }
+
+    if (self->hadjustment != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->hadjustment, self);
+        g_clear_object (&self->hadjustment);
+    }
+
+    if (self->vadjustment != NULL)
+    {
+        g_signal_handlers_disconnect_by_data (self->vadjustment, self);
+        g_clear_object (&self->vadjustment);
+    }
+
+    stop_rubberband (self);
+    g_clear_object (&self->multi_press_gesture);
+    g_clear_object (&self->drag_gesture);
+
+    G_OBJECT_CLASS (nautilus_view_icon_ui_parent_class)->dispose (object);
+}
+
+static void
+finalize (GObject *object)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (object);
+
+    g_ptr_array_unref (self->bound_items_ui);
+    g_ptr_array_unref (self->free_items_ui);
+    g_hash_table_destroy (self->selection);
+    g_hash_table_destroy (self->selection_changes);
+    g_hash_table_destroy (self->positions);
+
+    G_OBJECT_CLASS (nautilus_view_icon_ui_parent_class)->finalize (object);
+}
+
+static void
+constructed (GObject *object)
+{
+    NautilusViewIconUi *self = NAUTILUS_VIEW_ICON_UI (object);
+    NautilusViewModel *model;
+    GListStore *gmodel;
+
+    G_OBJECT_CLASS (nautilus_view_icon_ui_parent_class)->constructed (object);
+
+    gtk_widget_set_has_window (GTK_WIDGET (self), TRUE);
+    gtk_widget_set_can_focus (GTK_WIDGET (self), TRUE);
+    gtk_style_context_add_class (gtk_widget_get_style_context (GTK_WIDGET (self)),
+                                 GTK_STYLE_CLASS_VIEW);
+
+    /* Until the scrolled window gives us its own */
+    if (self->hadjustment == NULL)
+    {
+        set_adjustment (self, &self->hadjustment, NULL, "hadjustment");
+    }
+    if (self->vadjustment == NULL)
+    {
+        set_adjustment (self, &self->vadjustment, NULL, "vadjustment");
+    }
+
+    model = nautilus_view_icon_controller_get_model (self->controller);
+    gmodel = nautilus_view_model_get_g_model (model);
+    self->model = g_object_ref (G_LIST_MODEL (gmodel));
+    g_signal_connect (self->model, "items-changed",
+                      (GCallback) on_model_items_changed, self);
+
+    self->multi_press_gesture = gtk_gesture_multi_press_new (GTK_WIDGET (self));
+    gtk_gesture_single_set_button (GTK_GESTURE_SINGLE (self->multi_press_gesture), 0);
+    g_signal_connect (self->multi_press_gesture, "pressed",
+                      (GCallback) on_multi_press_pressed, self);
+
+    self->drag_gesture = gtk_gesture_drag_new (GTK_WIDGET (self));
+    gtk_gesture_single_set_button (GTK_GESTURE_SINGLE (self->drag_gesture), GDK_BUTTON_PRIMARY);
+    g_signal_connect (self->drag_gesture, "drag-begin",
+                      (GCallback) on_drag_begin, self);
+    g_signal_connect (self->drag_gesture, "drag-update",
+                      (GCallback) on_drag_update, self);
+    g_signal_connect (self->drag_gesture, "drag-end",
+                      (GCallback) on_drag_end, self);
+
+    update_cell_size (self);
+}
+
+static void
+nautilus_view_icon_ui_class_init (NautilusViewIconUiClass *klass)
+{
+    GObjectClass *object_class = G_OBJECT_CLASS (klass);
+    GtkWidgetClass *widget_class = GTK_WIDGET_CLASS (klass);
+    GtkContainerClass *container_class = GTK_CONTAINER_CLASS (klass);
+
+    object_class->dispose = dispose;
+    object_class->finalize = finalize;
+    object_class->set_property = set_property;
+    object_class->get_property = get_property;
+    object_class->constructed = constructed;
+
+    widget_class->realize = realize;
+    widget_class->size_allocate = size_allocate;
+    widget_class->draw = draw;
+    widget_class->get_preferred_width = get_preferred_width;
+    widget_class->get_preferred_height = get_preferred_height;
+    widget_class->style_updated = style_updated;
+    widget_class->key_press_event = key_press_event;
+
+    container_class->forall = forall;
+    container_class->remove = remove_child;
+
+    g_object_class_install_property (object_class,
+                                     PROP_CONTROLLER,
+                                     g_param_spec_object ("controller",
+                                                          "Controller",
+                                                          "The controller of the view",
+                                                          NAUTILUS_TYPE_VIEW_ICON_CONTROLLER,
+                                                          G_PARAM_WRITABLE | G_PARAM_CONSTRUCT_ONLY));
+
+    g_object_class_override_property (object_class, PROP_HADJUSTMENT, "hadjustment");
+    g_object_class_override_property (object_class, PROP_VADJUSTMENT, "vadjustment");
+    g_object_class_override_property (object_class, PROP_HSCROLL_POLICY, "hscroll-policy");
+    g_object_class_override_property (object_class, PROP_VSCROLL_POLICY, "vscroll-policy");
 }
 
 static void
 nautilus_view_icon_ui_init (NautilusViewIconUi *self)
 {
+    self->icon_size = NAUTILUS_CANVAS_ICON_SIZE_LARGE;
+    self->n_columns = 1;
+    self->bound_items_ui = g_ptr_array_new ();
+    self->free_items_ui = g_ptr_array_new ();
+    self->selection = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+    self->selection_changes = g_hash_table_new_full (NULL, NULL, g_object_unref, NULL);
+    self->positions = g_hash_table_new (NULL, NULL);
 }
 
 NautilusViewIconUi *
@@ -27,12 +27,29 @@ G_BEGIN_DECLS
 
 #define NAUTILUS_TYPE_VIEW_ICON_UI (nautilus_view_icon_ui_get_type())
 
-G_DECLARE_FINAL_TYPE (NautilusViewIconUi, nautilus_view_icon_ui, NAUTILUS, VIEW_ICON_UI, GtkFlowBox)
+G_DECLARE_FINAL_TYPE (NautilusViewIconUi, nautilus_view_icon_ui, NAUTILUS, VIEW_ICON_UI, GtkContainer)
 
 NautilusViewIconUi * nautilus_view_icon_ui_new (NautilusViewIconController *controller);
 /* TODO: this should become the "nautilus_view_set_selection" once we have a proper
  * MVC also in the nautilus-view level. */
 void nautilus_view_icon_ui_set_selection (NautilusViewIconUi *self,
                                           GQueue             *selection);
+GList * nautilus_view_icon_ui_get_selection (NautilusViewIconUi *self);
+void nautilus_view_icon_ui_select_all (NautilusViewIconUi *self);
+
+void nautilus_view_icon_ui_set_icon_size (NautilusViewIconUi *self,
+                                          guint               icon_size);
+void nautilus_view_icon_ui_move_cursor (NautilusViewIconUi *self,
+                                        GtkMovementStep     step,
+                                        gint                count);
+NautilusViewItemModel * nautilus_view_icon_ui_get_cursor_item (NautilusViewIconUi *self);
+NautilusViewItemModel * nautilus_view_icon_ui_get_item_at_pos (NautilusViewIconUi *self,
+                                                               gdouble             x,
+                                                               gdouble             y);
+gboolean nautilus_view_icon_ui_get_item_area (NautilusViewIconUi    *self,
+                                              NautilusViewItemModel *item_model,
+                                              GdkRectangle          *area);
+void nautilus_view_icon_ui_reveal_item (NautilusViewIconUi    *self,
+                                        NautilusViewItemModel *item_model);
 
 G_END_DECLS
\ No newline at end of file
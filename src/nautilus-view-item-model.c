@@ -200,8 +200,8 @@ nautilus_view_item_model_set_item_ui (NautilusViewItemModel *self,
 {
     g_return_if_fail (NAUTILUS_IS_VIEW_ITEM_MODEL (self));
 
-    g_clear_object (&self->item_ui);
-    self->item_ui = g_object_ref (item_ui);
-
-    g_object_notify (G_OBJECT (self), "item-ui");
+    if (g_set_object (&self->item_ui, item_ui))
+    {
+        g_object_notify (G_OBJECT (self), "item-ui");
+    }
 }
@@ -179,26 +179,10 @@ nautilus_view_model_get_items_from_files (NautilusViewModel *self,
     item_models = g_queue_new ();
     for (l = g_queue_peek_head_link (files); l != NULL; l = l->next)
     {
-        NautilusFile *file1;
-        gint i = 0;
-
-        file1 = NAUTILUS_FILE (l->data);
-        while ((item_model = g_list_model_get_item (G_LIST_MODEL (self->internal_model), i)))
+        item_model = g_hash_table_lookup (self->map_files_to_model, l->data);
+        if (item_model != NULL)
         {
-            NautilusFile *file2;
-            g_autofree gchar *file1_uri = NULL;
-            g_autofree gchar *file2_uri = NULL;
-
-            file2 = nautilus_view_item_model_get_file (item_model);
-            file1_uri = nautilus_file_get_uri (file1);
-            file2_uri = nautilus_file_get_uri (file2);
-            if (g_strcmp0 (file1_uri, file2_uri) == 0)
-            {
-                g_queue_push_tail (item_models, item_model);
-                break;
-            }
-
-            i++;
+            g_queue_push_tail (item_models, item_model);
         }
     }
 
@@ -235,17 +219,18 @@ nautilus_view_model_remove_item (NautilusViewModel     *self,
     {
         NautilusFile *file;
 
+        /* Keep the map in sync before the list store notifies the change */
         file = nautilus_view_item_model_get_file (item_model);
-        g_list_store_remove (self->internal_model, i);
         g_hash_table_remove (self->map_files_to_model, file);
+        g_list_store_remove (self->internal_model, i);
     }
 }
 
 void
 nautilus_view_model_remove_all_items (NautilusViewModel *self)
 {
-    g_list_store_remove_all (self->internal_model);
     g_hash_table_remove_all (self->map_files_to_model);
+    g_list_store_remove_all (self->internal_model);
 }
 
 void
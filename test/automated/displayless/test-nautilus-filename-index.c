@@ -0,0 +1,153 @@
+#include <glib/gstdio.h>
+#include <unistd.h>
+#include "test-utilities.h"
+#include "src/nautilus-filename-index.h"
+
+static void
+count_hit (GFile    *file,
+           gdouble   rank,
+           guint64   mtime,
+           gpointer  user_data)
+{
+    guint *n_hits = user_data;
+
+    g_assert_cmpfloat (rank, >, 0);
+    g_assert_cmpuint (mtime, >, 0);
+
+    *n_hits += 1;
+}
+
+static guint
+count_hits (NautilusFilenameIndex *index,
+            const char            *text,
+            gboolean               recursive,
+            GList                 *excluded)
+{
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    g_autoptr (GFile) location = NULL;
+    guint n_hits = 0;
+
+    matcher = nautilus_query_matcher_new (text);
+    location = g_file_new_for_path (test_get_tmp_dir ());
+
+    nautilus_filename_index_search (index, matcher, location, recursive, FALSE,
+                                    excluded, NULL, count_hit, &n_hits);
+
+    return n_hits;
+}
+
+static NautilusFilenameIndex *
+build_index (const char *index_dir)
+{
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GList) locations = NULL;
+    g_autofree gchar *path = NULL;
+    g_autoptr (GError) error = NULL;
+    NautilusFilenameIndex *index;
+
+    location = g_file_new_for_path (test_get_tmp_dir ());
+    locations = g_list_prepend (NULL, location);
+    path = g_build_filename (index_dir, "filename-index", NULL);
+
+    g_assert_true (nautilus_filename_index_build (locations, path, NULL, &error));
+    g_assert_no_error (error);
+
+    index = nautilus_filename_index_new_for_path (path, &error);
+    g_assert_no_error (error);
+    g_assert_nonnull (index);
+
+    return index;
+}
+
+/* Tests finding the same files as walking the folders */
+static void
+test_search (void)
+{
+    g_autofree gchar *index_dir = NULL;
+    g_autofree gchar *index_path = NULL;
+    g_autoptr (NautilusFilenameIndex) index = NULL;
+    g_autoptr (GFile) location = NULL;
+    g_autoptr (GFile) second_directory = NULL;
+    g_autoptr (GFile) missing = NULL;
+    g_autoptr (GList) excluded = NULL;
+
+    index_dir = g_dir_make_tmp ("nautilus-index.XXXXXX", NULL);
+    create_search_file_hierarchy ("index");
+
+    index = build_index (index_dir);
+    location = g_file_new_for_path (test_get_tmp_dir ());
+    second_directory = g_file_get_child (location, "engine_index_second_directory");
+    missing = g_file_get_child (location, "missing");
+
+    g_assert_cmpuint (nautilus_filename_index_get_n_files (index), ==, 8);
+    g_assert_true (nautilus_filename_index_has_folder (index, location));
+    g_assert_true (nautilus_filename_index_has_folder (index, second_directory));
+    g_assert_true (nautilus_filename_index_contains (index, second_directory));
+    g_assert_false (nautilus_filename_index_contains (index, missing));
+
+    g_assert_cmpuint (count_hits (index, "engine_index", TRUE, NULL), ==, 5);
+    g_assert_cmpuint (count_hits (index, "engine_index", FALSE, NULL), ==, 3);
+    g_assert_cmpuint (count_hits (index, "ENGINE index_child", TRUE, NULL), ==, 2);
+    g_assert_cmpuint (count_hits (index, "nothing", TRUE, NULL), ==, 0);
+
+    /* Words too short to have trigrams look at every name */
+    g_assert_cmpuint (count_hits (index, "ex", TRUE, NULL), ==, 7);
+
+    /* Excluding a folder excludes its contents too */
+    excluded = g_list_prepend (NULL, second_directory);
+    g_assert_cmpuint (count_hits (index, "engine_index", TRUE, excluded), ==, 3);
+
+    delete_search_file_hierarchy ("index");
+
+    index_path = g_build_filename (index_dir, "filename-index", NULL);
+    g_unlink (index_path);
+    g_rmdir (index_dir);
+}
+
+/* Tests refusing files that aren't indexes */
+static void
+test_invalid (void)
+{
+    g_autofree gchar *path = NULL;
+    g_autoptr (GError) error = NULL;
+    NautilusFilenameIndex *index;
+    gint fd;
+
+    fd = g_file_open_tmp ("nautilus-index.XXXXXX", &path, NULL);
+    g_assert_cmpint (fd, >=, 0);
+    g_assert_true (g_file_set_contents (path, "not an index at all, but long enough to hold a header", -1, NULL));
+    close (fd);
+
+    index = nautilus_filename_index_new_for_path (path, &error);
+    g_assert_null (index);
+    g_assert_nonnull (error);
+
+    g_unlink (path);
+}
+
+static void
+setup_test_suite (void)
+{
+    g_test_add_func ("/filename-index/search",
+                     test_search);
+    g_test_add_func ("/filename-index/invalid",
+                     test_invalid);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    int result;
+
+    g_test_init (&argc, &argv, NULL);
+    g_test_set_nonfatal_assertions ();
+
+    setup_test_suite ();
+
+    result = g_test_run ();
+
+    test_clear_tmp_dir ();
+
+    return result;
+}
@@ -0,0 +1,202 @@
+#include <glib.h>
+#include "src/nautilus-directory.h"
+#include "src/nautilus-file.h"
+#include "src/nautilus-file-private.h"
+#include "src/nautilus-file-utilities.h"
+#include "src/nautilus-pending-files.h"
+
+#define ROOT_DIR "file:///tmp"
+#define N_FILES 5000
+
+static int
+compare_names (gconstpointer a,
+               gconstpointer b,
+               gpointer      user_data)
+{
+    g_autofree gchar *name_a = NULL;
+    g_autofree gchar *name_b = NULL;
+
+    name_a = nautilus_file_get_name (NAUTILUS_FILE ((gpointer) a));
+    name_b = nautilus_file_get_name (NAUTILUS_FILE ((gpointer) b));
+
+    return g_strcmp0 (name_a, name_b);
+}
+
+static gboolean
+keep_file (gpointer item,
+           gpointer user_data)
+{
+    return nautilus_directory_contains_file (NAUTILUS_DIRECTORY (user_data), item);
+}
+
+static NautilusFile *
+create_file (NautilusDirectory *directory,
+             const char        *prefix,
+             guint              index)
+{
+    g_autofree gchar *file_name = NULL;
+    NautilusFile *file;
+
+    file_name = g_strdup_printf ("%s_%05u", prefix, index);
+    file = nautilus_file_new_from_filename (directory, file_name, FALSE);
+    nautilus_directory_add_file (directory, file);
+
+    return file;
+}
+
+/* Creates the files in reverse order, so that taking them in order relies
+ * on the heap */
+static GList *
+create_files (NautilusDirectory *directory,
+              const char        *prefix,
+              guint              n_files)
+{
+    GList *files = NULL;
+
+    for (guint i = 0; i < n_files; i++)
+    {
+        files = g_list_prepend (files, create_file (directory, prefix, 2 * i));
+    }
+
+    return files;
+}
+
+static void
+assert_in_order (GList *files)
+{
+    for (GList *l = files; l != NULL && l->next != NULL; l = l->next)
+    {
+        g_assert_cmpint (compare_names (l->data, l->next->data, NULL), <, 0);
+    }
+}
+
+/* Tests taking files in chunks, in order */
+static void
+test_take_in_order (void)
+{
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (NautilusPendingFiles) pending = NULL;
+    g_autolist (NautilusFile) files = NULL;
+    g_autolist (NautilusFile) first = NULL;
+    g_autolist (NautilusFile) rest = NULL;
+    g_autoptr (GList) pending_files = NULL;
+
+    directory = nautilus_directory_get_by_uri (ROOT_DIR);
+    files = create_files (directory, "pending_files_order", N_FILES);
+    pending = nautilus_pending_files_new (compare_names, keep_file,
+                                          (GDestroyNotify) nautilus_file_unref,
+                                          directory);
+
+    pending_files = g_list_copy_deep (files, (GCopyFunc) nautilus_file_ref, NULL);
+    nautilus_pending_files_add (pending, pending_files);
+    g_assert_cmpuint (nautilus_pending_files_get_length (pending), ==, N_FILES);
+
+    first = nautilus_pending_files_take (pending, 100, G_MAXINT64);
+    g_assert_cmpuint (g_list_length (first), ==, 100);
+    assert_in_order (first);
+    g_assert_true (first->data == g_list_last (files)->data);
+
+    rest = nautilus_pending_files_take (pending, G_MAXUINT, G_MAXINT64);
+    g_assert_cmpuint (g_list_length (rest), ==, N_FILES - 100);
+    assert_in_order (rest);
+    g_assert_cmpint (compare_names (g_list_last (first)->data, rest->data, NULL), <, 0);
+    g_assert_cmpuint (nautilus_pending_files_get_length (pending), ==, 0);
+}
+
+/* Tests that files deleted while waiting to be added are dropped, and that
+ * files added while others wait are taken in order with them */
+static void
+test_changes_during_load (void)
+{
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (NautilusPendingFiles) pending = NULL;
+    g_autolist (NautilusFile) files = NULL;
+    g_autolist (NautilusFile) first = NULL;
+    g_autolist (NautilusFile) rest = NULL;
+    g_autoptr (GList) pending_files = NULL;
+    g_autoptr (GList) added_files = NULL;
+    g_autoptr (NautilusFile) added = NULL;
+    NautilusFile *deleted;
+
+    directory = nautilus_directory_get_by_uri (ROOT_DIR);
+    files = create_files (directory, "pending_files_changes", N_FILES);
+    pending = nautilus_pending_files_new (compare_names, keep_file,
+                                          (GDestroyNotify) nautilus_file_unref,
+                                          directory);
+
+    pending_files = g_list_copy_deep (files, (GCopyFunc) nautilus_file_ref, NULL);
+    nautilus_pending_files_add (pending, pending_files);
+    first = nautilus_pending_files_take (pending, 100, G_MAXINT64);
+    g_assert_cmpuint (g_list_length (first), ==, 100);
+
+    /* A file still waiting is deleted, and a new one shows up between two
+     * waiting files */
+    deleted = g_list_nth_data (files, N_FILES - 200);
+    g_assert_null (g_list_find (first, deleted));
+    nautilus_file_mark_gone (deleted);
+
+    added = create_file (directory, "pending_files_changes", 2 * 300 + 1);
+    added_files = g_list_append (added_files, nautilus_file_ref (added));
+    nautilus_pending_files_add (pending, added_files);
+
+    rest = nautilus_pending_files_take (pending, G_MAXUINT, G_MAXINT64);
+    g_assert_cmpuint (g_list_length (rest), ==, N_FILES - 100);
+    assert_in_order (rest);
+    g_assert_null (g_list_find (rest, deleted));
+    g_assert_nonnull (g_list_find (rest, added));
+    g_assert_cmpuint (nautilus_pending_files_get_length (pending), ==, 0);
+}
+
+/* Tests that a chunk is never empty while there are files to keep, however
+ * short the budget */
+static void
+test_take_past_deadline (void)
+{
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (NautilusPendingFiles) pending = NULL;
+    g_autolist (NautilusFile) files = NULL;
+    g_autolist (NautilusFile) taken = NULL;
+    g_autoptr (GList) pending_files = NULL;
+
+    directory = nautilus_directory_get_by_uri (ROOT_DIR);
+    files = create_files (directory, "pending_files_deadline", 10);
+    pending = nautilus_pending_files_new (compare_names, keep_file,
+                                          (GDestroyNotify) nautilus_file_unref,
+                                          directory);
+
+    pending_files = g_list_copy_deep (files, (GCopyFunc) nautilus_file_ref, NULL);
+    nautilus_pending_files_add (pending, pending_files);
+
+    /* The first files are deleted */
+    nautilus_file_mark_gone (g_list_last (files)->data);
+    nautilus_file_mark_gone (g_list_last (files)->prev->data);
+
+    taken = nautilus_pending_files_take (pending, G_MAXUINT, 0);
+    g_assert_cmpuint (g_list_length (taken), ==, 1);
+    g_assert_true (taken->data == g_list_last (files)->prev->prev->data);
+    g_assert_cmpuint (nautilus_pending_files_get_length (pending), ==, 7);
+}
+
+static void
+setup_test_suite (void)
+{
+    g_test_add_func ("/pending-files/take-in-order",
+                     test_take_in_order);
+    g_test_add_func ("/pending-files/changes-during-load",
+                     test_changes_during_load);
+    g_test_add_func ("/pending-files/take-past-deadline",
+                     test_take_past_deadline);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    g_test_set_nonfatal_assertions ();
+    nautilus_ensure_extension_points ();
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
@@ -0,0 +1,110 @@
+#include <glib.h>
+#include <string.h>
+#include "src/nautilus-query-matcher.h"
+
+/* How names were ranked before the matcher, one normalized copy at a time */
+static gdouble
+reference_match (const char *text,
+                 const char *string)
+{
+    g_autofree gchar *normalized_text = NULL;
+    g_autofree gchar *prepared_text = NULL;
+    g_autofree gchar *normalized_string = NULL;
+    g_autofree gchar *prepared_string = NULL;
+    g_auto (GStrv) words = NULL;
+    gchar *ptr = NULL;
+    gint nonexact_malus = 0;
+
+    normalized_text = g_utf8_normalize (text, -1, G_NORMALIZE_NFD);
+    prepared_text = g_utf8_strdown (normalized_text, -1);
+    words = g_strsplit (prepared_text, " ", -1);
+
+    normalized_string = g_utf8_normalize (string, -1, G_NORMALIZE_NFD);
+    prepared_string = g_utf8_strdown (normalized_string, -1);
+
+    for (gint i = 0; words[i] != NULL; i++)
+    {
+        ptr = strstr (prepared_string, words[i]);
+        if (ptr == NULL)
+        {
+            return -1;
+        }
+
+        nonexact_malus += strlen (ptr) - strlen (words[i]);
+    }
+
+    return MAX (10.0, 50.0 - (gdouble) (ptr - prepared_string) - (gdouble) nonexact_malus / 100);
+}
+
+/* Tests that the matcher ranks names like the original implementation */
+static void
+test_same_ranks (void)
+{
+    const char *texts[] =
+    {
+        "report", "REPORT 2021", "café", "cafe", "straße", "a", "pdf report", "x  y"
+    };
+    const char *names[] =
+    {
+        "report.pdf", "Annual Report 2021.odt", "2021-report.txt", "Café.jpg",
+        "CAFE\xcc\x81 menu.png", "Straße.txt", "strasse.txt", "no match here",
+        "", "x y", "x  y", "aaaa", "Ünïcödé report.pdf",
+    };
+
+    for (guint i = 0; i < G_N_ELEMENTS (texts); i++)
+    {
+        g_autoptr (NautilusQueryMatcher) matcher = NULL;
+
+        matcher = nautilus_query_matcher_new (texts[i]);
+        for (guint j = 0; j < G_N_ELEMENTS (names); j++)
+        {
+            g_assert_cmpfloat_with_epsilon (nautilus_query_matcher_match (matcher, names[j]),
+                                            reference_match (texts[i], names[j]),
+                                            1e-9);
+        }
+    }
+}
+
+/* Tests ignoring case and accents, and requiring every word */
+static void
+test_matches (void)
+{
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    g_autoptr (NautilusQueryMatcher) no_text_matcher = NULL;
+
+    matcher = nautilus_query_matcher_new ("cafe menu");
+
+    g_assert_cmpfloat (nautilus_query_matcher_match (matcher, "CAFE MENU"), >, 0);
+    g_assert_cmpfloat (nautilus_query_matcher_match (matcher, "Café menu.pdf"), >, 0);
+    g_assert_cmpfloat (nautilus_query_matcher_match (matcher, "cafe.pdf"), ==, -1);
+    g_assert_cmpfloat (nautilus_query_matcher_match (matcher, "menu"), ==, -1);
+
+    /* Prefixes rank higher than suffixes */
+    g_assert_cmpfloat (nautilus_query_matcher_match (matcher, "cafe menu.pdf"),
+                       >,
+                       nautilus_query_matcher_match (matcher, "old cafe menu.pdf"));
+
+    no_text_matcher = nautilus_query_matcher_new (NULL);
+    g_assert_cmpfloat (nautilus_query_matcher_match (no_text_matcher, "cafe"), ==, -1);
+}
+
+static void
+setup_test_suite (void)
+{
+    g_test_add_func ("/query-matcher/same-ranks",
+                     test_same_ranks);
+    g_test_add_func ("/query-matcher/matches",
+                     test_matches);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    g_test_set_nonfatal_assertions ();
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
@@ -0,0 +1,102 @@
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include <unistd.h>
+#include "src/nautilus-query-type-filter.h"
+
+static NautilusQueryTypeFilter *
+filter_new (const char *mime_type)
+{
+    g_autoptr (GPtrArray) mime_types = NULL;
+
+    mime_types = g_ptr_array_new ();
+    if (mime_type != NULL)
+    {
+        g_ptr_array_add (mime_types, (gpointer) mime_type);
+    }
+
+    return nautilus_query_type_filter_new (mime_types);
+}
+
+/* Tests telling types from names, like GIO does */
+static void
+test_match_name (void)
+{
+    g_autoptr (NautilusQueryTypeFilter) text_filter = NULL;
+    g_autoptr (NautilusQueryTypeFilter) folder_filter = NULL;
+    g_autoptr (NautilusQueryTypeFilter) empty_filter = NULL;
+
+    text_filter = filter_new ("text/plain");
+    folder_filter = filter_new ("inode/directory");
+    empty_filter = filter_new (NULL);
+
+    g_assert_cmpint (nautilus_query_type_filter_match_name (text_filter, "notes.txt", G_FILE_TYPE_REGULAR),
+                     ==, NAUTILUS_QUERY_TYPE_FILTER_MATCH);
+    /* A subclass of text/plain */
+    g_assert_cmpint (nautilus_query_type_filter_match_name (text_filter, "main.c", G_FILE_TYPE_REGULAR),
+                     ==, NAUTILUS_QUERY_TYPE_FILTER_MATCH);
+    g_assert_cmpint (nautilus_query_type_filter_match_name (text_filter, "photo.png", G_FILE_TYPE_REGULAR),
+                     ==, NAUTILUS_QUERY_TYPE_FILTER_NO_MATCH);
+    g_assert_cmpint (nautilus_query_type_filter_match_name (text_filter, "notes.txt", G_FILE_TYPE_DIRECTORY),
+                     ==, NAUTILUS_QUERY_TYPE_FILTER_NO_MATCH);
+    g_assert_cmpint (nautilus_query_type_filter_match_name (folder_filter, "notes.txt", G_FILE_TYPE_DIRECTORY),
+                     ==, NAUTILUS_QUERY_TYPE_FILTER_MATCH);
+    g_assert_cmpint (nautilus_query_type_filter_match_name (text_filter, "no-extension-at-all", G_FILE_TYPE_REGULAR),
+                     ==, NAUTILUS_QUERY_TYPE_FILTER_UNSURE);
+
+    g_assert_true (nautilus_query_type_filter_is_empty (empty_filter));
+    g_assert_cmpint (nautilus_query_type_filter_match_name (empty_filter, "photo.png", G_FILE_TYPE_REGULAR),
+                     ==, NAUTILUS_QUERY_TYPE_FILTER_MATCH);
+}
+
+/* Tests reading files whose names don't tell their type */
+static void
+test_match_file (void)
+{
+    g_autoptr (NautilusQueryTypeFilter) text_filter = NULL;
+    g_autoptr (NautilusQueryTypeFilter) image_filter = NULL;
+    g_autoptr (GFile) file = NULL;
+    g_autoptr (GFileInfo) info = NULL;
+    g_autofree gchar *path = NULL;
+    gint fd;
+
+    text_filter = filter_new ("text/plain");
+    image_filter = filter_new ("image/png");
+
+    fd = g_file_open_tmp ("nautilus-type-filter-XXXXXX", &path, NULL);
+    g_assert_cmpint (fd, >=, 0);
+    close (fd);
+    g_assert_true (g_file_set_contents (path, "Some plain text\n", -1, NULL));
+
+    file = g_file_new_for_path (path);
+    info = g_file_query_info (file,
+                              G_FILE_ATTRIBUTE_STANDARD_NAME ","
+                              G_FILE_ATTRIBUTE_STANDARD_TYPE,
+                              G_FILE_QUERY_INFO_NOFOLLOW_SYMLINKS, NULL, NULL);
+    g_assert_nonnull (info);
+
+    g_assert_true (nautilus_query_type_filter_match_file (text_filter, file, info, NULL));
+    g_assert_false (nautilus_query_type_filter_match_file (image_filter, file, info, NULL));
+
+    g_unlink (path);
+}
+
+static void
+setup_test_suite (void)
+{
+    g_test_add_func ("/query-type-filter/match-name",
+                     test_match_name);
+    g_test_add_func ("/query-type-filter/match-file",
+                     test_match_file);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    g_test_set_nonfatal_assertions ();
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
@@ -0,0 +1,159 @@
+#include <glib/gstdio.h>
+#include "test-utilities.h"
+
+static guint total_hits = 0;
+
+static const struct
+{
+    const char *path;
+    const char *contents;
+    gsize length;
+} files[] =
+{
+    { "content_match", "Some text with nautilus content in it\n", 38 },
+    { "content_folder/content_match_upper", "NAUTILUS Content, in capitals\n", 30 },
+    { "content_binary", "nautilus content\0after a NUL byte", 33 },
+    { "content_partial", "only nautilus, not the other word\n", 34 },
+};
+
+/* Files are read in chunks of 64 KiB, and a word can span two */
+#define LARGE_FILE_PATH "content_large"
+#define LARGE_FILE_SPLIT_OFFSET (64 * 1024 - 4)
+
+static void
+create_large_file (void)
+{
+    g_autofree gchar *path = NULL;
+    GString *contents;
+
+    contents = g_string_new (NULL);
+    while (contents->len < LARGE_FILE_SPLIT_OFFSET)
+    {
+        g_string_append_c (contents, 'x');
+    }
+    g_string_append (contents, "nautilus ");
+    while (contents->len < 2 * LARGE_FILE_SPLIT_OFFSET)
+    {
+        g_string_append_c (contents, 'x');
+    }
+    g_string_append (contents, " content\n");
+
+    path = g_build_filename (test_get_tmp_dir (), LARGE_FILE_PATH, NULL);
+    g_assert_true (g_file_set_contents (path, contents->str, contents->len, NULL));
+
+    g_string_free (contents, TRUE);
+}
+
+static void
+create_files (void)
+{
+    g_autofree gchar *folder = NULL;
+    g_autofree gchar *path = NULL;
+
+    folder = g_build_filename (test_get_tmp_dir (), "content_folder", NULL);
+    g_mkdir (folder, 0700);
+
+    for (guint i = 0; i < G_N_ELEMENTS (files); i++)
+    {
+        g_free (path);
+        path = g_build_filename (test_get_tmp_dir (), files[i].path, NULL);
+        g_assert_true (g_file_set_contents (path, files[i].contents, files[i].length, NULL));
+    }
+
+    create_large_file ();
+}
+
+static void
+delete_files (void)
+{
+    g_autofree gchar *folder = NULL;
+    g_autofree gchar *path = NULL;
+
+    for (guint i = 0; i < G_N_ELEMENTS (files); i++)
+    {
+        g_free (path);
+        path = g_build_filename (test_get_tmp_dir (), files[i].path, NULL);
+        g_unlink (path);
+    }
+
+    g_free (path);
+    path = g_build_filename (test_get_tmp_dir (), LARGE_FILE_PATH, NULL);
+    g_unlink (path);
+
+    folder = g_build_filename (test_get_tmp_dir (), "content_folder", NULL);
+    g_rmdir (folder);
+}
+
+static void
+hits_added_cb (NautilusSearchEngine *engine,
+               GSList               *hits)
+{
+    g_print ("Hits added for search engine content!\n");
+    for (gint hit_number = 0; hits != NULL; hits = hits->next, hit_number++)
+    {
+        g_print ("Hit %i: %s\n", hit_number, nautilus_search_hit_get_uri (hits->data));
+        g_assert_nonnull (nautilus_search_hit_get_fts_snippet (hits->data));
+        total_hits += 1;
+    }
+}
+
+static void
+finished_cb (NautilusSearchEngine         *engine,
+             NautilusSearchProviderStatus  status,
+             gpointer                      user_data)
+{
+    nautilus_search_provider_stop (NAUTILUS_SEARCH_PROVIDER (engine));
+
+    g_print ("\nNautilus search engine content finished!\n");
+
+    delete_files ();
+
+    g_main_loop_quit (user_data);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_autoptr (GMainLoop) loop = NULL;
+    NautilusSearchEngine *engine;
+    g_autoptr (NautilusQuery) query = NULL;
+    g_autoptr (GFile) location = NULL;
+
+    loop = g_main_loop_new (NULL, FALSE);
+
+    nautilus_ensure_extension_points ();
+    /* Needed for nautilus-query.c.
+     * FIXME: tests are not installed, so the system does not
+     * have the gschema. Installed tests is a long term GNOME goal.
+     */
+    nautilus_global_preferences_init ();
+
+    engine = nautilus_search_engine_new ();
+    g_signal_connect (engine, "hits-added",
+                      G_CALLBACK (hits_added_cb), NULL);
+    g_signal_connect (engine, "finished",
+                      G_CALLBACK (finished_cb), loop);
+
+    query = nautilus_query_new ();
+    nautilus_query_set_text (query, "nautilus content");
+    nautilus_query_set_search_content (query, NAUTILUS_QUERY_SEARCH_CONTENT_FULL_TEXT);
+    nautilus_query_set_recursive (query, NAUTILUS_QUERY_RECURSIVE_ALWAYS);
+
+    location = g_file_new_for_path (test_get_tmp_dir ());
+    nautilus_query_set_location (query, location);
+    nautilus_search_provider_set_query (NAUTILUS_SEARCH_PROVIDER (engine), query);
+
+    create_files ();
+
+    nautilus_search_engine_start_by_target (NAUTILUS_SEARCH_PROVIDER (engine),
+                                            NAUTILUS_SEARCH_ENGINE_CONTENT_ENGINE);
+
+    g_main_loop_run (loop);
+
+    g_assert_cmpint (total_hits, ==, 3);
+
+    test_clear_tmp_dir ();
+
+    return 0;
+}
@@ -0,0 +1,123 @@
+#include <glib/gstdio.h>
+#include <gio/gio.h>
+#include "src/nautilus-search-prune-rules.h"
+
+static gboolean
+is_pruned (NautilusSearchPruneRules *rules,
+           GFile                    *base,
+           const char               *path)
+{
+    g_autoptr (GFile) directory = NULL;
+    g_autofree gchar *name = NULL;
+
+    directory = g_file_resolve_relative_path (base, path);
+    name = g_file_get_basename (directory);
+
+    return nautilus_search_prune_rules_match (rules, directory, name);
+}
+
+/* Tests the names that are always pruned, and the preference */
+static void
+test_patterns (void)
+{
+    const char * const patterns[] = { "node_modules", "*.egg-info", "/anchored", NULL };
+    g_autoptr (NautilusSearchPruneRules) rules = NULL;
+    g_autoptr (GFile) base = NULL;
+
+    rules = nautilus_search_prune_rules_new (patterns);
+    base = g_file_new_for_path ("/nonexistent");
+
+    g_assert_true (is_pruned (rules, base, ".git"));
+    g_assert_true (is_pruned (rules, base, "project/node_modules"));
+    g_assert_true (is_pruned (rules, base, "project/foo.egg-info"));
+    g_assert_false (is_pruned (rules, base, "project/src"));
+    /* Only ignore files have folders for paths to be relative to */
+    g_assert_false (is_pruned (rules, base, "anchored"));
+
+    g_assert_true (nautilus_search_prune_rules_is_ignore_file (".gitignore"));
+    g_assert_true (nautilus_search_prune_rules_is_ignore_file (".ignore"));
+    g_assert_false (nautilus_search_prune_rules_is_ignore_file ("ignore"));
+}
+
+/* Tests reading .gitignore and .ignore files */
+static void
+test_ignore_files (void)
+{
+    const char * const patterns[] = { "node_modules", NULL };
+    g_autoptr (NautilusSearchPruneRules) rules = NULL;
+    g_autoptr (NautilusSearchPruneRules) directory_rules = NULL;
+    g_autoptr (NautilusSearchPruneRules) empty_directory_rules = NULL;
+    g_autoptr (GFile) base = NULL;
+    g_autoptr (GFile) empty = NULL;
+    g_autofree gchar *directory = NULL;
+    g_autofree gchar *gitignore = NULL;
+    g_autofree gchar *ignore = NULL;
+    g_autofree gchar *empty_path = NULL;
+
+    directory = g_dir_make_tmp ("nautilus-prune-rules.XXXXXX", NULL);
+    g_assert_nonnull (directory);
+    gitignore = g_build_filename (directory, ".gitignore", NULL);
+    ignore = g_build_filename (directory, ".ignore", NULL);
+    empty_path = g_build_filename (directory, "empty", NULL);
+    g_assert_true (g_file_set_contents (gitignore,
+                                        "# Build output\n"
+                                        "build/\n"
+                                        "/out\n"
+                                        "docs/generated\n"
+                                        "cache*\n"
+                                        "!cache-keep\n"
+                                        "[Tt]emp\n",
+                                        -1, NULL));
+    g_assert_true (g_file_set_contents (ignore, "target\r\n", -1, NULL));
+    g_assert_cmpint (g_mkdir (empty_path, 0700), ==, 0);
+
+    rules = nautilus_search_prune_rules_new (patterns);
+    base = g_file_new_for_path (directory);
+    empty = g_file_new_for_path (empty_path);
+    directory_rules = nautilus_search_prune_rules_new_for_directory (rules, base, NULL);
+
+    g_assert_true (is_pruned (directory_rules, base, "build"));
+    g_assert_true (is_pruned (directory_rules, base, "src/build"));
+    g_assert_true (is_pruned (directory_rules, base, "out"));
+    g_assert_false (is_pruned (directory_rules, base, "src/out"));
+    g_assert_true (is_pruned (directory_rules, base, "docs/generated"));
+    g_assert_false (is_pruned (directory_rules, base, "src/docs/generated"));
+    g_assert_true (is_pruned (directory_rules, base, "cache-old"));
+    g_assert_false (is_pruned (directory_rules, base, "cache-keep"));
+    g_assert_true (is_pruned (directory_rules, base, "target"));
+    /* Character classes aren't supported, so nothing is pruned for them */
+    g_assert_false (is_pruned (directory_rules, base, "Temp"));
+    /* The rules of parent folders still apply */
+    g_assert_true (is_pruned (directory_rules, base, "node_modules"));
+    g_assert_false (is_pruned (directory_rules, base, "src"));
+
+    /* Folders without ignore files share the rules of their parent */
+    empty_directory_rules = nautilus_search_prune_rules_new_for_directory (directory_rules, empty, NULL);
+    g_assert_true (empty_directory_rules == directory_rules);
+
+    g_rmdir (empty_path);
+    g_unlink (gitignore);
+    g_unlink (ignore);
+    g_rmdir (directory);
+}
+
+static void
+setup_test_suite (void)
+{
+    g_test_add_func ("/search-prune-rules/patterns",
+                     test_patterns);
+    g_test_add_func ("/search-prune-rules/ignore-files",
+                     test_ignore_files);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    g_test_set_nonfatal_assertions ();
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
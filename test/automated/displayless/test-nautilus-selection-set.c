@@ -0,0 +1,149 @@
+#include <glib.h>
+#include "src/nautilus-directory.h"
+#include "src/nautilus-file.h"
+#include "src/nautilus-file-utilities.h"
+#include "src/nautilus-selection-set.h"
+
+#define ROOT_DIR "file:///tmp"
+
+static GList *
+create_files (NautilusDirectory *directory,
+              const char        *prefix,
+              guint              n_files)
+{
+    GList *files = NULL;
+
+    for (guint i = 0; i < n_files; i++)
+    {
+        g_autofree gchar *file_name = NULL;
+        NautilusFile *file;
+
+        file_name = g_strdup_printf ("%s_%u", prefix, i);
+        file = nautilus_file_new_from_filename (directory, file_name, FALSE);
+        nautilus_directory_add_file (directory, file);
+        files = g_list_prepend (files, file);
+    }
+
+    return g_list_reverse (files);
+}
+
+/* Tests adding, removing and looking up files */
+static void
+test_add_remove (void)
+{
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (NautilusSelectionSet) set = NULL;
+    g_autolist (NautilusFile) files = NULL;
+    g_autolist (NautilusFile) set_files = NULL;
+
+    directory = nautilus_directory_get_by_uri (ROOT_DIR);
+    files = create_files (directory, "selection_set_add_remove", 2);
+    set = nautilus_selection_set_new ();
+
+    g_assert_true (nautilus_selection_set_add (set, files->data));
+    g_assert_false (nautilus_selection_set_add (set, files->data));
+    g_assert_true (nautilus_selection_set_contains (set, files->data));
+    g_assert_false (nautilus_selection_set_contains (set, files->next->data));
+    g_assert_cmpuint (nautilus_selection_set_get_size (set), ==, 1);
+
+    set_files = nautilus_selection_set_get_files (set);
+    g_assert_cmpuint (g_list_length (set_files), ==, 1);
+    g_assert_true (set_files->data == files->data);
+
+    g_assert_true (nautilus_selection_set_remove (set, files->data));
+    g_assert_false (nautilus_selection_set_remove (set, files->data));
+    g_assert_cmpuint (nautilus_selection_set_get_size (set), ==, 0);
+}
+
+/* Tests comparing sets built from the same files in a different order */
+static void
+test_equal (void)
+{
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (NautilusSelectionSet) set_a = NULL;
+    g_autoptr (NautilusSelectionSet) set_b = NULL;
+    g_autolist (NautilusFile) files = NULL;
+    g_autoptr (GList) reversed = NULL;
+
+    directory = nautilus_directory_get_by_uri (ROOT_DIR);
+    files = create_files (directory, "selection_set_equal", 1000);
+    reversed = g_list_reverse (g_list_copy (files));
+
+    set_a = nautilus_selection_set_new_from_list (files);
+    set_b = nautilus_selection_set_new_from_list (reversed);
+    g_assert_true (nautilus_selection_set_equal (set_a, set_b));
+
+    nautilus_selection_set_remove (set_b, files->data);
+    g_assert_false (nautilus_selection_set_equal (set_a, set_b));
+}
+
+/* Tests the differences reported when replacing the contents of a set */
+static void
+test_replace (void)
+{
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (NautilusSelectionSet) set = NULL;
+    g_autolist (NautilusFile) files = NULL;
+    g_autolist (NautilusFile) added = NULL;
+    g_autolist (NautilusFile) removed = NULL;
+    g_autoptr (GList) old_selection = NULL;
+    g_autoptr (GList) new_selection = NULL;
+
+    directory = nautilus_directory_get_by_uri (ROOT_DIR);
+    files = create_files (directory, "selection_set_replace", 4);
+
+    /* Files 0 and 1 at first, then files 1, 2 and 3 */
+    old_selection = g_list_append (old_selection, g_list_nth_data (files, 0));
+    old_selection = g_list_append (old_selection, g_list_nth_data (files, 1));
+    new_selection = g_list_copy (files->next);
+
+    set = nautilus_selection_set_new_from_list (old_selection);
+    g_assert_false (nautilus_selection_set_replace (set, old_selection, &added, &removed));
+    g_assert_null (added);
+    g_assert_null (removed);
+
+    g_assert_true (nautilus_selection_set_replace (set, new_selection, &added, &removed));
+    g_assert_cmpuint (g_list_length (added), ==, 2);
+    g_assert_nonnull (g_list_find (added, g_list_nth_data (files, 2)));
+    g_assert_nonnull (g_list_find (added, g_list_nth_data (files, 3)));
+    g_assert_cmpuint (g_list_length (removed), ==, 1);
+    g_assert_true (removed->data == files->data);
+    g_assert_cmpuint (nautilus_selection_set_get_size (set), ==, 3);
+
+    g_assert_true (nautilus_selection_set_intersects (set, files));
+    g_assert_false (nautilus_selection_set_intersects (set, removed));
+
+    /* Files added one by one are dropped by the next replacement too */
+    g_assert_true (nautilus_selection_set_add (set, files->data));
+    g_clear_list (&added, (GDestroyNotify) nautilus_file_unref);
+    g_clear_list (&removed, (GDestroyNotify) nautilus_file_unref);
+    g_assert_true (nautilus_selection_set_replace (set, new_selection, &added, &removed));
+    g_assert_null (added);
+    g_assert_cmpuint (g_list_length (removed), ==, 1);
+    g_assert_true (removed->data == files->data);
+    g_assert_cmpuint (nautilus_selection_set_get_size (set), ==, 3);
+}
+
+static void
+setup_test_suite (void)
+{
+    g_test_add_func ("/selection-set/add-remove",
+                     test_add_remove);
+    g_test_add_func ("/selection-set/equal",
+                     test_equal);
+    g_test_add_func ("/selection-set/replace",
+                     test_replace);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    g_test_set_nonfatal_assertions ();
+    nautilus_ensure_extension_points ();
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
@@ -0,0 +1,240 @@
+#include <glib.h>
+#include "src/nautilus-directory.h"
+#include "src/nautilus-file.h"
+#include "src/nautilus-file-private.h"
+#include "src/nautilus-file-utilities.h"
+#include "src/nautilus-selection-summary.h"
+
+#define ROOT_DIR "file:///tmp"
+
+/* Gives @file the info it would have read, with a size of -1 for unknown */
+static void
+set_file_info (NautilusFile *file,
+               GFileType     type,
+               goffset       size,
+               gboolean      can_trash)
+{
+    g_autoptr (GFileInfo) info = NULL;
+    g_autofree gchar *name = NULL;
+
+    name = nautilus_file_get_name (file);
+    info = g_file_info_new ();
+    g_file_info_set_name (info, name);
+    g_file_info_set_display_name (info, name);
+    g_file_info_set_edit_name (info, name);
+    g_file_info_set_file_type (info, type);
+    g_file_info_set_is_symlink (info, FALSE);
+    g_file_info_set_is_hidden (info, FALSE);
+    g_file_info_set_is_backup (info, FALSE);
+    if (size >= 0)
+    {
+        g_file_info_set_size (info, size);
+    }
+    g_file_info_set_attribute_boolean (info, G_FILE_ATTRIBUTE_ACCESS_CAN_DELETE, TRUE);
+    g_file_info_set_attribute_boolean (info, G_FILE_ATTRIBUTE_ACCESS_CAN_TRASH, can_trash);
+    g_file_info_set_attribute_boolean (info, G_FILE_ATTRIBUTE_ACCESS_CAN_RENAME, TRUE);
+
+    nautilus_file_update_info (file, info);
+}
+
+static NautilusFile *
+create_file (NautilusDirectory *directory,
+             const char        *name,
+             GFileType          type,
+             goffset            size,
+             gboolean           can_trash)
+{
+    NautilusFile *file;
+
+    file = nautilus_file_new_from_filename (directory, name, FALSE);
+    nautilus_directory_add_file (directory, file);
+    set_file_info (file, type, size, can_trash);
+
+    return file;
+}
+
+static void
+assert_empty (NautilusSelectionSummary *summary)
+{
+    guint item_count = G_MAXUINT;
+    goffset size = -1;
+
+    g_assert_cmpuint (nautilus_selection_summary_get_count (summary), ==, 0);
+    g_assert_null (nautilus_selection_summary_get_any_file (summary));
+    g_assert_cmpuint (nautilus_selection_summary_get_folder_count (summary), ==, 0);
+    g_assert_true (nautilus_selection_summary_get_folder_item_count (summary, &item_count));
+    g_assert_cmpuint (item_count, ==, 0);
+    g_assert_false (nautilus_selection_summary_get_non_folder_size (summary, &size));
+    g_assert_cmpint (size, ==, 0);
+
+    /* Every file of an empty selection has any property, and none does */
+    for (guint i = 0; i < NAUTILUS_SELECTION_SUMMARY_N_FLAGS; i++)
+    {
+        g_assert_true (nautilus_selection_summary_all (summary, 1 << i));
+        g_assert_false (nautilus_selection_summary_any (summary, 1 << i));
+    }
+}
+
+/* Tests the totals of an empty selection */
+static void
+test_empty (void)
+{
+    g_autoptr (NautilusSelectionSummary) summary = NULL;
+
+    summary = nautilus_selection_summary_new ();
+    assert_empty (summary);
+}
+
+/* Tests the totals as files are added and removed */
+static void
+test_add_remove (void)
+{
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (NautilusSelectionSummary) summary = NULL;
+    g_autoptr (NautilusFile) large = NULL;
+    g_autoptr (NautilusFile) small = NULL;
+    g_autoptr (NautilusFile) folder = NULL;
+    guint item_count;
+    goffset size;
+
+    directory = nautilus_directory_get_by_uri (ROOT_DIR);
+    large = create_file (directory, "selection_summary_add_large", G_FILE_TYPE_REGULAR, 100, TRUE);
+    small = create_file (directory, "selection_summary_add_small", G_FILE_TYPE_REGULAR, 50, FALSE);
+    folder = create_file (directory, "selection_summary_add_folder", G_FILE_TYPE_DIRECTORY, -1, TRUE);
+    summary = nautilus_selection_summary_new ();
+
+    nautilus_selection_summary_add_file (summary, large);
+    nautilus_selection_summary_add_file (summary, small);
+    nautilus_selection_summary_add_file (summary, folder);
+    g_assert_cmpuint (nautilus_selection_summary_get_count (summary), ==, 3);
+    g_assert_cmpuint (nautilus_selection_summary_get_folder_count (summary), ==, 1);
+    g_assert_true (nautilus_selection_summary_get_non_folder_size (summary, &size));
+    g_assert_cmpint (size, ==, 150);
+    g_assert_true (nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_CAN_DELETE));
+    g_assert_false (nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_CAN_TRASH));
+    g_assert_true (nautilus_selection_summary_any (summary, NAUTILUS_SELECTION_SUMMARY_CAN_TRASH));
+    g_assert_true (nautilus_selection_summary_any (summary, NAUTILUS_SELECTION_SUMMARY_DIRECTORY));
+    g_assert_false (nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_DIRECTORY));
+    g_assert_false (nautilus_selection_summary_any (summary, NAUTILUS_SELECTION_SUMMARY_IN_TRASH));
+
+    /* Adding a file twice counts it once */
+    nautilus_selection_summary_add_file (summary, large);
+    g_assert_cmpuint (nautilus_selection_summary_get_count (summary), ==, 3);
+    g_assert_true (nautilus_selection_summary_get_non_folder_size (summary, &size));
+    g_assert_cmpint (size, ==, 150);
+
+    /* Removing takes back what the file added, and only once */
+    nautilus_selection_summary_remove_file (summary, small);
+    nautilus_selection_summary_remove_file (summary, small);
+    g_assert_cmpuint (nautilus_selection_summary_get_count (summary), ==, 2);
+    g_assert_true (nautilus_selection_summary_get_non_folder_size (summary, &size));
+    g_assert_cmpint (size, ==, 100);
+    g_assert_true (nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_CAN_TRASH));
+
+    nautilus_selection_summary_remove_file (summary, folder);
+    g_assert_cmpuint (nautilus_selection_summary_get_folder_count (summary), ==, 0);
+    g_assert_true (nautilus_selection_summary_get_folder_item_count (summary, &item_count));
+    g_assert_cmpuint (item_count, ==, 0);
+    g_assert_true (nautilus_selection_summary_get_any_file (summary) == large);
+
+    nautilus_selection_summary_remove_file (summary, large);
+    assert_empty (summary);
+}
+
+/* Tests that updating a file takes back what it added before it changed */
+static void
+test_update_file (void)
+{
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (NautilusSelectionSummary) summary = NULL;
+    g_autoptr (NautilusFile) file = NULL;
+    g_autoptr (NautilusFile) other = NULL;
+    goffset size;
+
+    directory = nautilus_directory_get_by_uri (ROOT_DIR);
+    file = create_file (directory, "selection_summary_update", G_FILE_TYPE_REGULAR, 4000, TRUE);
+    other = create_file (directory, "selection_summary_update_other", G_FILE_TYPE_REGULAR, 20, TRUE);
+    summary = nautilus_selection_summary_new ();
+
+    nautilus_selection_summary_add_file (summary, file);
+    nautilus_selection_summary_add_file (summary, other);
+    g_assert_true (nautilus_selection_summary_get_non_folder_size (summary, &size));
+    g_assert_cmpint (size, ==, 4020);
+
+    /* The file shrinks and can't be trashed anymore */
+    set_file_info (file, G_FILE_TYPE_REGULAR, 10, FALSE);
+    g_assert_true (nautilus_selection_summary_update_file (summary, file));
+    g_assert_true (nautilus_selection_summary_get_non_folder_size (summary, &size));
+    g_assert_cmpint (size, ==, 30);
+    g_assert_false (nautilus_selection_summary_all (summary, NAUTILUS_SELECTION_SUMMARY_CAN_TRASH));
+    g_assert_true (nautilus_selection_summary_any (summary, NAUTILUS_SELECTION_SUMMARY_CAN_TRASH));
+
+    /* Its size isn't known anymore */
+    set_file_info (file, G_FILE_TYPE_REGULAR, -1, FALSE);
+    g_assert_true (nautilus_selection_summary_update_file (summary, file));
+    g_assert_true (nautilus_selection_summary_get_non_folder_size (summary, &size));
+    g_assert_cmpint (size, ==, 20);
+
+    /* Files not in the selection are left alone */
+    nautilus_selection_summary_remove_file (summary, other);
+    g_assert_false (nautilus_selection_summary_update_file (summary, other));
+    g_assert_false (nautilus_selection_summary_get_non_folder_size (summary, &size));
+    g_assert_cmpint (size, ==, 0);
+    g_assert_cmpuint (nautilus_selection_summary_get_count (summary), ==, 1);
+
+    /* Once removed, the file takes back what it added last */
+    nautilus_selection_summary_remove_file (summary, file);
+    assert_empty (summary);
+}
+
+/* Tests that clearing the summary resets every total */
+static void
+test_clear (void)
+{
+    g_autoptr (NautilusDirectory) directory = NULL;
+    g_autoptr (NautilusSelectionSummary) summary = NULL;
+    g_autoptr (NautilusFile) file = NULL;
+    g_autoptr (NautilusFile) folder = NULL;
+    goffset size;
+
+    directory = nautilus_directory_get_by_uri (ROOT_DIR);
+    file = create_file (directory, "selection_summary_clear", G_FILE_TYPE_REGULAR, 70, TRUE);
+    folder = create_file (directory, "selection_summary_clear_folder", G_FILE_TYPE_DIRECTORY, -1, TRUE);
+    summary = nautilus_selection_summary_new ();
+
+    nautilus_selection_summary_add_file (summary, file);
+    nautilus_selection_summary_add_file (summary, folder);
+    nautilus_selection_summary_clear (summary);
+    assert_empty (summary);
+
+    nautilus_selection_summary_add_file (summary, file);
+    g_assert_cmpuint (nautilus_selection_summary_get_count (summary), ==, 1);
+    g_assert_true (nautilus_selection_summary_get_non_folder_size (summary, &size));
+    g_assert_cmpint (size, ==, 70);
+}
+
+static void
+setup_test_suite (void)
+{
+    g_test_add_func ("/selection-summary/empty",
+                     test_empty);
+    g_test_add_func ("/selection-summary/add-remove",
+                     test_add_remove);
+    g_test_add_func ("/selection-summary/update-file",
+                     test_update_file);
+    g_test_add_func ("/selection-summary/clear",
+                     test_clear);
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_test_init (&argc, &argv, NULL);
+    g_test_set_nonfatal_assertions ();
+    nautilus_ensure_extension_points ();
+
+    setup_test_suite ();
+
+    return g_test_run ();
+}
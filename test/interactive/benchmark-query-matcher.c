@@ -0,0 +1,253 @@
+/* Compares how fast file names are ranked against a query by
+ * NautilusQueryMatcher, and by the implementation it replaced, which
+ * normalized every name into new strings under the query lock.
+ *
+ * Usage: benchmark-query-matcher [N_NAMES [N_THREADS]]
+ */
+
+#include <glib.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <src/nautilus-query-matcher.h>
+
+#define DEFAULT_N_NAMES 2000000
+#define QUERY_TEXT "report 2021"
+
+static const char *name_words[] =
+{
+    "Report", "report", "draft", "IMG", "DSC", "invoice", "notes", "2021",
+    "2020", "final", "backup", "Photo", "résumé", "Ñandú", "straße", "data",
+};
+
+static const char *name_extensions[] =
+{
+    ".pdf", ".jpg", ".txt", ".odt", ".png", ".tar.gz", "",
+};
+
+typedef struct
+{
+    char **names;
+    guint n_names;
+    const char *text;
+    GMutex *mutex;
+    NautilusQueryMatcher *matcher;
+    gdouble *ranks;
+} BenchmarkJob;
+
+static gdouble
+reference_match (const char  *text,
+                 char       **prepared_words,
+                 GMutex      *mutex,
+                 const char  *string)
+{
+    gchar *normalized, *prepared_string, *ptr = NULL;
+    gboolean found = TRUE;
+    gint nonexact_malus = 0;
+    gdouble retval;
+
+    g_mutex_lock (mutex);
+    normalized = g_utf8_normalize (string, -1, G_NORMALIZE_NFD);
+    prepared_string = g_utf8_strdown (normalized, -1);
+    g_free (normalized);
+
+    for (gint i = 0; prepared_words[i] != NULL; i++)
+    {
+        if ((ptr = strstr (prepared_string, prepared_words[i])) == NULL)
+        {
+            found = FALSE;
+            break;
+        }
+
+        nonexact_malus += strlen (ptr) - strlen (prepared_words[i]);
+    }
+    g_mutex_unlock (mutex);
+
+    if (!found)
+    {
+        g_free (prepared_string);
+        return -1;
+    }
+
+    retval = MAX (10.0, 50.0 - (gdouble) (ptr - prepared_string) - (gdouble) nonexact_malus / 100);
+    g_free (prepared_string);
+
+    return retval;
+}
+
+static char **
+prepare_words (const char *text)
+{
+    g_autofree gchar *normalized = NULL;
+    g_autofree gchar *prepared = NULL;
+
+    normalized = g_utf8_normalize (text, -1, G_NORMALIZE_NFD);
+    prepared = g_utf8_strdown (normalized, -1);
+
+    return g_strsplit (prepared, " ", -1);
+}
+
+static gpointer
+reference_thread (gpointer user_data)
+{
+    BenchmarkJob *job = user_data;
+    g_auto (GStrv) words = NULL;
+
+    words = prepare_words (job->text);
+    for (guint i = 0; i < job->n_names; i++)
+    {
+        job->ranks[i] = reference_match (job->text, words, job->mutex, job->names[i]);
+    }
+
+    return NULL;
+}
+
+static gpointer
+matcher_thread (gpointer user_data)
+{
+    BenchmarkJob *job = user_data;
+
+    for (guint i = 0; i < job->n_names; i++)
+    {
+        job->ranks[i] = nautilus_query_matcher_match (job->matcher, job->names[i]);
+    }
+
+    return NULL;
+}
+
+static char **
+generate_names (guint n_names)
+{
+    GRand *rand;
+    char **names;
+    GString *name;
+
+    rand = g_rand_new_with_seed (42);
+    names = g_new0 (char *, n_names + 1);
+    name = g_string_new (NULL);
+
+    for (guint i = 0; i < n_names; i++)
+    {
+        guint n_words = g_rand_int_range (rand, 1, 5);
+
+        g_string_truncate (name, 0);
+        for (guint j = 0; j < n_words; j++)
+        {
+            if (j > 0)
+            {
+                g_string_append_c (name, g_rand_boolean (rand) ? ' ' : '_');
+            }
+            g_string_append (name, name_words[g_rand_int_range (rand, 0, G_N_ELEMENTS (name_words))]);
+        }
+        g_string_append_printf (name, "_%04u", g_rand_int_range (rand, 0, 10000));
+        g_string_append (name, name_extensions[g_rand_int_range (rand, 0, G_N_ELEMENTS (name_extensions))]);
+
+        names[i] = g_strdup (name->str);
+    }
+
+    g_string_free (name, TRUE);
+    g_rand_free (rand);
+
+    return names;
+}
+
+/* Runs @func over the names split between @n_threads threads, and returns
+ * the time it took, in seconds. */
+static gdouble
+run (GThreadFunc  func,
+     BenchmarkJob *template,
+     guint         n_threads)
+{
+    g_autofree BenchmarkJob *jobs = NULL;
+    g_autofree GThread **threads = NULL;
+    guint per_thread;
+    gint64 start;
+
+    jobs = g_new0 (BenchmarkJob, n_threads);
+    threads = g_new0 (GThread *, n_threads);
+    per_thread = (template->n_names + n_threads - 1) / n_threads;
+
+    start = g_get_monotonic_time ();
+    for (guint i = 0; i < n_threads; i++)
+    {
+        guint first = MIN (i * per_thread, template->n_names);
+
+        jobs[i] = *template;
+        jobs[i].names = template->names + first;
+        jobs[i].ranks = template->ranks + first;
+        jobs[i].n_names = MIN (per_thread, template->n_names - first);
+        threads[i] = g_thread_new ("benchmark", func, &jobs[i]);
+    }
+    for (guint i = 0; i < n_threads; i++)
+    {
+        g_thread_join (threads[i]);
+    }
+
+    return (gdouble) (g_get_monotonic_time () - start) / G_USEC_PER_SEC;
+}
+
+int
+main (int   argc,
+      char *argv[])
+{
+    g_auto (GStrv) names = NULL;
+    g_autofree gdouble *reference_ranks = NULL;
+    g_autofree gdouble *matcher_ranks = NULL;
+    g_autoptr (NautilusQueryMatcher) matcher = NULL;
+    BenchmarkJob job = { 0 };
+    GMutex mutex;
+    guint n_names = DEFAULT_N_NAMES;
+    guint n_threads = 1;
+    guint n_matches = 0;
+    gdouble reference_time;
+    gdouble matcher_time;
+
+    if (argc > 1)
+    {
+        n_names = MAX (1, atoi (argv[1]));
+    }
+    if (argc > 2)
+    {
+        n_threads = CLAMP (atoi (argv[2]), 1, 64);
+    }
+
+    names = generate_names (n_names);
+    reference_ranks = g_new (gdouble, n_names);
+    matcher_ranks = g_new (gdouble, n_names);
+    g_mutex_init (&mutex);
+    matcher = nautilus_query_matcher_new (QUERY_TEXT);
+
+    job.names = names;
+    job.n_names = n_names;
+    job.text = QUERY_TEXT;
+    job.mutex = &mutex;
+    job.matcher = matcher;
+
+    job.ranks = reference_ranks;
+    reference_time = run (reference_thread, &job, n_threads);
+
+    job.ranks = matcher_ranks;
+    matcher_time = run (matcher_thread, &job, n_threads);
+
+    for (guint i = 0; i < n_names; i++)
+    {
+        if (reference_ranks[i] != matcher_ranks[i])
+        {
+            g_printerr ("Rank mismatch for “%s”: %f, expected %f\n",
+                        names[i], matcher_ranks[i], reference_ranks[i]);
+            return EXIT_FAILURE;
+        }
+        n_matches += matcher_ranks[i] > -1;
+    }
+
+    g_print ("%u names, %u matching “%s”, %u threads\n",
+             n_names, n_matches, QUERY_TEXT, n_threads);
+    g_print ("Previous implementation: %.3f s, %.1f M names/s\n",
+             reference_time, n_names / reference_time / 1e6);
+    g_print ("NautilusQueryMatcher:    %.3f s, %.1f M names/s\n",
+             matcher_time, n_names / matcher_time / 1e6);
+
+    g_mutex_clear (&mutex);
+
+    return EXIT_SUCCESS;
+}